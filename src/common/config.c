@@ -78,6 +78,69 @@ struct nla_policy joolnl_session_entry_policy[JNLASE_COUNT] = {
 	[JNLASE_STATE] = { .type = NLA_U8 },
 	[JNLASE_TIMER] = { .type = NLA_U8 },
 	[JNLASE_EXPIRATION] = { .type = NLA_U32 },
+	[JNLASE_IDLE] = { .type = NLA_U32 },
+	[JNLASE_AGE] = { .type = NLA_U32 },
+};
+
+struct nla_policy joolnl_bulk_failure_policy[JNLABF_COUNT] = {
+	[JNLABF_INDEX] = { .type = NLA_U32 },
+	[JNLABF_CODE] = { .type = NLA_U16 },
+};
+
+struct nla_policy joolnl_digest_policy[JNLADG_COUNT] = {
+	[JNLADG_PROTO] = { .type = NLA_U8 },
+	[JNLADG_START_SRC] = { .type = NLA_NESTED },
+	[JNLADG_START_DST] = { .type = NLA_NESTED },
+	[JNLADG_START_INCLUDE] = { .type = NLA_U8 },
+	[JNLADG_END_SRC] = { .type = NLA_NESTED },
+	[JNLADG_END_DST] = { .type = NLA_NESTED },
+	[JNLADG_SESSIONS] = { .type = NLA_U32 },
+	[JNLADG_HASH] = { .type = NLA_U32 },
+};
+
+struct nla_policy joolnl_joold_socket_policy[JNLAJS_COUNT] = {
+#ifdef __KERNEL__
+	[JNLAJS_ADDR] = { .type = NLA_BINARY, .len = sizeof(struct in6_addr) },
+#else
+	[JNLAJS_ADDR] = {
+		.type = NLA_UNSPEC,
+		.minlen = sizeof(struct in_addr),
+		.maxlen = sizeof(struct in6_addr),
+	},
+#endif
+	[JNLAJS_PORT] = { .type = NLA_U16 },
+	[JNLAJS_IN_IFINDEX] = { .type = NLA_U32 },
+	[JNLAJS_OUT_IFINDEX] = { .type = NLA_U32 },
+	[JNLAJS_TTL] = { .type = NLA_U8 },
+};
+
+struct nla_policy joolnl_filter_policy[JNLAFI_COUNT] = {
+	[JNLAFI_SRC6] = { .type = NLA_NESTED },
+	[JNLAFI_SRC4] = { .type = NLA_NESTED },
+	[JNLAFI_PORT_MIN] = { .type = NLA_U16 },
+	[JNLAFI_PORT_MAX] = { .type = NLA_U16 },
+	[JNLAFI_DST4] = { .type = NLA_NESTED },
+	[JNLAFI_STATE] = { .type = NLA_U8 },
+	[JNLAFI_MIN_AGE] = { .type = NLA_U32 },
+};
+
+struct nla_policy joolnl_subscriber_policy[JNLASU_COUNT] = {
+	[JNLASU_PREFIX] = { .type = NLA_NESTED },
+	[JNLASU_BIBS] = { .type = NLA_U32 },
+	[JNLASU_SESSIONS] = { .type = NLA_U32 },
+};
+
+struct nla_policy joolnl_session_stats_policy[JNLASS_COUNT] = {
+	[JNLASS_BIBS] = { .type = NLA_U32 },
+	[JNLASS_SESSIONS] = { .type = NLA_U32 },
+	[JNLASS_EST] = { .type = NLA_U32 },
+	[JNLASS_TRANS] = { .type = NLA_U32 },
+	[JNLASS_SYN4] = { .type = NLA_U32 },
+	[JNLASS_STORED_PKTS] = { .type = NLA_U32 },
+	[JNLASS_STATES] = { .type = NLA_NESTED },
+	[JNLASS_AGES] = { .type = NLA_NESTED },
+	[JNLASS_EST_TIMEOUT] = { .type = NLA_U32 },
+	[JNLASS_TRANS_TIMEOUT] = { .type = NLA_U32 },
 };
 
 struct nla_policy siit_globals_policy[JNLAG_COUNT] = {
@@ -94,6 +157,8 @@ struct nla_policy siit_globals_policy[JNLAG_COUNT] = {
 	[JNLAG_RANDOMIZE_ERROR_ADDR] = { .type = NLA_U8 },
 	[JNLAG_POOL6791V6] = { .type = NLA_NESTED },
 	[JNLAG_POOL6791V4] = { .type = NLA_NESTED },
+	[JNLAG_XLAT_IN_PLACE] = { .type = NLA_U8 },
+	[JNLAG_DESTINATION_ROUTE_CACHE] = { .type = NLA_U8 },
 };
 
 struct nla_policy nat64_globals_policy[JNLAG_COUNT] = {
@@ -123,6 +188,27 @@ struct nla_policy nat64_globals_policy[JNLAG_COUNT] = {
 	[JNLAG_JOOLD_FLUSH_DEADLINE] = { .type = NLA_U32 },
 	[JNLAG_JOOLD_CAPACITY] = { .type = NLA_U32 },
 	[JNLAG_JOOLD_MAX_PAYLOAD] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_SYNC_TCP] = { .type = NLA_U8 },
+	[JNLAG_JOOLD_SYNC_UDP] = { .type = NLA_U8 },
+	[JNLAG_JOOLD_SYNC_ICMP] = { .type = NLA_U8 },
+	[JNLAG_JOOLD_TCP_EST_ONLY] = { .type = NLA_U8 },
+	[JNLAG_JOOLD_MIN_AGE] = { .type = NLA_U32 },
+	[JNLAG_JOOLD_SRC6_PREFIX] = { .type = NLA_NESTED },
+	[JNLAG_SUBSCRIBER_PREFIX_LEN] = { .type = NLA_U8 },
+	[JNLAG_SUBSCRIBER_MAX_BIBS] = { .type = NLA_U32 },
+	[JNLAG_SUBSCRIBER_MAX_SESSIONS] = { .type = NLA_U32 },
+	[JNLAG_SESSION_MEMORY_LIMIT] = { .type = NLA_U32 },
+	[JNLAG_HIGH_WATER_TCP] = { .type = NLA_U32 },
+	[JNLAG_HIGH_WATER_UDP] = { .type = NLA_U32 },
+	[JNLAG_HIGH_WATER_ICMP] = { .type = NLA_U32 },
+	[JNLAG_BINARY_LOGGING] = { .type = NLA_U8 },
+	[JNLAG_XLAT_IN_PLACE] = { .type = NLA_U8 },
+	[JNLAG_SESSION_ROUTE_CACHE] = { .type = NLA_U8 },
+	[JNLAG_FRAG_TRACKING] = { .type = NLA_U8 },
+	[JNLAG_FRAG_TRACKING_TIMEOUT] = { .type = NLA_U32 },
+	[JNLAG_FRAG_TRACKING_CAPACITY] = { .type = NLA_U32 },
+	[JNLAG_FLOW_CACHE] = { .type = NLA_U8 },
+	[JNLAG_FLOW_CACHE_CAPACITY] = { .type = NLA_U32 },
 };
 
 int iname_validate(const char *iname, bool allow_null)
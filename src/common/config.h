@@ -12,10 +12,12 @@
 #else
 #include <netlink/attr.h>
 #endif
+#include "common/session.h"
 #include "common/types.h"
 
 #define JOOLNL_FAMILY "Jool"
 #define JOOLNL_MULTICAST_GRP_NAME "joold"
+#define JOOLNL_EVENTS_GRP_NAME "jool_events"
 
 #define JOOLNL_HDR_MAGIC "jool"
 #define JOOLNL_HDR_MAGIC_LEN 4
@@ -61,6 +63,13 @@ enum joolnl_operation {
 	JNLOP_JOOLD_ADD,
 	JNLOP_JOOLD_ADVERTISE,
 	JNLOP_JOOLD_ACK,
+	JNLOP_JOOLD_RESYNC,
+	JNLOP_JOOLD_TRANSPORT,
+
+	JNLOP_SUBSCRIBER_FOREACH,
+	JNLOP_SESSION_STATS,
+	JNLOP_SESSION_ADD,
+	JNLOP_SESSION_TOUCH,
 };
 
 enum joolnl_attr_root {
@@ -77,12 +86,24 @@ enum joolnl_attr_root {
 	JNLAR_PROTO,
 	JNLAR_ATOMIC_INIT,
 	JNLAR_ATOMIC_END,
+	JNLAR_BULK_FAILURES,
+	JNLAR_BULK_LOG,
+	JNLAR_ATOMIC_INCREMENTAL,
+	JNLAR_ATOMIC_RM,
+	JNLAR_FILTER,
+	JNLAR_TOP,
+	JNLAR_HISTOGRAM,
+	JNLAR_EVENTS,
+	JNLAR_EVENTS_DROPPED,
 	JNLAR_COUNT,
 #define JNLAR_MAX (JNLAR_COUNT - 1)
 };
 
 enum joolnl_attr_list {
 	JNLAL_ENTRY = 1,
+	/* joold packets only. (See enum joolnl_attr_digest.) */
+	JNLAL_DIGEST,
+	JNLAL_RANGE,
 	JNLAL_COUNT,
 #define JNLAL_MAX (JNLAL_COUNT - 1)
 };
@@ -198,12 +219,185 @@ enum joolnl_attr_session {
 	JNLASE_STATE,
 	JNLASE_TIMER,
 	JNLASE_EXPIRATION,
+	/*
+	 * Milliseconds since the session's last packet. (Only used by
+	 * JNLOP_SESSION_TOUCH requests, and overrides JNLASE_EXPIRATION.)
+	 */
+	JNLASE_IDLE,
+	/*
+	 * Milliseconds since the session was created, wherever that happened.
+	 * Optional; if absent, the session is new.
+	 */
+	JNLASE_AGE,
 	JNLASE_COUNT,
 #define JNLASE_MAX (JNLASE_COUNT - 1)
 };
 
 extern struct nla_policy joolnl_session_entry_policy[JNLASE_COUNT];
 
+/*
+ * Entry that could not be added during a bulk add.
+ * (Bulk adds are the add operations whose request carries a *_ENTRIES list
+ * instead of a JNLAR_OPERAND.)
+ */
+enum joolnl_attr_bulk_failure {
+	/* Position of the entry in the request's list. */
+	JNLABF_INDEX = 1,
+	/* Positive error code. */
+	JNLABF_CODE,
+	JNLABF_COUNT,
+#define JNLABF_MAX (JNLABF_COUNT - 1)
+};
+
+extern struct nla_policy joolnl_bulk_failure_policy[JNLABF_COUNT];
+
+/*
+ * joold session digest.
+ * JNLAL_RANGE elements (requests for the sessions of a range) only include the
+ * proto, start and end attributes.
+ */
+enum joolnl_attr_digest {
+	JNLADG_PROTO = 1,
+	JNLADG_START_SRC,
+	JNLADG_START_DST,
+	JNLADG_START_INCLUDE,
+	JNLADG_END_SRC,
+	JNLADG_END_DST,
+	JNLADG_SESSIONS,
+	JNLADG_HASH,
+	JNLADG_COUNT,
+#define JNLADG_MAX (JNLADG_COUNT - 1)
+};
+
+extern struct nla_policy joolnl_digest_policy[JNLADG_COUNT];
+
+/*
+ * Kernel joold socket. (JNLOP_JOOLD_TRANSPORT's operand.)
+ * If the operand is absent, the kernel goes back to the Netlink transport.
+ */
+enum joolnl_attr_joold_socket {
+	/* IPv4 or IPv6 address where the sessions will be advertised. */
+	JNLAJS_ADDR = 1,
+	JNLAJS_PORT,
+	JNLAJS_IN_IFINDEX,
+	JNLAJS_OUT_IFINDEX,
+	JNLAJS_TTL,
+	JNLAJS_COUNT,
+#define JNLAJS_MAX (JNLAJS_COUNT - 1)
+};
+
+extern struct nla_policy joolnl_joold_socket_policy[JNLAJS_COUNT];
+
+/*
+ * BIB/session display filter. (JNLAR_FILTER.)
+ * Only the entries that match all of the included attributes are listed.
+ * BIB requests only accept SRC6, SRC4 and the ports.
+ */
+enum joolnl_attr_filter {
+	/* Prefix the IPv6 node's address (src6) has to belong to. */
+	JNLAFI_SRC6 = 1,
+	/* Prefix the pool4 address (src4) has to belong to. */
+	JNLAFI_SRC4,
+	/* Range the pool4 port/identifier has to belong to. (Inclusive.) */
+	JNLAFI_PORT_MIN,
+	JNLAFI_PORT_MAX,
+	/* Prefix the IPv4 node's address (dst4) has to belong to. */
+	JNLAFI_DST4,
+	/* TCP state. */
+	JNLAFI_STATE,
+	/* Minimum time since the session was created, in milliseconds. */
+	JNLAFI_MIN_AGE,
+	JNLAFI_COUNT,
+#define JNLAFI_MAX (JNLAFI_COUNT - 1)
+};
+
+extern struct nla_policy joolnl_filter_policy[JNLAFI_COUNT];
+
+/*
+ * Group of BIB entries whose src6 share the first subscriber-prefix-len bits.
+ * (JNLOP_SUBSCRIBER_FOREACH's list elements; the offset is a bare prefix.)
+ *
+ * If the request includes JNLAR_TOP, the response is a single message that
+ * contains the (at most SUBSCRIBER_TOP_MAX) subscribers with the most
+ * sessions, sorted in descending order.
+ */
+enum joolnl_attr_subscriber {
+	JNLASU_PREFIX = 1,
+	JNLASU_BIBS,
+	JNLASU_SESSIONS,
+	JNLASU_COUNT,
+#define JNLASU_MAX (JNLASU_COUNT - 1)
+};
+
+extern struct nla_policy joolnl_subscriber_policy[JNLASU_COUNT];
+
+/*
+ * BIB/session logging, binary flavor. (See bib_config.binary_logging.)
+ *
+ * Events are multicast to the JOOLNL_EVENTS_GRP_NAME group in batches. Each
+ * message contains a JNLAR_EVENTS attribute (an array of struct jool_events)
+ * and, if some events could not be delivered since the previous message from
+ * the same CPU, a JNLAR_EVENTS_DROPPED u32 that counts them.
+ *
+ * The kernel and the collector always share a host, so the fields are in host
+ * byte order. (Addresses are still in network byte order, as usual.)
+ */
+enum jool_event_type {
+	JEV_BIB_ADD = 1,
+	JEV_BIB_RM,
+	JEV_SESSION_ADD,
+	JEV_SESSION_RM,
+};
+
+struct jool_event {
+	/* Nanoseconds since the epoch. */
+	__u64 time;
+	struct in6_addr src6;
+	/* Zero in BIB events. */
+	struct in6_addr dst6;
+	struct in_addr src4;
+	/* Zero in BIB events. */
+	struct in_addr dst4;
+	__u16 src6_port;
+	__u16 dst6_port;
+	__u16 src4_port;
+	__u16 dst4_port;
+	__u8 type; /* enum jool_event_type */
+	__u8 proto; /* l4_protocol */
+	__u8 reserved[6];
+};
+
+/*
+ * JNLOP_SESSION_STATS's response.
+ *
+ * The counters are maintained by the session table, so they are cheap. The
+ * age histogram (JNLASS_AGES) requires a walk, so it's only included if the
+ * request contains JNLAR_HISTOGRAM.
+ *
+ * JNLASS_STATES and JNLASS_AGES are lists of NLA_U32s, indexed by tcp_state
+ * and histogram bucket, respectively. (Plus one, since attribute types cannot
+ * be zero.)
+ */
+enum joolnl_attr_session_stats {
+	JNLASS_BIBS = 1,
+	JNLASS_SESSIONS,
+	/* Sessions queued on each expirer. */
+	JNLASS_EST,
+	JNLASS_TRANS,
+	JNLASS_SYN4,
+	/* Packets stored for Simultaneous Open. */
+	JNLASS_STORED_PKTS,
+	JNLASS_STATES,
+	JNLASS_AGES,
+	/* Current timeouts (in milliseconds), after adaptation. */
+	JNLASS_EST_TIMEOUT,
+	JNLASS_TRANS_TIMEOUT,
+	JNLASS_COUNT,
+#define JNLASS_MAX (JNLASS_COUNT - 1)
+};
+
+extern struct nla_policy joolnl_session_stats_policy[JNLASS_COUNT];
+
 enum joolnl_attr_address_query {
 	JNLAAQ_ADDR6 = 1,
 	JNLAAQ_ADDR4,
@@ -252,6 +446,38 @@ enum joolnl_attr_global {
 	JNLAG_JOOLD_FLUSH_DEADLINE,
 	JNLAG_JOOLD_CAPACITY,
 	JNLAG_JOOLD_MAX_PAYLOAD,
+	JNLAG_JOOLD_SYNC_TCP,
+	JNLAG_JOOLD_SYNC_UDP,
+	JNLAG_JOOLD_SYNC_ICMP,
+	JNLAG_JOOLD_TCP_EST_ONLY,
+	JNLAG_JOOLD_MIN_AGE,
+	JNLAG_JOOLD_SRC6_PREFIX,
+
+	/* NAT64, again */
+	JNLAG_SUBSCRIBER_PREFIX_LEN,
+	JNLAG_SUBSCRIBER_MAX_BIBS,
+	JNLAG_SUBSCRIBER_MAX_SESSIONS,
+	JNLAG_SESSION_MEMORY_LIMIT,
+	JNLAG_HIGH_WATER_TCP,
+	JNLAG_HIGH_WATER_UDP,
+	JNLAG_HIGH_WATER_ICMP,
+	JNLAG_BINARY_LOGGING,
+
+	/* Common, again */
+	JNLAG_XLAT_IN_PLACE,
+
+	/* NAT64, once more */
+	JNLAG_SESSION_ROUTE_CACHE,
+
+	/* SIIT, again */
+	JNLAG_DESTINATION_ROUTE_CACHE,
+
+	/* NAT64, yet again */
+	JNLAG_FRAG_TRACKING,
+	JNLAG_FRAG_TRACKING_TIMEOUT,
+	JNLAG_FRAG_TRACKING_CAPACITY,
+	JNLAG_FLOW_CACHE,
+	JNLAG_FLOW_CACHE_CAPACITY,
 
 	/* Needs to be last */
 	JNLAG_COUNT,
@@ -321,6 +547,54 @@ struct config_prefix4 {
 	struct ipv4_prefix prefix;
 };
 
+/**
+ * Conditions a BIB or session entry has to meet to be listed.
+ * (Unset conditions always match.)
+ */
+struct table_filter {
+	struct config_prefix6 src6;
+	struct config_prefix4 src4;
+	bool ports_set;
+	__u16 port_min;
+	__u16 port_max;
+	struct config_prefix4 dst4;
+	bool state_set;
+	__u8 state; /* enum tcp_state */
+	/* Milliseconds. Zero means "any age." */
+	__u32 min_age;
+};
+
+struct subscriber_entry {
+	struct ipv6_prefix prefix;
+	/* Number of BIB entries whose src6 belongs to @prefix. */
+	__u32 bibs;
+	/* Number of sessions of those BIB entries. */
+	__u32 sessions;
+};
+
+/*
+ * Upper limits (in seconds, exclusive) of the session age histogram's buckets.
+ * There is one more bucket, which has no upper limit.
+ */
+#define SESSION_AGE_LIMITS { 10, 60, 300, 1800, 7200, 86400 }
+#define SESSION_AGE_BUCKETS 7
+
+struct session_stats {
+	__u32 bibs;
+	__u32 sessions;
+	__u32 est;
+	__u32 trans;
+	__u32 syn4;
+	__u32 stored_pkts;
+	__u32 states[TCP_STATE_COUNT];
+	/* Effective timeouts, in milliseconds. (See bib_config.high_water.) */
+	__u32 est_timeout;
+	__u32 trans_timeout;
+	/* Only meaningful if the histogram was requested. */
+	bool has_ages;
+	__u32 ages[SESSION_AGE_BUCKETS];
+};
+
 /**
  * Issued during atomic configuration initialization.
  */
@@ -404,6 +678,18 @@ struct bib_config {
 
 	bool bib_logging;
 	bool session_logging;
+	/**
+	 * Send the events enabled by @bib_logging and @session_logging to the
+	 * JOOLNL_EVENTS_GRP_NAME multicast group (as struct jool_events)
+	 * instead of the kernel log?
+	 */
+	bool binary_logging;
+
+	/**
+	 * Have each session remember the routes of its packets, so established
+	 * flows don't need a FIB lookup per packet?
+	 */
+	bool route_cache;
 
 	/** Use Address-Dependent Filtering? */
 	bool drop_by_addr;
@@ -411,6 +697,35 @@ struct bib_config {
 	bool drop_external_tcp;
 
 	__u32 max_stored_pkts;
+
+	/**
+	 * Length of the src6 prefix that identifies a subscriber.
+	 * Zero disables the subscriber index.
+	 */
+	__u8 subscriber_prefix_len;
+	/**
+	 * Maximum number of BIB entries and sessions a subscriber can have
+	 * before its new connections start being rejected.
+	 * Zero means "unlimited." Static entries and joold are exempt.
+	 */
+	__u32 subscriber_max_bibs;
+	__u32 subscriber_max_sessions;
+	/**
+	 * Maximum memory (in KiB) the instance's BIB entries and sessions can
+	 * use. Once reached, new sessions evict the oldest TCP transitory, UDP
+	 * and ICMP sessions. Zero means "unlimited."
+	 */
+	__u32 session_memory_limit;
+	/**
+	 * Number of sessions each table is expected to stay under.
+	 * From half of this on, the table's timeouts start shrinking. (See
+	 * ADAPTIVE_TIMEOUT_DIVISOR.) Zero disables the adaptation.
+	 */
+	struct {
+		__u32 tcp;
+		__u32 udp;
+		__u32 icmp;
+	} high_water;
 };
 
 #define JOOLD_MAX_PAYLOAD 2048
@@ -468,6 +783,30 @@ struct joold_config {
 	 * code. (I guess I'm missing something.)
 	 */
 	__u32 max_payload;
+
+	/*
+	 * Synchronization filters.
+	 *
+	 * Most sessions (DNS queries, pings) are not worth synchronizing
+	 * because they are useless by the time a failover happens. Sessions
+	 * that fail any of these checks are simply not queued.
+	 */
+
+	/** Synchronize TCP sessions? */
+	bool sync_tcp;
+	/** Synchronize UDP sessions? */
+	bool sync_udp;
+	/** Synchronize ICMP sessions? */
+	bool sync_icmp;
+	/** Only synchronize TCP sessions in the ESTABLISHED state? */
+	bool tcp_est_only;
+	/**
+	 * Milliseconds a session has to have existed before it is
+	 * synchronized. (Zero disables the filter.)
+	 */
+	__u32 min_age;
+	/** If set, only synchronize sessions whose src6 belongs here. */
+	struct config_prefix6 src6_prefix;
 };
 
 /**
@@ -525,6 +864,12 @@ struct jool_globals {
 	 */
 	struct mtu_plateaus plateaus;
 
+	/**
+	 * Translate eligible packets by rewriting the incoming skb's headers,
+	 * instead of building the outgoing packet in a copy?
+	 */
+	bool xlat_in_place;
+
 	union {
 		struct {
 			/**
@@ -558,6 +903,11 @@ struct jool_globals {
 			 */
 			struct config_prefix4 rfc6791_prefix4;
 
+			/**
+			 * Remember the routes of recent destinations, so
+			 * packets headed to them don't need a FIB lookup?
+			 */
+			bool route_cache;
 		} siit;
 		struct {
 			/** Filter ICMPv6 Informational packets? */
@@ -583,6 +933,29 @@ struct jool_globals {
 
 			struct bib_config bib;
 			struct joold_config joold;
+
+			/**
+			 * Translate fragments individually, as they arrive,
+			 * instead of letting the kernel reassemble them first?
+			 * (Subsequent fragments borrow the ports of their first
+			 * fragment.)
+			 */
+			bool frag_tracking;
+			/**
+			 * Milliseconds a fragmented packet's ports are
+			 * remembered after its latest fragment.
+			 */
+			__u32 frag_tracking_timeout;
+			/** Maximum number of fragmented packets remembered. */
+			__u32 frag_tracking_capacity;
+
+			/**
+			 * Let recently translated flows skip the first three
+			 * steps? (See db/flowcache.h.)
+			 */
+			bool flow_cache;
+			/** Maximum number of flows remembered. */
+			__u32 flow_cache_capacity;
 		} nat64;
 	};
 };
@@ -67,20 +67,42 @@
 #define DEFAULT_FILTER_ICMPV6_INFO false
 #define DEFAULT_DROP_EXTERNAL_CONNECTIONS false
 #define DEFAULT_MAX_STORED_PKTS 10
+#define DEFAULT_SUBSCRIBER_PREFIX_LEN 0
+#define DEFAULT_SUBSCRIBER_MAX_BIBS 0
+#define DEFAULT_SUBSCRIBER_MAX_SESSIONS 0
+#define DEFAULT_SESSION_MEMORY_LIMIT 0
+#define DEFAULT_HIGH_WATER 0
+/*
+ * Once a table reaches its high-water mark, its timeouts are divided by this.
+ * (And they get there linearly, starting from half the mark.)
+ */
+#define ADAPTIVE_TIMEOUT_DIVISOR 8
+/* Maximum number of subscribers a "top consumers" query can request. */
+#define SUBSCRIBER_TOP_MAX 32
 #define DEFAULT_SRC_ICMP6ERRS_BETTER true
 #define DEFAULT_F_ARGS 0b1011
 #define DEFAULT_HANDLE_FIN_RCV_RST false
 #define DEFAULT_BIB_LOGGING false
 #define DEFAULT_SESSION_LOGGING false
+#define DEFAULT_BINARY_LOGGING false
+#define DEFAULT_SESSION_ROUTE_CACHE false
+#define DEFAULT_FRAG_TRACKING false
+/* In seconds. */
+#define DEFAULT_FRAG_TRACKING_TIMEOUT 2
+#define DEFAULT_FRAG_TRACKING_CAPACITY 1024
+#define DEFAULT_FLOW_CACHE false
+#define DEFAULT_FLOW_CACHE_CAPACITY 4096
 
 #define DEFAULT_INSTANCE_ENABLED true
 #define DEFAULT_RESET_TRAFFIC_CLASS false
 #define DEFAULT_RESET_TOS false
 #define DEFAULT_NEW_TOS 0
 #define DEFAULT_LOWEST_IPV6_MTU 1280
+#define DEFAULT_XLAT_IN_PLACE false
 #define DEFAULT_COMPUTE_UDP_CSUM0 false
 #define DEFAULT_EAM_HAIRPIN_MODE EHM_INTRINSIC
 #define DEFAULT_RANDOMIZE_RFC6791 true
+#define DEFAULT_DESTINATION_ROUTE_CACHE false
 #define DEFAULT_MTU_PLATEAUS { 65535, 32000, 17914, 8166, 4352, 2002, 1492, \
 		1006, 508, 296, 68 }
 #define DEFAULT_JOOLD_ENABLED false
@@ -93,6 +115,17 @@
  * This means we can fit 22 sessions per packet. (Regardless of IPv4/IPv6)
  */
 #define DEFAULT_JOOLD_MAX_PAYLOAD 1452
+#define DEFAULT_JOOLD_SYNC_TCP true
+#define DEFAULT_JOOLD_SYNC_UDP true
+#define DEFAULT_JOOLD_SYNC_ICMP true
+#define DEFAULT_JOOLD_TCP_EST_ONLY false
+#define DEFAULT_JOOLD_MIN_AGE 0
+/**
+ * Number of sessions summarized by each joold digest during a resync.
+ * Smaller ranges mean more digests, but less sessions retransmitted per
+ * mismatch.
+ */
+#define JOOLD_DIGEST_SESSIONS 16
 
 /* -- IPv6 Pool -- */
 
@@ -180,6 +180,18 @@ static int nl2raw_pool6791v6(struct nlattr *attr, void *raw, bool force)
 	return prefix->set ? prefix6_validate(&prefix->prefix) : 0;
 }
 
+static int nl2raw_ss_src6_prefix(struct nlattr *attr, void *raw, bool force)
+{
+	struct config_prefix6 *prefix = raw;
+	int error;
+
+	error = jnla_get_prefix6_optional(attr, "joold src6 prefix", prefix);
+	if (error)
+		return error;
+
+	return prefix->set ? prefix6_validate(&prefix->prefix) : 0;
+}
+
 static int nl2raw_pool6791v4(struct nlattr *attr, void *raw, bool force)
 {
 	struct config_prefix4 *prefix = raw;
@@ -270,6 +282,22 @@ static int nl2raw_ttl_tcp_trans(struct nlattr *attr, void *raw, bool force)
 	return error;
 }
 
+static int nl2raw_subscriber_prefix_len(struct nlattr *attr, void *raw,
+		bool force)
+{
+	__u8 len;
+
+	len = nla_get_u8(attr);
+	if (len > 128) {
+		log_err("subscriber-prefix-len (%u) is out of range. (0-128)",
+				len);
+		return -EINVAL;
+	}
+
+	*((__u8 *)raw) = len;
+	return 0;
+}
+
 static int nl2raw_f_args(struct nlattr *attr, void *raw, bool force)
 {
 	__u8 f_args;
@@ -1003,6 +1031,166 @@ static const struct joolnl_global_meta globals_metadata[] = {
 		.doc = "Maximum amount of bytes joold should send per packet.",
 		.offset = offsetof(struct jool_globals, nat64.joold.max_payload),
 		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_SYNC_TCP,
+		.name = "ss-sync-tcp",
+		.type = &gt_bool,
+		.doc = "Synchronize TCP sessions?",
+		.offset = offsetof(struct jool_globals, nat64.joold.sync_tcp),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_SYNC_UDP,
+		.name = "ss-sync-udp",
+		.type = &gt_bool,
+		.doc = "Synchronize UDP sessions?",
+		.offset = offsetof(struct jool_globals, nat64.joold.sync_udp),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_SYNC_ICMP,
+		.name = "ss-sync-icmp",
+		.type = &gt_bool,
+		.doc = "Synchronize ICMP sessions?",
+		.offset = offsetof(struct jool_globals, nat64.joold.sync_icmp),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_TCP_EST_ONLY,
+		.name = "ss-sync-tcp-established-only",
+		.type = &gt_bool,
+		.doc = "Only synchronize TCP sessions in the ESTABLISHED state?",
+		.offset = offsetof(struct jool_globals, nat64.joold.tcp_est_only),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_MIN_AGE,
+		.name = "ss-sync-min-age",
+		.type = &gt_uint32,
+		.doc = "Milliseconds a session has to have existed before it is synchronized.",
+		.offset = offsetof(struct jool_globals, nat64.joold.min_age),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_JOOLD_SRC6_PREFIX,
+		.name = "ss-sync-src6-prefix",
+		.type = &gt_prefix6,
+		.doc = "Only synchronize sessions whose IPv6 client belongs to this prefix.",
+		.offset = offsetof(struct jool_globals, nat64.joold.src6_prefix),
+		.xt = XT_NAT64,
+#ifdef __KERNEL__
+		.nl2raw = nl2raw_ss_src6_prefix,
+#endif
+	}, {
+		.id = JNLAG_SUBSCRIBER_PREFIX_LEN,
+		.name = "subscriber-prefix-len",
+		.type = &gt_uint8,
+		.doc = "Length of the IPv6 prefix that identifies a subscriber. (0 disables the subscriber index.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.subscriber_prefix_len),
+		.xt = XT_NAT64,
+#ifdef __KERNEL__
+		.nl2raw = nl2raw_subscriber_prefix_len,
+#endif
+	}, {
+		.id = JNLAG_SUBSCRIBER_MAX_BIBS,
+		.name = "subscriber-max-bibs",
+		.type = &gt_uint32,
+		.doc = "Maximum number of BIB entries per subscriber. (0 = unlimited. Requires subscriber-prefix-len.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.subscriber_max_bibs),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_SUBSCRIBER_MAX_SESSIONS,
+		.name = "subscriber-max-sessions",
+		.type = &gt_uint32,
+		.doc = "Maximum number of sessions per subscriber. (0 = unlimited. Requires subscriber-prefix-len.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.subscriber_max_sessions),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_SESSION_MEMORY_LIMIT,
+		.name = "session-memory-limit",
+		.type = &gt_uint32,
+		.doc = "Maximum memory (in KiB) the BIB entries and sessions can use. (0 = unlimited.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.session_memory_limit),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_HIGH_WATER_TCP,
+		.name = "tcp-high-water",
+		.type = &gt_uint32,
+		.doc = "Number of TCP sessions from which the TCP timeouts start shrinking (from half) and bottom out. (0 = never.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.high_water.tcp),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_HIGH_WATER_UDP,
+		.name = "udp-high-water",
+		.type = &gt_uint32,
+		.doc = "Number of UDP sessions from which udp-timeout starts shrinking (from half) and bottoms out. (0 = never.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.high_water.udp),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_HIGH_WATER_ICMP,
+		.name = "icmp-high-water",
+		.type = &gt_uint32,
+		.doc = "Number of ICMP sessions from which icmp-timeout starts shrinking (from half) and bottoms out. (0 = never.)",
+		.offset = offsetof(struct jool_globals, nat64.bib.high_water.icmp),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_BINARY_LOGGING,
+		.name = "logging-binary",
+		.type = &gt_bool,
+		.doc = "Send BIB/session logging events to the collector ('jool session log') instead of the kernel log?",
+		.offset = offsetof(struct jool_globals, nat64.bib.binary_logging),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_XLAT_IN_PLACE,
+		.name = "translate-in-place",
+		.type = &gt_bool,
+		.doc = "Rewrite the headers of unshared packets instead of translating into a copy?",
+		.offset = offsetof(struct jool_globals, xlat_in_place),
+		.xt = XT_ANY,
+	}, {
+		.id = JNLAG_SESSION_ROUTE_CACHE,
+		.name = "session-route-cache",
+		.type = &gt_bool,
+		.doc = "Cache each session's routes, so established flows skip the FIB lookup?",
+		.offset = offsetof(struct jool_globals, nat64.bib.route_cache),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_DESTINATION_ROUTE_CACHE,
+		.name = "destination-route-cache",
+		.type = &gt_bool,
+		.doc = "Cache the routes of recent destinations, so their packets skip the FIB lookup?",
+		.offset = offsetof(struct jool_globals, siit.route_cache),
+		.xt = XT_SIIT,
+	}, {
+		.id = JNLAG_FRAG_TRACKING,
+		.name = "fragment-tracking",
+		.type = &gt_bool,
+		.doc = "Translate fragments as they arrive, instead of waiting for the kernel to reassemble them?",
+		.offset = offsetof(struct jool_globals, nat64.frag_tracking),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_FRAG_TRACKING_TIMEOUT,
+		.name = "fragment-tracking-timeout",
+		.type = &gt_timeout,
+		.doc = "Set how long a fragmented packet's ports are remembered while its fragments arrive (HH:MM:SS.mmm).",
+		.offset = offsetof(struct jool_globals, nat64.frag_tracking_timeout),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_FRAG_TRACKING_CAPACITY,
+		.name = "fragment-tracking-capacity",
+		.type = &gt_uint32,
+		.doc = "Set the maximum number of fragmented packets whose ports can be remembered at the same time.",
+		.offset = offsetof(struct jool_globals, nat64.frag_tracking_capacity),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_FLOW_CACHE,
+		.name = "flow-cache",
+		.type = &gt_bool,
+		.doc = "Let the packets of recently translated flows skip the session lookup?",
+		.offset = offsetof(struct jool_globals, nat64.flow_cache),
+		.xt = XT_NAT64,
+	}, {
+		.id = JNLAG_FLOW_CACHE_CAPACITY,
+		.name = "flow-cache-capacity",
+		.type = &gt_uint32,
+		.doc = "Set the maximum number of flows the flow cache can remember at the same time.",
+		.offset = offsetof(struct jool_globals, nat64.flow_cache_capacity),
+		.xt = XT_NAT64,
 	},
 };
 
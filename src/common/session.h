@@ -38,4 +38,6 @@ typedef enum tcp_state {
 	TRANS,
 } tcp_state;
 
+#define TCP_STATE_COUNT (TRANS + 1)
+
 #endif /* SRC_COMMON_SESSION_H_ */
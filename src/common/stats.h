@@ -94,6 +94,43 @@ enum jool_stat_id {
 	JSTAT_ICMPEXT_SMALL,
 	JSTAT_ICMPEXT_BIG,
 
+	JSTAT_JOOLD_FILTER_PROTO,
+	JSTAT_JOOLD_FILTER_STATE,
+	JSTAT_JOOLD_FILTER_AGE,
+	JSTAT_JOOLD_FILTER_SRC6,
+
+	JSTAT_SUBSCRIBERS,
+	JSTAT_SUBSCRIBER_QUOTA,
+
+	JSTAT_SESSION_MEMORY_LIMIT,
+	JSTAT_EVICTED_MEMORY_LIMIT,
+	JSTAT_EVICTED_MEMORY_PRESSURE,
+
+	JSTAT_EVENTS_DROPPED,
+
+	JSTAT_XLAT_IN_PLACE,
+	JSTAT_XLAT_COPIED,
+
+	JSTAT46_GSO_SEGMENTED,
+
+	JSTAT_ROUTE_CACHE_HIT,
+	JSTAT_ROUTE_CACHE_MISS,
+	JSTAT_ROUTE_CACHE_INVALID,
+
+	JSTAT_CSUM_INCREMENTAL,
+	JSTAT_CSUM_OFFLOADED,
+	JSTAT_CSUM_COMPUTED,
+	JSTAT_CSUM_COMPLETE_UPDATED,
+
+	JSTAT_FRAG_TRACKED,
+	JSTAT_FRAG_MATCHED,
+	JSTAT_FRAG_UNTRACKED,
+	JSTAT_FRAG_EVICTED,
+
+	JSTAT_FLOW_CACHE_HIT,
+	JSTAT_FLOW_CACHE_MISS,
+	JSTAT_FLOW_CACHE_EVICTED,
+
 	/* These 3 need to be last, and in this order. */
 	JSTAT_UNKNOWN, /* "WTF was that" errors only. */
 	JSTAT_PADDING,
@@ -3,11 +3,13 @@
 #include <linux/kref.h>
 #include <linux/timer.h>
 #include "mod/common/log.h"
+#include "mod/common/xlator.h"
 #include "mod/common/wkmalloc.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/global.h"
 #include "mod/common/nl/nl_common.h"
 #include "mod/common/db/eam.h"
+#include "mod/common/db/global.h"
 #include "mod/common/db/denylist4.h"
 #include "mod/common/joold.h"
 #include "mod/common/db/pool4/db.h"
@@ -25,9 +27,48 @@
  * configuration is then only replaced when the candidate has been completed and
  * validated.
  */
+enum delta_table {
+	DT_DENYLIST4,
+	DT_EAMT,
+	DT_POOL4,
+	DT_COUNT,
+};
+
+/**
+ * A list of table entries, stored in page-sized chunks so the list can grow
+ * big without needing large contiguous allocations.
+ */
+struct delta_list {
+	struct list_head chunks;
+	size_t entry_size;
+};
+
+struct delta_chunk {
+	struct list_head list_hook;
+	unsigned int count;
+	/* The entries follow. */
+};
+
+#define DELTA_CHUNK_SIZE PAGE_SIZE
+#define DELTA_CHUNK_CAPACITY(list) \
+	((DELTA_CHUNK_SIZE - sizeof(struct delta_chunk)) / (list)->entry_size)
+
 struct config_candidate {
 	struct xlator xlator;
 
+	/**
+	 * false: @xlator is a brand new instance, which will replace the
+	 * running one during the commit.
+	 * true: @xlator is a clone of the running instance (so it shares its
+	 * tables) and its tables are only touched during the commit, when
+	 * @rms and @adds are applied on them. Only the globals are rebuilt.
+	 */
+	bool incremental;
+	/** Incremental mode only: Entries to remove from each table. */
+	struct delta_list rms[DT_COUNT];
+	/** Incremental mode only: Entries to add to each table. */
+	struct delta_list adds[DT_COUNT];
+
 	/** Last jiffy the user made an edit. */
 	unsigned long update_time;
 	/** Process ID of the client that is populating this candidate. */
@@ -46,11 +87,94 @@ struct config_candidate {
 static LIST_HEAD(db);
 static DEFINE_MUTEX(lock);
 
+static void delta_init(struct delta_list *list, size_t entry_size)
+{
+	INIT_LIST_HEAD(&list->chunks);
+	list->entry_size = entry_size;
+}
+
+static void *delta_entry(struct delta_list *list, struct delta_chunk *chunk,
+		unsigned int index)
+{
+	return ((char *)(chunk + 1)) + index * list->entry_size;
+}
+
+static int delta_append(struct delta_list *list, void const *entry)
+{
+	struct delta_chunk *chunk = NULL;
+
+	if (!list_empty(&list->chunks))
+		chunk = list_entry(list->chunks.prev, struct delta_chunk,
+				list_hook);
+
+	if (!chunk || chunk->count >= DELTA_CHUNK_CAPACITY(list)) {
+		chunk = __wkmalloc("Atomic config delta", DELTA_CHUNK_SIZE,
+				GFP_KERNEL);
+		if (!chunk)
+			return -ENOMEM;
+		chunk->count = 0;
+		list_add_tail(&chunk->list_hook, &list->chunks);
+	}
+
+	memcpy(delta_entry(list, chunk, chunk->count), entry, list->entry_size);
+	chunk->count++;
+	return 0;
+}
+
+static void delta_destroy(struct delta_list *list)
+{
+	struct delta_chunk *chunk;
+	struct delta_chunk *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &list->chunks, list_hook) {
+		list_del(&chunk->list_hook);
+		__wkfree("Atomic config delta", chunk);
+	}
+}
+
+typedef int (*delta_cb)(struct xlator *, void *, bool);
+
+/**
+ * Calls @cb on the first @max entries of @list (all of them if @max is
+ * negative). Stops at the first error.
+ *
+ * Returns the number of entries @cb succeeded on through @done.
+ */
+static int delta_foreach(struct delta_list *list, struct xlator *jool,
+		delta_cb cb, bool force, int max, unsigned int *done)
+{
+	struct delta_chunk *chunk;
+	unsigned int i;
+	int error;
+
+	*done = 0;
+	list_for_each_entry(chunk, &list->chunks, list_hook) {
+		for (i = 0; i < chunk->count; i++) {
+			if (max >= 0 && (*done) >= (unsigned int)max)
+				return 0;
+			error = cb(jool, delta_entry(list, chunk, i), force);
+			if (error)
+				return error;
+			(*done)++;
+		}
+	}
+
+	return 0;
+}
+
 static void candidate_destroy(struct config_candidate *candidate)
 {
+	unsigned int t;
+
 	LOG_DEBUG("Destroying atomic configuration candidate '%s'.",
 			candidate->xlator.iname);
 	xlator_put(&candidate->xlator);
+	if (candidate->incremental) {
+		for (t = 0; t < DT_COUNT; t++) {
+			delta_destroy(&candidate->rms[t]);
+			delta_destroy(&candidate->adds[t]);
+		}
+	}
 	list_del(&candidate->list_hook);
 	wkfree(struct config_candidate, candidate);
 }
@@ -133,8 +257,46 @@ static int get_candidate(char *iname, struct config_candidate **result)
 	return -ESRCH;
 }
 
+/*
+ * Incremental version of handle_init(): Clones the running instance instead of
+ * creating a new one, and resets the clone's globals.
+ */
+static int init_incremental(struct config_candidate *candidate,
+		struct nlattr *attr, char *iname, xlator_type xt)
+{
+	xlator_flags flags;
+	int error;
+
+	flags = nla_get_u8(attr) | xt;
+	error = xlator_find_current(iname, flags, &candidate->xlator);
+	if (error == -ESRCH) {
+		log_err("There is no instance '%s' (with this framework) to update incrementally.",
+				iname);
+		return error;
+	}
+	if (error)
+		return error;
+
+	/* (Same as in a full rebuild: globals not in the file get defaults.) */
+	error = globals_init(&candidate->xlator.globals,
+			xlator_flags2xt(candidate->xlator.flags), NULL);
+	if (error) {
+		xlator_put(&candidate->xlator);
+		return error;
+	}
+
+	candidate->incremental = true;
+	delta_init(&candidate->rms[DT_DENYLIST4], sizeof(struct ipv4_prefix));
+	delta_init(&candidate->adds[DT_DENYLIST4], sizeof(struct ipv4_prefix));
+	delta_init(&candidate->rms[DT_EAMT], sizeof(struct eamt_entry));
+	delta_init(&candidate->adds[DT_EAMT], sizeof(struct eamt_entry));
+	delta_init(&candidate->rms[DT_POOL4], sizeof(struct pool4_entry));
+	delta_init(&candidate->adds[DT_POOL4], sizeof(struct pool4_entry));
+	return 0;
+}
+
 static int handle_init(struct config_candidate **out, struct nlattr *attr,
-		char *iname, xlator_type xt)
+		bool incremental, char *iname, xlator_type xt)
 {
 	struct config_candidate *candidate;
 	struct net *ns;
@@ -153,9 +315,12 @@ static int handle_init(struct config_candidate **out, struct nlattr *attr,
 		error = -ENOMEM;
 		goto end;
 	}
+	candidate->incremental = false;
 
-	error = xlator_init(&candidate->xlator, ns, iname, nla_get_u8(attr) | xt,
-			NULL);
+	error = incremental
+			? init_incremental(candidate, attr, iname, xt)
+			: xlator_init(&candidate->xlator, ns, iname,
+					nla_get_u8(attr) | xt, NULL);
 	if (error) {
 		wkfree(struct config_candidate, candidate);
 		goto end;
@@ -200,7 +365,9 @@ static int handle_eamt(struct config_candidate *new, struct nlattr *root,
 		error = jnla_get_eam(attr, "EAMT entry", &entry);
 		if (error)
 			return error;
-		error = eamt_add(new->xlator.siit.eamt, &entry, force, false);
+		error = new->incremental
+				? delta_append(&new->adds[DT_EAMT], &entry)
+				: eamt_add(new->xlator.siit.eamt, &entry, force, false);
 		if (error)
 			return error;
 	}
@@ -229,7 +396,9 @@ static int handle_denylist4(struct config_candidate *new, struct nlattr *root,
 		error = jnla_get_prefix4(attr, "IPv4 denylist4 entry", &entry);
 		if (error)
 			return error;
-		error = denylist4_add(new->xlator.siit.denylist4, &entry, force);
+		error = new->incremental
+				? delta_append(&new->adds[DT_DENYLIST4], &entry)
+				: denylist4_add(new->xlator.siit.denylist4, &entry, force);
 		if (error)
 			return error;
 	}
@@ -257,7 +426,9 @@ static int handle_pool4(struct config_candidate *new, struct nlattr *root)
 		error = jnla_get_pool4(attr, "pool4 entry", &entry);
 		if (error)
 			return error;
-		error = pool4db_add(new->xlator.nat64.pool4, &entry);
+		error = new->incremental
+				? delta_append(&new->adds[DT_POOL4], &entry)
+				: pool4db_add(new->xlator.nat64.pool4, &entry);
 		if (error)
 			return error;
 	}
@@ -278,6 +449,11 @@ static int handle_bib(struct config_candidate *new, struct nlattr *root)
 		log_err("SIIT doesn't have BIBs.");
 		return -EINVAL;
 	}
+	if (new->incremental) {
+		/* Same as in full rebuilds; see xlator_replace(). */
+		LOG_DEBUG("The BIB is not updated by atomic configuration; skipping.");
+		return 0;
+	}
 
 	nla_for_each_nested(attr, root, rem) {
 		if (nla_type(attr) != JNLAL_ENTRY)
@@ -293,6 +469,227 @@ static int handle_bib(struct config_candidate *new, struct nlattr *root)
 	return 0;
 }
 
+/*
+ * Queues the removals of the JNLAR_*_ENTRIES lists contained in @root.
+ * (Incremental mode only.)
+ */
+static int handle_rm(struct config_candidate *new, struct nlattr *root)
+{
+	struct nlattr *list;
+	struct nlattr *attr;
+	union {
+		struct ipv4_prefix prefix;
+		struct eamt_entry eam;
+		struct pool4_entry pool4;
+	} entry;
+	struct delta_list *delta;
+	int rem1, rem2;
+	int error;
+
+	LOG_DEBUG("Handling atomic removals attribute.");
+
+	if (!new->incremental) {
+		log_err("Removals only make sense in incremental transactions.");
+		return -EINVAL;
+	}
+
+	nla_for_each_nested(list, root, rem1) {
+		switch (nla_type(list)) {
+		case JNLAR_BL4_ENTRIES:
+			if (xlator_is_nat64(&new->xlator))
+				goto wrong_type;
+			delta = &new->rms[DT_DENYLIST4];
+			break;
+		case JNLAR_EAMT_ENTRIES:
+			if (xlator_is_nat64(&new->xlator))
+				goto wrong_type;
+			delta = &new->rms[DT_EAMT];
+			break;
+		case JNLAR_POOL4_ENTRIES:
+			if (xlator_is_siit(&new->xlator))
+				goto wrong_type;
+			delta = &new->rms[DT_POOL4];
+			break;
+		default:
+			goto wrong_type;
+		}
+
+		nla_for_each_nested(attr, list, rem2) {
+			if (nla_type(attr) != JNLAL_ENTRY)
+				continue; /* ? */
+
+			switch (nla_type(list)) {
+			case JNLAR_BL4_ENTRIES:
+				error = jnla_get_prefix4(attr, "IPv4 denylist4 entry", &entry.prefix);
+				break;
+			case JNLAR_EAMT_ENTRIES:
+				error = jnla_get_eam(attr, "EAMT entry", &entry.eam);
+				break;
+			default: /* JNLAR_POOL4_ENTRIES */
+				error = jnla_get_pool4(attr, "pool4 entry", &entry.pool4);
+			}
+			if (error)
+				return error;
+
+			error = delta_append(delta, &entry);
+			if (error)
+				return error;
+		}
+	}
+
+	return 0;
+
+wrong_type:
+	log_err("The instance type does not have a table of type %u.",
+			nla_type(list));
+	return -EINVAL;
+}
+
+static int denylist4_delta_add(struct xlator *jool, void *entry, bool force)
+{
+	return denylist4_add(jool->siit.denylist4, entry, force);
+}
+
+static int denylist4_delta_rm(struct xlator *jool, void *entry, bool force)
+{
+	return denylist4_rm(jool->siit.denylist4, entry);
+}
+
+static int eamt_delta_add(struct xlator *jool, void *entry, bool force)
+{
+	return eamt_add(jool->siit.eamt, entry, force, true);
+}
+
+static int eamt_delta_rm(struct xlator *jool, void *entry, bool force)
+{
+	struct eamt_entry *eam = entry;
+	return eamt_rm(jool->siit.eamt, &eam->prefix6, &eam->prefix4);
+}
+
+static int pool4_delta_add(struct xlator *jool, void *entry, bool force)
+{
+	return pool4db_add(jool->nat64.pool4, entry);
+}
+
+static int pool4_delta_rm(struct xlator *jool, void *entry, bool force)
+{
+	struct pool4_entry copy;
+
+	/* pool4db_rm_usr() normalizes the range, and the undo needs the original. */
+	memcpy(&copy, entry, sizeof(copy));
+	return pool4db_rm_usr(jool->nat64.pool4, &copy);
+}
+
+static const struct delta_ops {
+	char const *name;
+	delta_cb add;
+	delta_cb rm;
+} delta_ops[DT_COUNT] = {
+	[DT_DENYLIST4] = { "denylist4", denylist4_delta_add, denylist4_delta_rm },
+	[DT_EAMT] = { "EAMT", eamt_delta_add, eamt_delta_rm },
+	[DT_POOL4] = { "pool4", pool4_delta_add, pool4_delta_rm },
+};
+
+/*
+ * Undoes the first @rms removals and @adds additions of table @t.
+ * Errors are only logged, since there's nothing else to do about them.
+ */
+static void delta_revert_table(struct config_candidate *candidate,
+		unsigned int t, int rms, int adds)
+{
+	struct delta_ops const *ops = &delta_ops[t];
+	struct xlator *jool = &candidate->xlator;
+	unsigned int done;
+	int error;
+
+	error = delta_foreach(&candidate->adds[t], jool, ops->rm, true, adds,
+			&done);
+	if (!error) {
+		error = delta_foreach(&candidate->rms[t], jool, ops->add, true,
+				rms, &done);
+	}
+	if (error) {
+		log_err("Could not roll back the %s changes (error %d); the table might be left in an inconsistent state.",
+				ops->name, error);
+	}
+}
+
+static void delta_revert(struct config_candidate *candidate, unsigned int max)
+{
+	unsigned int t;
+
+	for (t = 0; t < max; t++)
+		delta_revert_table(candidate, t, -1, -1);
+}
+
+/*
+ * Applies the removals, then the additions, of every table on the running
+ * instance. If anything fails, everything applied so far is undone.
+ *
+ * Entries are applied one by one, so packets being translated meanwhile might
+ * see some of the changes before the others.
+ */
+static int delta_apply(struct config_candidate *candidate, bool force)
+{
+	struct delta_ops const *ops;
+	struct xlator *jool = &candidate->xlator;
+	unsigned int t;
+	unsigned int rms;
+	unsigned int adds;
+	int error;
+
+	for (t = 0; t < DT_COUNT; t++) {
+		ops = &delta_ops[t];
+
+		error = delta_foreach(&candidate->rms[t], jool, ops->rm, force,
+				-1, &rms);
+		if (error) {
+			log_err("Could not remove entry #%u from %s (error %d). Did the table change during the transaction?",
+					rms, ops->name, error);
+			delta_revert_table(candidate, t, rms, 0);
+			goto revert;
+		}
+
+		error = delta_foreach(&candidate->adds[t], jool, ops->add,
+				force, -1, &adds);
+		if (error) {
+			log_err("Could not add entry #%u to %s (error %d).",
+					adds, ops->name, error);
+			delta_revert_table(candidate, t, -1, adds);
+			goto revert;
+		}
+	}
+
+	return 0;
+
+revert:
+	delta_revert(candidate, t);
+	return error;
+}
+
+static int commit_incremental(struct config_candidate *candidate, bool force)
+{
+	int error;
+
+	LOG_DEBUG("Handling atomic END attribute (incremental).");
+
+	error = delta_apply(candidate, force);
+	if (error)
+		return error;
+
+	/* Tables are shared with the running instance; this swaps the globals. */
+	error = xlator_replace(&candidate->xlator);
+	if (error) {
+		log_err("xlator_replace() failed. Errcode %d", error);
+		delta_revert(candidate, DT_COUNT);
+		return error;
+	}
+
+	candidate_destroy(candidate);
+	LOG_DEBUG("The atomic configuration transaction was a success.");
+	return 0;
+}
+
 static int commit(struct config_candidate *candidate)
 {
 	int error;
@@ -326,7 +723,9 @@ int atomconfig_add(struct sk_buff *skb, struct genl_info *info)
 	mutex_lock(&lock);
 
 	error = info->attrs[JNLAR_ATOMIC_INIT]
-			? handle_init(&candidate, info->attrs[JNLAR_ATOMIC_INIT], jhdr->iname, jhdr->xt)
+			? handle_init(&candidate, info->attrs[JNLAR_ATOMIC_INIT],
+					!!info->attrs[JNLAR_ATOMIC_INCREMENTAL],
+					jhdr->iname, jhdr->xt)
 			: get_candidate(jhdr->iname, &candidate);
 	if (error)
 		goto end;
@@ -356,8 +755,15 @@ int atomconfig_add(struct sk_buff *skb, struct genl_info *info)
 		if (error)
 			goto revert;
 	}
+	if (info->attrs[JNLAR_ATOMIC_RM]) {
+		error = handle_rm(candidate, info->attrs[JNLAR_ATOMIC_RM]);
+		if (error)
+			goto revert;
+	}
 	if (info->attrs[JNLAR_ATOMIC_END]) {
-		error = commit(candidate);
+		error = candidate->incremental
+				? commit_incremental(candidate, jhdr->flags & JOOLNLHDR_FLAGS_FORCE)
+				: commit(candidate);
 		if (error)
 			goto revert;
 	}
@@ -1,10 +1,17 @@
 #include "mod/common/core.h"
 
+#include <linux/netdevice.h>
+#include "mod/common/linux_version.h"
+#if LINUX_VERSION_AT_LEAST(6, 5, 0, 9999, 0)
+#include <net/gso.h>
+#endif
+
 #include "common/config.h"
 #include "mod/common/log.h"
 #include "mod/common/trace.h"
 #include "mod/common/translation_state.h"
 #include "mod/common/xlator.h"
+#include "mod/common/db/flowcache.h"
 #include "mod/common/rfc7915/core.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
 #include "mod/common/steps/determine_incoming_tuple.h"
@@ -25,11 +32,43 @@ static verdict validate_xlator(struct xlation *state)
 	return VERDICT_CONTINUE;
 }
 
+/* Defers the sending of @state's outgoing packets to the end of the batch. */
+static void queue_batch(struct xlation *state)
+{
+	struct sk_buff *skb;
+	struct sk_buff *next;
+
+	for (skb = state->out.skb; skb != NULL; skb = next) {
+		next = skb->next;
+		skb->next = NULL;
+		__skb_queue_tail(&state->batch->out, skb);
+	}
+}
+
+/* Fills in what the super-packet's first three steps found out. */
+static void restore_segment(struct xlation *state)
+{
+	struct xlation_segment const *segment = state->segment;
+
+	state->in.tuple = segment->in;
+	state->out.tuple = segment->out;
+	state->entries = segment->entries;
+	log_debug(state, "GSO segment; skipping steps 1 through 3.");
+}
+
 static verdict core_common(struct xlation *state)
 {
 	verdict result;
 
 	if (xlation_is_nat64(state)) {
+		if (state->segment) {
+			restore_segment(state);
+			state->flow_hit = true;
+		} else {
+			state->flow_hit = flowcache_find(state);
+		}
+	}
+	if (xlation_is_nat64(state) && !state->flow_hit) {
 		result = determine_in_tuple(state);
 		if (result != VERDICT_CONTINUE)
 			return result;
@@ -49,11 +88,23 @@ static verdict core_common(struct xlation *state)
 		result = state->jool.handling_hairpinning(state);
 		kfree_skb(state->out.skb); /* Put this inside of hh()? */
 	} else {
-		result = sendpkt_send(state);
-		/* sendpkt_send() releases out's skb regardless of verdict. */
+		if (xlation_is_nat64(state) && !state->flow_hit)
+			flowcache_add(state);
+		if (state->batch) {
+			queue_batch(state);
+			result = VERDICT_CONTINUE;
+		} else {
+			result = sendpkt_send(state);
+			/* sendpkt_send() releases out's skb regardless of verdict. */
+		}
+	}
+	if (result != VERDICT_CONTINUE) {
+		/*
+		 * If @in was translated in place, it was also @out, so it's
+		 * already gone. (The failure was already counted.)
+		 */
+		return state->in_place ? VERDICT_STOLEN : result;
 	}
-	if (result != VERDICT_CONTINUE)
-		return result;
 
 	log_debug(state, "Success.");
 	/*
@@ -64,7 +115,8 @@ static verdict core_common(struct xlation *state)
 	 * count as an error, so we free the incoming packet ourselves and
 	 * return NF_STOLEN on success.
 	 */
-	kfree_skb(state->in.skb);
+	if (!state->in_place)
+		kfree_skb(state->in.skb);
 	return stolen(state, JSTAT_SUCCESS);
 }
 
@@ -84,11 +136,141 @@ static void send_icmp4_error(struct xlation *state, verdict result)
 			: JSTAT_ICMP4ERR_FAILURE);
 }
 
+/* Translates @skbs; see core_batch(). Assumes @state->batch is set. */
+static void translate_batch(struct xlation *state, struct sk_buff_head *skbs)
+{
+	struct sk_buff *skb;
+	verdict result;
+
+	while ((skb = __skb_dequeue(skbs)) != NULL) {
+		switch (ntohs(skb->protocol)) {
+		case ETH_P_IP:
+			result = core_4to6(skb, state);
+			break;
+		case ETH_P_IPV6:
+			result = core_6to4(skb, state);
+			break;
+		default:
+			result = VERDICT_UNTRANSLATABLE;
+		}
+
+		switch (result) {
+		case VERDICT_STOLEN:
+			break;
+		case VERDICT_UNTRANSLATABLE:
+			__skb_queue_tail(state->batch->rejected, skb);
+			break;
+		default:
+			kfree_skb(skb);
+		}
+
+		xlation_reset(state);
+	}
+}
+
+static void batch_init(struct xlation_batch *batch,
+		struct sk_buff_head *rejected)
+{
+	memset(batch, 0, sizeof(*batch));
+	__skb_queue_head_init(&batch->out);
+	batch->rejected = rejected;
+}
+
+static void batch_send(struct xlation *state)
+{
+	sendpkt_send_batch(state);
+	if (state->batch->dst)
+		dst_release(state->batch->dst);
+}
+
+/*
+ * Hands @skbs back to the kernel's receive path. (Since the netfilter hooks
+ * can only accept or reject the super-packet as a whole.)
+ * They will come back to Jool, which will hopefully let them through this
+ * time.
+ */
+static void reinject(struct sk_buff_head *skbs)
+{
+	struct sk_buff *skb;
+
+	while ((skb = __skb_dequeue(skbs)) != NULL) {
+		__skb_pull(skb, skb_network_offset(skb));
+		netif_rx(skb);
+	}
+}
+
+/*
+ * A GSO super-packet can't be fragmented as a whole, since its segments are
+ * separate packets. So if the segments need fragmentation, the super-packet
+ * has to be segmented first, and the segments translated separately. (This is
+ * what the kernel itself does in this situation, as well as NFQUEUE.)
+ *
+ * The segments belong to the same flow as the super-packet, so they reuse the
+ * outcome of its filtering, and are translated as a batch. (Or as part of the
+ * batch the super-packet belongs to.)
+ *
+ * Assumes @skb has already been through core_4to6().
+ */
+static verdict core_4to6_segments(struct sk_buff *skb, struct xlation *state)
+{
+	struct xlation_segment segment;
+	struct xlation_batch batch;
+	struct sk_buff_head segments;
+	struct sk_buff_head rejected;
+	struct xlation_batch *outer;
+	struct sk_buff *segs;
+	struct sk_buff *next;
+
+	jstat_inc(state->jool.stats, JSTAT46_GSO_SEGMENTED);
+
+	segment.in = state->in.tuple;
+	segment.out = state->out.tuple;
+	segment.entries = state->entries;
+	segment.entries.route.dst = NULL;
+	xlation_reset(state);
+
+	segs = skb_gso_segment(skb, 0);
+	if (IS_ERR_OR_NULL(segs)) {
+		log_debug(state, "skb_gso_segment() returned %ld.",
+				PTR_ERR(segs));
+		return drop(state, JSTAT_ENOMEM);
+	}
+
+	__skb_queue_head_init(&segments);
+	for (; segs; segs = next) {
+		next = segs->next;
+		segs->next = NULL;
+		__skb_queue_tail(&segments, segs);
+	}
+
+	outer = state->batch;
+	if (!outer) {
+		__skb_queue_head_init(&rejected);
+		batch_init(&batch, &rejected);
+		state->batch = &batch;
+	}
+	state->segment = &segment;
+
+	translate_batch(state, &segments);
+
+	state->segment = NULL;
+	if (!outer) {
+		batch_send(state);
+		state->batch = NULL;
+		reinject(&rejected);
+	}
+
+	consume_skb(skb);
+	return VERDICT_STOLEN;
+}
+
 verdict core_4to6(struct sk_buff *skb, struct xlation *state)
 {
 	verdict result;
 
-	jstat_inc(state->jool.stats, JSTAT_RECEIVED4);
+	/* Segments were already counted as part of their super-packet. */
+	if (!state->segment)
+		jstat_inc(state->jool.stats, JSTAT_RECEIVED4);
 
 	/*
 	 * PLEASE REFRAIN FROM READING HEADERS FROM @skb UNTIL
@@ -110,6 +292,8 @@ verdict core_4to6(struct sk_buff *skb, struct xlation *state)
 		pkt_trace4(state);
 
 	result = core_common(state);
+	if (state->result.segment)
+		return core_4to6_segments(skb, state);
 	/* Fall through */
 
 end:
@@ -165,3 +349,47 @@ end:
 	send_icmp6_error(state, result);
 	return result;
 }
+
+/**
+ * Translates a list of packets, handing the translated packets to the kernel
+ * all at once, at the end.
+ *
+ * Unlike the netfilter hooks, which pay for a state allocation, a configuration
+ * snapshot and a route lookup on every packet, this only needs one state per
+ * batch, and consecutive packets with the same routing arguments (ie. the same
+ * flow) share the route.
+ *
+ * @jool is the instance the whole batch belongs to; the caller is expected to
+ * already hold a reference to it. The packets can be any mix of IPv4 and IPv6.
+ *
+ * Every packet in @skbs is consumed, except for the ones Jool refuses to
+ * translate, which are moved to @rejected so the caller can hand them back to
+ * the kernel.
+ *
+ * Note: Netfilter hands Jool one packet per hook call, and there is no list
+ * hook to receive them in bulk, so the Netfilter frontend does not batch;
+ * core_6to4() and core_4to6() still translate its packets one at a time. In
+ * this tree, the only packets that actually travel through the batch path are
+ * the segments of GSO super-packets (see core_4to6_segments()). This function
+ * is the entry point a list-based frontend would call, and is otherwise only
+ * exercised by the unit tests.
+ */
+int core_batch(struct xlator *jool, struct sk_buff_head *skbs,
+		struct sk_buff_head *rejected)
+{
+	struct xlation *state;
+	struct xlation_batch batch;
+
+	state = xlation_create(jool);
+	if (!state)
+		return -ENOMEM;
+
+	batch_init(&batch, rejected);
+	state->batch = &batch;
+
+	translate_batch(state, skbs);
+	batch_send(state);
+
+	xlation_destroy(state);
+	return 0;
+}
@@ -19,5 +19,11 @@ verdict core_6to4(struct sk_buff *skb, struct xlation *state);
  * counterpart.
  */
 verdict core_4to6(struct sk_buff *skb, struct xlation *state);
+/**
+ * Translates and sends every packet in @skbs; see the definition for details.
+ * (Not called by the Netfilter frontend, which does not batch.)
+ */
+int core_batch(struct xlator *jool, struct sk_buff_head *skbs,
+		struct sk_buff_head *rejected);
 
 #endif /* SRC_MOD_COMMON_CORE_H_ */
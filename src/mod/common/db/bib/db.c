@@ -1,19 +1,28 @@
 #include "mod/common/db/bib/db.h"
 
+#include <linux/jhash.h>
 #include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/rhashtable.h>
 #include <net/ip6_checksum.h>
 
 #include "common/constants.h"
+#include "mod/common/address.h"
 #include "mod/common/icmp_wrapper.h"
 #include "mod/common/linux_version.h"
 #include "mod/common/log.h"
 #include "mod/common/wkmalloc.h"
+#include "mod/common/db/flowcache.h"
 #include "mod/common/db/rbtree.h"
+#include "mod/common/db/bib/event_log.h"
 #include "mod/common/db/bib/pkt_queue.h"
 
 #define XGLOBALS(xlator) (xlator->globals.nat64.bib)
 #define GLOBALS(state) (state->jool.globals.nat64.bib)
 
+/* In jiffies. Sessions forget routes they haven't needed for this long. */
+#define ROUTE_IDLE (10 * HZ)
+
 /*
  * TODO (performance) Maybe pack this?
  */
@@ -42,6 +51,14 @@ struct tabled_bib {
 	struct rb_node hook4;
 
 	struct rb_root sessions;
+	/** Number of nodes in @sessions. */
+	unsigned int session_count;
+
+	/**
+	 * The subscriber this entry is accounted to.
+	 * NULL if the subscriber index is disabled (or could not allocate it).
+	 */
+	struct subscriber *subscriber;
 };
 
 /*
@@ -86,6 +103,8 @@ struct tabled_session {
 	 */
 	struct rb_node tree_hook;
 
+	/** Jiffy this session was created in this database. */
+	unsigned long creation_time;
 	unsigned long update_time;
 	/** MUST NOT be NULL. */
 	struct expire_timer *expirer;
@@ -93,6 +112,21 @@ struct tabled_session {
 
 	/** See pke_queue.h for some thoughts on stored packets. */
 	struct sk_buff *stored;
+
+	/**
+	 * Routes this session's packets recently needed. @route4 leads to the
+	 * IPv4 node, @route6 to the IPv6 node.
+	 * (Only populated if the session-route-cache global is enabled.)
+	 */
+	struct session_route route4;
+	struct session_route route6;
+	/**
+	 * Hook to bib_table.routed. Unlinked (but initialized) if neither
+	 * @route4 nor @route6 is set.
+	 */
+	struct list_head route_hook;
+	/** Jiffy at which the routes were last found in use. */
+	unsigned long route_time;
 };
 
 struct bib_session_tuple {
@@ -118,20 +152,81 @@ struct probing_session {
 
 struct expire_timer {
 	struct list_head sessions;
+	/** Number of sessions currently queued in @sessions. */
+	unsigned int count;
 	session_timer_type type;
 	fate_cb decide_fate_cb;
 };
 
+/**
+ * The group of BIB entries whose src6 addresses share the same first
+ * subscriber-prefix-len bits. (ie. one customer, as far as accounting is
+ * concerned.)
+ */
+struct subscriber {
+	/** Already masked. */
+	struct in6_addr prefix;
+	/** Number of BIB entries that point to this subscriber. */
+	unsigned int bibs;
+	/** Sum of the session_counts of the BIB entries. */
+	unsigned int sessions;
+	struct rhash_head hook;
+};
+
+static const struct rhashtable_params subscriber_params = {
+	.key_len = sizeof(struct in6_addr),
+	.key_offset = offsetof(struct subscriber, prefix),
+	.head_offset = offsetof(struct subscriber, hook),
+	.automatic_shrinking = true,
+};
+
+/**
+ * Hash table of a BIB table's subscribers.
+ *
+ * Note that we do not need this to list the entries of a subscriber; tree6 is
+ * sorted by address, so a subscriber's entries are already contiguous there.
+ * The point of the index is O(1) access to the subscriber's counters.
+ *
+ * The hash table grows and shrinks along with the subscriber count. It is
+ * always accessed while holding the BIB table's lock.
+ */
+struct subscriber_index {
+	/** NULL if the index is disabled. */
+	struct rhashtable *table;
+	/**
+	 * subscriber-prefix-len the index was built for. Zero if disabled.
+	 * Only bib_index_subscribers() changes it.
+	 */
+	__u8 prefix_len;
+	/** Number of nodes currently hanging from @table. */
+	unsigned int count;
+};
+
 struct bib_table {
 	/** Indexes the entries using their IPv6 identifiers. */
 	struct rb_root tree6;
 	/** Indexes the entries using their IPv4 identifiers. */
 	struct rb_root tree4;
+	/** Groups the entries by src6 prefix. */
+	struct subscriber_index subscribers;
 
 	spinlock_t lock;
 
+	/** Number of BIB entries currently indexed by the trees. */
+	unsigned int bib_count;
+	/**
+	 * Number of sessions currently in each TCP state.
+	 * (UDP and ICMP sessions are always ESTABLISHED.)
+	 */
+	unsigned int state_count[TCP_STATE_COUNT];
+
 	/** Expires this table's established sessions. */
 	struct expire_timer est_timer;
+	/**
+	 * The sessions that remember routes, sorted by route_time (oldest
+	 * first). See release_idle_routes().
+	 */
+	struct list_head routed;
 
 	/*
 	 * =============================================================
@@ -172,6 +267,9 @@ struct bib {
 	/** The session table for ICMP conversations. */
 	struct bib_table icmp;
 
+	/** Binary logging buffers. (Only used if logging-binary is enabled.) */
+	struct event_log *events;
+
 	struct kref refs;
 };
 
@@ -181,7 +279,25 @@ static struct kmem_cache *session_cache;
 #define alloc_bib(flags) wkmem_cache_alloc("bib entry", bib_cache, flags)
 #define alloc_session(flags) wkmem_cache_alloc("session", session_cache, flags)
 #define free_bib(bib) wkmem_cache_free("bib entry", bib_cache, bib)
-#define free_session(session) wkmem_cache_free("session", session_cache, session)
+
+static void forget_routes(struct tabled_session *session)
+{
+	if (session->route4.dst) {
+		dst_release(session->route4.dst);
+		session->route4.dst = NULL;
+	}
+	if (session->route6.dst) {
+		dst_release(session->route6.dst);
+		session->route6.dst = NULL;
+	}
+}
+
+/* Does not unhook @session->route_hook; the caller needs the table's lock. */
+static void free_session(struct tabled_session *session)
+{
+	forget_routes(session);
+	wkmem_cache_free("session", session_cache, session);
+}
 
 static struct tabled_bib *bib6_entry(const struct rb_node *node)
 {
@@ -212,6 +328,40 @@ static void tbtobe(struct tabled_bib *tabled, struct bib_entry *bib)
 	bib->is_static = tabled->is_static;
 }
 
+/**
+ * Shrinks @msecs as @table's session count approaches @high_water.
+ *
+ * Below half the mark, @msecs is returned untouched. From there, it decreases
+ * linearly, until it reaches @msecs / ADAPTIVE_TIMEOUT_DIVISOR at the mark.
+ * It grows back the same way as the table drains.
+ *
+ * Because every session of an expirer gets the same treatment, the expirer's
+ * list remains sorted.
+ */
+static __u32 adapt_timeout(struct bib_table *table, __u32 msecs,
+		__u32 high_water)
+{
+	unsigned int sessions;
+	__u32 start;
+	__u32 floor;
+
+	if (!high_water)
+		return msecs;
+
+	sessions = table->est_timer.count + table->trans_timer.count
+			+ table->syn4_timer.count;
+	start = high_water / 2;
+	if (sessions <= start)
+		return msecs;
+
+	floor = msecs / ADAPTIVE_TIMEOUT_DIVISOR;
+	if (sessions >= high_water)
+		return floor;
+
+	return msecs - div_u64((__u64)(msecs - floor) * (sessions - start),
+			high_water - start);
+}
+
 static unsigned long get_timeout(struct xlator *jool,
 		struct expire_timer *expirer)
 {
@@ -219,15 +369,19 @@ static unsigned long get_timeout(struct xlator *jool,
 	__u32 msecs;
 
 	if (&db->tcp.est_timer == expirer)
-		msecs = XGLOBALS(jool).ttl.tcp_est;
+		msecs = adapt_timeout(&db->tcp, XGLOBALS(jool).ttl.tcp_est,
+				XGLOBALS(jool).high_water.tcp);
 	else if (&db->tcp.trans_timer == expirer)
-		msecs = XGLOBALS(jool).ttl.tcp_trans;
+		msecs = adapt_timeout(&db->tcp, XGLOBALS(jool).ttl.tcp_trans,
+				XGLOBALS(jool).high_water.tcp);
 	else if (&db->udp.est_timer == expirer)
-		msecs = XGLOBALS(jool).ttl.udp;
+		msecs = adapt_timeout(&db->udp, XGLOBALS(jool).ttl.udp,
+				XGLOBALS(jool).high_water.udp);
 	else if (&db->tcp.syn4_timer == expirer)
 		msecs = 1000 * TCP_INCOMING_SYN;
 	else if (&db->icmp.est_timer == expirer)
-		msecs = XGLOBALS(jool).ttl.icmp;
+		msecs = adapt_timeout(&db->icmp, XGLOBALS(jool).ttl.icmp,
+				XGLOBALS(jool).high_water.icmp);
 	else {
 		/*
 		 * This is known to happen whenever the timer is cleaning.
@@ -253,6 +407,7 @@ static void tstose(struct xlator *jool,
 	se->proto = ts->bib->proto;
 	se->state = ts->state;
 	se->timer_type = ts->expirer->type;
+	se->creation_time = ts->creation_time;
 	se->update_time = ts->update_time;
 	se->timeout = get_timeout(jool, ts->expirer);
 	se->has_stored = !!ts->stored;
@@ -272,6 +427,46 @@ static void tbtobs(struct tabled_bib *tabled, struct bib_session *bs)
 	bs->session.proto = tabled->proto;
 }
 
+/*
+ * Returns the route @session remembers for @state's outgoing direction.
+ */
+static struct session_route *outgoing_route(struct xlation *state,
+		struct tabled_session *session)
+{
+	return (pkt_l3_proto(&state->in) == L3PROTO_IPV6)
+			? &session->route4
+			: &session->route6;
+}
+
+/*
+ * Hands @state a reference to the route @ts remembers for @state's packet, if
+ * it's still valid. (Routes go stale whenever the routing tables change; see
+ * dst_check().)
+ */
+static void get_route(struct xlation *state, struct tabled_session *ts)
+{
+	struct session_route *route;
+
+	if (!GLOBALS(state).route_cache)
+		return;
+
+	route = outgoing_route(state, ts);
+	if (!route->dst)
+		return;
+
+	if (!dst_check(route->dst, route->cookie)) {
+		jstat_inc(state->jool.stats, JSTAT_ROUTE_CACHE_INVALID);
+		dst_release(route->dst);
+		route->dst = NULL;
+		return;
+	}
+
+	if (state->entries.route.dst)
+		dst_release(state->entries.route.dst);
+	state->entries.route = *route;
+	dst_hold(route->dst);
+}
+
 /**
  * [Convert] tabled session to bib_session"
  */
@@ -280,6 +475,7 @@ static void tstobs(struct xlation *state, struct tabled_session *ts)
 	state->entries.bib_set = true;
 	state->entries.session_set = true;
 	tstose(&state->jool, ts, &state->entries.session);
+	get_route(state, ts);
 }
 
 /**
@@ -356,6 +552,7 @@ static void init_expirer(struct expire_timer *expirer,
 		fate_cb fate_cb)
 {
 	INIT_LIST_HEAD(&expirer->sessions);
+	expirer->count = 0;
 	expirer->type = type;
 	expirer->decide_fate_cb = fate_cb;
 }
@@ -367,8 +564,14 @@ static void init_table(struct bib_table *table,
 {
 	table->tree6 = RB_ROOT;
 	table->tree4 = RB_ROOT;
+	table->subscribers.table = NULL;
+	table->subscribers.prefix_len = 0;
+	table->subscribers.count = 0;
 	spin_lock_init(&table->lock);
+	table->bib_count = 0;
+	memset(table->state_count, 0, sizeof(table->state_count));
 	init_expirer(&table->est_timer, est_timeout, SESSION_TIMER_EST, est_cb);
+	INIT_LIST_HEAD(&table->routed);
 
 	init_expirer(&table->trans_timer, trans_timeout, SESSION_TIMER_TRANS,
 			just_die);
@@ -402,11 +605,16 @@ struct bib *bib_alloc(void)
 	db->tcp.pkt_queue = pktqueue_alloc();
 	if (!db->tcp.pkt_queue)
 		goto pktqueue_alloc_fail;
+	db->events = evlog_alloc();
+	if (!db->events)
+		goto evlog_alloc_fail;
 
 	kref_init(&db->refs);
 
 	return db;
 
+evlog_alloc_fail:
+	pktqueue_release(db->tcp.pkt_queue);
 pktqueue_alloc_fail:
 	wkfree(struct bib, db);
 db_alloc_fail:
@@ -440,6 +648,20 @@ static void release_bib_entry(struct tabled_bib *bib)
 	free_bib(bib);
 }
 
+static void free_subscriber(void *subscriber, void *arg)
+{
+	wkfree(struct subscriber, subscriber);
+}
+
+static void free_subscribers(struct rhashtable *table)
+{
+	if (!table)
+		return;
+
+	rhashtable_free_and_destroy(table, free_subscriber, NULL);
+	__wkfree("Subscriber index", table);
+}
+
 static void bib_release(struct kref *refs)
 {
 	struct bib *db;
@@ -458,7 +680,13 @@ static void bib_release(struct kref *refs)
 	rbtree_foreach(bib, tmp, &db->icmp.tree4, hook4)
 		release_bib_entry(bib);
 
+	/* Normally bib_stop() already did this. */
+	free_subscribers(db->udp.subscribers.table);
+	free_subscribers(db->tcp.subscribers.table);
+	free_subscribers(db->icmp.subscribers.table);
+
 	pktqueue_release(db->tcp.pkt_queue);
+	evlog_release(db->events);
 
 	wkfree(struct bib, db);
 }
@@ -468,20 +696,43 @@ void bib_put(struct bib *db)
 	kref_put(&db->refs, bib_release);
 }
 
-static void log_bib(struct xlator *jool, struct tabled_bib *bib, char *action)
+static void log_bib_event(struct xlator *jool, struct tabled_bib *bib,
+		enum jool_event_type type)
+{
+	struct jool_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.time = ktime_get_real_ns();
+	event.src6 = bib->src6.l3;
+	event.src4 = bib->src4.l3;
+	event.src6_port = bib->src6.l4;
+	event.src4_port = bib->src4.l4;
+	event.type = type;
+	event.proto = bib->proto;
+
+	evlog_add(jool, jool->nat64.bib->events, &event);
+}
+
+static void log_bib(struct xlator *jool, struct tabled_bib *bib,
+		enum jool_event_type type)
 {
 	time64_t tsec;
 	struct tm time;
 
 	if (!jool->globals.nat64.bib.bib_logging)
 		return;
+	if (jool->globals.nat64.bib.binary_logging) {
+		log_bib_event(jool, bib, type);
+		return;
+	}
 
 	tsec = ktime_get_real_seconds();
 	time64_to_tm(tsec, 0, &time);
 	log_info("%s %ld/%d/%d %d:%d:%d (GMT) - %s %pI6c#%u to %pI4#%u (%s)",
 			jool->iname,
 			1900 + time.tm_year, time.tm_mon + 1, time.tm_mday,
-			time.tm_hour, time.tm_min, time.tm_sec, action,
+			time.tm_hour, time.tm_min, time.tm_sec,
+			(type == JEV_BIB_ADD) ? "Mapped" : "Forgot",
 			&bib->src6.l3, bib->src6.l4,
 			&bib->src4.l3, bib->src4.l4,
 			l4proto_to_string(bib->proto));
@@ -489,25 +740,52 @@ static void log_bib(struct xlator *jool, struct tabled_bib *bib, char *action)
 
 static void log_new_bib(struct xlator *jool, struct tabled_bib *bib)
 {
-	return log_bib(jool, bib, "Mapped");
+	return log_bib(jool, bib, JEV_BIB_ADD);
+}
+
+static void log_session_event(struct xlator *jool,
+		struct tabled_session *session,
+		enum jool_event_type type)
+{
+	struct jool_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.time = ktime_get_real_ns();
+	event.src6 = session->bib->src6.l3;
+	event.dst6 = session->dst6.l3;
+	event.src4 = session->bib->src4.l3;
+	event.dst4 = session->dst4.l3;
+	event.src6_port = session->bib->src6.l4;
+	event.dst6_port = session->dst6.l4;
+	event.src4_port = session->bib->src4.l4;
+	event.dst4_port = session->dst4.l4;
+	event.type = type;
+	event.proto = session->bib->proto;
+
+	evlog_add(jool, jool->nat64.bib->events, &event);
 }
 
 static void log_session(struct xlator *jool,
 		struct tabled_session *session,
-		char *action)
+		enum jool_event_type type)
 {
 	time64_t tsec;
 	struct tm time;
 
 	if (!jool->globals.nat64.bib.session_logging)
 		return;
+	if (jool->globals.nat64.bib.binary_logging) {
+		log_session_event(jool, session, type);
+		return;
+	}
 
 	tsec = ktime_get_real_seconds();
 	time64_to_tm(tsec, 0, &time);
 	log_info("%s %ld/%d/%d %d:%d:%d (GMT) - %s %pI6c#%u|%pI6c#%u|"
 			"%pI4#%u|%pI4#%u|%s", jool->iname,
 			1900 + time.tm_year, time.tm_mon + 1, time.tm_mday,
-			time.tm_hour, time.tm_min, time.tm_sec, action,
+			time.tm_hour, time.tm_min, time.tm_sec,
+			(type == JEV_SESSION_ADD) ? "Added session" : "Forgot session",
 			&session->bib->src6.l3, session->bib->src6.l4,
 			&session->dst6.l3, session->dst6.l4,
 			&session->bib->src4.l3, session->bib->src4.l4,
@@ -517,7 +795,7 @@ static void log_session(struct xlator *jool,
 
 static void log_new_session(struct xlator *jool, struct tabled_session *session)
 {
-	return log_session(jool, session, "Added session");
+	return log_session(jool, session, JEV_SESSION_ADD);
 }
 
 /**
@@ -572,6 +850,220 @@ discard_probe:
 	kill_stored_pkt(jool, table, session);
 }
 
+static struct subscriber *find_subscriber(struct subscriber_index *index,
+		struct in6_addr const *prefix)
+{
+	return rhashtable_lookup_fast(index->table, prefix, subscriber_params);
+}
+
+/* Assumes the index is enabled. */
+static void index_bib(struct xlator *jool, struct subscriber_index *index,
+		struct tabled_bib *bib)
+{
+	struct subscriber *subscriber;
+	struct in6_addr prefix;
+
+	ipv6_addr_prefix(&prefix, &bib->src6.l3, index->prefix_len);
+
+	subscriber = find_subscriber(index, &prefix);
+	if (!subscriber) {
+		subscriber = wkmalloc(struct subscriber, GFP_ATOMIC);
+		if (!subscriber)
+			goto fail;
+		subscriber->prefix = prefix;
+		subscriber->bibs = 0;
+		subscriber->sessions = 0;
+		if (rhashtable_insert_fast(index->table, &subscriber->hook,
+				subscriber_params)) {
+			wkfree(struct subscriber, subscriber);
+			goto fail;
+		}
+		index->count++;
+		jstat_inc(jool->stats, JSTAT_SUBSCRIBERS);
+	}
+
+	subscriber->bibs++;
+	subscriber->sessions += bib->session_count;
+	bib->subscriber = subscriber;
+	return;
+
+fail:
+	/* Not fatal; the entry just won't be accounted. */
+	bib->subscriber = NULL;
+}
+
+/**
+ * Rebuilds @table's subscriber index for @prefix_len, unless that's the length
+ * it was built for already. Zero disables the index.
+ */
+static int index_subscribers(struct xlator *jool, struct bib_table *table,
+		__u8 prefix_len)
+{
+	struct subscriber_index *index = &table->subscribers;
+	struct rhashtable *old;
+	struct rhashtable *new;
+	struct rb_node *node;
+	unsigned int count;
+	int error;
+
+	/* Only we write it, and the caller serializes us. */
+	if (index->prefix_len == prefix_len)
+		return 0;
+
+	new = NULL;
+	if (prefix_len) {
+		new = __wkmalloc("Subscriber index", sizeof(*new), GFP_KERNEL);
+		if (!new)
+			return -ENOMEM;
+		error = rhashtable_init(new, &subscriber_params);
+		if (error) {
+			__wkfree("Subscriber index", new);
+			return error;
+		}
+	}
+
+	spin_lock_bh(&table->lock);
+
+	old = index->table;
+	count = index->count;
+	index->table = new;
+	index->prefix_len = prefix_len;
+	index->count = 0;
+	for (node = rb_first(&table->tree6); node; node = rb_next(node)) {
+		bib6_entry(node)->subscriber = NULL;
+		if (new)
+			index_bib(jool, index, bib6_entry(node));
+	}
+
+	spin_unlock_bh(&table->lock);
+
+	jstat_add(jool->stats, JSTAT_SUBSCRIBERS, -(int)count);
+	free_subscribers(old);
+	return 0;
+}
+
+/**
+ * The BIB is shared by all the instance's xlators, while subscriber-prefix-len
+ * is a global. If @jool's subscriber-prefix-len differs from the one @db's
+ * subscriber indexes were built for, rebuilds them. This is O(n), so it is not
+ * done in the packet path; call it (from process context) whenever the global
+ * might have changed. The caller must serialize calls on the same @db.
+ */
+int bib_index_subscribers(struct bib *db, struct xlator *jool)
+{
+	__u8 prefix_len = XGLOBALS(jool).subscriber_prefix_len;
+	int error;
+
+	error = index_subscribers(jool, &db->udp, prefix_len);
+	if (error)
+		return error;
+	error = index_subscribers(jool, &db->tcp, prefix_len);
+	if (error)
+		return error;
+	return index_subscribers(jool, &db->icmp, prefix_len);
+}
+
+/**
+ * Disables @jool's subscriber indexes. Releasing them sleeps, and the last
+ * bib_put() might happen in softirq context, so the instance's removal has to
+ * call this first.
+ */
+void bib_stop(struct xlator *jool)
+{
+	struct bib *db = jool->nat64.bib;
+
+	/* Disabling never allocates, so this can't fail. */
+	index_subscribers(jool, &db->udp, 0);
+	index_subscribers(jool, &db->tcp, 0);
+	index_subscribers(jool, &db->icmp, 0);
+}
+
+/**
+ * Accounts @bib (which was just hung on @table's trees) to its subscriber.
+ * Assumes @table's lock is held.
+ */
+static void attach_subscriber(struct xlator *jool, struct bib_table *table,
+		struct tabled_bib *bib)
+{
+	if (table->subscribers.table)
+		index_bib(jool, &table->subscribers, bib);
+}
+
+/**
+ * Reverts attach_subscriber(). Assumes @table's lock is held.
+ */
+static void detach_subscriber(struct xlator *jool, struct bib_table *table,
+		struct tabled_bib *bib)
+{
+	struct subscriber *subscriber = bib->subscriber;
+
+	if (!subscriber)
+		return;
+
+	bib->subscriber = NULL;
+	subscriber->bibs--;
+	subscriber->sessions -= bib->session_count;
+	if (!subscriber->bibs) {
+		/* All lookups happen inside the lock, so no need for RCU. */
+		rhashtable_remove_fast(table->subscribers.table,
+				&subscriber->hook, subscriber_params);
+		wkfree(struct subscriber, subscriber);
+		table->subscribers.count--;
+		jstat_dec(jool->stats, JSTAT_SUBSCRIBERS);
+	}
+}
+
+/* @delta is the number of sessions @bib just gained. (Or lost, if negative.) */
+static void account_sessions(struct tabled_bib *bib, int delta)
+{
+	bib->session_count += delta;
+	if (bib->subscriber)
+		bib->subscriber->sessions += delta;
+}
+
+/**
+ * Returns -EDQUOT if the subscriber of @bib (which is either an existing entry
+ * or one we're about to add) cannot afford a new session.
+ * Assumes @table's lock is held.
+ */
+static int check_subscriber_quota(struct xlator *jool, struct bib_table *table,
+		struct tabled_bib *bib, bool new_bib)
+{
+	__u32 max_bibs = XGLOBALS(jool).subscriber_max_bibs;
+	__u32 max_sessions = XGLOBALS(jool).subscriber_max_sessions;
+	struct subscriber *subscriber;
+	struct in6_addr prefix;
+
+	if (!max_bibs && !max_sessions)
+		return 0;
+
+	if (!table->subscribers.table)
+		return 0;
+
+	if (new_bib) {
+		ipv6_addr_prefix(&prefix, &bib->src6.l3,
+				table->subscribers.prefix_len);
+		subscriber = find_subscriber(&table->subscribers, &prefix);
+	} else {
+		subscriber = bib->subscriber;
+	}
+	if (!subscriber)
+		return 0;
+
+	if (new_bib && max_bibs && subscriber->bibs >= max_bibs)
+		return -EDQUOT;
+	if (max_sessions && subscriber->sessions >= max_sessions)
+		return -EDQUOT;
+	return 0;
+}
+
+/* Keeps @table's per-state session counters up to date. */
+static void count_state(struct bib_table *table, tcp_state state, int delta)
+{
+	if (state < TCP_STATE_COUNT)
+		table->state_count[state] += delta;
+}
+
 static void rm(struct xlator *jool,
 		struct bib_table *table,
 		struct list_head *probes,
@@ -584,27 +1076,157 @@ static void rm(struct xlator *jool,
 		handle_probe(jool, table, probes, session, tmp);
 
 	rb_erase(&session->tree_hook, &bib->sessions);
+	account_sessions(bib, -1);
+	count_state(table, session->state, -1);
 	list_del(&session->list_hook);
-	log_session(jool, session, "Forgot session");
+	list_del(&session->route_hook);
+	session->expirer->count--;
+	log_session(jool, session, JEV_SESSION_RM);
 	free_session(session);
 	jstat_dec(jool->stats, JSTAT_SESSIONS);
 
 	if (!bib->is_static && RB_EMPTY_ROOT(&bib->sessions)) {
 		rb_erase(&bib->hook6, &table->tree6);
 		rb_erase(&bib->hook4, &table->tree4);
-		log_bib(jool, bib, "Forgot");
+		detach_subscriber(jool, table, bib);
+		table->bib_count--;
+		log_bib(jool, bib, JEV_BIB_RM);
 		free_bib(bib);
 		jstat_dec(jool->stats, JSTAT_BIB_ENTRIES);
 	}
 }
 
+/*
+ * Evictable sessions are the ones that can be forgotten early without breaking
+ * anything the endpoints care much about: TCP transitory sessions, and every
+ * UDP and ICMP session. Established TCP sessions and type 2 packets are never
+ * evicted.
+ */
+static bool is_tcp(struct xlator *jool, struct bib_table *table)
+{
+	return table == &jool->nat64.bib->tcp;
+}
+
+static unsigned int count_evictable(struct xlator *jool,
+		struct bib_table *table)
+{
+	return table->trans_timer.count
+			+ (is_tcp(jool, table) ? 0 : table->est_timer.count);
+}
+
+static unsigned int evict_expirer(struct xlator *jool, struct bib_table *table,
+		struct expire_timer *expirer, unsigned int max,
+		struct list_head *probes)
+{
+	struct tabled_session *session, *tmp;
+	struct session_entry tmp_entry;
+	unsigned int evicted = 0;
+
+	/* Oldest first; the list is sorted by update time. */
+	list_for_each_entry_safe(session, tmp, &expirer->sessions, list_hook) {
+		if (evicted >= max)
+			break;
+		if (session->stored) /* rm() will need to ICMP error it */
+			tstose(jool, session, &tmp_entry);
+		rm(jool, table, probes, session, &tmp_entry);
+		evicted++;
+	}
+
+	return evicted;
+}
+
+/*
+ * Forgets up to @max of @table's evictable sessions, transitory first.
+ * Assumes @table's lock is held.
+ */
+static unsigned int evict(struct xlator *jool, struct bib_table *table,
+		unsigned int max, struct list_head *probes)
+{
+	unsigned int evicted;
+
+	evicted = evict_expirer(jool, table, &table->trans_timer, max, probes);
+	if (!is_tcp(jool, table) && evicted < max) {
+		evicted += evict_expirer(jool, table, &table->est_timer,
+				max - evicted, probes);
+	}
+
+	return evicted;
+}
+
+static unsigned long table_memory(struct bib_table *table)
+{
+	return table->bib_count * sizeof(struct tabled_bib)
+			+ (table->est_timer.count + table->trans_timer.count
+			+ table->syn4_timer.count) * sizeof(struct tabled_session);
+}
+
+/*
+ * Returns true if adding @bibs BIB entries and a session would take @jool
+ * beyond session-memory-limit.
+ *
+ * Only the caller's table is locked, so the other two are approximate. That's
+ * fine; the limit is not meant to be byte-accurate.
+ */
+static bool exceeds_memory_limit(struct xlator *jool, unsigned int bibs)
+{
+	__u64 limit = ((__u64)XGLOBALS(jool).session_memory_limit) << 10;
+	struct bib *db = jool->nat64.bib;
+
+	if (!limit)
+		return false;
+
+	return table_memory(&db->tcp) + table_memory(&db->udp)
+			+ table_memory(&db->icmp)
+			+ bibs * sizeof(struct tabled_bib)
+			+ sizeof(struct tabled_session) > limit;
+}
+
+/*
+ * Makes sure the instance can afford @bibs new BIB entries and a new session.
+ * If session-memory-limit is in the way, evicts @table's oldest sessions.
+ *
+ * rm() rebalances the trees, so evicting invalidates the tree slots the caller
+ * computed. For that reason, this only evicts once per insertion (@evicted
+ * remembers), and returns -EAGAIN when it does, so the caller can redo its
+ * lookup. Two evictions are enough to compensate for one new couple.
+ *
+ * Returns 0 if there's room, -EAGAIN if the caller should look up again, and
+ * -ENOSPC if there is no room.
+ * Assumes @table's lock is held.
+ */
+static int make_room(struct xlator *jool, struct bib_table *table,
+		unsigned int bibs, bool *evicted, struct list_head *probes)
+{
+	unsigned int count = 0;
+
+	if (!exceeds_memory_limit(jool, bibs))
+		return 0;
+	if (*evicted)
+		return -ENOSPC;
+
+	*evicted = true;
+	while (count < 2 && exceeds_memory_limit(jool, bibs)) {
+		if (!evict(jool, table, 1, probes))
+			break;
+		count++;
+	}
+
+	if (!count)
+		return -ENOSPC;
+
+	jstat_add(jool->stats, JSTAT_EVICTED_MEMORY_LIMIT, count);
+	return -EAGAIN;
+}
+
 static void handle_fate_timer(struct tabled_session *session,
 		struct expire_timer *timer)
 {
 	session->update_time = jiffies;
+	session->expirer->count--;
 	session->expirer = timer;
 	list_del(&session->list_hook);
 	list_add_tail(&session->list_hook, &timer->sessions);
+	timer->count++;
 }
 
 static int queue_unsorted_session(struct bib_table *table,
@@ -640,10 +1262,13 @@ static int queue_unsorted_session(struct bib_table *table,
 			break;
 	}
 
-	if (remove_first)
+	if (remove_first) {
 		list_del(&session->list_hook);
+		session->expirer->count--;
+	}
 	list_add(&session->list_hook, cursor);
 	session->expirer = expirer;
+	expirer->count++;
 	return 0;
 }
 
@@ -670,6 +1295,10 @@ static bool decide_fate(struct xlator *jool,
 	fate = cb->cb(&tmp, cb->arg);
 
 	/* The callback above is entitled to tweak these fields. */
+	if (session->state != tmp.state) {
+		count_state(table, session->state, -1);
+		count_state(table, tmp.state, 1);
+	}
 	session->state = tmp.state;
 	session->update_time = tmp.update_time;
 	if (!tmp.has_stored)
@@ -843,16 +1472,22 @@ struct slot_group {
 	struct tree_slot session;
 };
 
-static void commit_bib_add(struct xlator *jool, struct slot_group *slots)
+static void commit_bib_add(struct xlator *jool, struct bib_table *table,
+		struct slot_group *slots)
 {
 	treeslot_commit(&slots->bib6);
 	treeslot_commit(&slots->bib4);
+	attach_subscriber(jool, table, bib6_entry(slots->bib6.entry));
+	table->bib_count++;
 	jstat_inc(jool->stats, JSTAT_BIB_ENTRIES);
 }
 
-static void commit_session_add(struct xlator *jool, struct tree_slot *slot)
+static void commit_session_add(struct xlator *jool, struct bib_table *table,
+		struct tabled_session *session, struct tree_slot *slot)
 {
 	treeslot_commit(slot);
+	account_sessions(session->bib, 1);
+	count_state(table, session->state, 1);
 	jstat_inc(jool->stats, JSTAT_SESSIONS);
 }
 
@@ -862,6 +1497,7 @@ static void attach_timer(struct tabled_session *session,
 	session->update_time = jiffies;
 	session->expirer = expirer;
 	list_add_tail(&session->list_hook, &expirer->sessions);
+	expirer->count++;
 }
 
 static int compare_src6(struct tabled_bib *a, struct ipv6_transport_addr *b)
@@ -980,13 +1616,13 @@ static struct tabled_session *find_session_slot(struct tabled_bib *bib,
 	return NULL;
 }
 
-static int alloc_bib_session(struct bib_session_tuple *tuple)
+static int alloc_bib_session(struct bib_session_tuple *tuple, gfp_t flags)
 {
-	tuple->bib = alloc_bib(GFP_ATOMIC);
+	tuple->bib = alloc_bib(flags);
 	if (!tuple->bib)
 		return -ENOMEM;
 
-	tuple->session = alloc_session(GFP_ATOMIC);
+	tuple->session = alloc_session(flags);
 	if (!tuple->session) {
 		free_bib(tuple->bib);
 		return -ENOMEM;
@@ -1002,7 +1638,7 @@ static int create_bib_session6(struct bib_session_tuple *tuple,
 {
 	int error;
 
-	error = alloc_bib_session(tuple);
+	error = alloc_bib_session(tuple, GFP_ATOMIC);
 	if (error)
 		return error;
 
@@ -1020,10 +1656,16 @@ static int create_bib_session6(struct bib_session_tuple *tuple,
 	tuple->bib->proto = tuple6->l4_proto;
 	tuple->bib->is_static = false;
 	tuple->bib->sessions = RB_ROOT;
+	tuple->bib->session_count = 0;
+	tuple->bib->subscriber = NULL;
 	tuple->session->dst6 = tuple6->dst.addr6;
 	tuple->session->dst4 = *dst4;
 	tuple->session->state = state;
+	tuple->session->creation_time = jiffies;
 	tuple->session->stored = NULL;
+	tuple->session->route4.dst = NULL;
+	tuple->session->route6.dst = NULL;
+	INIT_LIST_HEAD(&tuple->session->route_hook);
 	return 0;
 }
 
@@ -1044,16 +1686,20 @@ static struct tabled_session *create_session4(struct tuple *tuple4,
 	session->dst6 = *dst6;
 	session->dst4 = tuple4->src.addr4;
 	session->state = state;
+	session->creation_time = jiffies;
 	session->stored = NULL;
+	session->route4.dst = NULL;
+	session->route6.dst = NULL;
+	INIT_LIST_HEAD(&session->route_hook);
 	return session;
 }
 
 static int create_bib_session(struct session_entry *session,
-		struct bib_session_tuple *tuple)
+		struct bib_session_tuple *tuple, gfp_t flags)
 {
 	int error;
 
-	error = alloc_bib_session(tuple);
+	error = alloc_bib_session(tuple, flags);
 	if (error)
 		return error;
 
@@ -1066,11 +1712,17 @@ static int create_bib_session(struct session_entry *session,
 	tuple->bib->proto = session->proto;
 	tuple->bib->is_static = false;
 	tuple->bib->sessions = RB_ROOT;
+	tuple->bib->session_count = 0;
+	tuple->bib->subscriber = NULL;
 	tuple->session->dst6 = session->dst6;
 	tuple->session->dst4 = session->dst4;
 	tuple->session->state = session->state;
+	tuple->session->creation_time = session->creation_time;
 	tuple->session->update_time = session->update_time;
 	tuple->session->stored = NULL;
+	tuple->session->route4.dst = NULL;
+	tuple->session->route6.dst = NULL;
+	INIT_LIST_HEAD(&tuple->session->route_hook);
 	return 0;
 }
 
@@ -1082,20 +1734,21 @@ static int create_bib_session(struct session_entry *session,
  * supposed to be added.
  */
 static void commit_add6(struct xlation *state,
+		struct bib_table *table,
 		struct bib_session_tuple *old,
 		struct bib_session_tuple *new,
 		struct slot_group *slots,
 		struct expire_timer *expirer)
 {
 	new->session->bib = old->bib ? : new->bib;
-	commit_session_add(&state->jool, &slots->session);
+	commit_session_add(&state->jool, table, new->session, &slots->session);
 	attach_timer(new->session, expirer);
 	log_new_session(&state->jool, new->session);
 	tstobs(state, new->session);
 	new->session = NULL; /* Do not free! */
 
 	if (!old->bib) {
-		commit_bib_add(&state->jool, slots);
+		commit_bib_add(&state->jool, table, slots);
 		log_new_bib(&state->jool, new->bib);
 		new->bib = NULL; /* Do not free! */
 	}
@@ -1109,6 +1762,7 @@ static void commit_add6(struct xlation *state,
  * supposed to be added.
  */
 static void commit_add4(struct xlation *state,
+		struct bib_table *table,
 		struct bib_session_tuple *old,
 		struct tabled_session **new,
 		struct tree_slot *slot,
@@ -1117,7 +1771,7 @@ static void commit_add4(struct xlation *state,
 	struct tabled_session *session = *new;
 
 	session->bib = old->bib;
-	commit_session_add(&state->jool, slot);
+	commit_session_add(&state->jool, table, session, slot);
 	attach_timer(session, expirer);
 	log_new_session(&state->jool, session);
 	tstobs(state, session);
@@ -1145,12 +1799,12 @@ static int commit_add(struct xlator *jool,
 		return error;
 
 	new->session->bib = old->bib ? : new->bib;
-	commit_session_add(jool, &slots->session);
+	commit_session_add(jool, table, new->session, &slots->session);
 	log_new_session(jool, new->session);
 	new->session = NULL; /* Do not free! */
 
 	if (!old->bib) {
-		commit_bib_add(jool, slots);
+		commit_bib_add(jool, table, slots);
 		log_new_bib(jool, new->bib);
 		new->bib = NULL; /* Do not free! */
 	}
@@ -1165,6 +1819,9 @@ static int detach_sessions(struct bib_table *table, struct tabled_bib *bib)
 
 	rbtree_foreach(session, tmp, &bib->sessions, tree_hook) {
 		list_del(&session->list_hook);
+		list_del(&session->route_hook);
+		session->expirer->count--;
+		count_state(table, session->state, -1);
 		if (session->stored)
 			table->pkt_count--;
 		detached--;
@@ -1178,6 +1835,8 @@ static void detach_bib(struct xlator *jool, struct bib_table *table,
 {
 	rb_erase(&bib->hook6, &table->tree6);
 	rb_erase(&bib->hook4, &table->tree4);
+	detach_subscriber(jool, table, bib);
+	table->bib_count--;
 	jstat_dec(jool->stats, JSTAT_BIB_ENTRIES);
 	/* NOTE THAT detach_sessions() RETURNS NEGATIVE. */
 	jstat_add(jool->stats, JSTAT_SESSIONS, detach_sessions(table, bib));
@@ -1363,7 +2022,7 @@ static int upgrade_pktqueue_session(struct xlator *jool,
 	 * We're going to pretend that @sos has been a valid V4 INIT session all
 	 * along.
 	 */
-	error = alloc_bib_session(old);
+	error = alloc_bib_session(old, GFP_ATOMIC);
 	if (error) {
 		pktqueue_put_node(jool, sos);
 		return error;
@@ -1377,13 +2036,19 @@ static int upgrade_pktqueue_session(struct xlator *jool,
 	bib->proto = L4PROTO_TCP;
 	bib->is_static = false;
 	bib->sessions = RB_ROOT;
+	bib->session_count = 0;
+	bib->subscriber = NULL;
 
 	session->dst6 = sos->dst6;
 	session->dst4 = sos->dst4;
 	session->state = V4_INIT;
 	session->bib = bib;
+	session->creation_time = jiffies;
 	session->update_time = jiffies;
 	session->stored = NULL;
+	session->route4.dst = NULL;
+	session->route6.dst = NULL;
+	INIT_LIST_HEAD(&session->route_hook);
 
 	/*
 	 * This *has* to work. src6 wasn't in the database because we just
@@ -1397,10 +2062,14 @@ static int upgrade_pktqueue_session(struct xlator *jool,
 		goto trainwreck;
 	treeslot_commit(&bib_slot6);
 	treeslot_commit(&bib_slot4);
+	attach_subscriber(jool, table, bib);
+	table->bib_count++;
 	jstat_inc(jool->stats, JSTAT_BIB_ENTRIES);
 
 	rb_link_node(&session->tree_hook, NULL, &bib->sessions.rb_node);
 	rb_insert_color(&session->tree_hook, &bib->sessions);
+	account_sessions(bib, 1);
+	count_state(table, session->state, 1);
 	attach_timer(session, &table->syn4_timer);
 	jstat_inc(jool->stats, JSTAT_SESSIONS);
 
@@ -1582,6 +2251,8 @@ int bib_add6(struct xlation *state,
 	struct bib_session_tuple old;
 	struct slot_group slots;
 	struct bib_delete_list bdl = { NULL };
+	LIST_HEAD(probes);
+	bool evicted = false;
 	int error;
 
 	table = get_table(state->jool.nat64.bib, tuple6->l4_proto);
@@ -1607,6 +2278,7 @@ int bib_add6(struct xlation *state,
 
 	spin_lock_bh(&table->lock); /* Here goes... */
 
+again:
 	error = find_bib_session6(&state->jool, table, masks, &new, &old, &slots, &bdl);
 	if (error)
 		goto end;
@@ -1617,8 +2289,27 @@ int bib_add6(struct xlation *state,
 		goto end;
 	}
 
+	error = check_subscriber_quota(&state->jool, table,
+			old.bib ? : new.bib, !old.bib);
+	if (error) {
+		log_debug(state, "The subscriber has reached its quota.");
+		goto end;
+	}
+
+	error = make_room(&state->jool, table, old.bib ? 0 : 1, &evicted,
+			&probes);
+	if (error == -EAGAIN) {
+		if (masks && !old.bib)
+			mask_domain_rewind(masks);
+		goto again;
+	}
+	if (error) {
+		log_debug(state, "The instance has reached its memory limit.");
+		goto end;
+	}
+
 	/* New connection; add the session. (And maybe the BIB entry as well) */
-	commit_add6(state, &old, &new, &slots, &table->est_timer);
+	commit_add6(state, table, &old, &new, &slots, &table->est_timer);
 	/* Fall through */
 
 end:
@@ -1629,6 +2320,7 @@ end:
 	if (new.session)
 		free_session(new.session);
 	commit_delete_list(&bdl);
+	post_fate(&state->jool, &probes);
 
 	return error;
 }
@@ -1659,7 +2351,9 @@ int bib_add4(struct xlation *state,
 	struct bib_session_tuple old;
 	struct tabled_session *new;
 	struct tree_slot session_slot;
+	LIST_HEAD(probes);
 	bool allow;
+	bool evicted = false;
 	int error = 0;
 
 	table = get_table(state->jool.nat64.bib, tuple4->l4_proto);
@@ -1672,6 +2366,7 @@ int bib_add4(struct xlation *state,
 
 	spin_lock_bh(&table->lock);
 
+again:
 	find_bib_session4(table, tuple4, new, &old, &allow, &session_slot);
 
 	if (old.session) {
@@ -1691,14 +2386,23 @@ int bib_add4(struct xlation *state,
 		goto end;
 	}
 
+	error = make_room(&state->jool, table, 0, &evicted, &probes);
+	if (error == -EAGAIN)
+		goto again;
+	if (error) {
+		log_debug(state, "The instance has reached its memory limit.");
+		goto end;
+	}
+
 	/* Ok, no issues; add the session. */
-	commit_add4(state, &old, &new, &session_slot, &table->est_timer);
+	commit_add4(state, table, &old, &new, &session_slot, &table->est_timer);
 	/* Fall through */
 
 end:
 	spin_unlock_bh(&table->lock);
 	if (new)
 		free_session(new);
+	post_fate(&state->jool, &probes);
 	return error;
 }
 
@@ -1717,6 +2421,8 @@ verdict bib_add_tcp6(struct xlation *state,
 	struct bib_session_tuple old;
 	struct slot_group slots;
 	struct bib_delete_list bdl = { NULL };
+	LIST_HEAD(probes);
+	bool evicted = false;
 	verdict result;
 
 	pkt = &state->in;
@@ -1729,6 +2435,7 @@ verdict bib_add_tcp6(struct xlation *state,
 	table = &state->jool.nat64.bib->tcp;
 	spin_lock_bh(&table->lock);
 
+again:
 	if (find_bib_session6(&state->jool, table, masks, &new, &old, &slots, &bdl)) {
 		result = drop(state, JSTAT_UNKNOWN);
 		goto end;
@@ -1759,9 +2466,30 @@ verdict bib_add_tcp6(struct xlation *state,
 		goto end;
 	}
 
+	if (check_subscriber_quota(&state->jool, table, old.bib ? : new.bib,
+			!old.bib)) {
+		log_debug(state, "The subscriber has reached its quota.");
+		result = drop(state, JSTAT_SUBSCRIBER_QUOTA);
+		goto end;
+	}
+
+	switch (make_room(&state->jool, table, old.bib ? 0 : 1, &evicted,
+			&probes)) {
+	case 0:
+		break;
+	case -EAGAIN:
+		if (masks && !old.bib)
+			mask_domain_rewind(masks);
+		goto again;
+	default:
+		log_debug(state, "The instance has reached its memory limit.");
+		result = drop(state, JSTAT_SESSION_MEMORY_LIMIT);
+		goto end;
+	}
+
 	/* All exits up till now require @new.* to be deleted. */
 
-	commit_add6(state, &old, &new, &slots, &table->trans_timer);
+	commit_add6(state, table, &old, &new, &slots, &table->trans_timer);
 	result = VERDICT_CONTINUE;
 	/* Fall through */
 
@@ -1773,6 +2501,7 @@ end:
 	if (new.session)
 		free_session(new.session);
 	commit_delete_list(&bdl);
+	post_fate(&state->jool, &probes);
 
 	return result;
 }
@@ -1790,6 +2519,8 @@ verdict bib_add_tcp4(struct xlation *state,
 	struct tabled_session *new;
 	struct bib_session_tuple old;
 	struct tree_slot session_slot;
+	LIST_HEAD(probes);
+	bool evicted = false;
 	verdict result;
 	int error;
 
@@ -1804,6 +2535,7 @@ verdict bib_add_tcp4(struct xlation *state,
 	table = &state->jool.nat64.bib->tcp;
 	spin_lock_bh(&table->lock);
 
+again:
 	find_bib_session4(table, &pkt->tuple, new, &old, NULL, &session_slot);
 
 	if (old.session) {
@@ -1864,6 +2596,17 @@ verdict bib_add_tcp4(struct xlation *state,
 		goto end;
 	}
 
+	switch (make_room(&state->jool, table, 0, &evicted, &probes)) {
+	case 0:
+		break;
+	case -EAGAIN:
+		goto again;
+	default:
+		log_debug(state, "The instance has reached its memory limit.");
+		result = drop(state, JSTAT_SESSION_MEMORY_LIMIT);
+		goto end;
+	}
+
 	result = VERDICT_CONTINUE;
 
 	if (GLOBALS(state).drop_by_addr) {
@@ -1881,7 +2624,7 @@ verdict bib_add_tcp4(struct xlation *state,
 		 */
 	}
 
-	commit_add4(state, &old, &new, &session_slot,
+	commit_add4(state, table, &old, &new, &session_slot,
 			new->stored ? &table->syn4_timer : &table->trans_timer);
 	/* Fall through */
 
@@ -1890,17 +2633,60 @@ end:
 
 	if (new)
 		free_session(new);
+	post_fate(&state->jool, &probes);
 
 	return result;
 
 too_many_pkts:
 	spin_unlock_bh(&table->lock);
 	free_session(new);
+	post_fate(&state->jool, &probes);
 	log_debug(state, "Too many Simultaneous Opens.");
 	/* Fall back to assume there's no SO. */
 	return drop_icmp(state, JSTAT_SO_FULL, ICMPERR_PORT_UNREACHABLE, 0);
 }
 
+/**
+ * Makes @state's session remember @route, so the session's next packets (in
+ * the same direction as @state's) don't need to be routed.
+ *
+ * Does not steal @route's reference.
+ */
+void bib_cache_route(struct xlation *state, struct session_route const *route)
+{
+	struct bib_table *table;
+	struct tabled_session key;
+	struct tabled_session *session;
+	struct tabled_bib *bib;
+	struct session_route *cached;
+	struct tree_slot slot;
+
+	if (!state->entries.session_set)
+		return;
+	table = get_table(state->jool.nat64.bib, state->entries.session.proto);
+	if (!table)
+		return;
+
+	key.dst4 = state->entries.session.dst4;
+
+	spin_lock_bh(&table->lock);
+
+	/* The session might have died since filtering; that's fine. */
+	bib = find_bib6(table, &state->entries.session.src6);
+	session = bib ? find_session_slot(bib, &key, NULL, &slot) : NULL;
+	if (session) {
+		cached = outgoing_route(state, session);
+		if (cached->dst)
+			dst_release(cached->dst);
+		*cached = *route;
+		dst_hold(route->dst);
+		session->route_time = jiffies;
+		list_move_tail(&session->route_hook, &table->routed);
+	}
+
+	spin_unlock_bh(&table->lock);
+}
+
 int bib_find(struct bib *db, struct tuple *tuple, struct bib_session *result)
 {
 	struct bib_entry tmp;
@@ -1928,6 +2714,44 @@ int bib_find(struct bib *db, struct tuple *tuple, struct bib_session *result)
 	return 0;
 }
 
+/*
+ * Adds @new to @table, unless its session already exists, in which case it
+ * returns -EEXIST and leaves the collision in @old->session.
+ * Shared by the joold and import paths; @quota tells whether the subscriber
+ * quotas apply. Assumes @table's lock is held.
+ */
+static int add_session(struct xlator *jool, struct bib_table *table,
+		struct bib_session_tuple *new, struct bib_session_tuple *old,
+		session_timer_type timer_type, bool quota,
+		struct bib_delete_list *bdl, struct list_head *probes)
+{
+	struct slot_group slots;
+	bool evicted = false;
+	int error;
+
+again:
+	error = find_bib_session6(jool, table, NULL, new, old, &slots, bdl);
+	if (error)
+		return error;
+	if (old->session)
+		return -EEXIST;
+
+	if (quota) {
+		error = check_subscriber_quota(jool, table,
+				old->bib ? : new->bib, !old->bib);
+		if (error)
+			return error;
+	}
+
+	error = make_room(jool, table, old->bib ? 0 : 1, &evicted, probes);
+	if (error == -EAGAIN)
+		goto again;
+	if (error)
+		return error;
+
+	return commit_add(jool, table, old, new, &slots, timer_type);
+}
+
 int bib_add_session(struct xlator *jool,
 		struct session_entry *session,
 		struct collision_cb *cb)
@@ -1935,34 +2759,28 @@ int bib_add_session(struct xlator *jool,
 	struct bib_table *table;
 	struct bib_session_tuple new;
 	struct bib_session_tuple old;
-	struct slot_group slots;
 	struct bib_delete_list bdl = { NULL };
+	LIST_HEAD(probes);
 	int error;
 
 	table = get_table(jool->nat64.bib, session->proto);
 	if (!table)
 		return -EINVAL;
 
-	error = create_bib_session(session, &new);
+	error = create_bib_session(session, &new, GFP_ATOMIC);
 	if (error)
 		return error;
 
 	spin_lock_bh(&table->lock);
 
-	error = find_bib_session6(jool, table, NULL, &new, &old, &slots, &bdl);
-	if (error)
-		goto end;
-
-	if (old.session) {
+	error = add_session(jool, table, &new, &old, session->timer_type,
+			false, &bdl, &probes);
+	if (error == -EEXIST) {
 		/* There's no packet; ignore the verdict. */
 		decide_fate(jool, cb, table, old.session, NULL);
-		goto end;
+		error = 0;
 	}
 
-	error = commit_add(jool, table, &old, &new, &slots, session->timer_type);
-	/* Fall through */
-
-end:
 	spin_unlock_bh(&table->lock);
 
 	if (new.bib)
@@ -1970,10 +2788,184 @@ end:
 	if (new.session)
 		free_session(new.session);
 	commit_delete_list(&bdl);
+	post_fate(jool, &probes);
 
 	return error;
 }
 
+/**
+ * Adds @count sessions (and their BIB entries) at once. This is the import half
+ * of the session checkpoint; there is no packet and no collision callback, so
+ * sessions that already exist are left alone and reported as -EEXIST.
+ *
+ * Nodes are allocated outside of the spinlocks, which are then taken once per
+ * run of same-protocol sessions, and released every BIB_RM_BUDGET sessions so
+ * a large message doesn't stall the packet path. Unlike joold's, these
+ * sessions are subject to the subscriber quotas. Since the expirer lists are
+ * kept sorted by
+ * queue_unsorted_session() (which searches from the tail), the caller should
+ * hand in every timer's sessions in ascending expiration order.
+ *
+ * @errors's nonzero entries are skipped, and the rest are overridden with the
+ * result of the corresponding session.
+ */
+void bib_add_session_bulk(struct xlator *jool, struct session_entry *sessions,
+		unsigned int count, int *errors)
+{
+	struct bib_session_tuple *news;
+	struct bib_session_tuple old;
+	struct bib_delete_list bdl = { NULL };
+	struct bib_table *table;
+	LIST_HEAD(probes);
+	unsigned int budget;
+	unsigned int i;
+
+	news = __wkvmalloc_array("Session bulk nodes", count,
+			sizeof(*news), GFP_KERNEL);
+	if (!news) {
+		for (i = 0; i < count; i++)
+			if (!errors[i])
+				errors[i] = -ENOMEM;
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		news[i].bib = NULL;
+		news[i].session = NULL;
+		if (errors[i])
+			continue;
+		if (!get_table(jool->nat64.bib, sessions[i].proto)) {
+			errors[i] = -EINVAL;
+			continue;
+		}
+		errors[i] = create_bib_session(&sessions[i], &news[i],
+				GFP_KERNEL);
+	}
+
+	table = NULL;
+	budget = BIB_RM_BUDGET;
+	for (i = 0; i < count; i++) {
+		if (errors[i])
+			continue;
+
+		if (table != get_table(jool->nat64.bib, sessions[i].proto)) {
+			if (table)
+				spin_unlock_bh(&table->lock);
+			table = get_table(jool->nat64.bib, sessions[i].proto);
+			spin_lock_bh(&table->lock);
+			budget = BIB_RM_BUDGET;
+		} else if (budget == 0) {
+			spin_unlock_bh(&table->lock);
+			cond_resched();
+			spin_lock_bh(&table->lock);
+			budget = BIB_RM_BUDGET;
+		}
+
+		errors[i] = add_session(jool, table, &news[i], &old,
+				sessions[i].timer_type, true, &bdl, &probes);
+		budget--;
+	}
+	if (table)
+		spin_unlock_bh(&table->lock);
+
+	for (i = 0; i < count; i++) {
+		if (news[i].bib)
+			free_bib(news[i].bib);
+		if (news[i].session)
+			free_session(news[i].session);
+	}
+	commit_delete_list(&bdl);
+	post_fate(jool, &probes);
+	__wkvfree("Session bulk nodes", news);
+}
+
+static int compare_session_dst4(struct tabled_session *session,
+		struct ipv4_transport_addr *dst4)
+{
+	return taddr4_compare(&session->dst4, dst4);
+}
+
+/*
+ * Pretends @touch's session received a packet at @touch->update_time.
+ *
+ * Only established sessions (and TCP sessions whose probe is pending) can be
+ * touched; the rest of the states need the state machine to see the actual
+ * packets.
+ */
+static int touch_session(struct bib_table *table, struct session_entry *touch)
+{
+	struct tabled_bib *bib;
+	struct tabled_session *session;
+
+	bib = find_bib6(table, &touch->src6);
+	if (!bib || !taddr4_equals(&bib->src4, &touch->src4))
+		return -ESRCH;
+	session = rbtree_find(&touch->dst4, &bib->sessions,
+			compare_session_dst4, struct tabled_session, tree_hook);
+	if (!session || !taddr6_equals(&session->dst6, &touch->dst6))
+		return -ESRCH;
+
+	if (session->state != ESTABLISHED && session->state != TRANS)
+		return -EINVAL;
+
+	if (!time_after(touch->update_time, session->update_time))
+		return 0;
+
+	if (session->state != ESTABLISHED) {
+		count_state(table, session->state, -1);
+		count_state(table, ESTABLISHED, 1);
+		session->state = ESTABLISHED;
+	}
+	session->update_time = touch->update_time;
+	return queue_unsorted_session(table, session, SESSION_TIMER_EST, true);
+}
+
+/**
+ * Refreshes @count sessions that are being translated by someone other than
+ * Jool. (ie. an XDP fast path.) Each entry's update_time is the last time its
+ * session saw a packet.
+ *
+ * Sessions that no longer exist, or are no longer established, fail with
+ * -ESRCH and -EINVAL, respectively. Either way, the caller should stop
+ * translating them by itself.
+ *
+ * @errors's nonzero entries are skipped, and the rest are overridden with the
+ * result of the corresponding session.
+ *
+ * Each touched session is filed in its expiration list by a walk from the
+ * list's newest end, so @sessions should be grouped by protocol and sorted by
+ * update_time. Otherwise, the walks can add up to O(@count²).
+ */
+void bib_touch_session_bulk(struct xlator *jool, struct session_entry *sessions,
+		unsigned int count, int *errors)
+{
+	struct bib_table *table;
+	struct bib_table *current_table;
+	unsigned int i;
+
+	current_table = NULL;
+	for (i = 0; i < count; i++) {
+		if (errors[i])
+			continue;
+
+		table = get_table(jool->nat64.bib, sessions[i].proto);
+		if (!table) {
+			errors[i] = -EINVAL;
+			continue;
+		}
+		if (table != current_table) {
+			if (current_table)
+				spin_unlock_bh(&current_table->lock);
+			current_table = table;
+			spin_lock_bh(&current_table->lock);
+		}
+
+		errors[i] = touch_session(table, &sessions[i]);
+	}
+	if (current_table)
+		spin_unlock_bh(&current_table->lock);
+}
+
 static void __clean(struct xlator *jool,
 		struct expire_timer *expirer,
 		struct bib_table *table,
@@ -1999,6 +2991,35 @@ static void __clean(struct xlator *jool,
 	}
 }
 
+/*
+ * Releases the routes of the sessions that haven't needed them in a while, so
+ * idle (but unexpired) sessions don't keep routes, and therefore their devices,
+ * pinned. (An established TCP session can sit idle for hours.)
+ *
+ * Assumes @table's lock is held.
+ */
+static void release_idle_routes(struct bib_table *table)
+{
+	struct tabled_session *session;
+	struct tabled_session *tmp;
+
+	list_for_each_entry_safe(session, tmp, &table->routed, route_hook) {
+		/* Sorted by route_time, so stop on the first recent one. */
+		if (time_before(jiffies, session->route_time + ROUTE_IDLE))
+			break;
+
+		if (time_before(jiffies, session->update_time + ROUTE_IDLE)) {
+			/* Still in use; check again later. */
+			session->route_time = jiffies;
+			list_move_tail(&session->route_hook, &table->routed);
+			continue;
+		}
+
+		forget_routes(session);
+		list_del_init(&session->route_hook);
+	}
+}
+
 static void clean_table(struct xlator *jool, struct bib_table *table)
 {
 	LIST_HEAD(probes);
@@ -2008,6 +3029,7 @@ static void clean_table(struct xlator *jool, struct bib_table *table)
 	__clean(jool, &table->est_timer, table, &probes);
 	__clean(jool, &table->trans_timer, table, &probes);
 	__clean(jool, &table->syn4_timer, table, &probes);
+	release_idle_routes(table);
 	if (table->pkt_queue) {
 		table->pkt_count -= pktqueue_prepare_clean(table->pkt_queue,
 				&icmps);
@@ -2027,6 +3049,77 @@ void bib_clean(struct xlator *jool)
 	clean_table(jool, &db->udp);
 	clean_table(jool, &db->tcp);
 	clean_table(jool, &db->icmp);
+	evlog_flush(jool, db->events);
+}
+
+/**
+ * Returns the number of sessions bib_evict() could currently forget.
+ * (Approximate; the tables are not locked.)
+ */
+unsigned long bib_count_evictable(struct xlator *jool)
+{
+	struct bib *db = jool->nat64.bib;
+	return count_evictable(jool, &db->tcp)
+			+ count_evictable(jool, &db->udp)
+			+ count_evictable(jool, &db->icmp);
+}
+
+/*
+ * Evicts in batches of BIB_RM_BUDGET, releasing the lock and rescheduling in
+ * between.
+ */
+static unsigned long evict_table(struct xlator *jool, struct bib_table *table,
+		unsigned long max)
+{
+	struct list_head probes;
+	unsigned long evicted = 0;
+	unsigned int batch;
+	unsigned int evicted_now;
+
+	while (evicted < max) {
+		INIT_LIST_HEAD(&probes);
+		batch = min_t(unsigned long, max - evicted, BIB_RM_BUDGET);
+
+		spin_lock_bh(&table->lock);
+		evicted_now = evict(jool, table, batch, &probes);
+		spin_unlock_bh(&table->lock);
+
+		post_fate(jool, &probes);
+		evicted += evicted_now;
+		if (evicted_now < batch)
+			break;
+
+		cond_resched();
+	}
+
+	return evicted;
+}
+
+/**
+ * Forgets up to @max evictable sessions, oldest first: TCP transitory, then
+ * UDP, then ICMP. Meant for memory pressure; returns the number of sessions
+ * that were actually forgotten.
+ *
+ * Also empties the flow cache, since it might still be translating the
+ * evicted sessions. (And its memory is just as reclaimable.)
+ *
+ * Might sleep between batches, so don't call it from atomic context.
+ * (Including xlator_foreach() callbacks.)
+ */
+unsigned long bib_evict(struct xlator *jool, unsigned long max)
+{
+	struct bib *db = jool->nat64.bib;
+	unsigned long evicted;
+
+	evicted = evict_table(jool, &db->tcp, max);
+	evicted += evict_table(jool, &db->udp, max - evicted);
+	evicted += evict_table(jool, &db->icmp, max - evicted);
+
+	if (evicted) {
+		jstat_add(jool->stats, JSTAT_EVICTED_MEMORY_PRESSURE, evicted);
+		flowcache_flush(jool->nat64.flows);
+	}
+	return evicted;
 }
 
 static struct rb_node *find_starting_point(struct bib_table *table,
@@ -2059,63 +3152,492 @@ static struct rb_node *find_starting_point(struct bib_table *table,
 	return (compare_src4(bib, offset) < 0) ? rb_next(parent) : parent;
 }
 
-int bib_foreach(struct bib *db, l4_protocol proto,
+enum filter_verdict {
+	/* The entry matches the filter's BIB conditions. */
+	FV_MATCH,
+	/* The entry does not match, but the next one might. */
+	FV_SKIP,
+	/* The entry does not match; resume from the returned address. */
+	FV_SEEK,
+	/* Neither this nor any of the following entries can match. */
+	FV_STOP,
+};
+
+static bool filter_has_range(struct table_filter const *filter)
+{
+	return filter && (filter->src4.set || filter->ports_set);
+}
+
+/*
+ * The src4 range defined by @filter is a rectangle (addresses times ports).
+ * Because tree4 is sorted by address first and port second, the entries of
+ * each address are contiguous, so we can jump over the ports that don't match
+ * instead of iterating through them.
+ */
+static void get_filter_range(struct table_filter const *filter,
+		__u32 *first, __u32 *last, __u16 *port_min, __u16 *port_max)
+{
+	if (filter->src4.set) {
+		*first = be32_to_cpu(filter->src4.prefix.addr.s_addr);
+		*last = *first | ~get_prefix4_mask(&filter->src4.prefix);
+	} else {
+		*first = 0;
+		*last = 0xFFFFFFFFu;
+	}
+
+	if (filter->ports_set) {
+		*port_min = filter->port_min;
+		*port_max = filter->port_max;
+	} else {
+		*port_min = 0;
+		*port_max = 65535;
+	}
+}
+
+static void get_filter_start(struct table_filter const *filter,
+		struct ipv4_transport_addr *start)
+{
+	__u32 first, last;
+	__u16 port_min, port_max;
+
+	get_filter_range(filter, &first, &last, &port_min, &port_max);
+	start->l3.s_addr = cpu_to_be32(first);
+	start->l4 = port_min;
+}
+
+static enum filter_verdict filter_bib(struct table_filter const *filter,
+		struct ipv6_transport_addr const *src6,
+		struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr *next)
+{
+	__u32 addr, first, last;
+	__u16 port_min, port_max;
+
+	if (!filter)
+		return FV_MATCH;
+
+	if (filter_has_range(filter)) {
+		get_filter_range(filter, &first, &last, &port_min, &port_max);
+		addr = be32_to_cpu(src4->l3.s_addr);
+
+		if (addr < first) {
+			get_filter_start(filter, next);
+			return FV_SEEK;
+		}
+		if (addr > last)
+			return FV_STOP;
+		if (src4->l4 < port_min) {
+			next->l3 = src4->l3;
+			next->l4 = port_min;
+			return FV_SEEK;
+		}
+		if (src4->l4 > port_max) {
+			if (addr == last)
+				return FV_STOP;
+			next->l3.s_addr = cpu_to_be32(addr + 1);
+			next->l4 = port_min;
+			return FV_SEEK;
+		}
+	}
+
+	if (filter->src6.set && !prefix6_contains(&filter->src6.prefix,
+			&src6->l3))
+		return FV_SKIP;
+
+	return FV_MATCH;
+}
+
+static bool filter_session(struct table_filter const *filter,
+		struct tabled_session const *session)
+{
+	if (!filter)
+		return true;
+
+	if (filter->dst4.set && !prefix4_contains(&filter->dst4.prefix,
+			&session->dst4.l3))
+		return false;
+	if (filter->state_set && session->state != filter->state)
+		return false;
+	if (filter->min_age && time_before(jiffies, session->creation_time
+			+ msecs_to_jiffies(filter->min_age)))
+		return false;
+
+	return true;
+}
+
+static int foreach_src4(struct bib_table *table,
+		struct table_filter const *filter,
 		bib_foreach_entry_cb cb, void *cb_arg,
 		const struct ipv4_transport_addr *offset)
 {
-	struct bib_table *table;
 	struct rb_node *node;
 	struct tabled_bib *tabled;
 	struct bib_entry bib;
+	struct ipv4_transport_addr next;
+	bool include_offset;
 	int error = 0;
 
-	table = get_table(db, proto);
-	if (!table)
-		return -EINVAL;
+	include_offset = false;
+	if (filter_has_range(filter)) {
+		get_filter_start(filter, &next);
+		if (!offset || taddr4_compare(offset, &next) < 0) {
+			offset = &next;
+			include_offset = true;
+		}
+	}
 
 	spin_lock_bh(&table->lock);
 
-	node = find_starting_point(table, offset, false);
-	for (; node && !error; node = rb_next(node)) {
+	node = find_starting_point(table, offset, include_offset);
+	while (node && !error) {
 		tabled = bib4_entry(node);
-		tbtobe(tabled, &bib);
-		error = cb(&bib, cb_arg);
+		switch (filter_bib(filter, &tabled->src6, &tabled->src4, &next)) {
+		case FV_MATCH:
+			tbtobe(tabled, &bib);
+			error = cb(&bib, cb_arg);
+			/* Fall through. */
+		case FV_SKIP:
+			node = rb_next(node);
+			break;
+		case FV_SEEK:
+			node = find_starting_point(table, &next, true);
+			break;
+		case FV_STOP:
+			node = NULL;
+			break;
+		}
 	}
 
 	spin_unlock_bh(&table->lock);
 	return error;
 }
 
-static struct rb_node *slot_next(struct tree_slot *slot)
+static struct rb_node *find_starting_point6(struct bib_table *table,
+		struct ipv6_transport_addr *offset,
+		bool include_offset)
 {
-	if (!slot->parent)
+	struct tabled_bib *bib;
+	struct rb_node **node;
+	struct rb_node *parent;
+
+	rbtree_find_node(offset, &table->tree6, compare_src6, struct tabled_bib,
+			hook6, parent, node);
+	if (*node)
+		return include_offset ? (*node) : rb_next(*node);
+
+	if (!parent)
 		return NULL;
-	if (&slot->parent->rb_left == slot->rb_link)
-		return slot->parent;
-	/* else if (slot->parent->rb_right == &slot->rb_link) */
-	return rb_next(slot->parent);
-}
 
-static void next_bib(struct rb_node *next, struct bib_session_tuple *pos)
-{
-	pos->bib = bib4_entry(next);
+	bib = rb_entry(parent, struct tabled_bib, hook6);
+	return (compare_src6(bib, offset) < 0) ? rb_next(parent) : parent;
 }
 
-static void next_session(struct rb_node *next, struct bib_session_tuple *pos)
+/*
+ * tree6 is sorted by address, so all the entries whose src6 belongs to
+ * @filter's IPv6 prefix are contiguous there. (This is what makes "list the
+ * entries of subscriber X" O(log n + k) rather than a full table scan.)
+ */
+static int foreach_src6(struct bib_table *table,
+		struct table_filter const *filter,
+		bib_foreach_entry_cb cb, void *cb_arg,
+		const struct ipv6_transport_addr *offset)
 {
-	pos->session = node2session(next);
-	if (!pos->session) {
-		/* Tree was empty or the previous was the last session. */
-		/* Cascade "next" to the supertree. */
-		next_bib(rb_next(&pos->bib->hook4), pos);
+	struct rb_node *node;
+	struct tabled_bib *tabled;
+	struct bib_entry bib;
+	struct ipv6_transport_addr start;
+	bool include_start;
+	int error = 0;
+
+	start.l3 = filter->src6.prefix.addr;
+	start.l4 = 0;
+	include_start = true;
+	if (offset && taddr6_compare(offset, &start) >= 0) {
+		start = *offset;
+		include_start = false;
+	}
+
+	spin_lock_bh(&table->lock);
+
+	node = find_starting_point6(table, &start, include_start);
+	while (node && !error) {
+		tabled = bib6_entry(node);
+		if (!prefix6_contains(&filter->src6.prefix, &tabled->src6.l3))
+			break;
+		tbtobe(tabled, &bib);
+		error = cb(&bib, cb_arg);
+		node = rb_next(node);
 	}
+
+	spin_unlock_bh(&table->lock);
+	return error;
 }
 
-/**
- * Finds the BIB entry and/or session where a foreach of the sessions should
- * start with, based on @offset.
- *
- * If a session that matches @offset is found, will initialize both @pos->bib
+int bib_foreach(struct bib *db, l4_protocol proto,
+		bib_foreach_entry_cb cb, void *cb_arg,
+		const struct ipv4_transport_addr *offset)
+{
+	struct bib_table *table;
+
+	table = get_table(db, proto);
+	if (!table)
+		return -EINVAL;
+
+	return foreach_src4(table, NULL, cb, cb_arg, offset);
+}
+
+/**
+ * Same as bib_foreach(), except only the entries that match @filter's BIB
+ * conditions (src6 and the src4 range) are handed to @cb. @filter can be NULL.
+ *
+ * If @filter only specifies an IPv6 prefix, the entries are sorted by src6
+ * rather than src4. Either way, @offset is the last entry the caller received.
+ */
+int bib_foreach_filtered(struct bib *db, l4_protocol proto,
+		struct table_filter const *filter,
+		bib_foreach_entry_cb cb, void *cb_arg,
+		const struct bib_entry *offset)
+{
+	struct bib_table *table;
+
+	table = get_table(db, proto);
+	if (!table)
+		return -EINVAL;
+
+	if (filter && filter->src6.set && !filter_has_range(filter))
+		return foreach_src6(table, filter, cb, cb_arg,
+				offset ? &offset->addr6 : NULL);
+
+	return foreach_src4(table, filter, cb, cb_arg,
+			offset ? &offset->addr4 : NULL);
+}
+
+static void subscriber2entry(struct subscriber_index *index,
+		struct subscriber *subscriber,
+		struct subscriber_entry *entry)
+{
+	entry->prefix.addr = subscriber->prefix;
+	entry->prefix.len = index->prefix_len;
+	entry->bibs = subscriber->bibs;
+	entry->sessions = subscriber->sessions;
+}
+
+static int report_subscriber(struct subscriber_index *index,
+		struct subscriber *subscriber,
+		bib_foreach_subscriber_cb cb, void *cb_arg)
+{
+	struct subscriber_entry entry;
+
+	subscriber2entry(index, subscriber, &entry);
+	return cb(&entry, cb_arg);
+}
+
+/*
+ * Returns the first entry, starting from @node, that is accounted to a
+ * subscriber.
+ */
+static struct tabled_bib *first_subscribed(struct rb_node *node)
+{
+	struct tabled_bib *bib;
+
+	for (; node; node = rb_next(node)) {
+		bib = bib6_entry(node);
+		if (bib->subscriber)
+			return bib;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the first tree6 node that follows the entries of subscriber @prefix.
+ * (Subscribers are contiguous in tree6, so this is how we hop from one to the
+ * next in O(log n).)
+ */
+static struct rb_node *skip_subscriber(struct bib_table *table,
+		struct in6_addr const *prefix)
+{
+	struct ipv6_transport_addr last;
+	unsigned int i;
+
+	last.l3 = *prefix;
+	for (i = table->subscribers.prefix_len; i < 128; i++)
+		addr6_set_bit(&last.l3, i, true);
+	last.l4 = 65535;
+
+	return find_starting_point6(table, &last, false);
+}
+
+#define foreach_subscriber(table, bib, start) \
+	for (bib = first_subscribed(start); \
+			bib; \
+			bib = first_subscribed(skip_subscriber(table, \
+					&bib->subscriber->prefix)))
+
+/**
+ * Hands @cb the subscribers of @proto's table, sorted by prefix.
+ * @offset is the last subscriber the caller received.
+ */
+int bib_foreach_subscriber(struct xlator *jool, l4_protocol proto,
+		bib_foreach_subscriber_cb cb, void *cb_arg,
+		struct ipv6_prefix const *offset)
+{
+	struct bib_table *table;
+	struct subscriber_index *index;
+	struct tabled_bib *bib;
+	struct rb_node *start;
+	int error = 0;
+
+	table = get_table(jool->nat64.bib, proto);
+	if (!table)
+		return -EINVAL;
+	index = &table->subscribers;
+
+	spin_lock_bh(&table->lock);
+
+	if (!index->table)
+		goto end;
+
+	start = offset
+			? skip_subscriber(table, &offset->addr)
+			: rb_first(&table->tree6);
+	foreach_subscriber(table, bib, start) {
+		error = report_subscriber(index, bib->subscriber, cb, cb_arg);
+		if (error)
+			break;
+	}
+
+end:
+	spin_unlock_bh(&table->lock);
+	return error;
+}
+
+/* Sorting criteria of bib_top_subscribers(). */
+static bool consumes_more(struct subscriber const *subscriber,
+		struct subscriber_entry const *entry)
+{
+	if (subscriber->sessions != entry->sessions)
+		return subscriber->sessions > entry->sessions;
+	return subscriber->bibs > entry->bibs;
+}
+
+/**
+ * Writes the (at most @max) subscribers of @proto's table that own the most
+ * sessions into @result, in descending order. @count will be the number of
+ * subscribers written.
+ *
+ * @result has to be allocated by the caller, because we can't sleep while
+ * holding the lock. @max is expected to be small; this is O(subscribers * max).
+ */
+int bib_top_subscribers(struct xlator *jool, l4_protocol proto,
+		struct subscriber_entry *result, unsigned int max,
+		unsigned int *count)
+{
+	struct bib_table *table;
+	struct subscriber_index *index;
+	struct subscriber *subscriber;
+	struct tabled_bib *bib;
+	unsigned int j;
+
+	table = get_table(jool->nat64.bib, proto);
+	if (!table)
+		return -EINVAL;
+	index = &table->subscribers;
+	*count = 0;
+
+	spin_lock_bh(&table->lock);
+
+	if (!index->table || !max)
+		goto end;
+
+	foreach_subscriber(table, bib, rb_first(&table->tree6)) {
+		subscriber = bib->subscriber;
+
+		/* Find the insertion point; @result is sorted. */
+		j = *count;
+		while (j > 0 && consumes_more(subscriber, &result[j - 1]))
+			j--;
+		if (j >= max)
+			continue;
+
+		if (*count < max)
+			(*count)++;
+		memmove(&result[j + 1], &result[j],
+				(*count - j - 1) * sizeof(*result));
+		subscriber2entry(index, subscriber, &result[j]);
+	}
+
+end:
+	spin_unlock_bh(&table->lock);
+	return 0;
+}
+
+/**
+ * Copies @proto's table counters into @result. This does not walk the table.
+ * (The age histogram is left to the caller.)
+ */
+int bib_session_stats(struct xlator *jool, l4_protocol proto,
+		struct session_stats *result)
+{
+	struct bib_table *table;
+	unsigned int i;
+
+	table = get_table(jool->nat64.bib, proto);
+	if (!table)
+		return -EINVAL;
+
+	memset(result, 0, sizeof(*result));
+
+	spin_lock_bh(&table->lock);
+	result->bibs = table->bib_count;
+	result->est = table->est_timer.count;
+	result->trans = table->trans_timer.count;
+	result->syn4 = table->syn4_timer.count;
+	result->stored_pkts = table->pkt_count;
+	for (i = 0; i < TCP_STATE_COUNT; i++)
+		result->states[i] = table->state_count[i];
+	result->est_timeout = jiffies_to_msecs(get_timeout(jool,
+			&table->est_timer));
+	if (proto == L4PROTO_TCP) {
+		result->trans_timeout = jiffies_to_msecs(get_timeout(jool,
+				&table->trans_timer));
+	}
+	spin_unlock_bh(&table->lock);
+
+	result->sessions = result->est + result->trans + result->syn4;
+	return 0;
+}
+
+static struct rb_node *slot_next(struct tree_slot *slot)
+{
+	if (!slot->parent)
+		return NULL;
+	if (&slot->parent->rb_left == slot->rb_link)
+		return slot->parent;
+	/* else if (slot->parent->rb_right == &slot->rb_link) */
+	return rb_next(slot->parent);
+}
+
+static void next_bib(struct rb_node *next, struct bib_session_tuple *pos)
+{
+	pos->bib = bib4_entry(next);
+}
+
+static void next_session(struct rb_node *next, struct bib_session_tuple *pos)
+{
+	pos->session = node2session(next);
+	if (!pos->session) {
+		/* Tree was empty or the previous was the last session. */
+		/* Cascade "next" to the supertree. */
+		next_bib(rb_next(&pos->bib->hook4), pos);
+	}
+}
+
+/**
+ * Finds the BIB entry and/or session where a foreach of the sessions should
+ * start with, based on @offset.
+ *
+ * If a session that matches @offset is found, will initialize both @pos->bib
  * and @pos->session to point to this session.
  * If @pos->bib is defined but @pos->session is not, the foreach should start
  * from @pos->bib's first session.
@@ -2154,56 +3676,337 @@ static void find_session_offset(struct bib_table *table,
 		next_session(rb_next(&pos->session->tree_hook), pos);
 }
 
-#define foreach_bib(table, node) \
-		for (node = bib4_entry(rb_first(&(table)->tree4)); \
-				node; \
-				node = bib4_entry(rb_next(&node->hook4)))
-#define foreach_session(tree, node) \
-		for (node = node2session(rb_first(tree)); \
-				node; \
-				node = node2session(rb_next(&node->tree_hook)))
-
 int bib_foreach_session(struct xlator *jool, l4_protocol proto,
 		session_foreach_entry_cb cb, void *cb_arg,
 		struct session_foreach_offset *offset)
 {
-	struct bib_table *table;
+	return bib_foreach_session_filtered(jool, proto, NULL, cb, cb_arg,
+			offset);
+}
+
+/*
+ * Iterates through (at most) @budget nodes of @table, starting from @offset.
+ * Assumes @table's lock is held.
+ *
+ * If the budget runs out before the end of the table, @resume is set to the
+ * position where the iteration should continue and @paused becomes true.
+ */
+static int __foreach_session(struct xlator *jool, struct bib_table *table,
+		struct table_filter const *filter,
+		session_foreach_entry_cb cb, void *cb_arg,
+		struct session_foreach_offset *offset,
+		unsigned int budget,
+		struct session_foreach_offset *resume, bool *paused)
+{
 	struct bib_session_tuple pos;
+	struct session_foreach_offset start;
+	struct ipv4_transport_addr next;
 	struct session_entry tmp;
-	int error = 0;
+	int error;
 
-	table = get_table(jool->nat64.bib, proto);
-	if (!table)
-		return -EINVAL;
+	*paused = false;
 
-	spin_lock_bh(&table->lock);
+	if (filter_has_range(filter)) {
+		memset(&start, 0, sizeof(start));
+		get_filter_start(filter, &start.offset.src);
+		start.include_offset = true;
+		if (!offset || taddr4_compare(&offset->offset.src,
+				&start.offset.src) < 0)
+			offset = &start;
+	}
 
 	if (offset) {
-		find_session_offset(table, offset, &pos);
 		/* if pos.session != NULL, then pos.bib != NULL. */
-		if (pos.session)
-			goto goto_session;
-		if (pos.bib)
-			goto goto_bib;
-		goto end;
+		find_session_offset(table, offset, &pos);
+	} else {
+		pos.bib = bib4_entry(rb_first(&table->tree4));
+		pos.session = NULL;
 	}
 
-	foreach_bib(table, pos.bib) {
-goto_bib:	foreach_session(&pos.bib->sessions, pos.session) {
-goto_session:		tstose(jool, pos.session, &tmp);
+	while (pos.bib) {
+		if (!budget--)
+			goto pause;
+
+		switch (filter_bib(filter, &pos.bib->src6, &pos.bib->src4,
+				&next)) {
+		case FV_MATCH:
+			break;
+		case FV_SKIP:
+			next_bib(rb_next(&pos.bib->hook4), &pos);
+			pos.session = NULL;
+			continue;
+		case FV_SEEK:
+			next_bib(find_starting_point(table, &next, true), &pos);
+			pos.session = NULL;
+			continue;
+		case FV_STOP:
+			return 0;
+		}
+
+		/* NULL session means "start from the BIB's first session." */
+		if (!pos.session)
+			pos.session = node2session(rb_first(&pos.bib->sessions));
+
+		for (; pos.session; pos.session = node2session(
+				rb_next(&pos.session->tree_hook))) {
+			if (!budget--)
+				goto pause;
+			if (!filter_session(filter, pos.session))
+				continue;
+			tstose(jool, pos.session, &tmp);
 			error = cb(&tmp, cb_arg);
 			if (error)
-				goto end;
+				return error;
 		}
+
+		next_bib(rb_next(&pos.bib->hook4), &pos);
 	}
 
-end:
+	return 0;
+
+pause:
+	/*
+	 * Zero is the lowest dst4, so if there's no session, this resumes
+	 * from the BIB's first one.
+	 */
+	memset(resume, 0, sizeof(*resume));
+	resume->offset.src = pos.bib->src4;
+	if (pos.session)
+		resume->offset.dst = pos.session->dst4;
+	resume->include_offset = true;
+	*paused = true;
+	return 0;
+}
+
+/**
+ * Same as bib_foreach_session(), except only the sessions that match @filter
+ * are handed to @cb. @filter can be NULL.
+ *
+ * If @filter defines a src4 range, the iteration starts at the range's first
+ * entry and ends at its last one, instead of walking the whole table.
+ */
+int bib_foreach_session_filtered(struct xlator *jool, l4_protocol proto,
+		struct table_filter const *filter,
+		session_foreach_entry_cb cb, void *cb_arg,
+		struct session_foreach_offset *offset)
+{
+	struct bib_table *table;
+	struct session_foreach_offset resume;
+	bool paused;
+	int error;
+
+	table = get_table(jool->nat64.bib, proto);
+	if (!table)
+		return -EINVAL;
+
+	spin_lock_bh(&table->lock);
+	error = __foreach_session(jool, table, filter, cb, cb_arg, offset,
+			UINT_MAX, &resume, &paused);
 	spin_unlock_bh(&table->lock);
+
 	return error;
 }
 
-#undef foreach_session
-#undef foreach_bib
+/**
+ * Prepares @dump for a bib_dump_window() sequence. @filter and @offset can be
+ * NULL. @filter is not copied, so it needs to outlive the dump.
+ */
+void bib_dump_init(struct session_dump *dump, l4_protocol proto,
+		struct table_filter const *filter,
+		struct session_foreach_offset const *offset)
+{
+	memset(dump, 0, sizeof(*dump));
+	dump->proto = proto;
+	dump->filter = filter;
+	if (offset) {
+		dump->offset = *offset;
+		dump->has_offset = true;
+	}
+}
+
+/**
+ * Hands the next (at most) SESSION_DUMP_BUDGET sessions of @dump's table to
+ * @cb. (BIB entries that need to be skipped also count towards the budget.)
+ *
+ * Unlike bib_foreach_session(), this releases the table's lock after each
+ * window, so a full dump of a huge table does not block the packet path for
+ * long. The caller is expected to sleep/reschedule between calls. Insertions
+ * and removals that happen between windows are tolerated: Each session that
+ * exists during the whole dump is returned exactly once, and always in tree4
+ * order.
+ *
+ * Sets @dump->done once the table has been exhausted. Stops early if @cb
+ * returns nonzero, and returns that value.
+ */
+int bib_dump_window(struct xlator *jool, struct session_dump *dump,
+		session_foreach_entry_cb cb, void *cb_arg)
+{
+	struct bib_table *table;
+	struct session_foreach_offset resume;
+	bool paused;
+	ktime_t start;
+	s64 hold;
+	int error;
+
+	table = get_table(jool->nat64.bib, dump->proto);
+	if (!table)
+		return -EINVAL;
+
+	start = ktime_get();
+	spin_lock_bh(&table->lock);
+	error = __foreach_session(jool, table, dump->filter, cb, cb_arg,
+			dump->has_offset ? &dump->offset : NULL,
+			SESSION_DUMP_BUDGET, &resume, &paused);
+	spin_unlock_bh(&table->lock);
+	hold = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	dump->windows++;
+	if (hold > dump->max_hold_ns)
+		dump->max_hold_ns = hold;
+
+	if (error)
+		return error;
+
+	if (paused) {
+		dump->offset = resume;
+		dump->has_offset = true;
+	} else {
+		dump->done = true;
+	}
+
+	return 0;
+}
+
+static int compare_tuple4(struct ipv4_transport_addr const *src4,
+		struct ipv4_transport_addr const *dst4,
+		struct taddr4_tuple const *tuple)
+{
+	int gap;
+
+	gap = taddr4_compare(src4, &tuple->src);
+	if (gap)
+		return gap;
+
+	return taddr4_compare(dst4, &tuple->dst);
+}
+
+/**
+ * Returns true if @session lies after @end in tree4 order.
+ */
+bool session_beyond(struct session_entry const *session,
+		struct taddr4_tuple const *end)
+{
+	return compare_tuple4(&session->src4, &session->dst4, end) > 0;
+}
+
+/*
+ * Timers and TCP states are left out on purpose; they change all the time and
+ * are already synchronized by regular joold traffic. The digests are only meant
+ * to detect sessions one of the peers lacks.
+ */
+static __u32 hash_session(struct session_entry const *session)
+{
+	__u32 words[12];
+
+	memcpy(&words[0], &session->src6.l3, sizeof(struct in6_addr));
+	memcpy(&words[4], &session->dst6.l3, sizeof(struct in6_addr));
+	words[8] = session->src4.l3.s_addr;
+	words[9] = session->dst4.l3.s_addr;
+	words[10] = (((__u32)session->src6.l4) << 16) | session->dst6.l4;
+	words[11] = (((__u32)session->src4.l4) << 16) | session->dst4.l4;
+
+	return jhash2(words, ARRAY_SIZE(words), session->proto);
+}
+
+struct digest_args {
+	struct session_digest *digest;
+	/* Stop after this many sessions. Zero means "no limit." */
+	unsigned int max;
+	/* true: @max ends the range. false: @digest->end does. */
+	bool stretch;
+};
+
+static int digest_cb(struct session_entry const *session, void *arg)
+{
+	struct digest_args *args = arg;
+	struct session_digest *digest = args->digest;
+
+	if (!args->stretch && session_beyond(session, &digest->end))
+		return 1; /* Range ended. */
+
+	digest->count++;
+	digest->hash += hash_session(session);
+
+	if (args->max && digest->count >= args->max) {
+		if (args->stretch) {
+			digest->end.src = session->src4;
+			digest->end.dst = session->dst4;
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * bib_digest_end_max - Stretches @digest's range to the end of the table.
+ */
+void bib_digest_end_max(struct session_digest *digest)
+{
+	digest->end.src.l3.s_addr = cpu_to_be32(0xFFFFFFFFu);
+	digest->end.src.l4 = 0xFFFFu;
+	digest->end.dst = digest->end.src;
+}
+
+/**
+ * bib_digest - Computes @digest's count and hash, from the sessions that lie
+ * between @digest->start and @digest->end.
+ *
+ * If @max is nonzero, the walk stops after @max sessions, even if the range
+ * continues. (So @digest->count reaching @max only means "at least @max.")
+ */
+int bib_digest(struct xlator *jool, struct session_digest *digest,
+		unsigned int max)
+{
+	struct digest_args args;
+	int error;
+
+	digest->count = 0;
+	digest->hash = 0;
+
+	args.digest = digest;
+	args.max = max;
+	args.stretch = false;
+	error = bib_foreach_session(jool, digest->proto, digest_cb, &args,
+			&digest->start);
+	return (error < 0) ? error : 0;
+}
+
+/**
+ * bib_digest_next - Computes the digest of the (up to) @max sessions that
+ * follow @digest->start, and sets @digest->end accordingly.
+ *
+ * If the table runs out of sessions before @max, the range is stretched until
+ * the end of the table, so sessions only the peers know about are covered as
+ * well. (This is the case iff @digest->count ends up lower than @max.)
+ */
+int bib_digest_next(struct xlator *jool, struct session_digest *digest,
+		unsigned int max)
+{
+	struct digest_args args;
+	int error;
+
+	digest->count = 0;
+	digest->hash = 0;
+	bib_digest_end_max(digest);
+
+	args.digest = digest;
+	args.max = max;
+	args.stretch = true;
+	error = bib_foreach_session(jool, digest->proto, digest_cb, &args,
+			&digest->start);
+	return (error < 0) ? error : 0;
+}
 
 int bib_find6(struct bib *db, l4_protocol proto,
 		struct ipv6_transport_addr *addr,
@@ -2252,32 +4055,22 @@ static void bib2tabled(struct bib_entry *bib, struct tabled_bib *tabled)
 	tabled->proto = bib->l4_proto;
 	tabled->is_static = true;
 	tabled->sessions = RB_ROOT;
+	tabled->session_count = 0;
+	tabled->subscriber = NULL;
 }
 
-static int __bib_add_static(struct xlator *jool, struct bib_entry *new,
+/*
+ * Hangs @bib (which describes @new) on @table's trees.
+ * Assumes @table's lock is held. Always takes ownership of @bib.
+ */
+static int add_static_locked(struct xlator *jool, struct bib_table *table,
+		struct bib_entry *new, struct tabled_bib *bib,
 		struct bib_entry *old)
 {
-	struct bib_table *table;
-	struct tabled_bib *bib;
 	struct tabled_bib *collision;
 	struct tree_slot slot6;
 	struct tree_slot slot4;
 
-	__log_debug(jool, "Adding static BIB entry (%pI6c#%u, %pI4#%u).",
-			&new->addr6.l3, new->addr6.l4,
-			&new->addr4.l3, new->addr4.l4);
-
-	table = get_table(jool->nat64.bib, new->l4_proto);
-	if (!table)
-		return -EINVAL;
-
-	bib = alloc_bib(GFP_ATOMIC);
-	if (!bib)
-		return -ENOMEM;
-	bib2tabled(new, bib);
-
-	spin_lock_bh(&table->lock);
-
 	collision = find_bibtree6_slot(table, bib, &slot6);
 	if (collision) {
 		if (taddr4_equals(&bib->src4, &collision->src4))
@@ -2291,6 +4084,8 @@ static int __bib_add_static(struct xlator *jool, struct bib_entry *new,
 
 	treeslot_commit(&slot6);
 	treeslot_commit(&slot4);
+	attach_subscriber(jool, table, bib);
+	table->bib_count++;
 	jstat_inc(jool->stats, JSTAT_BIB_ENTRIES);
 
 	/*
@@ -2302,29 +4097,49 @@ static int __bib_add_static(struct xlator *jool, struct bib_entry *new,
 	if (new->l4_proto == L4PROTO_TCP)
 		pktqueue_rm(jool->nat64.bib->tcp.pkt_queue, &new->addr4);
 
-	spin_unlock_bh(&table->lock);
 	return 0;
 
 upgrade:
 	collision->is_static = true;
-	spin_unlock_bh(&table->lock);
 	free_bib(bib);
 	return 0;
 
 eexist:
 	tbtobe(collision, old);
-	spin_unlock_bh(&table->lock);
 	free_bib(bib);
 	return -EEXIST;
 }
 
-/* Noisy version. */
-int bib_add_static(struct xlator *jool, struct bib_entry *new)
+static int __bib_add_static(struct xlator *jool, struct bib_entry *new,
+		struct bib_entry *old)
 {
-	struct bib_entry old;
+	struct bib_table *table;
+	struct tabled_bib *bib;
 	int error;
 
-	error = __bib_add_static(jool, new, &old);
+	__log_debug(jool, "Adding static BIB entry (%pI6c#%u, %pI4#%u).",
+			&new->addr6.l3, new->addr6.l4,
+			&new->addr4.l3, new->addr4.l4);
+
+	table = get_table(jool->nat64.bib, new->l4_proto);
+	if (!table)
+		return -EINVAL;
+
+	bib = alloc_bib(GFP_ATOMIC);
+	if (!bib)
+		return -ENOMEM;
+	bib2tabled(new, bib);
+
+	spin_lock_bh(&table->lock);
+	error = add_static_locked(jool, table, new, bib, old);
+	spin_unlock_bh(&table->lock);
+
+	return error;
+}
+
+static void log_add_static_error(struct bib_entry *new, struct bib_entry *old,
+		int error)
+{
 	switch (error) {
 	case 0:
 		break;
@@ -2332,17 +4147,91 @@ int bib_add_static(struct xlator *jool, struct bib_entry *new)
 		log_err("Entry %pI4#%u|%pI6c#%u collides with %pI4#%u|%pI6c#%u.",
 				&new->addr4.l3, new->addr4.l4,
 				&new->addr6.l3, new->addr6.l4,
-				&old.addr4.l3, old.addr4.l4,
-				&old.addr6.l3, old.addr6.l4);
+				&old->addr4.l3, old->addr4.l4,
+				&old->addr6.l3, old->addr6.l4);
 		break;
 	default:
 		log_err("Unknown error code: %d", error);
 		break;
 	}
+}
 
+/* Noisy version. */
+int bib_add_static(struct xlator *jool, struct bib_entry *new)
+{
+	struct bib_entry old;
+	int error;
+
+	error = __bib_add_static(jool, new, &old);
+	log_add_static_error(new, &old, error);
 	return error;
 }
 
+/**
+ * Adds the @count static entries from @news.
+ *
+ * Every table's lock is taken once per run of consecutive entries of its
+ * protocol, so the caller should group the entries by protocol.
+ *
+ * Entries whose @errors slot is already nonzero are skipped. The result of the
+ * remaining ones is stored in their @errors slot.
+ */
+void bib_add_static_bulk(struct xlator *jool, struct bib_entry *news,
+		unsigned int count, int *errors)
+{
+	struct tabled_bib **bibs;
+	struct bib_table *table;
+	struct bib_entry old;
+	unsigned int i;
+
+	bibs = __wkvmalloc_array("BIB bulk nodes", count, sizeof(*bibs),
+			GFP_KERNEL);
+	if (!bibs) {
+		for (i = 0; i < count; i++)
+			if (!errors[i])
+				errors[i] = -ENOMEM;
+		return;
+	}
+
+	/* Allocate outside of the spinlocks. */
+	for (i = 0; i < count; i++) {
+		bibs[i] = NULL;
+		if (errors[i])
+			continue;
+		if (!get_table(jool->nat64.bib, news[i].l4_proto)) {
+			errors[i] = -EINVAL;
+			continue;
+		}
+		bibs[i] = alloc_bib(GFP_KERNEL);
+		if (!bibs[i]) {
+			errors[i] = -ENOMEM;
+			continue;
+		}
+		bib2tabled(&news[i], bibs[i]);
+	}
+
+	table = NULL;
+	for (i = 0; i < count; i++) {
+		if (errors[i])
+			continue;
+
+		if (table != get_table(jool->nat64.bib, news[i].l4_proto)) {
+			if (table)
+				spin_unlock_bh(&table->lock);
+			table = get_table(jool->nat64.bib, news[i].l4_proto);
+			spin_lock_bh(&table->lock);
+		}
+
+		errors[i] = add_static_locked(jool, table, &news[i], bibs[i],
+				&old);
+		log_add_static_error(&news[i], &old, errors[i]);
+	}
+	if (table)
+		spin_unlock_bh(&table->lock);
+
+	__wkvfree("BIB bulk nodes", bibs);
+}
+
 int bib_rm(struct xlator *jool, struct bib_entry *entry)
 {
 	struct bib_table *table;
@@ -2372,15 +4261,61 @@ int bib_rm(struct xlator *jool, struct bib_entry *entry)
 	return error;
 }
 
+/*
+ * Detaches @range's entries, starting from @offset, until either the range or
+ * the BIB_RM_BUDGET run out. Returns true if there's more to do, in which case
+ * @offset is updated to where the next batch should start.
+ *
+ * Assumes @table's lock is held.
+ */
+static bool rm_range_batch(struct xlator *jool, struct bib_table *table,
+		struct ipv4_range *range, struct ipv4_transport_addr *offset,
+		struct bib_delete_list *delete_list)
+{
+	struct rb_node *node;
+	struct rb_node *next;
+	struct tabled_bib *bib;
+	unsigned int budget = BIB_RM_BUDGET;
+
+	node = find_starting_point(table, offset, true);
+	for (; node; node = next) {
+		next = rb_next(node);
+		bib = bib4_entry(node);
+
+		if (!prefix4_contains(&range->prefix, &bib->src4.l3))
+			return false;
+		if (budget == 0) {
+			*offset = bib->src4;
+			return true;
+		}
+
+		if (port_range_contains(&range->ports, bib->src4.l4)) {
+			/* Each session is also a list_del() and a free. */
+			budget -= min(budget, 1 + bib->session_count);
+			detach_bib(jool, table, bib);
+			add_to_delete_list(delete_list, node);
+		} else {
+			budget--;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Removes the dynamic and static entries whose IPv4 address belongs to @range.
+ *
+ * The table lock is released (and the detached entries are freed) after every
+ * BIB_RM_BUDGET nodes, so removing a busy pool4 chunk does not stall the
+ * translation. Process context only.
+ */
 void bib_rm_range(struct xlator *jool, l4_protocol proto,
 		struct ipv4_range *range)
 {
 	struct bib_table *table;
 	struct ipv4_transport_addr offset;
-	struct rb_node *node;
-	struct rb_node *next;
-	struct tabled_bib *bib;
-	struct bib_delete_list delete_list = { NULL };
+	struct bib_delete_list delete_list;
+	bool more;
 
 	table = get_table(jool->nat64.bib, proto);
 	if (!table)
@@ -2389,43 +4324,91 @@ void bib_rm_range(struct xlator *jool, l4_protocol proto,
 	offset.l3 = range->prefix.addr;
 	offset.l4 = range->ports.min;
 
-	spin_lock_bh(&table->lock);
+	do {
+		delete_list.first = NULL;
 
-	node = find_starting_point(table, &offset, true);
-	for (; node; node = next) {
-		next = rb_next(node);
-		bib = bib4_entry(node);
+		spin_lock_bh(&table->lock);
+		more = rm_range_batch(jool, table, range, &offset,
+				&delete_list);
+		spin_unlock_bh(&table->lock);
 
-		if (!prefix4_contains(&range->prefix, &bib->src4.l3))
-			break;
-		if (port_range_contains(&range->ports, bib->src4.l4)) {
-			detach_bib(jool, table, bib);
-			add_to_delete_list(&delete_list, node);
-		}
-	}
+		commit_delete_list(&delete_list);
+		cond_resched();
+	} while (more);
+}
 
-	spin_unlock_bh(&table->lock);
+static unsigned int count_stored_pkts(struct tabled_bib *bib)
+{
+	struct tabled_session *session, *tmp;
+	unsigned int count = 0;
 
-	commit_delete_list(&delete_list);
+	rbtree_foreach(session, tmp, &bib->sessions, tree_hook)
+		if (session->stored)
+			count++;
+
+	return count;
 }
 
+/*
+ * Empties @table in constant time (as far as the lock is concerned): The trees
+ * are unhooked whole, and their nodes are freed afterwards, without spinlock or
+ * rebalancing. Process context only.
+ */
 static void flush_table(struct xlator *jool, struct bib_table *table)
 {
-	struct rb_node *node;
-	struct rb_node *next;
-	struct bib_delete_list delete_list = { NULL };
+	struct rb_root tree4;
+	struct tabled_bib *bib, *tmp;
+	unsigned int bibs;
+	unsigned int sessions;
+	unsigned int subscribers;
+	unsigned int stored;
+	unsigned int freed;
 
 	spin_lock_bh(&table->lock);
 
-	for (node = rb_first(&table->tree4); node; node = next) {
-		next = rb_next(node);
-		detach_bib(jool, table, bib4_entry(node));
-		add_to_delete_list(&delete_list, node);
-	}
+	tree4 = table->tree4;
+	table->tree4 = RB_ROOT;
+	table->tree6 = RB_ROOT;
+
+	bibs = table->bib_count;
+	sessions = table->est_timer.count + table->trans_timer.count
+			+ table->syn4_timer.count;
+	subscribers = table->subscribers.count;
+
+	INIT_LIST_HEAD(&table->est_timer.sessions);
+	table->est_timer.count = 0;
+	INIT_LIST_HEAD(&table->trans_timer.sessions);
+	table->trans_timer.count = 0;
+	INIT_LIST_HEAD(&table->syn4_timer.sessions);
+	table->syn4_timer.count = 0;
+	INIT_LIST_HEAD(&table->routed);
+	table->bib_count = 0;
+	memset(table->state_count, 0, sizeof(table->state_count));
+	free_subscribers(&table->subscribers);
 
 	spin_unlock_bh(&table->lock);
 
-	commit_delete_list(&delete_list);
+	jstat_add(jool->stats, JSTAT_BIB_ENTRIES, -(int)bibs);
+	jstat_add(jool->stats, JSTAT_SESSIONS, -(int)sessions);
+	jstat_add(jool->stats, JSTAT_SUBSCRIBERS, -(int)subscribers);
+
+	stored = 0;
+	freed = 0;
+	rbtree_foreach(bib, tmp, &tree4, hook4) {
+		stored += count_stored_pkts(bib);
+		freed += 1 + bib->session_count;
+		release_bib_entry(bib);
+		if (freed >= BIB_RM_BUDGET) {
+			cond_resched();
+			freed = 0;
+		}
+	}
+
+	if (stored) {
+		spin_lock_bh(&table->lock);
+		table->pkt_count -= stored;
+		spin_unlock_bh(&table->lock);
+	}
 }
 
 void bib_flush(struct xlator *jool)
@@ -63,6 +63,9 @@ struct bib *bib_alloc(void);
 void bib_get(struct bib *db);
 void bib_put(struct bib *db);
 
+int bib_index_subscribers(struct bib *db, struct xlator *jool);
+void bib_stop(struct xlator *jool);
+
 typedef enum session_fate (*fate_cb)(struct session_entry *, void *);
 
 struct collision_cb {
@@ -92,6 +95,10 @@ verdict bib_add_tcp4(struct xlation *xstate,
 		struct ipv6_transport_addr *dst6,
 		struct collision_cb *cb);
 
+/* This one is used by Translating the Packet. */
+
+void bib_cache_route(struct xlation *state, struct session_route const *route);
+
 /* These are used by other kernel submodules. */
 
 int bib_find(struct bib *db, struct tuple *tuple,
@@ -99,23 +106,78 @@ int bib_find(struct bib *db, struct tuple *tuple,
 int bib_add_session(struct xlator *jool, struct session_entry *new,
 		struct collision_cb *cb);
 void bib_clean(struct xlator *jool);
+unsigned long bib_count_evictable(struct xlator *jool);
+unsigned long bib_evict(struct xlator *jool, unsigned long max);
+int bib_digest(struct xlator *jool, struct session_digest *digest,
+		unsigned int max);
+int bib_digest_next(struct xlator *jool, struct session_digest *digest,
+		unsigned int max);
+void bib_digest_end_max(struct session_digest *digest);
+bool session_beyond(struct session_entry const *session,
+		struct taddr4_tuple const *end);
 
 /* These are used by userspace request handling. */
 
 typedef int (*bib_foreach_entry_cb)(struct bib_entry const *, void *);
 typedef int (*session_foreach_entry_cb)(struct session_entry const *, void *);
 
-struct session_foreach_offset {
-	struct taddr4_tuple offset;
-	bool include_offset;
-};
-
 int bib_foreach(struct bib *db, l4_protocol proto,
 		bib_foreach_entry_cb cb, void *cb_arg,
 		const struct ipv4_transport_addr *offset);
+int bib_foreach_filtered(struct bib *db, l4_protocol proto,
+		struct table_filter const *filter,
+		bib_foreach_entry_cb cb, void *cb_arg,
+		const struct bib_entry *offset);
+typedef int (*bib_foreach_subscriber_cb)(struct subscriber_entry const *,
+		void *);
+int bib_foreach_subscriber(struct xlator *jool, l4_protocol proto,
+		bib_foreach_subscriber_cb cb, void *cb_arg,
+		struct ipv6_prefix const *offset);
+int bib_top_subscribers(struct xlator *jool, l4_protocol proto,
+		struct subscriber_entry *result, unsigned int max,
+		unsigned int *count);
+int bib_session_stats(struct xlator *jool, l4_protocol proto,
+		struct session_stats *result);
 int bib_foreach_session(struct xlator *jool, l4_protocol proto,
 		session_foreach_entry_cb cb, void *cb_arg,
 		struct session_foreach_offset *offset);
+int bib_foreach_session_filtered(struct xlator *jool, l4_protocol proto,
+		struct table_filter const *filter,
+		session_foreach_entry_cb cb, void *cb_arg,
+		struct session_foreach_offset *offset);
+
+/*
+ * Maximum number of nodes a bib_dump_window() visits per lock acquisition.
+ * (Around a few microseconds' worth.)
+ */
+#define SESSION_DUMP_BUDGET 64
+/*
+ * Maximum number of nodes bib_rm_range() detaches per lock acquisition.
+ * The entries are freed after the lock is released.
+ */
+#define BIB_RM_BUDGET 256
+
+/* A session table dump that releases the lock between windows. */
+struct session_dump {
+	l4_protocol proto;
+	struct table_filter const *filter;
+	/* Where the next window starts. */
+	struct session_foreach_offset offset;
+	bool has_offset;
+	/* The table has been exhausted. */
+	bool done;
+
+	/* Measurements */
+	unsigned int windows;
+	s64 max_hold_ns;
+};
+
+void bib_dump_init(struct session_dump *dump, l4_protocol proto,
+		struct table_filter const *filter,
+		struct session_foreach_offset const *offset);
+int bib_dump_window(struct xlator *jool, struct session_dump *dump,
+		session_foreach_entry_cb cb, void *cb_arg);
+
 int bib_find6(struct bib *db, l4_protocol proto,
 		struct ipv6_transport_addr *addr,
 		struct bib_entry *result);
@@ -123,6 +185,12 @@ int bib_find4(struct bib *db, l4_protocol proto,
 		struct ipv4_transport_addr *addr,
 		struct bib_entry *result);
 int bib_add_static(struct xlator *jool, struct bib_entry *new);
+void bib_add_session_bulk(struct xlator *jool, struct session_entry *sessions,
+		unsigned int count, int *errors);
+void bib_touch_session_bulk(struct xlator *jool, struct session_entry *sessions,
+		unsigned int count, int *errors);
+void bib_add_static_bulk(struct xlator *jool, struct bib_entry *news,
+		unsigned int count, int *errors);
 int bib_rm(struct xlator *jool, struct bib_entry *entry);
 void bib_rm_range(struct xlator *jool, l4_protocol proto,
 		struct ipv4_range *range);
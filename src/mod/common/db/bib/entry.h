@@ -55,6 +55,11 @@ struct session_entry {
 	/** An indicator of the timer that is going to expire this session. */
 	session_timer_type timer_type;
 
+	/**
+	 * Jiffy (from the epoch) this session was created in. Synchronized and
+	 * imported sessions keep the age they had at their origin.
+	 */
+	unsigned long creation_time;
 	/** Jiffy (from the epoch) this session was last updated/used. */
 	unsigned long update_time;
 	/*
@@ -66,6 +71,20 @@ struct session_entry {
 	bool has_stored;
 };
 
+/**
+ * A route one of a session's packets needed, along with the packet fields it
+ * was computed out of. (The rest of the routing arguments are defined by the
+ * session itself.)
+ */
+struct session_route {
+	/** NULL if unset. Holds a reference. */
+	struct dst_entry *dst;
+	/** Validates @dst; see dst_check(). */
+	__u32 cookie;
+	__u32 mark;
+	__u8 tos;
+};
+
 struct bib_session {
 	/** Are @session.src6, @session.src4, @session.proto set? */
 	bool bib_set;
@@ -75,6 +94,32 @@ struct bib_session {
 	 */
 	bool session_set;
 	struct session_entry session;
+	/**
+	 * The route the session remembers for the packet's outgoing direction,
+	 * if any. Only set if the session-route-cache global is enabled.
+	 */
+	struct session_route route;
+};
+
+struct session_foreach_offset {
+	struct taddr4_tuple offset;
+	bool include_offset;
+};
+
+/**
+ * Summary of the sessions (of the @proto table) whose IPv4 tuples lie between
+ * @start and @end, in tree4 order. joold exchanges these to find out which
+ * parts of the table differ between peers, without transmitting the sessions.
+ */
+struct session_digest {
+	l4_protocol proto;
+	struct session_foreach_offset start;
+	/* Inclusive. */
+	struct taddr4_tuple end;
+	/* Number of sessions in the range. */
+	__u32 count;
+	/* Order-independent hash of the sessions in the range. */
+	__u32 hash;
 };
 
 bool session_equals(const struct session_entry *s1,
@@ -0,0 +1,200 @@
+#include "mod/common/db/bib/event_log.h"
+
+#include <linux/percpu.h>
+#include <net/genetlink.h>
+
+#include "common/xlat.h"
+#include "mod/common/log.h"
+#include "mod/common/stats.h"
+#include "mod/common/wkmalloc.h"
+#include "mod/common/nl/nl_handler.h"
+
+/* Number of events each CPU accumulates before multicasting them. */
+#define EVENTS_PER_MSG 32
+/* Index of JOOLNL_EVENTS_GRP_NAME in the family's multicast groups. */
+#define EVENTS_GROUP 1
+
+struct event_buffer {
+	spinlock_t lock;
+	struct jool_event events[EVENTS_PER_MSG];
+	/* Number of queued events. */
+	unsigned int count;
+	/* Events lost since the last message that was handed to Netlink. */
+	unsigned int dropped;
+};
+
+struct event_log {
+	struct event_buffer __percpu *buffers;
+};
+
+struct event_log *evlog_alloc(void)
+{
+	struct event_log *log;
+	struct event_buffer *buffer;
+	int cpu;
+
+	log = wkmalloc(struct event_log, GFP_KERNEL);
+	if (!log)
+		return NULL;
+
+	log->buffers = alloc_percpu(struct event_buffer);
+	if (!log->buffers) {
+		wkfree(struct event_log, log);
+		return NULL;
+	}
+
+	for_each_possible_cpu(cpu) {
+		buffer = per_cpu_ptr(log->buffers, cpu);
+		spin_lock_init(&buffer->lock);
+		buffer->count = 0;
+		buffer->dropped = 0;
+	}
+
+	return log;
+}
+
+void evlog_release(struct event_log *log)
+{
+	free_percpu(log->buffers);
+	wkfree(struct event_log, log);
+}
+
+static struct sk_buff *build_msg(struct xlator *jool,
+		struct event_buffer *buffer)
+{
+	struct sk_buff *skb;
+	struct joolnlhdr *jhdr;
+
+	skb = genlmsg_new(sizeof(struct joolnlhdr)
+			+ nla_total_size(sizeof(buffer->events))
+			+ nla_total_size(sizeof(__u32)), GFP_ATOMIC);
+	if (!skb)
+		return NULL;
+
+	jhdr = genlmsg_put(skb, 0, 0, jnl_family(), sizeof(*jhdr), 0);
+	if (!jhdr)
+		goto fail;
+
+	memset(jhdr, 0, sizeof(*jhdr));
+	memcpy(jhdr->magic, JOOLNL_HDR_MAGIC, JOOLNL_HDR_MAGIC_LEN);
+	jhdr->version = cpu_to_be32(xlat_version());
+	jhdr->xt = XT_NAT64;
+	memcpy(jhdr->iname, jool->iname, INAME_MAX_SIZE);
+
+	if (nla_put(skb, JNLAR_EVENTS, buffer->count * sizeof(struct jool_event),
+			buffer->events))
+		goto fail;
+	if (buffer->dropped) {
+		if (nla_put_u32(skb, JNLAR_EVENTS_DROPPED, buffer->dropped))
+			goto fail;
+	}
+
+	genlmsg_end(skb, jhdr);
+	return skb;
+
+fail:
+	kfree_skb(skb);
+	return NULL;
+}
+
+/*
+ * Empties @buffer into a new message.
+ * Assumes @buffer's lock is held.
+ */
+static struct sk_buff *prepare_msg(struct xlator *jool,
+		struct event_buffer *buffer)
+{
+	struct sk_buff *skb;
+
+	skb = build_msg(jool, buffer);
+	if (skb) {
+		buffer->dropped = 0;
+	} else {
+		buffer->dropped += buffer->count;
+		jstat_add(jool->stats, JSTAT_EVENTS_DROPPED, buffer->count);
+	}
+	buffer->count = 0;
+
+	return skb;
+}
+
+/*
+ * If the message goes nowhere, its @events (and the @dropped it was reporting)
+ * go back to the dropped count of @buffer.
+ */
+static void send_msg(struct xlator *jool, struct event_buffer *buffer,
+		struct sk_buff *skb, unsigned int events, unsigned int dropped)
+{
+	int error;
+
+	if (!skb)
+		return;
+
+	error = genlmsg_multicast_netns(jnl_family(), jool->ns, skb, 0,
+			EVENTS_GROUP, GFP_ATOMIC);
+	if (!error)
+		return;
+
+	/* -ESRCH means there's no collector; not worth a warning. */
+	if (error != -ESRCH)
+		log_warn_once("Could not multicast BIB/session events (errcode %d).",
+				error);
+
+	spin_lock_bh(&buffer->lock);
+	buffer->dropped += events + dropped;
+	spin_unlock_bh(&buffer->lock);
+	jstat_add(jool->stats, JSTAT_EVENTS_DROPPED, events);
+}
+
+void evlog_add(struct xlator *jool, struct event_log *log,
+		struct jool_event const *event)
+{
+	struct event_buffer *buffer;
+	struct sk_buff *skb = NULL;
+	unsigned int events = 0;
+	unsigned int dropped = 0;
+
+	buffer = get_cpu_ptr(log->buffers);
+
+	spin_lock_bh(&buffer->lock);
+	buffer->events[buffer->count] = *event;
+	buffer->count++;
+	if (buffer->count >= EVENTS_PER_MSG) {
+		events = buffer->count;
+		dropped = buffer->dropped;
+		skb = prepare_msg(jool, buffer);
+	}
+	spin_unlock_bh(&buffer->lock);
+
+	put_cpu_ptr(log->buffers);
+	send_msg(jool, buffer, skb, events, dropped);
+}
+
+/*
+ * Multicasts whatever the CPUs have accumulated so far, so quiet translators
+ * don't sit on their events forever. Called periodically.
+ */
+void evlog_flush(struct xlator *jool, struct event_log *log)
+{
+	struct event_buffer *buffer;
+	struct sk_buff *skb;
+	unsigned int events;
+	unsigned int dropped;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		buffer = per_cpu_ptr(log->buffers, cpu);
+		skb = NULL;
+		events = dropped = 0;
+
+		spin_lock_bh(&buffer->lock);
+		if (buffer->count) {
+			events = buffer->count;
+			dropped = buffer->dropped;
+			skb = prepare_msg(jool, buffer);
+		}
+		spin_unlock_bh(&buffer->lock);
+
+		send_msg(jool, buffer, skb, events, dropped);
+	}
+}
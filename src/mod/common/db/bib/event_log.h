@@ -0,0 +1,30 @@
+#ifndef SRC_MOD_NAT64_BIB_EVENT_LOG_H_
+#define SRC_MOD_NAT64_BIB_EVENT_LOG_H_
+
+/**
+ * @file
+ * Binary BIB/session logging. (logging-binary.)
+ *
+ * printk cannot keep up with busy translators, so when logging-binary is
+ * enabled, the events are instead accumulated as fixed-size records (struct
+ * jool_event) in per-CPU buffers, and multicast to userspace in batches. The
+ * collector is `jool session log`.
+ *
+ * Each CPU only ever touches its own buffer, except for the periodic flush.
+ * Events that cannot be delivered are counted (JSTAT_EVENTS_DROPPED), and the
+ * count travels along the CPU's next message.
+ */
+
+#include "common/config.h"
+#include "mod/common/xlator.h"
+
+struct event_log;
+
+struct event_log *evlog_alloc(void);
+void evlog_release(struct event_log *log);
+
+void evlog_add(struct xlator *jool, struct event_log *log,
+		struct jool_event const *event);
+void evlog_flush(struct xlator *jool, struct event_log *log);
+
+#endif /* SRC_MOD_NAT64_BIB_EVENT_LOG_H_ */
@@ -89,37 +89,70 @@ void denylist4_put(struct addr4_pool *pool)
 	kref_put(&pool->refcounter, pool_release);
 }
 
-int denylist4_add(struct addr4_pool *pool, struct ipv4_prefix *prefix,
-		bool force)
+static int validate_addend(struct ipv4_prefix *prefix, bool force)
 {
-	struct list_head *list;
-	struct pool_entry *entry;
 	int error;
 
 	error = prefix4_validate(prefix);
 	if (error)
 		return error;
-	error = prefix4_validate_scope(prefix, force);
-	if (error)
-		return error;
+	return prefix4_validate_scope(prefix, force);
+}
 
-	mutex_lock(&lock);
+/* Assumes the lock is held. */
+static int __add(struct addr4_pool *pool, struct ipv4_prefix *prefix)
+{
+	struct list_head *list;
+	struct pool_entry *entry;
 
 	entry = wkmalloc(struct pool_entry, GFP_KERNEL);
-	if (!entry) {
-		error = -ENOMEM;
-		goto end;
-	}
+	if (!entry)
+		return -ENOMEM;
 	entry->prefix = *prefix;
 
 	list = rcu_dereference_protected(pool->list, lockdep_is_held(&lock));
 	list_add_tail_rcu(&entry->list_hook, list);
+	return 0;
+}
 
-end:
+int denylist4_add(struct addr4_pool *pool, struct ipv4_prefix *prefix,
+		bool force)
+{
+	int error;
+
+	error = validate_addend(prefix, force);
+	if (error)
+		return error;
+
+	mutex_lock(&lock);
+	error = __add(pool, prefix);
 	mutex_unlock(&lock);
+
 	return error;
 }
 
+/**
+ * Adds the @count prefixes from @prefixes, taking the lock only once.
+ *
+ * Entries whose @errors slot is already nonzero are skipped. The result of the
+ * remaining ones is stored in their @errors slot.
+ */
+void denylist4_add_bulk(struct addr4_pool *pool, struct ipv4_prefix *prefixes,
+		unsigned int count, bool force, int *errors)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		if (!errors[i])
+			errors[i] = validate_addend(&prefixes[i], force);
+
+	mutex_lock(&lock);
+	for (i = 0; i < count; i++)
+		if (!errors[i])
+			errors[i] = __add(pool, &prefixes[i]);
+	mutex_unlock(&lock);
+}
+
 int denylist4_rm(struct addr4_pool *pool, struct ipv4_prefix *prefix)
 {
 	struct list_head *list;
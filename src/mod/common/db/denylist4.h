@@ -15,6 +15,8 @@ void denylist4_put(struct addr4_pool *pool);
 
 int denylist4_add(struct addr4_pool *pool, struct ipv4_prefix *prefix,
 		bool force);
+void denylist4_add_bulk(struct addr4_pool *pool, struct ipv4_prefix *prefixes,
+		unsigned int count, bool force, int *errors);
 int denylist4_rm(struct addr4_pool *pool, struct ipv4_prefix *prefix);
 int denylist4_flush(struct addr4_pool *pool);
 
@@ -208,36 +208,67 @@ static int eamt_add4(struct eam_table *eamt, struct eamt_entry *eam,
 	return error;
 }
 
-int eamt_add(struct eam_table *eamt, struct eamt_entry *new, bool force,
+/* Assumes the lock is held. */
+static int __add(struct eam_table *eamt, struct eamt_entry *new, bool force,
 		bool synchronize)
 {
 	int error;
 
-	error = validate_prefixes(new);
-	if (error)
-		return error;
-
-	mutex_lock(&lock);
-
 	error = validate_overlapping(eamt, new, force);
 	if (error)
-		goto end;
+		return error;
 
 	error = eamt_add6(eamt, new, synchronize);
 	if (error)
-		goto end;
+		return error;
 	error = eamt_add4(eamt, new, synchronize);
 	if (error) {
 		__revert_add6(eamt, &new->prefix6, synchronize);
-		goto end;
+		return error;
 	}
 
 	eamt->count++;
-end:
+	return 0;
+}
+
+int eamt_add(struct eam_table *eamt, struct eamt_entry *new, bool force,
+		bool synchronize)
+{
+	int error;
+
+	error = validate_prefixes(new);
+	if (error)
+		return error;
+
+	mutex_lock(&lock);
+	error = __add(eamt, new, force, synchronize);
 	mutex_unlock(&lock);
+
 	return error;
 }
 
+/**
+ * Adds the @count entries from @news, taking the lock only once.
+ *
+ * Entries whose @errors slot is already nonzero are skipped. The result of the
+ * remaining ones is stored in their @errors slot.
+ */
+void eamt_add_bulk(struct eam_table *eamt, struct eamt_entry *news,
+		unsigned int count, bool force, int *errors)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		if (!errors[i])
+			errors[i] = validate_prefixes(&news[i]);
+
+	mutex_lock(&lock);
+	for (i = 0; i < count; i++)
+		if (!errors[i])
+			errors[i] = __add(eamt, &news[i], force, true);
+	mutex_unlock(&lock);
+}
+
 static int get_exact6(struct eam_table *eamt, struct ipv6_prefix *prefix,
 		struct eamt_entry *eam)
 {
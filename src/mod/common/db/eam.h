@@ -30,6 +30,8 @@ bool eamt_is_empty(struct eam_table *eamt);
 /* See rtrie.h for info on the "synchronize" flag */
 int eamt_add(struct eam_table *jool, struct eamt_entry *new, bool force,
 		bool synchronize);
+void eamt_add_bulk(struct eam_table *eamt, struct eamt_entry *news,
+		unsigned int count, bool force, int *errors);
 int eamt_rm(struct eam_table *eamt, struct ipv6_prefix *prefix6,
 		struct ipv4_prefix *prefix4);
 void eamt_flush(struct eam_table *eamt);
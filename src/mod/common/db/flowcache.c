@@ -0,0 +1,348 @@
+#include "mod/common/db/flowcache.h"
+
+#include <linux/jhash.h>
+#include <linux/kref.h>
+#include <linux/random.h>
+#include <net/dst.h>
+#include "mod/common/address.h"
+#include "mod/common/db/lru.h"
+#include "mod/common/log.h"
+#include "mod/common/packet.h"
+#include "mod/common/stats.h"
+#include "mod/common/wkmalloc.h"
+
+#define FLOWCACHE_BITS 10
+#define FLOWCACHE_BUCKETS (1 << FLOWCACHE_BITS)
+/* In jiffies. */
+#define FLOWCACHE_TTL HZ
+
+struct flow {
+	/** The incoming tuple. */
+	struct tuple key;
+	/** The outgoing tuple. */
+	struct tuple out;
+	/** The session, as Filtering and Updating left it. */
+	struct session_entry session;
+	/** The outgoing packet's route. @route.dst might be NULL. */
+	struct session_route route;
+
+	struct lru_node lru_hook;
+};
+
+struct flowcache {
+	struct hlist_head table[FLOWCACHE_BUCKETS];
+	struct lru flows;
+	u32 seed;
+
+	spinlock_t lock;
+	struct kref refcount;
+};
+
+static void free_flow(struct lru_node *node)
+{
+	struct flow *flow = container_of(node, struct flow, lru_hook);
+
+	if (flow->route.dst)
+		dst_release(flow->route.dst);
+	wkfree(struct flow, flow);
+}
+
+struct flowcache *flowcache_alloc(void)
+{
+	struct flowcache *result;
+	unsigned int i;
+
+	result = wkmalloc(struct flowcache, GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	for (i = 0; i < FLOWCACHE_BUCKETS; i++)
+		INIT_HLIST_HEAD(&result->table[i]);
+	lru_init(&result->flows, free_flow);
+	get_random_bytes(&result->seed, sizeof(result->seed));
+	spin_lock_init(&result->lock);
+	kref_init(&result->refcount);
+
+	return result;
+}
+
+void flowcache_get(struct flowcache *cache)
+{
+	kref_get(&cache->refcount);
+}
+
+static void flowcache_release(struct kref *refcount)
+{
+	struct flowcache *cache;
+
+	cache = container_of(refcount, struct flowcache, refcount);
+	lru_flush(&cache->flows);
+	wkfree(struct flowcache, cache);
+}
+
+void flowcache_put(struct flowcache *cache)
+{
+	kref_put(&cache->refcount, flowcache_release);
+}
+
+/**
+ * Initializes @key as @pkt's incoming tuple. Returns false if @pkt cannot
+ * skip the first three steps, even if its flow is cached.
+ *
+ * Fragments, TCP packets that might change the session's state and ICMP are
+ * always left to the slow path.
+ */
+static bool init_key(struct packet const *pkt, struct tuple *key)
+{
+	struct iphdr *hdr4;
+	struct ipv6hdr *hdr6;
+	struct tcphdr *tcp;
+	__be16 sport;
+	__be16 dport;
+
+	switch (pkt_l4_proto(pkt)) {
+	case L4PROTO_TCP:
+		tcp = pkt_tcp_hdr(pkt);
+		if (tcp->syn || tcp->fin || tcp->rst)
+			return false;
+		sport = tcp->source;
+		dport = tcp->dest;
+		break;
+	case L4PROTO_UDP:
+		sport = pkt_udp_hdr(pkt)->source;
+		dport = pkt_udp_hdr(pkt)->dest;
+		break;
+	default:
+		return false;
+	}
+
+	switch (pkt_l3_proto(pkt)) {
+	case L3PROTO_IPV4:
+		hdr4 = pkt_ip4_hdr(pkt);
+		if (is_fragmented_ipv4(hdr4))
+			return false;
+		key->src.addr4.l3.s_addr = hdr4->saddr;
+		key->src.addr4.l4 = be16_to_cpu(sport);
+		key->dst.addr4.l3.s_addr = hdr4->daddr;
+		key->dst.addr4.l4 = be16_to_cpu(dport);
+		break;
+	case L3PROTO_IPV6:
+		if (is_fragmented_ipv6(pkt_frag_hdr(pkt)))
+			return false;
+		hdr6 = pkt_ip6_hdr(pkt);
+		key->src.addr6.l3 = hdr6->saddr;
+		key->src.addr6.l4 = be16_to_cpu(sport);
+		key->dst.addr6.l3 = hdr6->daddr;
+		key->dst.addr6.l4 = be16_to_cpu(dport);
+		break;
+	}
+
+	key->l3_proto = pkt_l3_proto(pkt);
+	key->l4_proto = pkt_l4_proto(pkt);
+	return true;
+}
+
+static struct hlist_head *get_bucket(struct flowcache *cache,
+		struct tuple const *key)
+{
+	u32 ports;
+	u32 hash;
+
+	switch (key->l3_proto) {
+	case L3PROTO_IPV4:
+		ports = (key->src.addr4.l4 << 16) | key->dst.addr4.l4;
+		hash = jhash_3words(key->src.addr4.l3.s_addr,
+				key->dst.addr4.l3.s_addr, ports,
+				cache->seed ^ key->l4_proto);
+		break;
+	case L3PROTO_IPV6:
+		ports = (key->src.addr6.l4 << 16) | key->dst.addr6.l4;
+		hash = jhash2(key->src.addr6.l3.s6_addr32, 4,
+				cache->seed ^ key->l4_proto);
+		hash = jhash2(key->dst.addr6.l3.s6_addr32, 4, hash ^ ports);
+		break;
+	default:
+		hash = 0;
+	}
+
+	return &cache->table[hash & (FLOWCACHE_BUCKETS - 1)];
+}
+
+static bool key_equals(struct tuple const *a, struct tuple const *b)
+{
+	if (a->l3_proto != b->l3_proto || a->l4_proto != b->l4_proto)
+		return false;
+
+	switch (a->l3_proto) {
+	case L3PROTO_IPV4:
+		return taddr4_equals(&a->src.addr4, &b->src.addr4)
+				&& taddr4_equals(&a->dst.addr4, &b->dst.addr4);
+	case L3PROTO_IPV6:
+		return taddr6_equals(&a->src.addr6, &b->src.addr6)
+				&& taddr6_equals(&a->dst.addr6, &b->dst.addr6);
+	}
+
+	return false;
+}
+
+static struct flow *find_flow(struct hlist_head *bucket,
+		struct tuple const *key)
+{
+	struct flow *flow;
+
+	hlist_for_each_entry(flow, bucket, lru_hook.hash_hook)
+		if (key_equals(&flow->key, key))
+			return flow;
+
+	return NULL;
+}
+
+/*
+ * Hands @state a reference to @flow's route, unless the routing tables changed
+ * since it was computed.
+ */
+static void get_route(struct xlation *state, struct flow *flow)
+{
+	struct session_route *route = &flow->route;
+
+	if (!route->dst)
+		return;
+
+	if (!dst_check(route->dst, route->cookie)) {
+		dst_release(route->dst);
+		route->dst = NULL;
+		return;
+	}
+
+	if (state->entries.route.dst)
+		dst_release(state->entries.route.dst);
+	state->entries.route = *route;
+	dst_hold(route->dst);
+}
+
+/**
+ * flowcache_find - If @state->in belongs to a cached flow, fills in its
+ * incoming tuple, session, outgoing tuple and route, and returns true.
+ * Filtering and Updating can then be skipped.
+ */
+bool flowcache_find(struct xlation *state)
+{
+	struct flowcache *cache = state->jool.nat64.flows;
+	struct tuple key;
+	struct flow *flow;
+
+	if (!state->jool.globals.nat64.flow_cache)
+		return false;
+
+	memset(&key, 0, sizeof(key));
+	if (!init_key(&state->in, &key))
+		return false;
+
+	spin_lock_bh(&cache->lock);
+
+	lru_expire(&cache->flows);
+
+	flow = find_flow(get_bucket(cache, &key), &key);
+	if (!flow) {
+		spin_unlock_bh(&cache->lock);
+		jstat_inc(state->jool.stats, JSTAT_FLOW_CACHE_MISS);
+		return false;
+	}
+
+	state->in.tuple = flow->key;
+	state->out.tuple = flow->out;
+	state->entries.bib_set = true;
+	state->entries.session_set = true;
+	state->entries.session = flow->session;
+	get_route(state, flow);
+
+	spin_unlock_bh(&cache->lock);
+
+	jstat_inc(state->jool.stats, JSTAT_FLOW_CACHE_HIT);
+	log_debug(state, "Flow cache hit; skipping steps 1 through 3.");
+	return true;
+}
+
+static bool is_cacheable(struct xlation *state)
+{
+	if (!state->entries.session_set)
+		return false;
+
+	switch (state->in.tuple.l4_proto) {
+	case L4PROTO_TCP:
+		/* Other states need the TCP state machine. */
+		return state->entries.session.state == ESTABLISHED;
+	case L4PROTO_UDP:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * flowcache_add - Remembers @state's flow, so its next packets can skip the
+ * first three steps.
+ *
+ * Assumes @state->in was successfully translated through the slow path.
+ * Steals @state->flow_route's reference, if any.
+ */
+void flowcache_add(struct xlation *state)
+{
+	struct flowcache *cache = state->jool.nat64.flows;
+	struct flow *flow;
+	struct flow *old;
+	struct hlist_head *bucket;
+	__u32 capacity;
+
+	if (!state->jool.globals.nat64.flow_cache || !is_cacheable(state))
+		return;
+	capacity = state->jool.globals.nat64.flow_cache_capacity;
+	if (capacity == 0)
+		return;
+
+	flow = wkmalloc(struct flow, GFP_ATOMIC);
+	if (!flow)
+		return; /* The flow will simply keep using the slow path. */
+	flow->key = state->in.tuple;
+	flow->out = state->out.tuple;
+	flow->session = state->entries.session;
+	flow->route = state->flow_route;
+	state->flow_route.dst = NULL;
+
+	spin_lock_bh(&cache->lock);
+
+	lru_expire(&cache->flows);
+
+	bucket = get_bucket(cache, &flow->key);
+	old = find_flow(bucket, &flow->key);
+	if (old) /* Possibly a different session by now */
+		lru_rm(&cache->flows, &old->lru_hook);
+
+	jstat_add(state->jool.stats, JSTAT_FLOW_CACHE_EVICTED,
+			lru_make_room(&cache->flows, capacity));
+	lru_add(&cache->flows, bucket, &flow->lru_hook, FLOWCACHE_TTL);
+
+	spin_unlock_bh(&cache->lock);
+}
+
+/**
+ * flowcache_clean - Forgets the expired flows, even if no packets are arriving.
+ * (So their routes don't keep their devices pinned.)
+ */
+void flowcache_clean(struct flowcache *cache)
+{
+	spin_lock_bh(&cache->lock);
+	lru_expire(&cache->flows);
+	spin_unlock_bh(&cache->lock);
+}
+
+/**
+ * flowcache_flush - Forgets every flow. Needed whenever sessions or the
+ * configuration change in ways the cached flows would not notice.
+ */
+void flowcache_flush(struct flowcache *cache)
+{
+	spin_lock_bh(&cache->lock);
+	lru_flush(&cache->flows);
+	spin_unlock_bh(&cache->lock);
+}
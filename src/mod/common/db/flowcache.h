@@ -0,0 +1,31 @@
+#ifndef SRC_MOD_COMMON_DB_FLOWCACHE_H_
+#define SRC_MOD_COMMON_DB_FLOWCACHE_H_
+
+/**
+ * @file
+ * NAT64's flow cache. (See the flow-cache global.)
+ *
+ * Remembers the outcome of the first three steps (incoming tuple, session and
+ * outgoing tuple) and the route of recently translated TCP and UDP packets,
+ * indexed by their incoming tuple. Later packets of the same flow copy them
+ * instead of computing them again, which spares them the BIB's locks.
+ *
+ * Flows are forgotten one second after they are cached, so every active flow
+ * still goes through Filtering and Updating (and therefore refreshes its
+ * session) about once per second.
+ */
+
+#include "mod/common/translation_state.h"
+
+struct flowcache;
+
+struct flowcache *flowcache_alloc(void);
+void flowcache_get(struct flowcache *cache);
+void flowcache_put(struct flowcache *cache);
+
+bool flowcache_find(struct xlation *state);
+void flowcache_add(struct xlation *state);
+void flowcache_clean(struct flowcache *cache);
+void flowcache_flush(struct flowcache *cache);
+
+#endif /* SRC_MOD_COMMON_DB_FLOWCACHE_H_ */
@@ -0,0 +1,352 @@
+#include "mod/common/db/fragdb.h"
+
+#include <linux/jhash.h>
+#include <linux/kref.h>
+#include <linux/random.h>
+#include "mod/common/db/lru.h"
+#include "mod/common/log.h"
+#include "mod/common/packet.h"
+#include "mod/common/stats.h"
+#include "mod/common/wkmalloc.h"
+
+#define FRAGDB_BITS 8
+#define FRAGDB_BUCKETS (1 << FRAGDB_BITS)
+
+/*
+ * Identifies a fragmented packet. (RFC 791 section 3.2 and RFC 8200 section
+ * 4.5.)
+ *
+ * Zeroed before it's filled, so it can be hashed and compared as raw memory.
+ */
+struct frag_key {
+	union {
+		struct {
+			__be32 src;
+			__be32 dst;
+		} v4;
+		struct {
+			struct in6_addr src;
+			struct in6_addr dst;
+		} v6;
+	} addrs;
+	__u32 id;
+	__u8 l3_proto;
+	__u8 l4_proto;
+};
+
+struct frag_flow {
+	struct frag_key key;
+	/** The first fragment's tuple. */
+	struct tuple tuple;
+	/**
+	 * Some of the packet's fragments were handed to the kernel's
+	 * defragmenter, so the rest of them have to follow.
+	 */
+	bool kernel;
+
+	struct lru_node lru_hook;
+};
+
+struct fragdb {
+	struct hlist_head table[FRAGDB_BUCKETS];
+	struct lru flows;
+	u32 seed;
+
+	spinlock_t lock;
+	struct kref refcount;
+};
+
+static void free_flow(struct lru_node *node)
+{
+	wkfree(struct frag_flow, container_of(node, struct frag_flow,
+			lru_hook));
+}
+
+struct fragdb *fragdb_alloc(void)
+{
+	struct fragdb *result;
+	unsigned int i;
+
+	result = wkmalloc(struct fragdb, GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	for (i = 0; i < FRAGDB_BUCKETS; i++)
+		INIT_HLIST_HEAD(&result->table[i]);
+	lru_init(&result->flows, free_flow);
+	get_random_bytes(&result->seed, sizeof(result->seed));
+	spin_lock_init(&result->lock);
+	kref_init(&result->refcount);
+
+	return result;
+}
+
+void fragdb_get(struct fragdb *db)
+{
+	kref_get(&db->refcount);
+}
+
+static void fragdb_release(struct kref *refcount)
+{
+	struct fragdb *db;
+
+	db = container_of(refcount, struct fragdb, refcount);
+	lru_flush(&db->flows);
+	wkfree(struct fragdb, db);
+}
+
+void fragdb_put(struct fragdb *db)
+{
+	kref_put(&db->refcount, fragdb_release);
+}
+
+static void init_key(struct packet const *pkt, struct frag_key *key)
+{
+	struct iphdr *hdr4;
+	struct ipv6hdr *hdr6;
+
+	memset(key, 0, sizeof(*key));
+
+	switch (pkt_l3_proto(pkt)) {
+	case L3PROTO_IPV4:
+		hdr4 = pkt_ip4_hdr(pkt);
+		key->addrs.v4.src = hdr4->saddr;
+		key->addrs.v4.dst = hdr4->daddr;
+		key->id = be16_to_cpu(hdr4->id);
+		break;
+	case L3PROTO_IPV6:
+		hdr6 = pkt_ip6_hdr(pkt);
+		key->addrs.v6.src = hdr6->saddr;
+		key->addrs.v6.dst = hdr6->daddr;
+		key->id = be32_to_cpu(pkt_frag_hdr(pkt)->identification);
+		break;
+	}
+
+	key->l3_proto = pkt_l3_proto(pkt);
+	key->l4_proto = pkt_l4_proto(pkt);
+}
+
+/** Returns true if @pkt is the first fragment of a fragmented packet. */
+static bool is_head_frag(struct packet const *pkt)
+{
+	struct iphdr *hdr4;
+	struct frag_hdr *hdr_frag;
+
+	switch (pkt_l3_proto(pkt)) {
+	case L3PROTO_IPV4:
+		hdr4 = pkt_ip4_hdr(pkt);
+		return is_first_frag4(hdr4) && is_mf_set_ipv4(hdr4);
+	case L3PROTO_IPV6:
+		hdr_frag = pkt_frag_hdr(pkt);
+		return hdr_frag && is_first_frag6(hdr_frag)
+				&& is_mf_set_ipv6(hdr_frag);
+	}
+
+	return false;
+}
+
+/** Returns true if @pkt is the last fragment of a fragmented packet. */
+static bool is_tail_frag(struct packet const *pkt)
+{
+	switch (pkt_l3_proto(pkt)) {
+	case L3PROTO_IPV4:
+		return !is_mf_set_ipv4(pkt_ip4_hdr(pkt));
+	case L3PROTO_IPV6:
+		return !is_mf_set_ipv6(pkt_frag_hdr(pkt));
+	}
+
+	return false;
+}
+
+static struct hlist_head *get_bucket(struct fragdb *db,
+		struct frag_key const *key)
+{
+	u32 hash;
+
+	hash = jhash(key, sizeof(*key), db->seed);
+	return &db->table[hash & (FRAGDB_BUCKETS - 1)];
+}
+
+static struct frag_flow *find_flow(struct hlist_head *bucket,
+		struct frag_key const *key)
+{
+	struct frag_flow *flow;
+
+	hlist_for_each_entry(flow, bucket, lru_hook.hash_hook)
+		if (memcmp(&flow->key, key, sizeof(*key)) == 0)
+			return flow;
+
+	return NULL;
+}
+
+static unsigned long get_timeout(struct xlation *state)
+{
+	return msecs_to_jiffies(
+			state->jool.globals.nat64.frag_tracking_timeout);
+}
+
+static void refresh_flow(struct xlation *state, struct fragdb *db,
+		struct frag_flow *flow)
+{
+	lru_refresh(&db->flows, &flow->lru_hook, get_timeout(state));
+}
+
+/*
+ * Jool can't compute the checksum of a fragmented UDP packet, so zero
+ * checksums have to wait for reassembly. (RFC 7915 section 4.5.)
+ */
+static bool is_csum0_udp4(struct packet const *pkt)
+{
+	return pkt_l3_proto(pkt) == L3PROTO_IPV4
+			&& pkt_l4_proto(pkt) == L4PROTO_UDP
+			&& pkt_udp_hdr(pkt)->check == 0;
+}
+
+/*
+ * Creates @key's flow. Returns NULL if the tracker is disabled, or out of
+ * memory.
+ */
+static struct frag_flow *add_flow(struct xlation *state, struct fragdb *db,
+		struct hlist_head *bucket, struct frag_key const *key)
+{
+	struct frag_flow *flow;
+	__u32 capacity;
+
+	capacity = state->jool.globals.nat64.frag_tracking_capacity;
+	if (capacity == 0)
+		return NULL;
+
+	flow = wkmalloc(struct frag_flow, GFP_ATOMIC);
+	if (!flow)
+		return NULL;
+	flow->key = *key;
+	flow->kernel = false;
+
+	jstat_add(state->jool.stats, JSTAT_FRAG_EVICTED,
+			lru_make_room(&db->flows, capacity));
+	lru_add(&db->flows, bucket, &flow->lru_hook, get_timeout(state));
+	return flow;
+}
+
+/**
+ * fragdb_add - If @state->in is the first fragment of a fragmented packet,
+ * remember its tuple for the rest of the fragments.
+ *
+ * Assumes @state->in.tuple has already been computed.
+ *
+ * First fragments the tracker can't handle are left to the kernel's
+ * defragmenter (ie. VERDICT_UNTRANSLATABLE), and so are their siblings.
+ */
+verdict fragdb_add(struct xlation *state)
+{
+	struct fragdb *db = state->jool.nat64.frags;
+	struct frag_key key;
+	struct frag_flow *flow;
+	struct hlist_head *bucket;
+	enum jool_stat_id stat;
+	bool kernel;
+
+	if (!is_head_frag(&state->in))
+		return VERDICT_CONTINUE;
+
+	init_key(&state->in, &key);
+	kernel = is_csum0_udp4(&state->in);
+	stat = kernel ? JSTAT46_FRAGMENTED_ZERO_CSUM : JSTAT_FRAG_UNTRACKED;
+
+	spin_lock_bh(&db->lock);
+
+	/*
+	 * Forget the packets whose fragments stopped arriving.
+	 * (Lost fragments, or fragments that were already reassembled
+	 * elsewhere.)
+	 */
+	lru_expire(&db->flows);
+
+	bucket = get_bucket(db, &key);
+	flow = find_flow(bucket, &key);
+	if (flow) {
+		/*
+		 * Retransmission, or the sender recycled the ID.
+		 * If the kernel already has some of the fragments, the first
+		 * one must join them.
+		 */
+		kernel |= flow->kernel;
+	} else {
+		flow = add_flow(state, db, bucket, &key);
+		if (!flow) {
+			spin_unlock_bh(&db->lock);
+			log_debug(state, "The fragment cannot be tracked.");
+			return untranslatable(state, stat);
+		}
+	}
+
+	flow->tuple = state->in.tuple;
+	flow->kernel = kernel;
+	refresh_flow(state, db, flow);
+
+	spin_unlock_bh(&db->lock);
+
+	if (kernel) {
+		log_debug(state, "The packet will have to be reassembled.");
+		return untranslatable(state, stat);
+	}
+
+	jstat_inc(state->jool.stats, JSTAT_FRAG_TRACKED);
+	return VERDICT_CONTINUE;
+}
+
+/**
+ * fragdb_find - Initializes subsequent fragment @state->in's tuple out of its
+ * first fragment's.
+ *
+ * The tracker does not store packets, so out-of-order fragments (ie. those
+ * that arrive before their first fragment) are left to the kernel's
+ * defragmenter. Their flow is remembered, so the first fragment follows them
+ * once it arrives.
+ */
+verdict fragdb_find(struct xlation *state)
+{
+	struct fragdb *db = state->jool.nat64.frags;
+	struct frag_key key;
+	struct frag_flow *flow;
+	struct hlist_head *bucket;
+
+	init_key(&state->in, &key);
+
+	spin_lock_bh(&db->lock);
+
+	lru_expire(&db->flows);
+
+	bucket = get_bucket(db, &key);
+	flow = find_flow(bucket, &key);
+	if (!flow) {
+		flow = add_flow(state, db, bucket, &key);
+		if (flow)
+			flow->kernel = true;
+		spin_unlock_bh(&db->lock);
+		log_debug(state, "The fragment's first fragment is unknown.");
+		return untranslatable(state, JSTAT_FRAG_UNTRACKED);
+	}
+
+	if (flow->kernel) {
+		/*
+		 * Don't forget the flow on the last fragment; the first one
+		 * might still be on its way.
+		 */
+		refresh_flow(state, db, flow);
+		spin_unlock_bh(&db->lock);
+		log_debug(state, "The packet is being reassembled by the kernel.");
+		return untranslatable(state, JSTAT_FRAG_UNTRACKED);
+	}
+
+	state->in.tuple = flow->tuple;
+	if (is_tail_frag(&state->in))
+		lru_rm(&db->flows, &flow->lru_hook);
+	else
+		refresh_flow(state, db, flow);
+
+	spin_unlock_bh(&db->lock);
+
+	jstat_inc(state->jool.stats, JSTAT_FRAG_MATCHED);
+	return VERDICT_CONTINUE;
+}
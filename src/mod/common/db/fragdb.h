@@ -0,0 +1,28 @@
+#ifndef SRC_MOD_COMMON_DB_FRAGDB_H_
+#define SRC_MOD_COMMON_DB_FRAGDB_H_
+
+/**
+ * @file
+ * NAT64's fragment tracker. (See the fragment-tracking global.)
+ *
+ * Only the first fragment of a packet carries the transport header, so the
+ * other fragments cannot be mapped to a session on their own. Instead of
+ * reassembling them, Jool remembers the first fragment's tuple, indexed by the
+ * packet's addresses, protocol and Fragment Identification, and hands it to the
+ * subsequent fragments as they arrive.
+ *
+ * Packets the tracker can't handle are left to the kernel's defragmenter.
+ */
+
+#include "mod/common/translation_state.h"
+
+struct fragdb;
+
+struct fragdb *fragdb_alloc(void);
+void fragdb_get(struct fragdb *db);
+void fragdb_put(struct fragdb *db);
+
+verdict fragdb_add(struct xlation *state);
+verdict fragdb_find(struct xlation *state);
+
+#endif /* SRC_MOD_COMMON_DB_FRAGDB_H_ */
@@ -77,6 +77,7 @@ int globals_init(struct jool_globals *config, xlator_type type,
 	config->reset_tos = DEFAULT_RESET_TOS;
 	config->new_tos = DEFAULT_NEW_TOS;
 	config->lowest_ipv6_mtu = DEFAULT_LOWEST_IPV6_MTU;
+	config->xlat_in_place = DEFAULT_XLAT_IN_PLACE;
 	memcpy(config->plateaus.values, &PLATEAUS, sizeof(PLATEAUS));
 	config->plateaus.count = ARRAY_SIZE(PLATEAUS);
 
@@ -85,6 +86,7 @@ int globals_init(struct jool_globals *config, xlator_type type,
 		config->siit.compute_udp_csum_zero = DEFAULT_COMPUTE_UDP_CSUM0;
 		config->siit.eam_hairpin_mode = DEFAULT_EAM_HAIRPIN_MODE;
 		config->siit.randomize_error_addresses = DEFAULT_RANDOMIZE_RFC6791;
+		config->siit.route_cache = DEFAULT_DESTINATION_ROUTE_CACHE;
 		config->siit.rfc6791_prefix6.set = false;
 		config->siit.rfc6791_prefix4.set = false;
 		break;
@@ -101,15 +103,37 @@ int globals_init(struct jool_globals *config, xlator_type type,
 		config->nat64.bib.ttl.icmp = 1000 * ICMP_DEFAULT;
 		config->nat64.bib.bib_logging = DEFAULT_BIB_LOGGING;
 		config->nat64.bib.session_logging = DEFAULT_SESSION_LOGGING;
+		config->nat64.bib.binary_logging = DEFAULT_BINARY_LOGGING;
+		config->nat64.bib.route_cache = DEFAULT_SESSION_ROUTE_CACHE;
 		config->nat64.bib.drop_by_addr = DEFAULT_ADDR_DEPENDENT_FILTERING;
 		config->nat64.bib.drop_external_tcp = DEFAULT_DROP_EXTERNAL_CONNECTIONS;
 		config->nat64.bib.max_stored_pkts = DEFAULT_MAX_STORED_PKTS;
+		config->nat64.bib.subscriber_prefix_len = DEFAULT_SUBSCRIBER_PREFIX_LEN;
+		config->nat64.bib.subscriber_max_bibs = DEFAULT_SUBSCRIBER_MAX_BIBS;
+		config->nat64.bib.subscriber_max_sessions = DEFAULT_SUBSCRIBER_MAX_SESSIONS;
+		config->nat64.bib.session_memory_limit = DEFAULT_SESSION_MEMORY_LIMIT;
+		config->nat64.bib.high_water.tcp = DEFAULT_HIGH_WATER;
+		config->nat64.bib.high_water.udp = DEFAULT_HIGH_WATER;
+		config->nat64.bib.high_water.icmp = DEFAULT_HIGH_WATER;
+
+		config->nat64.frag_tracking = DEFAULT_FRAG_TRACKING;
+		config->nat64.frag_tracking_timeout = 1000 * DEFAULT_FRAG_TRACKING_TIMEOUT;
+		config->nat64.frag_tracking_capacity = DEFAULT_FRAG_TRACKING_CAPACITY;
+
+		config->nat64.flow_cache = DEFAULT_FLOW_CACHE;
+		config->nat64.flow_cache_capacity = DEFAULT_FLOW_CACHE_CAPACITY;
 
 		config->nat64.joold.enabled = DEFAULT_JOOLD_ENABLED;
 		config->nat64.joold.flush_asap = DEFAULT_JOOLD_FLUSH_ASAP;
 		config->nat64.joold.flush_deadline = 1000 * DEFAULT_JOOLD_DEADLINE;
 		config->nat64.joold.capacity = DEFAULT_JOOLD_CAPACITY;
 		config->nat64.joold.max_payload = DEFAULT_JOOLD_MAX_PAYLOAD;
+		config->nat64.joold.sync_tcp = DEFAULT_JOOLD_SYNC_TCP;
+		config->nat64.joold.sync_udp = DEFAULT_JOOLD_SYNC_UDP;
+		config->nat64.joold.sync_icmp = DEFAULT_JOOLD_SYNC_ICMP;
+		config->nat64.joold.tcp_est_only = DEFAULT_JOOLD_TCP_EST_ONLY;
+		config->nat64.joold.min_age = DEFAULT_JOOLD_MIN_AGE;
+		config->nat64.joold.src6_prefix.set = false;
 		break;
 
 	default:
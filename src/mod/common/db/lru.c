@@ -0,0 +1,93 @@
+#include "mod/common/db/lru.h"
+
+#include <linux/jiffies.h>
+
+void lru_init(struct lru *lru, void (*free_fn)(struct lru_node *))
+{
+	INIT_LIST_HEAD(&lru->list);
+	lru->count = 0;
+	lru->free_fn = free_fn;
+}
+
+/**
+ * lru_flush - Removes and releases every node.
+ */
+void lru_flush(struct lru *lru)
+{
+	struct lru_node *node;
+	struct lru_node *tmp;
+
+	list_for_each_entry_safe(node, tmp, &lru->list, list_hook)
+		lru_rm(lru, node);
+}
+
+/**
+ * lru_add - Inserts @node in @bucket, as the newest node.
+ * @timeout is in jiffies.
+ *
+ * Does not make room; see lru_make_room().
+ */
+void lru_add(struct lru *lru, struct hlist_head *bucket, struct lru_node *node,
+		unsigned long timeout)
+{
+	node->expiration = jiffies + timeout;
+	hlist_add_head(&node->hash_hook, bucket);
+	list_add_tail(&node->list_hook, &lru->list);
+	lru->count++;
+}
+
+/**
+ * lru_refresh - Postpones @node's expiration, and makes it the newest node.
+ * @timeout is in jiffies.
+ */
+void lru_refresh(struct lru *lru, struct lru_node *node,
+		unsigned long timeout)
+{
+	node->expiration = jiffies + timeout;
+	list_move_tail(&node->list_hook, &lru->list);
+}
+
+/**
+ * lru_rm - Removes @node from the table, and releases it.
+ */
+void lru_rm(struct lru *lru, struct lru_node *node)
+{
+	hlist_del(&node->hash_hook);
+	list_del(&node->list_hook);
+	lru->count--;
+	lru->free_fn(node);
+}
+
+/**
+ * lru_make_room - Evicts the oldest nodes until there's room for one more.
+ * Returns the number of evicted nodes.
+ *
+ * Callers should not add anything if @capacity is zero.
+ */
+unsigned int lru_make_room(struct lru *lru, unsigned int capacity)
+{
+	unsigned int evicted = 0;
+
+	while (lru->count >= capacity && !list_empty(&lru->list)) {
+		lru_rm(lru, list_first_entry(&lru->list, struct lru_node,
+				list_hook));
+		evicted++;
+	}
+
+	return evicted;
+}
+
+/**
+ * lru_expire - Removes the nodes whose expiration has passed.
+ */
+void lru_expire(struct lru *lru)
+{
+	struct lru_node *node;
+	struct lru_node *tmp;
+
+	list_for_each_entry_safe(node, tmp, &lru->list, list_hook) {
+		if (time_before(jiffies, node->expiration))
+			break;
+		lru_rm(lru, node);
+	}
+}
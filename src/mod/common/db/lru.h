@@ -0,0 +1,48 @@
+#ifndef SRC_MOD_COMMON_DB_LRU_H_
+#define SRC_MOD_COMMON_DB_LRU_H_
+
+/**
+ * @file
+ * Bounded, expiring hash table bookkeeping, shared by the fragment tracker and
+ * the flow cache.
+ *
+ * The users own the hash table (since they hash and compare their own keys),
+ * and embed a struct lru_node in their entries. This module keeps the entries
+ * sorted by expiration, evicts the oldest ones when the table is full, and
+ * forgets the expired ones. Every entry of a given table is assumed to share
+ * the same timeout, so a refreshed entry is simply sent to the back of the
+ * list.
+ *
+ * None of this is thread-safe; the users lock.
+ */
+
+#include <linux/list.h>
+
+struct lru_node {
+	/** In jiffies. */
+	unsigned long expiration;
+	struct hlist_node hash_hook;
+	struct list_head list_hook;
+};
+
+struct lru {
+	/** All the nodes, sorted by expiration. */
+	struct list_head list;
+	unsigned int count;
+	/** Releases a node that's no longer in the table. */
+	void (*free_fn)(struct lru_node *);
+};
+
+void lru_init(struct lru *lru, void (*free_fn)(struct lru_node *));
+void lru_flush(struct lru *lru);
+
+void lru_add(struct lru *lru, struct hlist_head *bucket, struct lru_node *node,
+		unsigned long timeout);
+void lru_refresh(struct lru *lru, struct lru_node *node,
+		unsigned long timeout);
+void lru_rm(struct lru *lru, struct lru_node *node);
+
+unsigned int lru_make_room(struct lru *lru, unsigned int capacity);
+void lru_expire(struct lru *lru);
+
+#endif /* SRC_MOD_COMMON_DB_LRU_H_ */
@@ -35,6 +35,9 @@
  * entries that share a mark do not necessarily share addresses and vice-versa.
  */
 
+/* Addresses pool4db_add_bulk() adds per lock hold. */
+#define POOL4_ADD_BUDGET 64
+
 struct pool4_table {
 	union {
 		__u32 mark;
@@ -530,55 +533,124 @@ static int add_to_addr_tree(struct pool4 *pool,
 	return 0;
 }
 
-int pool4db_add(struct pool4 *pool, const struct pool4_entry *entry)
+static int validate_entry(const struct pool4_entry *entry)
 {
-	struct ipv4_range addend = { .ports = entry->range.ports };
-	u64 tmp;
 	int error;
 
 	error = prefix4_validate(&entry->range.prefix);
 	if (error)
 		return error;
-	error = max_iterations_validate(entry->flags, entry->iterations);
+	return max_iterations_validate(entry->flags, entry->iterations);
+}
+
+static void init_addend(const struct pool4_entry *entry,
+		struct ipv4_range *addend)
+{
+	addend->ports = entry->range.ports;
+	if (addend->ports.min > addend->ports.max)
+		swap(addend->ports.min, addend->ports.max);
+	if (entry->proto == L4PROTO_TCP || entry->proto == L4PROTO_UDP)
+		if (addend->ports.min == 0)
+			addend->ports.min = 1;
+
+	addend->prefix.len = 32;
+}
+
+/* Assumes the lock is held. */
+static int add_addr(struct pool4 *pool, const struct pool4_entry *entry,
+		struct ipv4_range *addend)
+{
+	int error;
+
+	error = add_to_mark_tree(pool, entry, addend);
 	if (error)
 		return error;
 
-	if (addend.ports.min > addend.ports.max)
-		swap(addend.ports.min, addend.ports.max);
-	if (entry->proto == L4PROTO_TCP || entry->proto == L4PROTO_UDP)
-		if (addend.ports.min == 0)
-			addend.ports.min = 1;
+	error = add_to_addr_tree(pool, entry, addend);
+	if (error) {
+		/*
+		 * We're in a serious conundrum.
+		 * We cannot revert the add_to_mark_tree() because of port range
+		 * fusing; we don't know the state before we locked unless we
+		 * rebuild the entire mark tree based on the address tree, but
+		 * since this error was caused either by a memory allocation
+		 * failure or a bug, we can't do that.
+		 * (Also laziness. It sounds like a million lines of code.)
+		 * So let's just let the user know that the database was left
+		 * in an inconsistent state and have them restart from scratch.
+		 */
+		log_err("pool4 was probably left in an inconsistent state because of a memory allocation failure or a bug. Please remove NAT64 Jool from your kernel.");
+	}
+
+	return error;
+}
+
+int pool4db_add(struct pool4 *pool, const struct pool4_entry *entry)
+{
+	struct ipv4_range addend;
+	u64 tmp;
+	int error;
+
+	error = validate_entry(entry);
+	if (error)
+		return error;
 
-	addend.prefix.len = 32;
+	init_addend(entry, &addend);
 	foreach_addr4(addend.prefix.addr, tmp, &entry->range.prefix) {
 		spin_lock_bh(&pool->lock);
-		error = add_to_mark_tree(pool, entry, &addend);
-		if (!error) {
-			error = add_to_addr_tree(pool, entry, &addend);
-			if (error)
-				goto trainwreck;
-		}
+		error = add_addr(pool, entry, &addend);
 		spin_unlock_bh(&pool->lock);
 		if (error)
 			return error;
 	}
 
 	return 0;
+}
 
-trainwreck:
+/**
+ * Adds the @count entries from @entries, taking the lock once per
+ * POOL4_ADD_BUDGET addresses. (Instead of once per address, like
+ * pool4db_add().)
+ *
+ * Entries whose @errors slot is already nonzero are skipped. The result of the
+ * remaining ones is stored in their @errors slot.
+ *
+ * Process context only.
+ */
+void pool4db_add_bulk(struct pool4 *pool, const struct pool4_entry *entries,
+		unsigned int count, int *errors)
+{
+	struct ipv4_range addend;
+	u64 tmp;
+	unsigned int budget;
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		if (!errors[i])
+			errors[i] = validate_entry(&entries[i]);
+
+	budget = POOL4_ADD_BUDGET;
+	spin_lock_bh(&pool->lock);
+	for (i = 0; i < count; i++) {
+		if (errors[i])
+			continue;
+		init_addend(&entries[i], &addend);
+		foreach_addr4(addend.prefix.addr, tmp, &entries[i].range.prefix) {
+			if (budget == 0) {
+				/* Let the translation have the pool for a bit. */
+				spin_unlock_bh(&pool->lock);
+				cond_resched();
+				budget = POOL4_ADD_BUDGET;
+				spin_lock_bh(&pool->lock);
+			}
+			budget--;
+
+			errors[i] = add_addr(pool, &entries[i], &addend);
+			if (errors[i])
+				break;
+		}
+	}
 	spin_unlock_bh(&pool->lock);
-	/*
-	 * We're in a serious conundrum.
-	 * We cannot revert the add_to_mark_tree() because of port range fusing;
-	 * we don't know the state before we locked unless we rebuild the entire
-	 * mark tree based on the address tree, but since this error was caused
-	 * either by a memory allocation failure or a bug, we can't do that.
-	 * (Also laziness. It sounds like a million lines of code.)
-	 * So let's just let the user know that the database was left in an
-	 * inconsistent state and have them restart from scratch.
-	 */
-	log_err("pool4 was probably left in an inconsistent state because of a memory allocation failure or a bug. Please remove NAT64 Jool from your kernel.");
-	return error;
 }
 
 int pool4db_update(struct pool4 *pool, const struct pool4_update *update)
@@ -1186,6 +1258,16 @@ void mask_domain_commit(struct mask_domain *masks)
 	atomic_add(masks->taddr_counter, &next_ephemeral);
 }
 
+/*
+ * Makes the next mask_domain_next() start over from the mask it last returned,
+ * with a full budget. For lookups that need to be redone.
+ */
+void mask_domain_rewind(struct mask_domain *masks)
+{
+	masks->taddr_counter = 0;
+	masks->current_port--;
+}
+
 bool mask_domain_matches(struct mask_domain *masks,
 		struct ipv4_transport_addr *addr)
 {
@@ -24,6 +24,8 @@ void pool4db_get(struct pool4 *pool);
 void pool4db_put(struct pool4 *pool);
 
 int pool4db_add(struct pool4 *pool, const struct pool4_entry *entry);
+void pool4db_add_bulk(struct pool4 *pool, const struct pool4_entry *entries,
+		unsigned int count, int *errors);
 int pool4db_update(struct pool4 *pool, const struct pool4_update *update);
 int pool4db_rm(struct pool4 *pool, const __u32 mark, enum l4_protocol proto,
 		struct ipv4_range *range);
@@ -50,6 +52,7 @@ int mask_domain_next(struct mask_domain *masks,
 		struct ipv4_transport_addr *addr,
 		bool *consecutive);
 void mask_domain_commit(struct mask_domain *masks);
+void mask_domain_rewind(struct mask_domain *masks);
 bool mask_domain_matches(struct mask_domain *masks,
 		struct ipv4_transport_addr *addr);
 bool mask_domain_is_dynamic(struct mask_domain *masks);
@@ -5,6 +5,7 @@
 #include "mod/common/atomic_config.h"
 #include "mod/common/joold.h"
 #include "mod/common/log.h"
+#include "mod/common/shrinker.h"
 #include "mod/common/timer.h"
 #include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
@@ -36,6 +37,9 @@ static int setup_common_modules(void)
 	error = jtimer_setup();
 	if (error)
 		goto jtimer_fail;
+	error = jshrinker_setup();
+	if (error)
+		goto jshrinker_fail;
 
 	/* Common */
 	error = xlation_setup();
@@ -59,6 +63,8 @@ nlhandler_fail:
 xlator_fail:
 	xlation_teardown();
 xlation_fail:
+	jshrinker_teardown();
+jshrinker_fail:
 	jtimer_teardown();
 jtimer_fail:
 	rfc6056_teardown();
@@ -80,6 +86,7 @@ static void teardown_common_modules(void)
 	atomconfig_teardown();
 
 	/* NAT64 */
+	jshrinker_teardown();
 	jtimer_teardown();
 	rfc6056_teardown();
 	joold_teardown();
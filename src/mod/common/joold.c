@@ -4,6 +4,8 @@
 #include <net/genetlink.h>
 
 #include "common/constants.h"
+#include "mod/common/joold_udp.h"
+#include "mod/common/address.h"
 #include "mod/common/log.h"
 #include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
@@ -14,6 +16,11 @@
 
 #define GLOBALS(xlator) (xlator->globals.nat64.joold)
 
+/* Maximum number of BIB windows a drain() can write. */
+#define DRAIN_WINDOWS 8
+/* Maximum number of digests write_digests() computes per window. */
+#define DIGESTS_PER_WINDOW (SESSION_DUMP_BUDGET / JOOLD_DIGEST_SESSIONS)
+
 /*
  * Remember to include in the user documentation:
  *
@@ -32,7 +39,7 @@ struct joold_queue {
 	struct list_head sessions;
 	/** Number of nodes in @sessions. */
 	unsigned int count;
-	/** Number of advertisement nodes in @sessions. */
+	/** Number of nodes in @sessions that are not lone sessions. */
 	unsigned int advertisement_count;
 
 	/**
@@ -50,46 +57,71 @@ struct joold_queue {
 
 	/** Namespace where the sessions will be multicasted. */
 	struct net *ns;
+	/**
+	 * If not NULL, the sessions are exchanged with the peers through this
+	 * kernel socket instead of the joold daemon.
+	 */
+	struct joold_udp *udp;
+	/**
+	 * The instance was removed; @udp can no longer be opened.
+	 * (See joold_stop().)
+	 */
+	bool stopped;
+	/**
+	 * Someone is writing the first node's next window into @skb, with the
+	 * lock released. (See drain().) Until they're done, nobody else can
+	 * touch @skb or the first node.
+	 */
+	bool draining;
 
 	spinlock_t lock;
 	struct kref refs;
 };
 
+enum joold_node_type {
+	/**
+	 * A lone session.
+	 * These are added whenever a translating packet updates a session.
+	 */
+	JNT_SESSION,
+	/**
+	 * A group of sessions. Either the user issued an --advertise (and the
+	 * whole table needs to be transmitted), or a peer's digest revealed a
+	 * range of the table in which we differ.
+	 */
+	JNT_GROUP,
+	/** The user issued a --resync; digests of the whole table are due. */
+	JNT_DIGESTS,
+	/** A peer's digest mismatched ours; request its sessions. */
+	JNT_RANGE,
+};
+
 /**
  * A session or group of sessions that need to be transmitted to other Jool
  * instances in the near future.
  */
 struct joold_node {
-	/**
-	 * true - @group below is valid.
-	 * false - @single below is valid.
-	 */
-	bool is_group;
+	enum joold_node_type type;
 	union {
-		/**
-		 * If @single is valid, this node represents a lone session.
-		 * These are added whenever a translating packet updates a
-		 * session.
-		 */
+		/** Valid if @type is JNT_SESSION. */
 		struct session_entry single;
 		/**
-		 * If @group is valid, the user issued an --advertise.
-		 * The whole database needs to be transmitted.
-		 * Unfortunately, a typical table won't fit in a single
-		 * packet so this node might stick for several iterations and
-		 * keep track of what is yet to be sent.
+		 * Valid if @type is JNT_GROUP or JNT_DIGESTS.
+		 * Unfortunately, a typical table won't fit in a single packet
+		 * so this node might stick for several iterations and keep
+		 * track of what is yet to be sent.
 		 */
 		struct {
-			/** IPv4 ID of the session sent in the last packet. */
-			struct taddr4_tuple offset;
-			/**
-			 * true - @offset above is valid.
-			 * false - @no sessions from this node have been sent.
-			 */
-			bool offset_set;
+			/** Where the next packet's sessions/digests start. */
+			struct session_foreach_offset offset;
 			/** Protocol table this group belongs to. */
 			l4_protocol proto;
+			/** true - Sessions after @end are not part of the group. */
+			bool bounded;
+			struct taddr4_tuple end;
 		} group;
+		/** Valid if @type is JNT_RANGE. */
+		struct session_digest range;
 	};
 
 	/** List hook to joold_queue.sessions.  */
@@ -151,6 +183,7 @@ static int allocate_joold_skb(struct xlator *jool)
 		goto kill_packet;
 	}
 
+	queue->skb_full = false;
 	return 0;
 
 kill_packet:
@@ -159,13 +192,173 @@ kill_packet:
 	return -ENOMEM;
 }
 
+static int write_group_cb(struct session_entry const *session, void *arg)
+{
+	struct joold_advertise_struct *args = arg;
+	struct joold_node *node = args->node;
+
+	if (node->group.bounded && session_beyond(session, &node->group.end))
+		return 1; /* Group ended. */
+
+	if (jnla_put_session(args->skb, JNLAL_ENTRY, session)) {
+		args->status->is_full = true;
+		return 1;
+	}
+
+	node->group.offset.offset.src = session->src4;
+	node->group.offset.offset.dst = session->dst4;
+	node->group.offset.include_offset = false;
+	args->status->entries_written++;
+	return 0;
+}
+
+/*
+ * Writes the next window (see bib_dump_window()) of group @node into @skb.
+ * Returns true if @node was written completely. Sets @full if @skb ran out of
+ * room.
+ *
+ * Must not be called with the queue's lock held.
+ */
+static bool write_group(struct xlator *jool, struct sk_buff *skb,
+		struct joold_node *node, bool *full)
+{
+	struct session_dump dump;
+	struct write_status status;
+	struct joold_advertise_struct args;
+	int error;
+
+	status.is_full = false;
+	status.entries_written = 0;
+	args.skb = skb;
+	args.node = node;
+	args.status = &status;
+
+	bib_dump_init(&dump, node->group.proto, NULL, &node->group.offset);
+	error = bib_dump_window(jool, &dump, write_group_cb, &args);
+	if (error < 0) {
+		log_err("bib_dump_window() threw error code %d.", error);
+		return true; /* Discard the node; can't do anything. */
+	}
+
+	if (status.is_full) {
+		*full = true;
+		return false;
+	}
+	if (error || dump.done)
+		return true; /* Group or table ended. */
+
+	node->group.offset = dump.offset;
+	return false;
+}
+
+/*
+ * Writes the next (at most) DIGESTS_PER_WINDOW digests of @node into @skb.
+ * Returns true if @node was written completely. Sets @full if @skb ran out of
+ * room.
+ *
+ * Must not be called with the queue's lock held.
+ */
+static bool write_digests(struct xlator *jool, struct sk_buff *skb,
+		struct joold_node *node, bool *full)
+{
+	struct session_digest digest;
+	unsigned int i;
+	int error;
+
+	digest.proto = node->group.proto;
+	digest.start = node->group.offset;
+
+	for (i = 0; i < DIGESTS_PER_WINDOW; i++) {
+		error = bib_digest_next(jool, &digest, JOOLD_DIGEST_SESSIONS);
+		if (error) {
+			log_err("bib_digest_next() threw error code %d.", error);
+			return true;
+		}
+
+		if (jnla_put_digest(skb, JNLAL_DIGEST, &digest, true)) {
+			*full = true;
+			return false;
+		}
+
+		if (digest.count < JOOLD_DIGEST_SESSIONS)
+			return true; /* That was the last one. */
+
+		digest.start.offset = digest.end;
+		digest.start.include_offset = false;
+		node->group.offset = digest.start;
+	}
+
+	return false;
+}
+
+static void free_node(struct joold_queue *queue, struct joold_node *node)
+{
+	list_del(&node->nextprev);
+	queue->count--;
+	if (node->type != JNT_SESSION)
+		queue->advertisement_count--;
+	wkmem_cache_free("joold node", node_cache, node);
+}
+
+/**
+ * Moves as many queued nodes as possible to the packet.
+ * Assumes the lock is held.
+ *
+ * Group and digest nodes need to walk the BIB, so they're left to drain().
+ * This stops at the first one, so the nodes behind it do not overtake it.
+ */
+static void write_nodes(struct xlator *jool)
+{
+	struct joold_queue *queue;
+	struct joold_node *node;
+	bool done;
+
+	queue = jool->nat64.joold;
+
+	while (!list_empty(&queue->sessions)) {
+		if (queue->draining)
+			return;
+
+		node = list_first_entry(&queue->sessions, struct joold_node,
+				nextprev);
+		if (node->type == JNT_GROUP || node->type == JNT_DIGESTS)
+			return;
+
+		if (!queue->skb && allocate_joold_skb(jool))
+			return;
+		if (queue->skb_full)
+			return;
+
+		switch (node->type) {
+		case JNT_SESSION:
+			done = !jnla_put_session(queue->skb, JNLAL_ENTRY,
+					&node->single);
+			break;
+		case JNT_RANGE:
+			done = !jnla_put_digest(queue->skb, JNLAL_RANGE,
+					&node->range, false);
+			break;
+		default:
+			WARN(true, "Unknown joold node type: %u", node->type);
+			done = true;
+		}
+
+		if (!done) {
+			queue->skb_full = true;
+			return;
+		}
+
+		free_node(queue, node);
+	}
+}
+
 static bool should_send(struct xlator *jool)
 {
 	struct joold_queue *queue;
 	unsigned long deadline;
 
 	queue = jool->nat64.joold;
-	if (!queue->skb)
+	if (!queue->skb || queue->draining)
 		return false;
 
 	deadline = msecs_to_jiffies(GLOBALS(jool).flush_deadline);
@@ -194,6 +387,7 @@ static struct sk_buff *send_to_userspace_prepare(struct xlator *jool)
 	struct joold_queue *queue;
 	struct sk_buff *skb;
 
+	write_nodes(jool);
 	if (!should_send(jool))
 		return NULL;
 
@@ -210,11 +404,19 @@ static struct sk_buff *send_to_userspace_prepare(struct xlator *jool)
 	 * But the alternative is to do the nlcore_send_multicast_message()
 	 * with the lock held, and I don't have the stomach for that.
 	 */
+	queue->last_flush_time = jiffies;
+
+	if (queue->udp) {
+		/* Nobody is going to ACK; the socket paces itself. */
+		joold_udp_send(queue->udp, skb, queue->root);
+		skb = NULL;
+	} else {
+		queue->ack_received = false;
+	}
+
 	queue->skb = NULL;
 	queue->jhdr = NULL;
 	queue->root = NULL;
-	queue->ack_received = false;
-	queue->last_flush_time = jiffies;
 	return skb;
 }
 
@@ -246,6 +448,67 @@ static void send_to_userspace(struct xlator *jool, struct sk_buff *skb,
 	}
 }
 
+/*
+ * Writes (at most DRAIN_WINDOWS) windows of the queued group and digest nodes,
+ * and sends the packet if it's due.
+ *
+ * The BIB is walked with the queue's lock released, so the packet path (which
+ * only ever needs the queue's lock) is never stuck behind a BIB walk. Not to be
+ * called from the packet path; the timer, the ACKs and the UDP transport's
+ * worker take care of it.
+ */
+static void drain(struct xlator *jool)
+{
+	struct joold_queue *queue;
+	struct joold_node *node;
+	struct joold_node cursor;
+	struct sk_buff *skb;
+	unsigned int windows;
+	bool full;
+	bool done;
+
+	queue = jool->nat64.joold;
+
+	spin_lock_bh(&queue->lock);
+
+	for (windows = 0; windows < DRAIN_WINDOWS; windows++) {
+		write_nodes(jool);
+		if (queue->draining || queue->skb_full)
+			break;
+		if (list_empty(&queue->sessions))
+			break;
+		if (!queue->skb && allocate_joold_skb(jool))
+			break;
+
+		/* write_nodes() stopped at a group or digests node. */
+		node = list_first_entry(&queue->sessions, struct joold_node,
+				nextprev);
+		cursor = *node;
+		skb = queue->skb;
+		queue->draining = true;
+		spin_unlock_bh(&queue->lock);
+
+		full = false;
+		done = (cursor.type == JNT_GROUP)
+				? write_group(jool, skb, &cursor, &full)
+				: write_digests(jool, skb, &cursor, &full);
+
+		spin_lock_bh(&queue->lock);
+		queue->draining = false;
+		node->group = cursor.group;
+		if (full)
+			queue->skb_full = true;
+		if (done)
+			free_node(queue, node);
+	}
+
+	skb = send_to_userspace_prepare(jool);
+
+	spin_unlock_bh(&queue->lock);
+
+	send_to_userspace(jool, skb, jool->ns);
+}
+
 /**
  * joold_create - Constructor for joold_queue structs.
  */
@@ -278,6 +541,9 @@ struct joold_queue *joold_alloc(struct net *ns)
 	queue->ack_received = true;
 	queue->last_flush_time = jiffies;
 	queue->ns = ns;
+	queue->udp = NULL;
+	queue->stopped = false;
+	queue->draining = false;
 
 	spin_lock_init(&queue->lock);
 	kref_init(&queue->refs);
@@ -312,7 +578,15 @@ static void joold_release(struct kref *refs)
 	struct joold_queue *queue;
 	queue = container_of(refs, struct joold_queue, refs);
 
+	/*
+	 * The last put can happen in softirq context, so the socket (whose
+	 * release sleeps) was closed by joold_stop() already.
+	 */
+	WARN(queue->udp, "joold queue released with an open socket.");
+
 	purge_sessions(queue);
+	if (queue->skb)
+		kfree_skb(queue->skb);
 	wkfree(struct joold_queue, queue);
 }
 
@@ -321,6 +595,104 @@ void joold_put(struct joold_queue *queue)
 	kref_put(&queue->refs, joold_release);
 }
 
+/**
+ * Returns a new node, already queued.
+ * Assumes the lock is held.
+ */
+static struct joold_node *queue_node(struct xlator *jool,
+		enum joold_node_type type)
+{
+	struct joold_queue *queue;
+	struct joold_node *node;
+
+	queue = jool->nat64.joold;
+
+	if (queue->count >= GLOBALS(jool).capacity) {
+		log_warn_once("joold: Too many sessions deferred! I need to drop some; sorry.");
+		return NULL;
+	}
+
+	node = wkmem_cache_alloc("joold node", node_cache, GFP_ATOMIC);
+	if (!node)
+		return NULL;
+
+	node->type = type;
+	list_add_tail(&node->nextprev, &queue->sessions);
+	queue->count++;
+	if (type != JNT_SESSION)
+		queue->advertisement_count++;
+
+	return node;
+}
+
+/* Assumes the lock is held. */
+static int write_session(struct xlator *jool, struct session_entry const *entry)
+{
+	struct joold_queue *queue;
+	int error;
+
+	queue = jool->nat64.joold;
+
+	if (!queue->skb) {
+		error = allocate_joold_skb(jool);
+		if (error)
+			return error;
+	}
+
+	error = jnla_put_session(queue->skb, JNLAL_ENTRY, entry);
+	if (error)
+		queue->skb_full = true;
+	return error;
+}
+
+/**
+ * Returns whether @entry passes the user's synchronization filters.
+ * Only reads the globals; no locking needed.
+ */
+static bool should_sync(struct xlator *jool, struct session_entry *entry)
+{
+	struct joold_config *cfg = &GLOBALS(jool);
+	bool proto_enabled;
+
+	switch (entry->proto) {
+	case L4PROTO_TCP:
+		proto_enabled = cfg->sync_tcp;
+		break;
+	case L4PROTO_UDP:
+		proto_enabled = cfg->sync_udp;
+		break;
+	case L4PROTO_ICMP:
+		proto_enabled = cfg->sync_icmp;
+		break;
+	default:
+		proto_enabled = false;
+	}
+	if (!proto_enabled) {
+		jstat_inc(jool->stats, JSTAT_JOOLD_FILTER_PROTO);
+		return false;
+	}
+
+	if (cfg->tcp_est_only && entry->proto == L4PROTO_TCP
+			&& entry->state != ESTABLISHED) {
+		jstat_inc(jool->stats, JSTAT_JOOLD_FILTER_STATE);
+		return false;
+	}
+
+	if (cfg->min_age && time_before(jiffies, entry->creation_time
+			+ msecs_to_jiffies(cfg->min_age))) {
+		jstat_inc(jool->stats, JSTAT_JOOLD_FILTER_AGE);
+		return false;
+	}
+
+	if (cfg->src6_prefix.set && !prefix6_contains(&cfg->src6_prefix.prefix,
+			&entry->src6.l3)) {
+		jstat_inc(jool->stats, JSTAT_JOOLD_FILTER_SRC6);
+		return false;
+	}
+
+	return true;
+}
+
 /**
  * joold_add - Add the @entry session to @queue.
  *
@@ -336,25 +708,20 @@ void joold_add(struct xlator *jool, struct session_entry *entry)
 
 	if (!GLOBALS(jool).enabled)
 		return;
+	if (!should_sync(jool, entry))
+		return;
 
 	queue = jool->nat64.joold;
 
 	spin_lock_bh(&queue->lock);
 
-	if (!queue->skb && allocate_joold_skb(jool)) {
-		spin_unlock_bh(&queue->lock);
-		return;
-	}
-
-	queue->skb_full = jnla_put_session(queue->skb, JNLAL_ENTRY, entry);
-	if (queue->skb_full) {
-		copy = wkmem_cache_alloc("joold node", node_cache, GFP_ATOMIC);
-		if (copy) {
-			copy->is_group = false;
+	/* Do not overtake the sessions that are already waiting. */
+	write_nodes(jool);
+	if (!list_empty(&queue->sessions) || write_session(jool, entry)) {
+		copy = queue_node(jool, JNT_SESSION);
+		if (copy)
 			copy->single = *entry;
-			list_add_tail(&copy->nextprev, &queue->sessions);
-			queue->count++;
-		} /* Else discard it; can't do anything. */
+		/* Else discard it; can't do anything. */
 	}
 
 	skb = send_to_userspace_prepare(jool);
@@ -375,6 +742,14 @@ static enum session_fate collision_cb(struct session_entry *old, void *arg)
 	struct session_entry *new = &params->new;
 
 	if (session_equals(old, new)) { /* It's the same session; update it. */
+		/*
+		 * Advertisements and resyncs can carry data older than ours.
+		 * (Regular updates can't; they were created after ours.)
+		 */
+		if (time_before(new->update_time, old->update_time)) {
+			params->success = true;
+			return FATE_PRESERVE;
+		}
 		old->state = new->state;
 		old->timer_type = new->timer_type;
 		old->update_time = new->update_time;
@@ -434,68 +809,292 @@ static int validate_enabled(struct xlator *jool)
 	return 0;
 }
 
-/**
- * joold_sync - Parses a bunch of sessions out of @data and adds them to @jool's
- * session database.
- *
- * This is the function that gets called whenever the jool daemon sends data to
- * the @jool Jool instance.
+/* Assumes the lock is held. */
+static int queue_group(struct xlator *jool, struct session_digest *range)
+{
+	struct joold_node *node;
+
+	node = queue_node(jool, JNT_GROUP);
+	if (!node)
+		return -ENOMEM;
+
+	node->group.offset = range->start;
+	node->group.proto = range->proto;
+	node->group.bounded = true;
+	node->group.end = range->end;
+	return 0;
+}
+
+/* Assumes the lock is held. */
+static int queue_range(struct xlator *jool, struct session_digest *range)
+{
+	struct joold_node *node;
+
+	node = queue_node(jool, JNT_RANGE);
+	if (!node)
+		return -ENOMEM;
+
+	node->range = *range;
+	return 0;
+}
+
+/*
+ * A peer sent the digest of one of its table ranges. If ours differs, send our
+ * sessions of the range, and ask the peer for theirs.
+ * (Sessions are never removed through joold, so the union is the reconciled
+ * range.)
  */
-int joold_sync(struct xlator *jool, struct nlattr *root)
+static bool handle_digest(struct xlator *jool, struct nlattr *attr,
+		bool *queued)
+{
+	struct session_digest remote;
+	struct session_digest local;
+	unsigned int max;
+	spinlock_t *lock;
+	int error;
+
+	error = jnla_get_digest(attr, "Joold digest", &remote);
+	if (error)
+		return false;
+
+	/*
+	 * The peer's last digest stretches to the end of the table, so the
+	 * range can be arbitrarily large on our end. Counting one session past
+	 * the peer's is enough to tell the ranges apart, and the group queued
+	 * below is written later, in bounded windows.
+	 */
+	local = remote;
+	max = min_t(__u32, remote.count, JOOLD_DIGEST_SESSIONS) + 1;
+	error = bib_digest(jool, &local, max);
+	if (error)
+		return false;
+
+	if (local.count < max && local.count == remote.count
+			&& local.hash == remote.hash)
+		return true;
+
+	__log_debug(jool, "Digest mismatch: %s %pI4#%u|%pI4#%u - %pI4#%u|%pI4#%u (%u vs %u sessions).",
+			l4proto_to_string(remote.proto),
+			&remote.start.offset.src.l3, remote.start.offset.src.l4,
+			&remote.start.offset.dst.l3, remote.start.offset.dst.l4,
+			&remote.end.src.l3, remote.end.src.l4,
+			&remote.end.dst.l3, remote.end.dst.l4,
+			remote.count, local.count);
+
+	lock = &jool->nat64.joold->lock;
+	spin_lock_bh(lock);
+	error = local.count ? queue_group(jool, &remote) : 0;
+	if (!error && remote.count)
+		error = queue_range(jool, &remote);
+	spin_unlock_bh(lock);
+
+	*queued = true;
+	return !error;
+}
+
+/* A peer requested our sessions of a range. */
+static bool handle_range(struct xlator *jool, struct nlattr *attr,
+		bool *queued)
+{
+	struct session_digest range;
+	spinlock_t *lock;
+	int error;
+
+	error = jnla_get_digest(attr, "Joold range", &range);
+	if (error)
+		return false;
+
+	lock = &jool->nat64.joold->lock;
+	spin_lock_bh(lock);
+	error = queue_group(jool, &range);
+	spin_unlock_bh(lock);
+
+	*queued = true;
+	return !error;
+}
+
+/*
+ * Sends what can be sent without walking the BIB. Can be called in softirq
+ * context. The group nodes are handed over to the UDP transport's worker if
+ * there is one, or the timer otherwise.
+ */
+static void flush_queue(struct xlator *jool)
+{
+	struct joold_queue *queue;
+	struct sk_buff *skb;
+
+	queue = jool->nat64.joold;
+
+	spin_lock_bh(&queue->lock);
+	skb = send_to_userspace_prepare(jool);
+	if (queue->udp && queue->advertisement_count)
+		joold_udp_kick(queue->udp);
+	spin_unlock_bh(&queue->lock);
+
+	send_to_userspace(jool, skb, jool->ns);
+}
+
+/* @atomic: Are we in softirq context? */
+static int sync_attrs(struct xlator *jool, struct nlattr *head, int len,
+		bool atomic)
 {
 	struct nlattr *attr;
 	int rem;
 	int error;
 	bool success;
+	bool queued;
 
 	error = validate_enabled(jool);
 	if (error)
 		return error;
 
 	success = true;
-	nla_for_each_nested(attr, root, rem)
-		success &= add_new_session(jool, attr);
+	queued = false;
+	nla_for_each_attr(attr, head, len, rem) {
+		switch (nla_type(attr)) {
+		case JNLAL_ENTRY:
+			success &= add_new_session(jool, attr);
+			break;
+		case JNLAL_DIGEST:
+			success &= handle_digest(jool, attr, &queued);
+			break;
+		case JNLAL_RANGE:
+			success &= handle_range(jool, attr, &queued);
+			break;
+		default:
+			log_err("Unknown joold element type: %d", nla_type(attr));
+			success = false;
+		}
+	}
+
+	if (queued) {
+		if (atomic)
+			flush_queue(jool);
+		else
+			drain(jool);
+	}
 
 	__log_debug(jool, "Done.");
 	return success ? 0 : -EINVAL;
 }
 
-static int add_advertise_node(struct joold_queue *queue, l4_protocol proto)
+/**
+ * joold_sync - Parses a bunch of sessions (and digests) out of @data and adds
+ * them to @jool's session database.
+ *
+ * This is the function that gets called whenever the jool daemon sends data to
+ * the @jool Jool instance.
+ */
+int joold_sync(struct xlator *jool, struct nlattr *root)
+{
+	return sync_attrs(jool, nla_data(root), nla_len(root), false);
+}
+
+/**
+ * joold_sync_payload - Same as joold_sync(), except @data is the raw content of
+ * the session container, as received from the network.
+ */
+int joold_sync_payload(struct xlator *jool, void *data, int len)
+{
+	return sync_attrs(jool, data, len, true);
+}
+
+/**
+ * joold_set_transport - Starts exchanging @jool's sessions directly through a
+ * kernel UDP socket configured as @config. If @config is NULL, reverts to
+ * the Netlink (joold daemon) transport.
+ *
+ * Must be called in process context.
+ */
+int joold_set_transport(struct xlator *jool, struct joold_udp_config *config)
+{
+	struct joold_queue *queue;
+	struct joold_udp *new;
+	struct joold_udp *old;
+
+	if (config) {
+		new = joold_udp_create(jool, config);
+		if (IS_ERR(new))
+			return PTR_ERR(new);
+	} else {
+		new = NULL;
+	}
+
+	queue = jool->nat64.joold;
+
+	spin_lock_bh(&queue->lock);
+	if (queue->stopped) {
+		spin_unlock_bh(&queue->lock);
+		if (new)
+			joold_udp_destroy(new);
+		log_err("The instance is being removed.");
+		return -ESRCH;
+	}
+	old = queue->udp;
+	queue->udp = new;
+	queue->ack_received = true;
+	spin_unlock_bh(&queue->lock);
+
+	if (old)
+		joold_udp_destroy(old);
+	return 0;
+}
+
+/**
+ * joold_stop - Closes @queue's kernel socket (if any), and prevents new ones
+ * from being opened. Called when @queue's instance is removed.
+ *
+ * Must be called in process context. (Unlike the last joold_put(), which
+ * might happen while a packet is being translated.)
+ */
+void joold_stop(struct joold_queue *queue)
+{
+	struct joold_udp *udp;
+
+	spin_lock_bh(&queue->lock);
+	udp = queue->udp;
+	queue->udp = NULL;
+	queue->stopped = true;
+	spin_unlock_bh(&queue->lock);
+
+	if (udp)
+		joold_udp_destroy(udp);
+}
+
+/* Assumes the lock is held. */
+static int add_advertise_node(struct xlator *jool, enum joold_node_type type,
+		l4_protocol proto)
 {
 	struct joold_node *node;
 
-	node = wkmem_cache_alloc("joold node", node_cache, GFP_ATOMIC);
+	node = queue_node(jool, type);
 	if (!node)
 		return -ENOMEM;
 
-	node->is_group = true;
 	memset(&node->group.offset, 0, sizeof(node->group.offset));
-	node->group.offset_set = false;
+	node->group.offset.include_offset = true;
 	node->group.proto = proto;
-
-	list_add_tail(&node->nextprev, &queue->sessions);
-	queue->count++;
-	queue->advertisement_count++;
+	node->group.bounded = false;
 
 	return 0;
 }
 
-static int prepare_advertisement(struct joold_queue *queue)
+static int prepare_advertisement(struct xlator *jool, enum joold_node_type type)
 {
 	int error;
 
-	error = add_advertise_node(queue, L4PROTO_TCP);
+	error = add_advertise_node(jool, type, L4PROTO_TCP);
 	if (error)
 		return error;
 
-	error = add_advertise_node(queue, L4PROTO_UDP);
+	error = add_advertise_node(jool, type, L4PROTO_UDP);
 	if (error)
 		return error;
 
-	return add_advertise_node(queue, L4PROTO_ICMP);
+	return add_advertise_node(jool, type, L4PROTO_ICMP);
 }
 
-int joold_advertise(struct xlator *jool)
+static int advertise(struct xlator *jool, enum joold_node_type type)
 {
 	struct joold_queue *queue;
 	struct sk_buff *skb;
@@ -508,20 +1107,37 @@ int joold_advertise(struct xlator *jool)
 	queue = jool->nat64.joold;
 
 	spin_lock_bh(&queue->lock);
-
-	error = prepare_advertisement(queue);
-	skb = error ? NULL : send_to_userspace_prepare(jool);
-
+	error = prepare_advertisement(jool, type);
 	spin_unlock_bh(&queue->lock);
 
-	send_to_userspace(jool, skb, jool->ns);
+	if (!error)
+		drain(jool);
 	return error;
 }
 
+/**
+ * joold_advertise - Multicast the entire session database.
+ */
+int joold_advertise(struct xlator *jool)
+{
+	return advertise(jool, JNT_GROUP);
+}
+
+/**
+ * joold_resync - Multicast digests of the session database, so the peers can
+ * find out (and exchange) the ranges in which they differ from us.
+ *
+ * This is a lot cheaper than joold_advertise() when the databases are mostly
+ * in sync already. (eg. after a few lost sync packets.)
+ */
+int joold_resync(struct xlator *jool)
+{
+	return advertise(jool, JNT_DIGESTS);
+}
+
 void joold_ack(struct xlator *jool)
 {
 	struct joold_queue *queue;
-	struct sk_buff *skb;
 
 	if (validate_enabled(jool))
 		return;
@@ -529,13 +1145,10 @@ void joold_ack(struct xlator *jool)
 	queue = jool->nat64.joold;
 
 	spin_lock_bh(&queue->lock);
-
 	queue->ack_received = true;
-	skb = send_to_userspace_prepare(jool);
-
 	spin_unlock_bh(&queue->lock);
 
-	send_to_userspace(jool, skb, jool->ns);
+	drain(jool);
 }
 
 /**
@@ -543,22 +1156,15 @@ void joold_ack(struct xlator *jool)
  * the deadline is in the past and no new packets have triggered a flush.
  * It's just a last-resort attempt to prevent nodes from lingering here for too
  * long that's generally only useful in non-flush-asap mode.
+ *
+ * Also writes the next windows of the group and digest nodes. (The UDP
+ * transport, which has no ACKs, calls this after sending each batch of
+ * packets.)
  */
 void joold_clean(struct xlator *jool)
 {
-	spinlock_t *lock;
-	struct sk_buff *skb;
-
 	if (!GLOBALS(jool).enabled)
 		return;
 
-	lock = &jool->nat64.joold->lock;
-
-	spin_lock_bh(lock);
-
-	skb = send_to_userspace_prepare(jool);
-
-	spin_unlock_bh(lock);
-
-	send_to_userspace(jool, skb, jool->ns);
+	drain(jool);
 }
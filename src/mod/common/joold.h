@@ -2,6 +2,7 @@
 #define SRC_MOD_NAT64_JOOLD_H_
 
 #include "common/config.h"
+#include "mod/common/joold_udp.h"
 #include "mod/common/xlator.h"
 #include "mod/common/db/bib/entry.h"
 
@@ -20,11 +21,16 @@ void joold_get(struct joold_queue *queue);
 void joold_put(struct joold_queue *queue);
 
 int joold_sync(struct xlator *jool, struct nlattr *root);
+int joold_sync_payload(struct xlator *jool, void *data, int len);
 void joold_add(struct xlator *jool, struct session_entry *entry);
 
 int joold_advertise(struct xlator *jool);
+int joold_resync(struct xlator *jool);
 void joold_ack(struct xlator *jool);
 
 void joold_clean(struct xlator *jool);
 
+int joold_set_transport(struct xlator *jool, struct joold_udp_config *config);
+void joold_stop(struct joold_queue *queue);
+
 #endif /* SRC_MOD_NAT64_JOOLD_H_ */
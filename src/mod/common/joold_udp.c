@@ -0,0 +1,283 @@
+#include "mod/common/joold_udp.h"
+
+#include <linux/igmp.h>
+#include <linux/rtnetlink.h>
+#include <linux/udp.h>
+#include <linux/workqueue.h>
+#include <net/ipv6.h>
+#include <net/udp.h>
+#include <net/udp_tunnel.h>
+
+#include "mod/common/joold.h"
+#include "mod/common/log.h"
+#include "mod/common/wkmalloc.h"
+
+/**
+ * Maximum number of packets waiting for the worker.
+ * (The Netlink transport has the ACKs for this.)
+ */
+#define MAX_PENDING 64
+
+struct joold_udp {
+	struct socket *sock;
+
+	/** Where the packets are sent. */
+	union {
+		struct sockaddr_in v4;
+		struct sockaddr_in6 v6;
+	} dst;
+	int dst_len;
+
+	/** Instance the received sessions belong to. */
+	xlator_flags flags;
+	char iname[INAME_MAX_SIZE];
+
+	/**
+	 * Packets waiting to be sent by @work.
+	 * (The queue is flushed in softirq context, but sendmsg wants to be
+	 * called from process context.)
+	 */
+	struct sk_buff_head pending;
+	struct work_struct work;
+};
+
+static int joold_udp_rcv(struct sock *sk, struct sk_buff *skb)
+{
+	struct joold_udp *udp;
+	struct xlator jool;
+
+	udp = rcu_dereference_sk_user_data(sk);
+	if (!udp)
+		goto end;
+	/* Our own multicast, looped back. */
+	if (skb->pkt_type == PACKET_LOOPBACK)
+		goto end;
+	/*
+	 * Recent kernels validate the checksum before handing the packet to
+	 * encap_rcv, but older ones don't. (If it was validated, this is
+	 * cheap.) A corrupted payload could otherwise become bogus sessions.
+	 */
+	if (udp_lib_checksum_complete(skb))
+		goto end;
+	if (skb_linearize(skb))
+		goto end;
+	__skb_pull(skb, sizeof(struct udphdr));
+
+	if (xlator_find(sock_net(sk), udp->flags, udp->iname, &jool))
+		goto end;
+	joold_sync_payload(&jool, skb->data, skb->len);
+	xlator_put(&jool);
+	/* Fall through. */
+
+end:
+	consume_skb(skb);
+	return 0; /* Always consumed. */
+}
+
+static void send_pending(struct work_struct *work)
+{
+	struct joold_udp *udp;
+	struct sk_buff *skb;
+	struct msghdr msg;
+	struct kvec iov;
+	struct xlator jool;
+	int error;
+
+	udp = container_of(work, struct joold_udp, work);
+
+	while ((skb = skb_dequeue(&udp->pending)) != NULL) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &udp->dst;
+		msg.msg_namelen = udp->dst_len;
+		msg.msg_flags = MSG_DONTWAIT;
+		iov.iov_base = skb->data;
+		iov.iov_len = skb->len;
+
+		error = kernel_sendmsg(udp->sock, &msg, &iov, 1, skb->len);
+		if (error < 0) {
+			log_warn_once("joold: Could not send a packet to the network (errcode %d).",
+					error);
+		}
+
+		consume_skb(skb);
+	}
+
+	/*
+	 * The packets are out, which is as close to an ACK as this transport
+	 * gets. Write the next part of the pending advertisements, if any.
+	 * (This is the only process context joold gets without the daemon.)
+	 */
+	if (xlator_find(sock_net(udp->sock->sk), udp->flags, udp->iname, &jool))
+		return;
+	joold_clean(&jool);
+	xlator_put(&jool);
+}
+
+static int adjust_mcast_opts(struct socket *sock,
+		struct joold_udp_config *config)
+{
+	struct sock *sk = sock->sk;
+	struct ip_mreqn mreq;
+	int error = 0;
+
+	rtnl_lock();
+	lock_sock(sk);
+
+	switch (config->family) {
+	case AF_INET:
+		if (ipv4_is_multicast(config->addr.v4.s_addr)) {
+			memset(&mreq, 0, sizeof(mreq));
+			mreq.imr_multiaddr = config->addr.v4;
+			mreq.imr_ifindex = config->in_ifindex;
+			error = ip_mc_join_group(sk, &mreq);
+		}
+		inet_sk(sk)->mc_index = config->out_ifindex;
+		if (config->ttl >= 0)
+			inet_sk(sk)->mc_ttl = config->ttl;
+		break;
+
+	case AF_INET6:
+		if (ipv6_addr_is_multicast(&config->addr.v6)) {
+			error = ipv6_sock_mc_join(sk, config->in_ifindex,
+					&config->addr.v6);
+		}
+		inet6_sk(sk)->mcast_oif = config->out_ifindex;
+		if (config->ttl >= 0)
+			inet6_sk(sk)->mcast_hops = config->ttl;
+		break;
+
+	default:
+		error = -EAFNOSUPPORT;
+	}
+
+	release_sock(sk);
+	rtnl_unlock();
+
+	if (error)
+		log_err("Cannot join the joold multicast group (errcode %d).",
+				error);
+	return error;
+}
+
+static void init_dst(struct joold_udp *udp, struct joold_udp_config *config)
+{
+	memset(&udp->dst, 0, sizeof(udp->dst));
+
+	if (config->family == AF_INET) {
+		udp->dst.v4.sin_family = AF_INET;
+		udp->dst.v4.sin_addr = config->addr.v4;
+		udp->dst.v4.sin_port = htons(config->port);
+		udp->dst_len = sizeof(udp->dst.v4);
+	} else {
+		udp->dst.v6.sin6_family = AF_INET6;
+		udp->dst.v6.sin6_addr = config->addr.v6;
+		udp->dst.v6.sin6_port = htons(config->port);
+		udp->dst.v6.sin6_scope_id = config->out_ifindex;
+		udp->dst_len = sizeof(udp->dst.v6);
+	}
+}
+
+/**
+ * joold_udp_create - Opens a UDP socket in @jool's namespace, through which
+ * @jool's sessions will be exchanged with its peers.
+ *
+ * Must be called in process context.
+ */
+struct joold_udp *joold_udp_create(struct xlator *jool,
+		struct joold_udp_config *config)
+{
+	struct joold_udp *udp;
+	struct udp_port_cfg port_cfg;
+	struct udp_tunnel_sock_cfg tunnel_cfg;
+	int error;
+
+	udp = wkmalloc(struct joold_udp, GFP_KERNEL);
+	if (!udp)
+		return ERR_PTR(-ENOMEM);
+
+	memset(&port_cfg, 0, sizeof(port_cfg));
+	port_cfg.family = config->family;
+	port_cfg.local_udp_port = htons(config->port);
+	if (config->family == AF_INET6)
+		port_cfg.ipv6_v6only = 1;
+
+	error = udp_sock_create(jool->ns, &port_cfg, &udp->sock);
+	if (error) {
+		log_err("Cannot create the joold socket (errcode %d).", error);
+		goto free_udp;
+	}
+
+	error = adjust_mcast_opts(udp->sock, config);
+	if (error)
+		goto release_sock;
+
+	init_dst(udp, config);
+	udp->flags = jool->flags;
+	memcpy(udp->iname, jool->iname, INAME_MAX_SIZE);
+	skb_queue_head_init(&udp->pending);
+	INIT_WORK(&udp->work, send_pending);
+
+	memset(&tunnel_cfg, 0, sizeof(tunnel_cfg));
+	tunnel_cfg.sk_user_data = udp;
+	tunnel_cfg.encap_type = 1;
+	tunnel_cfg.encap_rcv = joold_udp_rcv;
+	setup_udp_tunnel_sock(jool->ns, udp->sock, &tunnel_cfg);
+
+	return udp;
+
+release_sock:
+	udp_tunnel_sock_release(udp->sock);
+free_udp:
+	wkfree(struct joold_udp, udp);
+	return ERR_PTR(error);
+}
+
+/**
+ * joold_udp_destroy - Reverts joold_udp_create().
+ *
+ * Must be called in process context, after @udp stopped being reachable by
+ * joold_udp_send() callers.
+ */
+void joold_udp_destroy(struct joold_udp *udp)
+{
+	cancel_work_sync(&udp->work);
+	skb_queue_purge(&udp->pending);
+	udp_tunnel_sock_release(udp->sock);
+	/* Wait for ongoing joold_udp_rcv()s. */
+	synchronize_rcu();
+	wkfree(struct joold_udp, udp);
+}
+
+/**
+ * joold_udp_send - Sends @skb's sessions to the peers.
+ *
+ * @skb is a finished joold Netlink message, and @root is its session container.
+ * Takes ownership of @skb. Can be called in atomic context.
+ */
+void joold_udp_send(struct joold_udp *udp, struct sk_buff *skb,
+		struct nlattr *root)
+{
+	/* Leave nothing but the payload. */
+	skb_pull(skb, (unsigned char *)nla_data(root) - skb->data);
+	skb_trim(skb, nla_len(root));
+
+	if (skb_queue_len(&udp->pending) >= MAX_PENDING) {
+		log_warn_once("joold: Too many packets waiting to be sent; dropping.");
+		kfree_skb(skb);
+		return;
+	}
+
+	skb_queue_tail(&udp->pending, skb);
+	schedule_work(&udp->work);
+}
+
+/**
+ * joold_udp_kick - Asks @udp's worker to call joold_clean() soon, so the queued
+ * advertisements move along without waiting for the timer.
+ *
+ * Can be called in atomic context.
+ */
+void joold_udp_kick(struct joold_udp *udp)
+{
+	schedule_work(&udp->work);
+}
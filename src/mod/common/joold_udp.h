@@ -0,0 +1,48 @@
+#ifndef SRC_MOD_COMMON_JOOLD_UDP_H_
+#define SRC_MOD_COMMON_JOOLD_UDP_H_
+
+/**
+ * @file
+ * Optional in-kernel network side of joold.
+ *
+ * By default, joold packets travel kernel -> Netlink multicast -> joold daemon
+ * -> UDP socket (and the other way around). When this transport is active,
+ * the kernel module exchanges them with its peers through a kernel UDP socket
+ * instead, and the daemon is only needed to configure it.
+ *
+ * The payload is the same in both cases (the contents of the
+ * JNLAR_SESSION_ENTRIES container), so the two modes interoperate.
+ */
+
+#include <linux/in6.h>
+#include "mod/common/xlator.h"
+
+struct joold_udp;
+
+struct joold_udp_config {
+	/** AF_INET or AF_INET6. */
+	int family;
+	/** Address where the sessions will be advertised. */
+	union {
+		struct in_addr v4;
+		struct in6_addr v6;
+	} addr;
+	/** UDP port where the sessions will be advertised. */
+	__u16 port;
+	/** Interface where the traffic is expected. 0 means "any." */
+	int in_ifindex;
+	/** Interface where the traffic will be sent. 0 means "route." */
+	int out_ifindex;
+	/** Multicast TTL/hop limit. Negative means "kernel default." */
+	int ttl;
+};
+
+struct joold_udp *joold_udp_create(struct xlator *jool,
+		struct joold_udp_config *config);
+void joold_udp_destroy(struct joold_udp *udp);
+
+void joold_udp_send(struct joold_udp *udp, struct sk_buff *skb,
+		struct nlattr *root);
+void joold_udp_kick(struct joold_udp *udp);
+
+#endif /* SRC_MOD_COMMON_JOOLD_UDP_H_ */
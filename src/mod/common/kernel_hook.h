@@ -13,6 +13,10 @@ unsigned int hook_ipv6(void *priv, struct sk_buff *skb,
 		const struct nf_hook_state *nhs);
 unsigned int hook_ipv4(void *priv, struct sk_buff *skb,
 		const struct nf_hook_state *nhs);
+unsigned int hook_ipv6_frag(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs);
+unsigned int hook_ipv4_frag(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs);
 
 #ifndef XTABLES_DISABLED
 
@@ -106,3 +106,69 @@ end:	xlation_destroy(state);
 	return verdict2netfilter(result, enable_debug);
 }
 EXPORT_SYMBOL_GPL(hook_ipv4);
+
+/*
+ * The fragment hooks run before the kernel's defragmenter. If the namespace's
+ * instance is a NAT64 that tracks fragments, they translate fragments right
+ * away, so the defragmenter never gets to queue them.
+ * (Otherwise they let them through, and the regular hooks will see the
+ * reassembled packet.)
+ */
+static unsigned int hook_frag(struct sk_buff *skb,
+		verdict (*core_fn)(struct sk_buff *, struct xlation *))
+{
+	struct xlation *state;
+	verdict result;
+	bool enable_debug = false;
+
+	/* Don't build the translation state for nothing. */
+	if (!xlator_tracks_frags(dev_net(skb->dev)))
+		return NF_ACCEPT;
+
+	state = xlation_create(NULL);
+	if (!state)
+		return NF_DROP;
+
+	result = find_instance(skb, &state->jool);
+	if (result != VERDICT_CONTINUE)
+		goto end;
+
+	if (xlation_is_nat64(state) && state->jool.globals.nat64.frag_tracking) {
+		enable_debug = state->jool.globals.debug;
+		result = core_fn(skb, state);
+	} else {
+		result = VERDICT_UNTRANSLATABLE;
+	}
+
+	xlator_put(&state->jool);
+end:	xlation_destroy(state);
+	return verdict2netfilter(result, enable_debug);
+}
+
+static bool is_fragment6(struct sk_buff *skb)
+{
+	unsigned int offset = 0;
+	__u8 nexthdr;
+
+	nexthdr = ipv6_hdr(skb)->nexthdr;
+	if (nexthdr == NEXTHDR_FRAGMENT)
+		return true;
+	if (!ipv6_ext_hdr(nexthdr))
+		return false;
+
+	return ipv6_find_hdr(skb, &offset, NEXTHDR_FRAGMENT, NULL, NULL) >= 0;
+}
+
+unsigned int hook_ipv6_frag(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs)
+{
+	return is_fragment6(skb) ? hook_frag(skb, core_6to4) : NF_ACCEPT;
+}
+EXPORT_SYMBOL_GPL(hook_ipv6_frag);
+
+unsigned int hook_ipv4_frag(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs)
+{
+	return ip_is_fragment(ip_hdr(skb)) ? hook_frag(skb, core_4to6) : NF_ACCEPT;
+}
+EXPORT_SYMBOL_GPL(hook_ipv4_frag);
@@ -2,6 +2,7 @@
 
 #include <linux/sort.h>
 #include "common/constants.h"
+#include "mod/common/address.h"
 #include "mod/common/log.h"
 
 static int validate_null(struct nlattr *attr, char const *name)
@@ -430,11 +431,157 @@ int jnla_get_session(struct nlattr *attr, char const *name,
 		expiration = msecs_to_jiffies(nla_get_u32(attrs[JNLASE_EXPIRATION]));
 		entry->update_time = jiffies + expiration - entry->timeout;
 	}
+	if (attrs[JNLASE_IDLE]) {
+		entry->update_time = jiffies
+				- msecs_to_jiffies(nla_get_u32(attrs[JNLASE_IDLE]));
+	}
+	entry->creation_time = jiffies;
+	if (attrs[JNLASE_AGE]) {
+		entry->creation_time -= msecs_to_jiffies(
+				nla_get_u32(attrs[JNLASE_AGE]));
+	}
 	entry->has_stored = false;
 
 	return 0;
 }
 
+int jnla_get_digest(struct nlattr *attr, char const *name,
+		struct session_digest *digest)
+{
+	struct nlattr *attrs[JNLADG_COUNT];
+	__u8 proto;
+	int error;
+
+	error = validate_null(attr, name);
+	if (error)
+		return error;
+
+	error = jnla_parse_nested(attrs, JNLADG_MAX, attr,
+			joolnl_digest_policy, name);
+	if (error)
+		return error;
+
+	memset(digest, 0, sizeof(*digest));
+
+	error = jnla_get_u8(attrs[JNLADG_PROTO], "Digest protocol", &proto);
+	if (error)
+		return error;
+	digest->proto = proto;
+	error = jnla_get_taddr4(attrs[JNLADG_START_SRC],
+			"Digest start source", &digest->start.offset.src);
+	if (error)
+		return error;
+	error = jnla_get_taddr4(attrs[JNLADG_START_DST],
+			"Digest start destination", &digest->start.offset.dst);
+	if (error)
+		return error;
+	error = jnla_get_taddr4(attrs[JNLADG_END_SRC],
+			"Digest end source", &digest->end.src);
+	if (error)
+		return error;
+	error = jnla_get_taddr4(attrs[JNLADG_END_DST],
+			"Digest end destination", &digest->end.dst);
+	if (error)
+		return error;
+
+	if (attrs[JNLADG_START_INCLUDE])
+		digest->start.include_offset = nla_get_u8(attrs[JNLADG_START_INCLUDE]);
+	if (attrs[JNLADG_SESSIONS])
+		digest->count = nla_get_u32(attrs[JNLADG_SESSIONS]);
+	if (attrs[JNLADG_HASH])
+		digest->hash = nla_get_u32(attrs[JNLADG_HASH]);
+
+	return 0;
+}
+
+static int get_filter_prefix6(struct nlattr *attr, char const *name,
+		struct config_prefix6 *out)
+{
+	int error;
+
+	if (!attr) {
+		out->set = false;
+		return 0;
+	}
+
+	error = jnla_get_prefix6(attr, name, &out->prefix);
+	if (error)
+		return error;
+	out->set = true;
+	return prefix6_validate(&out->prefix);
+}
+
+static int get_filter_prefix4(struct nlattr *attr, char const *name,
+		struct config_prefix4 *out)
+{
+	int error;
+
+	if (!attr) {
+		out->set = false;
+		return 0;
+	}
+
+	error = jnla_get_prefix4(attr, name, &out->prefix);
+	if (error)
+		return error;
+	out->set = true;
+	return prefix4_validate(&out->prefix);
+}
+
+int jnla_get_filter(struct nlattr *attr, char const *name,
+		struct table_filter *filter)
+{
+	struct nlattr *attrs[JNLAFI_COUNT];
+	int error;
+
+	error = validate_null(attr, name);
+	if (error)
+		return error;
+
+	error = jnla_parse_nested(attrs, JNLAFI_MAX, attr,
+			joolnl_filter_policy, name);
+	if (error)
+		return error;
+
+	memset(filter, 0, sizeof(*filter));
+
+	error = get_filter_prefix6(attrs[JNLAFI_SRC6], "IPv6 source prefix",
+			&filter->src6);
+	if (error)
+		return error;
+	error = get_filter_prefix4(attrs[JNLAFI_SRC4], "IPv4 source prefix",
+			&filter->src4);
+	if (error)
+		return error;
+	error = get_filter_prefix4(attrs[JNLAFI_DST4],
+			"IPv4 destination prefix", &filter->dst4);
+	if (error)
+		return error;
+
+	if (attrs[JNLAFI_PORT_MIN] || attrs[JNLAFI_PORT_MAX]) {
+		filter->ports_set = true;
+		filter->port_min = attrs[JNLAFI_PORT_MIN]
+				? nla_get_u16(attrs[JNLAFI_PORT_MIN]) : 0;
+		filter->port_max = attrs[JNLAFI_PORT_MAX]
+				? nla_get_u16(attrs[JNLAFI_PORT_MAX]) : 65535;
+		if (filter->port_min > filter->port_max) {
+			log_err("Malformed %s: Port range %u-%u is inverted.",
+					name, filter->port_min,
+					filter->port_max);
+			return -EINVAL;
+		}
+	}
+
+	if (attrs[JNLAFI_STATE]) {
+		filter->state_set = true;
+		filter->state = nla_get_u8(attrs[JNLAFI_STATE]);
+	}
+	if (attrs[JNLAFI_MIN_AGE])
+		filter->min_age = nla_get_u32(attrs[JNLAFI_MIN_AGE]);
+
+	return 0;
+}
+
 static int u16_compare(const void *a, const void *b)
 {
 	return *(__u16 *)b - *(__u16 *)a;
@@ -706,11 +853,34 @@ int jnla_put_bib(struct sk_buff *skb, int attrtype, struct bib_entry const *bib)
 	return 0;
 }
 
+int jnla_put_subscriber(struct sk_buff *skb, int attrtype,
+		struct subscriber_entry const *subscriber)
+{
+	struct nlattr *root;
+	int error;
+
+	root = nla_nest_start(skb, attrtype);
+	if (!root)
+		return -EMSGSIZE;
+
+	error = jnla_put_prefix6(skb, JNLASU_PREFIX, &subscriber->prefix)
+		|| nla_put_u32(skb, JNLASU_BIBS, subscriber->bibs)
+		|| nla_put_u32(skb, JNLASU_SESSIONS, subscriber->sessions);
+	if (error) {
+		nla_nest_cancel(skb, root);
+		return -EMSGSIZE;
+	}
+
+	nla_nest_end(skb, root);
+	return 0;
+}
+
 int jnla_put_session(struct sk_buff *skb, int attrtype,
 		struct session_entry const *entry)
 {
 	struct nlattr *root;
 	unsigned long dying_time;
+	unsigned long age;
 	int error;
 
 	root = nla_nest_start(skb, attrtype);
@@ -723,6 +893,9 @@ int jnla_put_session(struct sk_buff *skb, int attrtype,
 			: 0;
 	if (dying_time > MAX_U32)
 		dying_time = MAX_U32;
+	age = jiffies_to_msecs(jiffies - entry->creation_time);
+	if (age > MAX_U32)
+		age = MAX_U32;
 
 	error = jnla_put_taddr6(skb, JNLASE_SRC6, &entry->src6)
 		|| jnla_put_taddr6(skb, JNLASE_DST6, &entry->dst6)
@@ -731,7 +904,41 @@ int jnla_put_session(struct sk_buff *skb, int attrtype,
 		|| nla_put_u8(skb, JNLASE_PROTO, entry->proto)
 		|| nla_put_u8(skb, JNLASE_STATE, entry->state)
 		|| nla_put_u8(skb, JNLASE_TIMER, entry->timer_type)
-		|| nla_put_u32(skb, JNLASE_EXPIRATION, dying_time);
+		|| nla_put_u32(skb, JNLASE_EXPIRATION, dying_time)
+		|| nla_put_u32(skb, JNLASE_AGE, age);
+	if (error) {
+		nla_nest_cancel(skb, root);
+		return error;
+	}
+
+	nla_nest_end(skb, root);
+	return 0;
+}
+
+/*
+ * JNLAL_RANGE elements don't need the count and hash; set @summary to false to
+ * skip them.
+ */
+int jnla_put_digest(struct sk_buff *skb, int attrtype,
+		struct session_digest const *digest, bool summary)
+{
+	struct nlattr *root;
+	int error;
+
+	root = nla_nest_start(skb, attrtype);
+	if (!root)
+		return -EMSGSIZE;
+
+	error = nla_put_u8(skb, JNLADG_PROTO, digest->proto)
+		|| jnla_put_taddr4(skb, JNLADG_START_SRC, &digest->start.offset.src)
+		|| jnla_put_taddr4(skb, JNLADG_START_DST, &digest->start.offset.dst)
+		|| nla_put_u8(skb, JNLADG_START_INCLUDE, digest->start.include_offset)
+		|| jnla_put_taddr4(skb, JNLADG_END_SRC, &digest->end.src)
+		|| jnla_put_taddr4(skb, JNLADG_END_DST, &digest->end.dst);
+	if (!error && summary) {
+		error = nla_put_u32(skb, JNLADG_SESSIONS, digest->count)
+			|| nla_put_u32(skb, JNLADG_HASH, digest->hash);
+	}
 	if (error) {
 		nla_nest_cancel(skb, root);
 		return error;
@@ -764,6 +971,21 @@ int jnla_put_plateaus(struct sk_buff *skb, int attrtype,
 	return 0;
 }
 
+/* Returns the number of JNLAL_ENTRY attributes nested in @root. */
+unsigned int jnla_count_entries(struct nlattr *root)
+{
+	struct nlattr *attr;
+	unsigned int count;
+	int rem;
+
+	count = 0;
+	nla_for_each_nested(attr, root, rem)
+		if (nla_type(attr) == JNLAL_ENTRY)
+			count++;
+
+	return count;
+}
+
 int jnla_parse_nested(struct nlattr *tb[], int maxtype,
 		const struct nlattr *nla, const struct nla_policy *policy,
 		char const *name)
@@ -21,6 +21,8 @@ int jnla_get_eam(struct nlattr *attr, char const *name, struct eamt_entry *eam);
 int jnla_get_pool4(struct nlattr *attr, char const *name, struct pool4_entry *entry);
 int jnla_get_bib(struct nlattr *attr, char const *name, struct bib_entry *entry);
 int jnla_get_session(struct nlattr *attr, char const *name, struct bib_config *config, struct session_entry *entry);
+int jnla_get_digest(struct nlattr *attr, char const *name, struct session_digest *digest);
+int jnla_get_filter(struct nlattr *attr, char const *name, struct table_filter *filter);
 int jnla_get_plateaus(struct nlattr *attr, struct mtu_plateaus *out);
 
 /* Note: None of these print error messages. */
@@ -33,9 +35,12 @@ int jnla_put_taddr4(struct sk_buff *skb, int attrtype, struct ipv4_transport_add
 int jnla_put_eam(struct sk_buff *skb, int attrtype, struct eamt_entry const *eam);
 int jnla_put_pool4(struct sk_buff *skb, int attrtype, struct pool4_entry const *bib);
 int jnla_put_bib(struct sk_buff *skb, int attrtype, struct bib_entry const *bib);
+int jnla_put_subscriber(struct sk_buff *skb, int attrtype, struct subscriber_entry const *subscriber);
 int jnla_put_session(struct sk_buff *skb, int attrtype, struct session_entry const *entry);
+int jnla_put_digest(struct sk_buff *skb, int attrtype, struct session_digest const *digest, bool summary);
 int jnla_put_plateaus(struct sk_buff *skb, int attrtype, struct mtu_plateaus const *plateaus);
 
+unsigned int jnla_count_entries(struct nlattr *root);
 int jnla_parse_nested(struct nlattr *tb[], int maxtype,
 		const struct nlattr *nla, const struct nla_policy *policy,
 		char const *name);
@@ -1,10 +1,13 @@
 #include "mod/common/nl/bib.h"
 
+#include "common/constants.h"
 #include "mod/common/log.h"
+#include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
 #include "mod/common/nl/nl_core.h"
+#include "mod/common/db/flowcache.h"
 #include "mod/common/db/pool4/db.h"
 #include "mod/common/db/bib/db.h"
 
@@ -13,11 +16,28 @@ static int serialize_bib_entry(struct bib_entry const *entry, void *arg)
 	return jnla_put_bib(arg, JNLAL_ENTRY, entry) ? 1 : 0;
 }
 
+static int get_filter(struct nlattr *attr, struct table_filter *filter)
+{
+	int error;
+
+	error = jnla_get_filter(attr, "BIB filter", filter);
+	if (error)
+		return error;
+
+	if (filter->dst4.set || filter->state_set || filter->min_age) {
+		log_err("BIB entries can only be filtered by IPv6 prefix, IPv4 prefix and port range.");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 int handle_bib_foreach(struct sk_buff *skb, struct genl_info *info)
 {
 	struct xlator jool;
 	struct jool_response response;
 	struct bib_entry offset, *offset_ptr;
+	struct table_filter filter, *filter_ptr;
 	int error;
 
 	error = request_handle_start(info, XT_NAT64, &jool, true);
@@ -48,9 +68,124 @@ int handle_bib_foreach(struct sk_buff *skb, struct genl_info *info)
 		goto revert_response;
 	}
 
-	error = bib_foreach(jool.nat64.bib, offset.l4_proto, serialize_bib_entry,
-			response.skb, offset_ptr ? &offset_ptr->addr4 : NULL);
+	if (info->attrs[JNLAR_FILTER]) {
+		error = get_filter(info->attrs[JNLAR_FILTER], &filter);
+		if (error)
+			goto revert_response;
+		filter_ptr = &filter;
+	} else {
+		filter_ptr = NULL;
+	}
+
+	error = bib_foreach_filtered(jool.nat64.bib, offset.l4_proto,
+			filter_ptr, serialize_bib_entry, response.skb,
+			offset_ptr);
+
+	error = jresponse_send_array(&jool, &response, error);
+	if (error)
+		goto revert_response;
+
+	request_handle_end(&jool);
+	return 0;
+
+revert_response:
+	jresponse_cleanup(&response);
+revert_start:
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
+
+static int serialize_subscriber(struct subscriber_entry const *entry,
+		void *arg)
+{
+	return jnla_put_subscriber(arg, JNLAL_ENTRY, entry) ? 1 : 0;
+}
+
+static int top_subscribers(struct xlator *jool, l4_protocol proto,
+		unsigned int max, struct sk_buff *skb)
+{
+	struct subscriber_entry *top;
+	unsigned int count;
+	unsigned int i;
+	int error;
+
+	if (max > SUBSCRIBER_TOP_MAX) {
+		log_err("Cannot print more than %u top subscribers.",
+				SUBSCRIBER_TOP_MAX);
+		return -EINVAL;
+	}
+
+	top = __wkmalloc("Top subscribers", max * sizeof(*top), GFP_KERNEL);
+	if (!top)
+		return -ENOMEM;
+
+	error = bib_top_subscribers(jool, proto, top, max, &count);
+	if (error)
+		goto end;
+
+	for (i = 0; i < count; i++) {
+		if (jnla_put_subscriber(skb, JNLAL_ENTRY, &top[i])) {
+			/* SUBSCRIBER_TOP_MAX is supposed to prevent this. */
+			report_put_failure();
+			error = -EINVAL;
+			break;
+		}
+	}
+
+end:
+	__wkfree("Top subscribers", top);
+	return error;
+}
+
+int handle_subscriber_foreach(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	struct jool_response response;
+	struct ipv6_prefix offset, *offset_ptr;
+	l4_protocol proto;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, true);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Sending subscribers to userspace.");
+
+	error = jresponse_init(&response, info);
+	if (error)
+		goto revert_start;
+
+	if (!info->attrs[JNLAR_PROTO]) {
+		log_err("The request is missing a protocol.");
+		error = -EINVAL;
+		goto revert_response;
+	}
+	proto = nla_get_u8(info->attrs[JNLAR_PROTO]);
+
+	if (info->attrs[JNLAR_TOP]) {
+		error = top_subscribers(&jool, proto,
+				nla_get_u16(info->attrs[JNLAR_TOP]),
+				response.skb);
+		goto send;
+	}
+
+	if (info->attrs[JNLAR_OFFSET]) {
+		error = jnla_get_prefix6(info->attrs[JNLAR_OFFSET],
+				"Iteration offset", &offset);
+		if (error)
+			goto revert_response;
+		offset_ptr = &offset;
+		__log_debug(&jool, "Offset: [%pI6c/%u]", &offset.addr,
+				offset.len);
+	} else {
+		offset_ptr = NULL;
+	}
+
+	error = bib_foreach_subscriber(&jool, proto, serialize_subscriber,
+			response.skb, offset_ptr);
 
+send:
 	error = jresponse_send_array(&jool, &response, error);
 	if (error)
 		goto revert_response;
@@ -66,6 +201,57 @@ revert_start:
 	return error;
 }
 
+static int handle_bib_add_bulk(struct xlator *jool, struct genl_info *info)
+{
+	struct nlattr *root = info->attrs[JNLAR_BIB_ENTRIES];
+	struct nlattr *attr;
+	struct bib_entry *entries;
+	int *errors;
+	unsigned int count;
+	unsigned int i;
+	int rem;
+	int error;
+
+	count = jnla_count_entries(root);
+	__log_debug(jool, "Adding BIB entries in bulk. (%u)", count);
+
+	entries = __wkvmalloc_array("BIB bulk", count, sizeof(*entries),
+			GFP_KERNEL);
+	if (!entries)
+		return jresponse_send_simple(jool, info, -ENOMEM);
+	errors = __wkvmalloc_array("Bulk errors", count, sizeof(*errors),
+			GFP_KERNEL);
+	if (!errors) {
+		error = jresponse_send_simple(jool, info, -ENOMEM);
+		goto end;
+	}
+
+	i = 0;
+	nla_for_each_nested(attr, root, rem) {
+		if (nla_type(attr) != JNLAL_ENTRY)
+			continue;
+		errors[i] = jnla_get_bib(attr, "BIB entry", &entries[i]);
+		if (!errors[i] && !pool4db_contains(jool->nat64.pool4, jool->ns,
+				entries[i].l4_proto, &entries[i].addr4)) {
+			log_err("The transport address '%pI4#%u' does not belong to pool4.",
+					&entries[i].addr4.l3, entries[i].addr4.l4);
+			errors[i] = -EINVAL;
+		}
+		i++;
+	}
+
+	bib_add_static_bulk(jool, entries, count, errors);
+
+	error = jresponse_send_bulk(jool, info, errors, count);
+	if (error)
+		error = jresponse_send_simple(jool, info, error);
+
+	__wkvfree("Bulk errors", errors);
+end:
+	__wkvfree("BIB bulk", entries);
+	return error;
+}
+
 int handle_bib_add(struct sk_buff *skb, struct genl_info *info)
 {
 	struct xlator jool;
@@ -76,6 +262,12 @@ int handle_bib_add(struct sk_buff *skb, struct genl_info *info)
 	if (error)
 		return jresponse_send_simple(NULL, info, error);
 
+	if (info->attrs[JNLAR_BIB_ENTRIES]) {
+		error = handle_bib_add_bulk(&jool, info);
+		request_handle_end(&jool);
+		return error;
+	}
+
 	__log_debug(&jool, "Adding BIB entry.");
 
 	error = jnla_get_bib(info->attrs[JNLAR_OPERAND], "Operand", &new);
@@ -153,6 +345,7 @@ int handle_bib_rm(struct sk_buff *skb, struct genl_info *info)
 	error = bib_rm(&jool, &entry);
 	if (error == -ESRCH)
 		goto esrch;
+	flowcache_flush(jool.nat64.flows);
 	/* Fall through */
 
 revert_start:
@@ -6,5 +6,6 @@
 int handle_bib_foreach(struct sk_buff *skb, struct genl_info *info);
 int handle_bib_add(struct sk_buff *skb, struct genl_info *info);
 int handle_bib_rm(struct sk_buff *skb, struct genl_info *info);
+int handle_subscriber_foreach(struct sk_buff *skb, struct genl_info *info);
 
 #endif /* SRC_MOD_COMMON_NL */
@@ -2,6 +2,7 @@
 
 #include "common/types.h"
 #include "mod/common/log.h"
+#include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
@@ -59,6 +60,52 @@ revert_start:
 	return error;
 }
 
+static int handle_denylist4_add_bulk(struct xlator *jool, struct genl_info *info)
+{
+	struct nlattr *root = info->attrs[JNLAR_BL4_ENTRIES];
+	struct nlattr *attr;
+	struct ipv4_prefix *entries;
+	int *errors;
+	unsigned int count;
+	unsigned int i;
+	int rem;
+	int error;
+
+	count = jnla_count_entries(root);
+	__log_debug(jool, "Adding denylist4 entries in bulk. (%u)", count);
+
+	entries = __wkvmalloc_array("Denylist4 bulk", count, sizeof(*entries),
+			GFP_KERNEL);
+	if (!entries)
+		return jresponse_send_simple(jool, info, -ENOMEM);
+	errors = __wkvmalloc_array("Bulk errors", count, sizeof(*errors),
+			GFP_KERNEL);
+	if (!errors) {
+		error = jresponse_send_simple(jool, info, -ENOMEM);
+		goto end;
+	}
+
+	i = 0;
+	nla_for_each_nested(attr, root, rem) {
+		if (nla_type(attr) != JNLAL_ENTRY)
+			continue;
+		errors[i] = jnla_get_prefix4(attr, "Denylist4 entry", &entries[i]);
+		i++;
+	}
+
+	denylist4_add_bulk(jool->siit.denylist4, entries, count,
+			get_jool_hdr(info)->flags & JOOLNLHDR_FLAGS_FORCE, errors);
+
+	error = jresponse_send_bulk(jool, info, errors, count);
+	if (error)
+		error = jresponse_send_simple(jool, info, error);
+
+	__wkvfree("Bulk errors", errors);
+end:
+	__wkvfree("Denylist4 bulk", entries);
+	return error;
+}
+
 int handle_denylist4_add(struct sk_buff *skb, struct genl_info *info)
 {
 	struct xlator jool;
@@ -69,6 +116,12 @@ int handle_denylist4_add(struct sk_buff *skb, struct genl_info *info)
 	if (error)
 		return jresponse_send_simple(NULL, info, error);
 
+	if (info->attrs[JNLAR_BL4_ENTRIES]) {
+		error = handle_denylist4_add_bulk(&jool, info);
+		request_handle_end(&jool);
+		return error;
+	}
+
 	__log_debug(&jool, "Adding Denylist4 entry.");
 
 	error = jnla_get_prefix4(info->attrs[JNLAR_OPERAND], "Operand", &operand);
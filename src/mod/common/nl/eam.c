@@ -2,6 +2,7 @@
 
 #include "common/types.h"
 #include "mod/common/log.h"
+#include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
@@ -63,6 +64,52 @@ revert_start:
 	return error;
 }
 
+static int handle_eamt_add_bulk(struct xlator *jool, struct genl_info *info)
+{
+	struct nlattr *root = info->attrs[JNLAR_EAMT_ENTRIES];
+	struct nlattr *attr;
+	struct eamt_entry *entries;
+	int *errors;
+	unsigned int count;
+	unsigned int i;
+	int rem;
+	int error;
+
+	count = jnla_count_entries(root);
+	__log_debug(jool, "Adding EAM entries in bulk. (%u)", count);
+
+	entries = __wkvmalloc_array("EAMT bulk", count, sizeof(*entries),
+			GFP_KERNEL);
+	if (!entries)
+		return jresponse_send_simple(jool, info, -ENOMEM);
+	errors = __wkvmalloc_array("Bulk errors", count, sizeof(*errors),
+			GFP_KERNEL);
+	if (!errors) {
+		error = jresponse_send_simple(jool, info, -ENOMEM);
+		goto end;
+	}
+
+	i = 0;
+	nla_for_each_nested(attr, root, rem) {
+		if (nla_type(attr) != JNLAL_ENTRY)
+			continue;
+		errors[i] = jnla_get_eam(attr, "EAMT entry", &entries[i]);
+		i++;
+	}
+
+	eamt_add_bulk(jool->siit.eamt, entries, count,
+			get_jool_hdr(info)->flags & JOOLNLHDR_FLAGS_FORCE, errors);
+
+	error = jresponse_send_bulk(jool, info, errors, count);
+	if (error)
+		error = jresponse_send_simple(jool, info, error);
+
+	__wkvfree("Bulk errors", errors);
+end:
+	__wkvfree("EAMT bulk", entries);
+	return error;
+}
+
 int handle_eamt_add(struct sk_buff *skb, struct genl_info *info)
 {
 	struct xlator jool;
@@ -73,6 +120,12 @@ int handle_eamt_add(struct sk_buff *skb, struct genl_info *info)
 	if (error)
 		return jresponse_send_simple(NULL, info, error);
 
+	if (info->attrs[JNLAR_EAMT_ENTRIES]) {
+		error = handle_eamt_add_bulk(&jool, info);
+		request_handle_end(&jool);
+		return error;
+	}
+
 	__log_debug(&jool, "Adding EAM entry.");
 
 	error = jnla_get_eam(info->attrs[JNLAR_OPERAND], "Operand", &addend);
@@ -131,6 +131,20 @@ revert_start:
 	return error;
 }
 
+/* The quotas are per subscriber, so they need subscribers. */
+static int validate_subscriber_quotas(struct jool_globals *cfg)
+{
+	struct bib_config *bib = &cfg->nat64.bib;
+
+	if (bib->subscriber_prefix_len)
+		return 0;
+	if (!bib->subscriber_max_bibs && !bib->subscriber_max_sessions)
+		return 0;
+
+	log_err("subscriber-max-bibs and subscriber-max-sessions need a nonzero subscriber-prefix-len.");
+	return -EINVAL;
+}
+
 int global_update(struct jool_globals *cfg, xlator_type xt, bool force,
 		struct nlattr *root)
 {
@@ -170,5 +184,5 @@ int global_update(struct jool_globals *cfg, xlator_type xt, bool force,
 			return error;
 	}
 
-	return 0;
+	return (xt == XT_NAT64) ? validate_subscriber_quotas(cfg) : 0;
 }
@@ -1,6 +1,7 @@
 #include "mod/common/nl/joold.h"
 
 #include "mod/common/log.h"
+#include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
 #include "mod/common/nl/nl_core.h"
 #include "mod/common/joold.h"
@@ -50,6 +51,23 @@ int handle_joold_advertise(struct sk_buff *skb, struct genl_info *info)
 	return error;
 }
 
+int handle_joold_resync(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, true);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Handling joold resync.");
+
+	error = joold_resync(&jool);
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
+
 int handle_joold_ack(struct sk_buff *skb, struct genl_info *info)
 {
 	struct xlator jool;
@@ -66,3 +84,76 @@ int handle_joold_ack(struct sk_buff *skb, struct genl_info *info)
 	request_handle_end(&jool);
 	return 0; /* Do not ack the ack. */
 }
+
+static int parse_socket(struct nlattr *root, struct joold_udp_config *config)
+{
+	struct nlattr *attrs[JNLAJS_COUNT];
+	struct nlattr *addr;
+	int error;
+
+	error = jnla_parse_nested(attrs, JNLAJS_MAX, root,
+			joolnl_joold_socket_policy, "joold socket");
+	if (error)
+		return error;
+
+	memset(config, 0, sizeof(*config));
+
+	addr = attrs[JNLAJS_ADDR];
+	if (!addr || !attrs[JNLAJS_PORT]) {
+		log_err("The joold socket lacks an address or port.");
+		return -EINVAL;
+	}
+
+	switch (nla_len(addr)) {
+	case sizeof(struct in_addr):
+		config->family = AF_INET;
+		error = jnla_get_addr4(addr, "joold address", &config->addr.v4);
+		break;
+	case sizeof(struct in6_addr):
+		config->family = AF_INET6;
+		error = jnla_get_addr6(addr, "joold address", &config->addr.v6);
+		break;
+	default:
+		log_err("The joold address has an invalid length: %d",
+				nla_len(addr));
+		return -EINVAL;
+	}
+	if (error)
+		return error;
+
+	config->port = nla_get_u16(attrs[JNLAJS_PORT]);
+	if (attrs[JNLAJS_IN_IFINDEX])
+		config->in_ifindex = nla_get_u32(attrs[JNLAJS_IN_IFINDEX]);
+	if (attrs[JNLAJS_OUT_IFINDEX])
+		config->out_ifindex = nla_get_u32(attrs[JNLAJS_OUT_IFINDEX]);
+	config->ttl = attrs[JNLAJS_TTL] ? nla_get_u8(attrs[JNLAJS_TTL]) : -1;
+
+	return 0;
+}
+
+int handle_joold_transport(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	struct joold_udp_config config;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, true);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Handling joold transport.");
+
+	if (info->attrs[JNLAR_OPERAND]) {
+		error = parse_socket(info->attrs[JNLAR_OPERAND], &config);
+		if (error)
+			goto end;
+		error = joold_set_transport(&jool, &config);
+	} else {
+		error = joold_set_transport(&jool, NULL);
+	}
+
+end:
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
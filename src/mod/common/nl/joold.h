@@ -6,6 +6,8 @@
 
 int handle_joold_add(struct sk_buff *skb, struct genl_info *info);
 int handle_joold_advertise(struct sk_buff *skb, struct genl_info *info);
+int handle_joold_resync(struct sk_buff *skb, struct genl_info *info);
+int handle_joold_transport(struct sk_buff *skb, struct genl_info *info);
 int handle_joold_ack(struct sk_buff *skb, struct genl_info *info);
 
 #endif /* SRC_MOD_COMMON_NL_JOOLD_H_ */
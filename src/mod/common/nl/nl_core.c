@@ -21,10 +21,11 @@
  * the error message (via log_err()) to userspace is a fairly lost cause.
  */
 
-int jresponse_init(struct jool_response *response, struct genl_info *info)
+static int __jresponse_init(struct jool_response *response,
+		struct genl_info *info, size_t size)
 {
 	response->info = info;
-	response->skb = genlmsg_new(GENLMSG_DEFAULT_SIZE, GFP_KERNEL);
+	response->skb = genlmsg_new(size, GFP_KERNEL);
 	if (!response->skb) {
 		pr_err("genlmsg_new() failed.\n");
 		return -ENOMEM;
@@ -43,6 +44,11 @@ int jresponse_init(struct jool_response *response, struct genl_info *info)
 	return 0;
 }
 
+int jresponse_init(struct jool_response *response, struct genl_info *info)
+{
+	return __jresponse_init(response, info, GENLMSG_DEFAULT_SIZE);
+}
+
 /* Swallows @response. */
 int jresponse_send(struct jool_response *response)
 {
@@ -148,3 +154,103 @@ revert_msg:
 	return error;
 }
 
+
+/* Maximum number of error pool bytes a bulk response will carry. */
+#define BULK_LOG_MAX 4096
+
+static size_t bulk_response_size(int const *errors, unsigned int count,
+		size_t log_len)
+{
+	size_t size;
+	unsigned int i;
+
+	size = sizeof(struct joolnlhdr) + nla_total_size(0);
+	for (i = 0; i < count; i++)
+		if (errors[i])
+			size += nla_total_size(0) + nla_total_size(sizeof(__u32))
+					+ nla_total_size(sizeof(__u16));
+
+	return size + nla_total_size(log_len);
+}
+
+static int put_bulk_failure(struct sk_buff *skb, unsigned int index, int code)
+{
+	struct nlattr *root;
+
+	if (code < 0)
+		code = abs(code);
+	else if (code > MAX_U16)
+		code = MAX_U16;
+
+	root = nla_nest_start(skb, JNLAL_ENTRY);
+	if (!root)
+		return -EMSGSIZE;
+
+	if (nla_put_u32(skb, JNLABF_INDEX, index)
+			|| nla_put_u16(skb, JNLABF_CODE, code)) {
+		nla_nest_cancel(skb, root);
+		return -EMSGSIZE;
+	}
+
+	nla_nest_end(skb, root);
+	return 0;
+}
+
+/**
+ * Answers a bulk add request. @errors contains the result of each of the
+ * request's @count entries; the nonzero ones are reported as failures, along
+ * with whatever was log_err()'d while handling the request.
+ */
+int jresponse_send_bulk(struct xlator *jool, struct genl_info *info,
+		int const *errors, unsigned int count)
+{
+	struct jool_response response;
+	struct nlattr *root;
+	char *log;
+	size_t log_size;
+	unsigned int i;
+	unsigned int failures;
+	int error;
+
+	error = error_pool_get_message(&log, &log_size);
+	if (error)
+		return error; /* Error msg already printed. */
+	if (log_size > BULK_LOG_MAX) {
+		log[BULK_LOG_MAX - 1] = '\0';
+		log_size = BULK_LOG_MAX;
+	}
+
+	error = __jresponse_init(&response, info,
+			bulk_response_size(errors, count, log_size));
+	if (error)
+		goto revert_log;
+
+	root = nla_nest_start(response.skb, JNLAR_BULK_FAILURES);
+	if (!root)
+		goto too_small;
+
+	failures = 0;
+	for (i = 0; i < count; i++) {
+		if (!errors[i])
+			continue;
+		if (put_bulk_failure(response.skb, i, errors[i]))
+			goto too_small;
+		failures++;
+	}
+	nla_nest_end(response.skb, root);
+
+	if (log_size > 1 && nla_put_string(response.skb, JNLAR_BULK_LOG, log))
+		goto too_small;
+
+	__log_debug(jool, "Bulk add: %u/%u entries failed.", failures, count);
+	error = jresponse_send(&response);
+	goto revert_log;
+
+too_small:
+	pr_err("The bulk response does not fit in its packet. This is a bug.\n");
+	jresponse_cleanup(&response);
+	error = -EMSGSIZE;
+revert_log:
+	__wkfree("Error msg out", log);
+	return error;
+}
@@ -21,6 +21,8 @@ int jresponse_send_array(struct xlator *jool, struct jool_response *response,
 		int error);
 int jresponse_send_simple(struct xlator *jool, struct genl_info *info,
 		int error);
+int jresponse_send_bulk(struct xlator *jool, struct genl_info *info,
+		int const *errors, unsigned int count);
 
 
 #endif /* SRC_MOD_COMMON_NL_CORE_H_ */
@@ -49,6 +49,13 @@ static struct nla_policy const jool_policy[JNLAR_COUNT] = {
 	[JNLAR_PROTO] = { .type = NLA_U8 },
 	[JNLAR_ATOMIC_INIT] = { .type = NLA_U8 },
 	[JNLAR_ATOMIC_END] = { .type = NLA_BINARY, .len = 0 },
+	[JNLAR_BULK_FAILURES] = { .type = NLA_NESTED },
+	[JNLAR_BULK_LOG] = { .type = NLA_NUL_STRING },
+	[JNLAR_ATOMIC_INCREMENTAL] = { .type = NLA_FLAG },
+	[JNLAR_ATOMIC_RM] = { .type = NLA_NESTED },
+	[JNLAR_FILTER] = { .type = NLA_NESTED },
+	[JNLAR_TOP] = { .type = NLA_U16 },
+	[JNLAR_HISTOGRAM] = { .type = NLA_FLAG },
 };
 
 #if LINUX_VERSION_AT_LEAST(5, 2, 0, 8, 0)
@@ -178,12 +185,39 @@ static const struct genl_ops ops[] = {
 		.cmd = JNLOP_JOOLD_ACK,
 		.doit = handle_joold_ack,
 		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_JOOLD_RESYNC,
+		.doit = handle_joold_resync,
+		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_JOOLD_TRANSPORT,
+		.doit = handle_joold_transport,
+		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_SUBSCRIBER_FOREACH,
+		.doit = handle_subscriber_foreach,
+		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_SESSION_STATS,
+		.doit = handle_session_stats,
+		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_SESSION_ADD,
+		.doit = handle_session_add,
+		JOOL_POLICY
+	}, {
+		.cmd = JNLOP_SESSION_TOUCH,
+		.doit = handle_session_touch,
+		JOOL_POLICY
 	}
 };
 
+/* Careful; the groups are addressed by index. (See event_log.c.) */
 static struct genl_multicast_group mc_groups[] = {
 	{
 		.name = JOOLNL_MULTICAST_GRP_NAME,
+	}, {
+		.name = JOOLNL_EVENTS_GRP_NAME,
 	},
 };
 
@@ -1,10 +1,12 @@
 #include "mod/common/nl/pool4.h"
 
 #include "mod/common/log.h"
+#include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
 #include "mod/common/nl/nl_core.h"
+#include "mod/common/db/flowcache.h"
 #include "mod/common/db/pool4/db.h"
 #include "mod/common/db/bib/db.h"
 
@@ -73,6 +75,51 @@ revert_start:
 	return error;
 }
 
+static int handle_pool4_add_bulk(struct xlator *jool, struct genl_info *info)
+{
+	struct nlattr *root = info->attrs[JNLAR_POOL4_ENTRIES];
+	struct nlattr *attr;
+	struct pool4_entry *entries;
+	int *errors;
+	unsigned int count;
+	unsigned int i;
+	int rem;
+	int error;
+
+	count = jnla_count_entries(root);
+	__log_debug(jool, "Adding pool4 entries in bulk. (%u)", count);
+
+	entries = __wkvmalloc_array("pool4 bulk", count, sizeof(*entries),
+			GFP_KERNEL);
+	if (!entries)
+		return jresponse_send_simple(jool, info, -ENOMEM);
+	errors = __wkvmalloc_array("Bulk errors", count, sizeof(*errors),
+			GFP_KERNEL);
+	if (!errors) {
+		error = jresponse_send_simple(jool, info, -ENOMEM);
+		goto end;
+	}
+
+	i = 0;
+	nla_for_each_nested(attr, root, rem) {
+		if (nla_type(attr) != JNLAL_ENTRY)
+			continue;
+		errors[i] = jnla_get_pool4(attr, "pool4 entry", &entries[i]);
+		i++;
+	}
+
+	pool4db_add_bulk(jool->nat64.pool4, entries, count, errors);
+
+	error = jresponse_send_bulk(jool, info, errors, count);
+	if (error)
+		error = jresponse_send_simple(jool, info, error);
+
+	__wkvfree("Bulk errors", errors);
+end:
+	__wkvfree("pool4 bulk", entries);
+	return error;
+}
+
 int handle_pool4_add(struct sk_buff *skb, struct genl_info *info)
 {
 	struct xlator jool;
@@ -83,6 +130,12 @@ int handle_pool4_add(struct sk_buff *skb, struct genl_info *info)
 	if (error)
 		return jresponse_send_simple(NULL, info, error);
 
+	if (info->attrs[JNLAR_POOL4_ENTRIES]) {
+		error = handle_pool4_add_bulk(&jool, info);
+		request_handle_end(&jool);
+		return error;
+	}
+
 	__log_debug(&jool, "Adding elements to pool4.");
 
 	error = jnla_get_pool4(info->attrs[JNLAR_OPERAND], "Operand", &entry);
@@ -123,6 +176,7 @@ int handle_pool4_rm(struct sk_buff *skb, struct genl_info *info)
 	error = pool4db_rm_usr(jool.nat64.pool4, &entry);
 	if (xlator_is_nat64(&jool) && !(get_jool_hdr(info)->flags & JOOLNLHDR_FLAGS_QUICK))
 		bib_rm_range(&jool, entry.proto, &entry.range);
+	flowcache_flush(jool.nat64.flows);
 
 revert_start:
 	error = jresponse_send_simple(&jool, info, error);
@@ -150,6 +204,7 @@ int handle_pool4_flush(struct sk_buff *skb, struct genl_info *info)
 		 */
 		bib_flush(&jool);
 	}
+	flowcache_flush(jool.nat64.flows);
 
 	error = jresponse_send_simple(&jool, info, error);
 	request_handle_end(&jool);
@@ -1,6 +1,8 @@
 #include "mod/common/nl/session.h"
 
+#include <linux/sched.h>
 #include "mod/common/log.h"
+#include "mod/common/wkmalloc.h"
 #include "mod/common/xlator.h"
 #include "mod/common/nl/attribute.h"
 #include "mod/common/nl/nl_common.h"
@@ -43,6 +45,8 @@ int handle_session_foreach(struct sk_buff *skb, struct genl_info *info)
 	struct xlator jool;
 	struct jool_response response;
 	struct session_foreach_offset offset, *offset_ptr;
+	struct table_filter filter, *filter_ptr;
+	struct session_dump dump;
 	l4_protocol proto;
 	int error;
 
@@ -76,8 +80,28 @@ int handle_session_foreach(struct sk_buff *skb, struct genl_info *info)
 				&offset.offset.dst.l3, offset.offset.dst.l4);
 	}
 
-	error = bib_foreach_session(&jool, proto, serialize_session_entry,
-			response.skb, offset_ptr);
+	if (!info->attrs[JNLAR_FILTER]) {
+		filter_ptr = NULL;
+	} else {
+		error = jnla_get_filter(info->attrs[JNLAR_FILTER],
+				"Session filter", &filter);
+		if (error)
+			goto revert_response;
+		filter_ptr = &filter;
+	}
+
+	/*
+	 * This runs in process context, so don't hog the table lock while
+	 * the message is being filled; let the translator in between windows.
+	 */
+	bib_dump_init(&dump, proto, filter_ptr, offset_ptr);
+	do {
+		error = bib_dump_window(&jool, &dump, serialize_session_entry,
+				response.skb);
+		cond_resched();
+	} while (!error && !dump.done);
+	__log_debug(&jool, "Dumped in %u windows; longest lock hold: %lld ns.",
+			dump.windows, dump.max_hold_ns);
 
 	error = jresponse_send_array(&jool, &response, error);
 	if (error)
@@ -93,3 +117,227 @@ revert_start:
 	request_handle_end(&jool);
 	return error;
 }
+
+static const unsigned int age_limits[] = SESSION_AGE_LIMITS;
+
+struct histogram_args {
+	unsigned long now;
+	__u32 *ages;
+};
+
+static int count_age(struct session_entry const *session, void *arg)
+{
+	struct histogram_args *args = arg;
+	unsigned int age;
+	unsigned int i;
+
+	age = jiffies_to_msecs(args->now - session->creation_time) / 1000;
+	for (i = 0; i < ARRAY_SIZE(age_limits); i++)
+		if (age < age_limits[i])
+			break;
+
+	args->ages[i]++;
+	return 0;
+}
+
+/*
+ * The counters are maintained by the table, but ages change all the time, so
+ * the histogram needs a walk. Do it in windows, same as the session dump.
+ */
+static int compute_ages(struct xlator *jool, l4_protocol proto,
+		struct session_stats *stats)
+{
+	struct session_dump dump;
+	struct histogram_args args;
+	int error;
+
+	BUILD_BUG_ON(ARRAY_SIZE(age_limits) + 1 != SESSION_AGE_BUCKETS);
+
+	args.now = jiffies;
+	args.ages = stats->ages;
+
+	bib_dump_init(&dump, proto, NULL, NULL);
+	do {
+		error = bib_dump_window(jool, &dump, count_age, &args);
+		cond_resched();
+	} while (!error && !dump.done);
+
+	stats->has_ages = !error;
+	return error;
+}
+
+static int put_u32_list(struct sk_buff *skb, int attrtype,
+		__u32 const *values, unsigned int count)
+{
+	struct nlattr *root;
+	unsigned int i;
+
+	root = nla_nest_start(skb, attrtype);
+	if (!root)
+		return -EMSGSIZE;
+
+	for (i = 0; i < count; i++) {
+		if (nla_put_u32(skb, i + 1, values[i])) {
+			nla_nest_cancel(skb, root);
+			return -EMSGSIZE;
+		}
+	}
+
+	nla_nest_end(skb, root);
+	return 0;
+}
+
+static int jnla_put_session_stats(struct sk_buff *skb,
+		struct session_stats const *stats)
+{
+	int error;
+
+	error = nla_put_u32(skb, JNLASS_BIBS, stats->bibs)
+		|| nla_put_u32(skb, JNLASS_SESSIONS, stats->sessions)
+		|| nla_put_u32(skb, JNLASS_EST, stats->est)
+		|| nla_put_u32(skb, JNLASS_TRANS, stats->trans)
+		|| nla_put_u32(skb, JNLASS_SYN4, stats->syn4)
+		|| nla_put_u32(skb, JNLASS_STORED_PKTS, stats->stored_pkts)
+		|| nla_put_u32(skb, JNLASS_EST_TIMEOUT, stats->est_timeout)
+		|| nla_put_u32(skb, JNLASS_TRANS_TIMEOUT, stats->trans_timeout)
+		|| put_u32_list(skb, JNLASS_STATES, stats->states,
+				TCP_STATE_COUNT);
+	if (error)
+		return -EMSGSIZE;
+
+	if (stats->has_ages) {
+		error = put_u32_list(skb, JNLASS_AGES, stats->ages,
+				SESSION_AGE_BUCKETS);
+		if (error)
+			return error;
+	}
+
+	return 0;
+}
+
+int handle_session_stats(struct sk_buff *skb, struct genl_info *info)
+{
+	struct xlator jool;
+	struct jool_response response;
+	struct session_stats stats;
+	l4_protocol proto;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, true);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	__log_debug(&jool, "Sending session counters to userspace.");
+
+	if (!info->attrs[JNLAR_PROTO]) {
+		log_err("The request is missing a transport protocol.");
+		error = -EINVAL;
+		goto revert_start;
+	}
+	proto = nla_get_u8(info->attrs[JNLAR_PROTO]);
+
+	error = bib_session_stats(&jool, proto, &stats);
+	if (error)
+		goto revert_start;
+	if (info->attrs[JNLAR_HISTOGRAM]) {
+		error = compute_ages(&jool, proto, &stats);
+		if (error)
+			goto revert_start;
+	}
+
+	error = jresponse_init(&response, info);
+	if (error)
+		goto revert_start;
+
+	error = jnla_put_session_stats(response.skb, &stats);
+	if (error) {
+		report_put_failure();
+		goto revert_response;
+	}
+
+	request_handle_end(&jool);
+	return jresponse_send(&response);
+
+revert_response:
+	jresponse_cleanup(&response);
+revert_start:
+	error = jresponse_send_simple(&jool, info, error);
+	request_handle_end(&jool);
+	return error;
+}
+
+typedef void (*session_bulk_fn)(struct xlator *, struct session_entry *,
+		unsigned int, int *);
+
+static int handle_session_bulk(struct genl_info *info, session_bulk_fn fn,
+		char const *what)
+{
+	struct xlator jool;
+	struct nlattr *root;
+	struct nlattr *attr;
+	struct session_entry *entries;
+	int *errors;
+	unsigned int count;
+	unsigned int i;
+	int rem;
+	int error;
+
+	error = request_handle_start(info, XT_NAT64, &jool, true);
+	if (error)
+		return jresponse_send_simple(NULL, info, error);
+
+	root = info->attrs[JNLAR_SESSION_ENTRIES];
+	if (!root) {
+		log_err("The request lacks a session list.");
+		error = jresponse_send_simple(&jool, info, -EINVAL);
+		goto end;
+	}
+
+	count = jnla_count_entries(root);
+	__log_debug(&jool, "%s sessions. (%u)", what, count);
+
+	entries = __wkvmalloc_array("Session bulk", count,
+			sizeof(*entries), GFP_KERNEL);
+	if (!entries) {
+		error = jresponse_send_simple(&jool, info, -ENOMEM);
+		goto end;
+	}
+	errors = __wkvmalloc_array("Bulk errors", count, sizeof(*errors),
+			GFP_KERNEL);
+	if (!errors) {
+		error = jresponse_send_simple(&jool, info, -ENOMEM);
+		goto free_entries;
+	}
+
+	i = 0;
+	nla_for_each_nested(attr, root, rem) {
+		if (nla_type(attr) != JNLAL_ENTRY)
+			continue;
+		errors[i] = jnla_get_session(attr, "Session",
+				&jool.globals.nat64.bib, &entries[i]);
+		i++;
+	}
+
+	fn(&jool, entries, count, errors);
+
+	error = jresponse_send_bulk(&jool, info, errors, count);
+	if (error)
+		error = jresponse_send_simple(&jool, info, error);
+
+	__wkvfree("Bulk errors", errors);
+free_entries:
+	__wkvfree("Session bulk", entries);
+end:
+	request_handle_end(&jool);
+	return error;
+}
+
+int handle_session_add(struct sk_buff *skb, struct genl_info *info)
+{
+	return handle_session_bulk(info, bib_add_session_bulk, "Importing");
+}
+
+int handle_session_touch(struct sk_buff *skb, struct genl_info *info)
+{
+	return handle_session_bulk(info, bib_touch_session_bulk, "Touching");
+}
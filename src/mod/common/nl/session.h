@@ -4,5 +4,8 @@
 #include <net/genetlink.h>
 
 int handle_session_foreach(struct sk_buff *skb, struct genl_info *info);
+int handle_session_stats(struct sk_buff *skb, struct genl_info *info);
+int handle_session_add(struct sk_buff *skb, struct genl_info *info);
+int handle_session_touch(struct sk_buff *skb, struct genl_info *info);
 
 #endif /* SRC_MOD_COMMON_NL_SESSION_H_ */
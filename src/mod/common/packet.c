@@ -315,7 +315,9 @@ static verdict handle_icmp6(struct xlation *state, struct pkt_metadata const *me
 			return truncated(state, "fragment header");
 		if (is_fragmented_ipv6(ptr.frag)) {
 			log_debug(state, "Packet is fragmented and ICMP; ICMP checksum cannot be translated.");
-			return drop(state, JSTAT64_FRAGMENTED_ICMP);
+			return xlation_is_nat64(state)
+					? untranslatable(state, JSTAT64_FRAGMENTED_ICMP)
+					: drop(state, JSTAT64_FRAGMENTED_ICMP);
 		}
 	}
 
@@ -438,7 +440,10 @@ static verdict handle_icmp4(struct xlation *state, struct pkt_metadata *meta)
 	/*
 	 * If fragmented:
 	 * 	If NAT64:
-	 * 		Impossible (because nf_defrag_ipv4)
+	 * 		Only possible if fragment-tracking is enabled (otherwise
+	 * 		nf_defrag_ipv4 reassembles first). Leave it to the
+	 * 		kernel's defragmenter; the translation of the whole packet
+	 * 		will succeed.
 	 * 	Else (ie. SIIT):
 	 * 		If ICMP error:
 	 * 			Drop (because illegal)
@@ -451,7 +456,9 @@ static verdict handle_icmp4(struct xlation *state, struct pkt_metadata *meta)
 	 */
 	if (is_fragmented_ipv4(pkt_ip4_hdr(&state->in))) {
 		log_debug(state, "Packet is fragmented and ICMP; ICMP checksum cannot be translated.");
-		return drop(state, JSTAT46_FRAGMENTED_ICMP);
+		return xlation_is_nat64(state)
+				? untranslatable(state, JSTAT46_FRAGMENTED_ICMP)
+				: drop(state, JSTAT46_FRAGMENTED_ICMP);
 	}
 
 	ptr = skb_hdr_ptr(state->in.skb, meta->l4_offset, buffer);
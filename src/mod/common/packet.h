@@ -236,6 +236,20 @@ struct packet {
 	 * packet.
 	 */
 	struct packet *original_pkt;
+
+	/**
+	 * In-place translation (see ttpcomm_xlat_in_place()) hands the skb
+	 * over to the outgoing packet, and overwrites these headers. So it
+	 * copies them here first, and the l3 and l4 header accessors below
+	 * read them from the copy from then on.
+	 *
+	 * NULL otherwise.
+	 */
+	unsigned char *hdrs;
+	/** Offset of the l4 header within @hdrs. */
+	unsigned int hdrs_l4_offset;
+	/** Length of @hdrs. (ie. offset of the payload, from the l3 header.) */
+	unsigned int hdrs_len;
 };
 
 /**
@@ -254,6 +268,7 @@ static inline void pkt_fill(struct packet *pkt, struct sk_buff *skb,
 	pkt->frag_offset = frag ? ((unsigned char *)frag - skb->data) : 0;
 	pkt->payload_offset = (unsigned char *)payload - skb->data;
 	pkt->original_pkt = original_pkt;
+	pkt->hdrs = NULL;
 }
 
 static inline l3_protocol pkt_l3_proto(const struct packet *pkt)
@@ -261,16 +276,28 @@ static inline l3_protocol pkt_l3_proto(const struct packet *pkt)
 	return pkt->l3_proto;
 }
 
+static inline void *pkt_l3_hdr(const struct packet *pkt)
+{
+	return unlikely(pkt->hdrs) ? pkt->hdrs : skb_network_header(pkt->skb);
+}
+
+static inline void *pkt_l4_hdr(const struct packet *pkt)
+{
+	return unlikely(pkt->hdrs)
+			? (pkt->hdrs + pkt->hdrs_l4_offset)
+			: skb_transport_header(pkt->skb);
+}
+
 /* l3_proto must be IPv4. */
 static inline struct iphdr *pkt_ip4_hdr(const struct packet *pkt)
 {
-	return ip_hdr(pkt->skb);
+	return pkt_l3_hdr(pkt);
 }
 
 /* l3_proto must be IPv6. */
 static inline struct ipv6hdr *pkt_ip6_hdr(const struct packet *pkt)
 {
-	return ipv6_hdr(pkt->skb);
+	return pkt_l3_hdr(pkt);
 }
 
 static inline l4_protocol pkt_l4_proto(const struct packet *pkt)
@@ -281,25 +308,25 @@ static inline l4_protocol pkt_l4_proto(const struct packet *pkt)
 /* Incompatible with subsequent fragments, l4_proto must be TCP. */
 static inline struct udphdr *pkt_udp_hdr(const struct packet *pkt)
 {
-	return udp_hdr(pkt->skb);
+	return pkt_l4_hdr(pkt);
 }
 
 /* Incompatible with subsequent fragments, l4_proto must be UDP. */
 static inline struct tcphdr *pkt_tcp_hdr(const struct packet *pkt)
 {
-	return tcp_hdr(pkt->skb);
+	return pkt_l4_hdr(pkt);
 }
 
 /* l4_proto must be ICMP. */
 static inline struct icmphdr *pkt_icmp4_hdr(const struct packet *pkt)
 {
-	return icmp_hdr(pkt->skb);
+	return pkt_l4_hdr(pkt);
 }
 
 /* l4_proto must be ICMP. */
 static inline struct icmp6hdr *pkt_icmp6_hdr(const struct packet *pkt)
 {
-	return icmp6_hdr(pkt->skb);
+	return pkt_l4_hdr(pkt);
 }
 
 /* l3_proto must be IPv6. */
@@ -312,7 +339,9 @@ static inline struct frag_hdr *pkt_frag_hdr(const struct packet *pkt)
 
 static inline void *pkt_payload(const struct packet *pkt)
 {
-	return pkt->skb->data + pkt->payload_offset;
+	return unlikely(pkt->hdrs)
+			? (pkt->hdrs + pkt->hdrs_len)
+			: (pkt->skb->data + pkt->payload_offset);
 }
 
 static inline bool pkt_is_inner(const struct packet *pkt)
@@ -342,7 +371,7 @@ static inline struct packet *pkt_original_pkt(const struct packet *pkt)
  */
 static inline unsigned int pkt_l3hdr_len(const struct packet *pkt)
 {
-	return skb_transport_header(pkt->skb) - skb_network_header(pkt->skb);
+	return pkt_l4_hdr(pkt) - pkt_l3_hdr(pkt);
 }
 
 /**
@@ -357,7 +386,7 @@ static inline unsigned int pkt_l3hdr_len(const struct packet *pkt)
  */
 static inline unsigned int pkt_l4hdr_len(const struct packet *pkt)
 {
-	return pkt_payload(pkt) - (void *)skb_transport_header(pkt->skb);
+	return pkt_payload(pkt) - pkt_l4_hdr(pkt);
 }
 
 /**
@@ -402,6 +431,14 @@ static inline bool pkt_is_icmp4_error(const struct packet *pkt)
 			&& is_icmp4_error(pkt_icmp4_hdr(pkt)->type);
 }
 
+/** Is @pkt a fragment other than the first one? (ie. has no l4 header.) */
+static inline bool pkt_is_subsequent_frag(const struct packet *pkt)
+{
+	return (pkt_l3_proto(pkt) == L3PROTO_IPV4)
+			? !is_first_frag4(pkt_ip4_hdr(pkt))
+			: !is_first_frag6(pkt_frag_hdr(pkt));
+}
+
 struct xlation;
 
 /**
@@ -7,7 +7,6 @@
 #include "mod/common/linux_version.h"
 #include "mod/common/log.h"
 #include "mod/common/rfc6052.h"
-#include "mod/common/route.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
 
 /* Layer 3 only */
@@ -257,7 +256,7 @@ static verdict predict_route46(struct xlation *state)
 
 	flow6 = &state->flowx.v6.flowi;
 	log_debug(state, "Routing: %pI6c->%pI6c", &flow6->saddr, &flow6->daddr);
-	state->dst = route6(&state->jool, flow6);
+	state->dst = ttpcomm_route6(state, flow6);
 	if (!state->dst)
 		return untranslatable(state, JSTAT_FAILED_ROUTES);
 
@@ -378,6 +377,73 @@ static bool fragment_exceeds_mtu46(struct packet *in, unsigned int mtu)
 	return (out_hdrs_len + out_payload_len) > mtu;
 }
 
+/**
+ * Returns "true" if "hdr" contains a source route option and the last address
+ * from it hasn't been reached.
+ *
+ * Assumes the options are glued in memory after "hdr", the way sk_buffs work
+ * (when linearized or pullable).
+ */
+static bool has_unexpired_src_route(struct iphdr *hdr)
+{
+	unsigned char *current_opt, *end_of_opts;
+	__u8 src_route_len, src_route_ptr;
+
+	/* Find a loose source route or a strict source route option. */
+	current_opt = (unsigned char *)(hdr + 1);
+	end_of_opts = ((unsigned char *)hdr) + (4 * hdr->ihl);
+	if (current_opt >= end_of_opts)
+		return false;
+
+	while (current_opt[0] != IPOPT_LSRR && current_opt[0] != IPOPT_SSRR) {
+		switch (current_opt[0]) {
+		case IPOPT_END:
+			return false;
+		case IPOPT_NOOP:
+			current_opt++;
+			break;
+		default:
+			/*
+			 * IPOPT_SEC, IPOPT_RR, IPOPT_SID, IPOPT_TIMESTAMP,
+			 * IPOPT_CIPSO and IPOPT_RA are known to fall through
+			 * here.
+			 */
+			current_opt += current_opt[1];
+			break;
+		}
+
+		if (current_opt >= end_of_opts)
+			return false;
+	}
+
+	/* Finally test. */
+	src_route_len = current_opt[1];
+	src_route_ptr = current_opt[2];
+	return src_route_len >= src_route_ptr;
+}
+
+/*
+ * Can @state->in be translated in place? In addition to the common checks,
+ * this weeds out everything that could make ttp46_ipv6_external() or the l4
+ * steps fail.
+ */
+static bool can_xlat_in_place46(struct xlation *state)
+{
+	struct packet *in = &state->in;
+	struct iphdr *hdr4 = pkt_ip4_hdr(in);
+
+	if (will_need_frag_hdr(hdr4))
+		return false;
+	if (hdr4->ttl <= 1)
+		return false;
+	if (has_unexpired_src_route(hdr4))
+		return false;
+	if (pkt_l4_proto(in) == L4PROTO_UDP && pkt_udp_hdr(in)->check == 0)
+		return false;
+
+	return ttpcomm_can_xlat_in_place(state, iphdr_delta(hdr4));
+}
+
 static verdict allocate_fast(struct xlation *state, bool ignore_df,
 		unsigned short gso_size)
 {
@@ -387,17 +453,30 @@ static verdict allocate_fast(struct xlation *state, bool ignore_df,
 	struct frag_hdr *hdr_frag;
 	struct skb_shared_info *shinfo;
 	int delta;
+	verdict result;
 
 	/* Dunno what happens when headroom is negative, so don't risk it. */
 	delta = get_delta(in);
 	if (delta < 0)
 		delta = 0;
 
-	/* Allocate the outgoing packet as a copy of @in with shared pages. */
-	out = __pskb_copy(in->skb, delta + skb_headroom(in->skb), GFP_ATOMIC);
-	if (!out) {
-		log_debug(state, "__pskb_copy() returned NULL.");
-		return drop(state, JSTAT46_PSKB_COPY);
+	result = ttpcomm_prepare_fraglist(state, delta);
+	if (result != VERDICT_CONTINUE)
+		return result;
+
+	if (can_xlat_in_place46(state)) {
+		out = ttpcomm_xlat_in_place(state);
+	} else {
+		/*
+		 * Allocate the outgoing packet as a copy of @in with shared
+		 * pages.
+		 */
+		out = __pskb_copy(in->skb, delta + skb_headroom(in->skb),
+				GFP_ATOMIC);
+		if (!out) {
+			log_debug(state, "__pskb_copy() returned NULL.");
+			return drop(state, JSTAT46_PSKB_COPY);
+		}
 	}
 
 	/* https://github.com/NICMx/Jool/issues/289 */
@@ -452,6 +531,11 @@ static verdict allocate_fast(struct xlation *state, bool ignore_df,
 	out->mark = in->skb->mark;
 	out->protocol = htons(ETH_P_IPV6);
 
+	/*
+	 * gso_size is the segments' l4 payload length, so it is not affected
+	 * by the l3 header change. SKB_GSO_UDP_L4 and SKB_GSO_FRAGLIST are
+	 * family-agnostic, so only TCP needs its type adjusted.
+	 */
 	shinfo = skb_shinfo(out);
 	if (shinfo->gso_size && gso_size)
 		shinfo->gso_size = gso_size;
@@ -463,6 +547,122 @@ static verdict allocate_fast(struct xlation *state, bool ignore_df,
 	return VERDICT_CONTINUE;
 }
 
+/*
+ * Can allocate_slow() build the fragments by referencing @skb's pages, instead
+ * of copying its payload?
+ */
+static bool can_share_pages(struct sk_buff *skb)
+{
+	/* Each fragment might need a piece of the head and of every page. */
+	if (skb_shinfo(skb)->nr_frags + 1 > MAX_SKB_FRAGS)
+		return false;
+	if (skb_has_frag_list(skb))
+		return false;
+	/* Userspace owns these pages, and wants to know when we're done. */
+#if LINUX_VERSION_AT_LEAST(4, 14, 0, 8, 0)
+	if (skb_zcopy(skb))
+		return false;
+#else
+	if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY)
+		return false;
+#endif
+	return true;
+}
+
+/*
+ * Returns how many of the first @len bytes of a fragment (which start at
+ * offset @offset of @in's data) have to be copied into the fragment's head.
+ * The rest can be referenced by share_pages().
+ */
+static unsigned int get_copy_len(struct packet *in, bool share,
+		unsigned int offset, unsigned int len, bool first)
+{
+	unsigned int headlen;
+	unsigned int copy_len;
+
+	if (!share)
+		return len;
+
+	/* The l4 header is going to be rewritten, so it can't be shared. */
+	copy_len = first ? pkt_l4hdr_len(in) : 0;
+
+	/* kmalloc()ed heads can't be referenced as page fragments. */
+	headlen = skb_headlen(in->skb);
+	if (!in->skb->head_frag && offset < headlen)
+		copy_len = max(copy_len, headlen - offset);
+
+	return min(copy_len, len);
+}
+
+static void add_page(struct sk_buff *skb, struct page *page,
+		unsigned int offset, unsigned int size)
+{
+	skb_fill_page_desc(skb, skb_shinfo(skb)->nr_frags, page, offset, size);
+	skb->len += size;
+	skb->data_len += size;
+	skb->truesize += size;
+}
+
+static unsigned int get_frag_offset(skb_frag_t const *frag)
+{
+#if LINUX_VERSION_AT_LEAST(5, 4, 0, 9999, 0)
+	return skb_frag_off(frag);
+#else
+	return frag->page_offset;
+#endif
+}
+
+/*
+ * Appends @len bytes of @from's data (starting from @offset) to @to's paged
+ * area, by reference. Like skb_segment() does.
+ *
+ * If the range touches @from's head, the head must be a page fragment.
+ */
+static void share_pages(struct sk_buff *to, struct sk_buff *from,
+		unsigned int offset, unsigned int len)
+{
+	struct skb_shared_info *shinfo;
+	skb_frag_t *frag;
+	struct page *page;
+	unsigned int frag_start; /* Offset of @frag, in @from's data */
+	unsigned int frag_end;
+	unsigned int size;
+	unsigned int i;
+
+	frag_start = skb_headlen(from);
+	if (offset < frag_start) {
+		page = virt_to_head_page(from->head);
+		size = min(len, frag_start - offset);
+		get_page(page);
+		add_page(to, page, from->data + offset
+				- (unsigned char *)page_address(page), size);
+		offset += size;
+		len -= size;
+	}
+
+	shinfo = skb_shinfo(from);
+	for (i = 0; i < shinfo->nr_frags && len > 0; i++) {
+		frag = &shinfo->frags[i];
+		frag_end = frag_start + skb_frag_size(frag);
+		if (offset < frag_end) {
+			size = min(len, frag_end - offset);
+			__skb_frag_ref(frag);
+			add_page(to, skb_frag_page(frag), get_frag_offset(frag)
+					+ offset - frag_start, size);
+			offset += size;
+			len -= size;
+		}
+		frag_start = frag_end;
+	}
+}
+
+/*
+ * Fragments @state->in into @state->out.skb's list.
+ *
+ * Each fragment gets a new head for its headers, but (when possible) its
+ * payload is a reference to @in's pages rather than a copy. The first
+ * fragment's l4 header is always copied, since it will be rewritten.
+ */
 static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 {
 	struct packet *in;
@@ -473,7 +673,10 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 	unsigned int payload_per_frag;
 	/* Current fragment's layer 3 payload length */
 	unsigned int fragment_payload_len;
-	unsigned int bytes_consumed;
+	/* Part of the current fragment's payload that is copied to its head */
+	unsigned int copy_len;
+	unsigned int offset;
+	bool share;
 	struct frag_hdr *frag;
 	unsigned char *l3_payload;
 
@@ -481,7 +684,8 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 	previous = &state->out.skb;
 	payload_left = in->skb->len - pkt_l3hdr_len(in);
 	payload_per_frag = (mpl - HDRS_LEN) & 0xFFFFFFF8U;
-	bytes_consumed = 0;
+	offset = skb_transport_offset(in->skb);
+	share = can_share_pages(in->skb);
 
 	while (payload_left > 0) {
 		if (payload_left > payload_per_frag) {
@@ -492,8 +696,12 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 			payload_left = 0;
 		}
 
-		out = alloc_skb(skb_headroom(in->skb) + HDRS_LEN
-				+ fragment_payload_len, GFP_ATOMIC);
+		copy_len = get_copy_len(in, share, offset,
+				fragment_payload_len,
+				previous == &state->out.skb);
+
+		out = alloc_skb(skb_headroom(in->skb) + HDRS_LEN + copy_len,
+				GFP_ATOMIC);
 		if (!out)
 			goto fail;
 
@@ -505,7 +713,7 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 		skb_reset_network_header(out);
 		skb_put(out, sizeof(struct ipv6hdr));
 		frag = (struct frag_hdr *)skb_put(out, sizeof(struct frag_hdr));
-		l3_payload = skb_put(out, fragment_payload_len);
+		l3_payload = skb_put(out, copy_len);
 
 		skb_set_transport_header(out, HDRS_LEN);
 		if (out == state->out.skb) {
@@ -519,11 +727,13 @@ static verdict allocate_slow(struct xlation *state, unsigned int mpl)
 		out->mark = in->skb->mark;
 		out->protocol = htons(ETH_P_IPV6);
 
-		if (skb_copy_bits(in->skb,
-				skb_transport_offset(in->skb) + bytes_consumed,
-				l3_payload, fragment_payload_len))
+		if (skb_copy_bits(in->skb, offset, l3_payload, copy_len))
 			goto fail;
-		bytes_consumed += fragment_payload_len;
+		if (copy_len < fragment_payload_len) {
+			share_pages(out, in->skb, offset + copy_len,
+					fragment_payload_len - copy_len);
+		}
+		offset += fragment_payload_len;
 	}
 
 	return VERDICT_CONTINUE;
@@ -726,11 +936,20 @@ static verdict ttp46_alloc_skb(struct xlation *state)
 		}
 
 	} else if (fragment_exceeds_mtu46(in, mpl)) {
-		/*
-		 * Force LIM and Fragmentation ID preservation through manual
-		 * fragmentation.
-		 */
-		result = allocate_slow(state, mpl);
+		if (skb_is_gso(in->skb)) {
+			/*
+			 * It's the segments that need fragmentation, not the
+			 * super-packet. See core_4to6_segments().
+			 */
+			state->result.segment = true;
+			result = VERDICT_UNTRANSLATABLE;
+		} else {
+			/*
+			 * Force LIM and Fragmentation ID preservation through
+			 * manual fragmentation.
+			 */
+			result = allocate_slow(state, mpl);
+		}
 
 	} else {
 		/*
@@ -752,51 +971,6 @@ fail:
 	return result;
 }
 
-/**
- * Returns "true" if "hdr" contains a source route option and the last address
- * from it hasn't been reached.
- *
- * Assumes the options are glued in memory after "hdr", the way sk_buffs work
- * (when linearized or pullable).
- */
-static bool has_unexpired_src_route(struct iphdr *hdr)
-{
-	unsigned char *current_opt, *end_of_opts;
-	__u8 src_route_len, src_route_ptr;
-
-	/* Find a loose source route or a strict source route option. */
-	current_opt = (unsigned char *)(hdr + 1);
-	end_of_opts = ((unsigned char *)hdr) + (4 * hdr->ihl);
-	if (current_opt >= end_of_opts)
-		return false;
-
-	while (current_opt[0] != IPOPT_LSRR && current_opt[0] != IPOPT_SSRR) {
-		switch (current_opt[0]) {
-		case IPOPT_END:
-			return false;
-		case IPOPT_NOOP:
-			current_opt++;
-			break;
-		default:
-			/*
-			 * IPOPT_SEC, IPOPT_RR, IPOPT_SID, IPOPT_TIMESTAMP,
-			 * IPOPT_CIPSO and IPOPT_RA are known to fall through
-			 * here.
-			 */
-			current_opt += current_opt[1];
-			break;
-		}
-
-		if (current_opt >= end_of_opts)
-			return false;
-	}
-
-	/* Finally test. */
-	src_route_len = current_opt[1];
-	src_route_ptr = current_opt[2];
-	return src_route_len >= src_route_ptr;
-}
-
 /**
  * One-liner for creating the Identification field of the IPv6 Fragment header.
  */
@@ -1266,6 +1440,7 @@ static verdict post_icmp6error(struct xlation *state)
 		return result;
 
 	compute_icmp6_csum(&state->out);
+	jstat_inc(state->jool.stats, JSTAT_CSUM_COMPUTED);
 	return VERDICT_CONTINUE;
 }
 
@@ -1300,6 +1475,7 @@ static verdict ttp46_icmp(struct xlation *state)
 				: icmpv4_hdr->un.echo.id;
 		icmpv6_hdr->icmp6_sequence = icmpv4_hdr->un.echo.sequence;
 		update_icmp6_csum(state);
+		jstat_inc(state->jool.stats, JSTAT_CSUM_INCREMENTAL);
 		return VERDICT_CONTINUE;
 
 	case ICMP_DEST_UNREACH:
@@ -1398,7 +1574,13 @@ static bool can_compute_csum(struct xlation *state)
 	struct udphdr *hdr_udp;
 	bool amend_csum0;
 
-	if (xlation_is_nat64(state))
+	hdr4 = pkt_ip4_hdr(&state->in);
+
+	/*
+	 * NAT64 only sees a fragment if fragment-tracking is enabled, and
+	 * fragdb_add() leaves fragmented zero-checksum packets to the kernel.
+	 */
+	if (xlation_is_nat64(state) && !is_mf_set_ipv4(hdr4))
 		return true;
 
 	/*
@@ -1415,8 +1597,8 @@ static bool can_compute_csum(struct xlation *state)
 	 * It does not include the addresses/ports, which is OK because users
 	 * don't like it: https://github.com/NICMx/Jool/pull/129
 	 */
-	hdr4 = pkt_ip4_hdr(&state->in);
-	amend_csum0 = state->jool.globals.siit.compute_udp_csum_zero;
+	amend_csum0 = xlation_is_siit(state)
+			&& state->jool.globals.siit.compute_udp_csum_zero;
 	if (is_mf_set_ipv4(hdr4) || !amend_csum0) {
 		hdr_udp = pkt_udp_hdr(&state->in);
 		log_debug(state, "Dropping zero-checksum UDP packet: %pI4#%u->%pI4#%u",
@@ -1453,16 +1635,20 @@ static verdict ttp46_tcp(struct xlation *state)
 				pkt_ip4_hdr(in), &tcp_copy,
 				pkt_ip6_hdr(out), tcp_out,
 				sizeof(*tcp_out));
+		jstat_inc(state->jool.stats, JSTAT_CSUM_INCREMENTAL);
 
 	} else if (out->skb->next) {
+		/* Fragments can't be offloaded; the sum spans all of them. */
 		tcp_out->check = 0;
 		tcp_out->check = skb_list_csum(out->skb, NEXTHDR_TCP);
+		jstat_inc(state->jool.stats, JSTAT_CSUM_COMPUTED);
 
 	} else {
 		tcp_out->check = ~tcp_v6_check(pkt_datagram_len(out),
 				&pkt_ip6_hdr(out)->saddr,
 				&pkt_ip6_hdr(out)->daddr, 0);
 		partialize_skb(out->skb, offsetof(struct tcphdr, check));
+		jstat_inc(state->jool.stats, JSTAT_CSUM_OFFLOADED);
 	}
 
 	return VERDICT_CONTINUE;
@@ -1500,10 +1686,12 @@ static verdict ttp46_udp(struct xlation *state)
 				pkt_ip4_hdr(in), &udp_copy,
 				pkt_ip6_hdr(out), udp_out,
 				sizeof(*udp_out));
+		jstat_inc(state->jool.stats, JSTAT_CSUM_INCREMENTAL);
 
 	} else if (out->skb->next) {
 		udp_out->check = 0;
 		udp_out->check = skb_list_csum(out->skb, NEXTHDR_UDP);
+		jstat_inc(state->jool.stats, JSTAT_CSUM_COMPUTED);
 
 	} else {
 		goto partial;
@@ -1516,6 +1704,7 @@ partial:
 			&pkt_ip6_hdr(out)->saddr,
 			&pkt_ip6_hdr(out)->daddr, 0);
 	partialize_skb(out->skb, offsetof(struct udphdr, check));
+	jstat_inc(state->jool.stats, JSTAT_CSUM_OFFLOADED);
 	return VERDICT_CONTINUE;
 }
 
@@ -8,7 +8,6 @@
 #include "mod/common/ipv6_hdr_iterator.h"
 #include "mod/common/linux_version.h"
 #include "mod/common/log.h"
-#include "mod/common/route.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
 
 static __u8 xlat_tos(struct jool_globals const *config, struct ipv6hdr const *hdr)
@@ -307,7 +306,7 @@ static verdict __predict_route64(struct xlation *state)
 		log_debug(state, "Packet is hairpinning; skipping routing.");
 	} else {
 		log_debug(state, "Routing: %pI4->%pI4", &flow4->saddr, &flow4->daddr);
-		state->dst = route4(&state->jool, flow4);
+		state->dst = ttpcomm_route4(state, flow4);
 		if (!state->dst)
 			return untranslatable(state, JSTAT_FAILED_ROUTES);
 	}
@@ -427,6 +426,53 @@ static verdict validate_size(struct xlation *state)
 	return drop(state, JSTAT_UNKNOWN);
 }
 
+/**
+ * has_nonzero_segments_left - Returns true if @hdr6's packet has a routing
+ * header, and its Segments Left field is not zero.
+ *
+ * @location: if the packet has nonzero segments left, the offset
+ *		of the segments left field (from the start of @hdr6) will be
+ *		stored here.
+ */
+static bool has_nonzero_segments_left(struct ipv6hdr const *hdr6,
+		__u32 *location)
+{
+	struct ipv6_rt_hdr const *rt_hdr;
+	unsigned int offset;
+
+	rt_hdr = hdr_iterator_find(hdr6, NEXTHDR_ROUTING);
+	if (!rt_hdr)
+		return false;
+
+	if (rt_hdr->segments_left == 0)
+		return false;
+
+	offset = ((void *)rt_hdr) - (void *)hdr6;
+	*location = offset + offsetof(struct ipv6_rt_hdr, segments_left);
+	return true;
+}
+
+/*
+ * Can @state->in be translated in place? In addition to the common checks,
+ * this weeds out everything that could make ttp64_ipv4_external() fail.
+ */
+static bool can_xlat_in_place64(struct xlation *state)
+{
+	struct packet const *in = &state->in;
+	struct ipv6hdr const *hdr6 = pkt_ip6_hdr(in);
+	__u32 nonzero_location;
+
+	if (pkt_frag_hdr(in))
+		return false;
+	if (hdr6->hop_limit <= 1)
+		return false;
+	if (has_nonzero_segments_left(hdr6, &nonzero_location))
+		return false;
+
+	return ttpcomm_can_xlat_in_place(state,
+			(int)sizeof(struct iphdr) - (int)pkt_l3hdr_len(in));
+}
+
 static verdict ttp64_alloc_skb(struct xlation *state)
 {
 	struct packet const *in = &state->in;
@@ -457,13 +503,20 @@ static verdict ttp64_alloc_skb(struct xlation *state)
 	 * tail area without knowing it. (I'm reading the Linux 4.4 code.)
 	 *
 	 * We will therefore *not* attempt to allocate less.
+	 *
+	 * (Unless the packet can be translated in place, in which case there's
+	 * no copy at all.)
 	 */
 
-	out = pskb_copy(in->skb, GFP_ATOMIC);
-	if (!out) {
-		log_debug(state, "pskb_copy() returned NULL.");
-		result = drop(state, JSTAT64_PSKB_COPY);
-		goto revert;
+	if (can_xlat_in_place64(state)) {
+		out = ttpcomm_xlat_in_place(state);
+	} else {
+		out = pskb_copy(in->skb, GFP_ATOMIC);
+		if (!out) {
+			log_debug(state, "pskb_copy() returned NULL.");
+			result = drop(state, JSTAT64_PSKB_COPY);
+			goto revert;
+		}
 	}
 
 	/* https://github.com/NICMx/Jool/issues/289 */
@@ -539,6 +592,26 @@ static void generate_ipv4_id(struct xlation const *state, struct iphdr *hdr4,
 	}
 }
 
+/*
+ * Does @in's GSO type cut the packet into standalone segments (as opposed to
+ * fragments)?
+ */
+static bool is_segmented_gso(struct packet const *in)
+{
+	switch (pkt_l4_proto(in)) {
+	case L4PROTO_TCP:
+		return true;
+	case L4PROTO_UDP:
+#if LINUX_VERSION_AT_LEAST(4, 18, 0, 8, 0)
+		return skb_shinfo(in->skb)->gso_type & SKB_GSO_UDP_L4;
+#else
+		return false;
+#endif
+	default:
+		return false;
+	}
+}
+
 static bool generate_df_flag(struct xlation const *state)
 {
 	struct packet const *in;
@@ -556,18 +629,21 @@ static bool generate_df_flag(struct xlation const *state)
 		/* Unimportant. Guess: RFC logic. Meh. */
 		return ntohs(pkt_ip4_hdr(out)->tot_len) > 1260;
 	}
-	if (skb_has_frag_list(in->skb)) {
-		/* Clearly fragmented */
-		return false;
-	}
 	if (skb_is_gso(in->skb)) {
-		if (pkt_l4_proto(in) != L4PROTO_TCP) {
+		if (!is_segmented_gso(in)) {
 			/* UDP fragmented, ICMP & OTHER undefined */
 			return false;
 		}
-		/* TCP not fragmented */
+		/*
+		 * TCP and UDP L4 not fragmented. (Includes GRO fraglist; the
+		 * frag_list contains segments, not fragments.)
+		 */
 		return pkt_hdrs_len(out) + skb_shinfo(in->skb)->gso_size > 1260;
 	}
+	if (skb_has_frag_list(in->skb)) {
+		/* Clearly fragmented */
+		return false;
+	}
 
 	/* Not fragmented */
 	return out->skb->len > 1260;
@@ -593,32 +669,6 @@ static __be16 xlat_frag_off(struct frag_hdr const *hdr_frag,
 	return build_ipv4_frag_off_field(df, mf, frag_offset);
 }
 
-/**
- * has_nonzero_segments_left - Returns true if @hdr6's packet has a routing
- * header, and its Segments Left field is not zero.
- *
- * @location: if the packet has nonzero segments left, the offset
- *		of the segments left field (from the start of @hdr6) will be
- *		stored here.
- */
-static bool has_nonzero_segments_left(struct ipv6hdr const *hdr6,
-		__u32 *location)
-{
-	struct ipv6_rt_hdr const *rt_hdr;
-	unsigned int offset;
-
-	rt_hdr = hdr_iterator_find(hdr6, NEXTHDR_ROUTING);
-	if (!rt_hdr)
-		return false;
-
-	if (rt_hdr->segments_left == 0)
-		return false;
-
-	offset = ((void *)rt_hdr) - (void *)hdr6;
-	*location = offset + offsetof(struct ipv6_rt_hdr, segments_left);
-	return true;
-}
-
 /**
  * Translates @state->in's IPv6 header into @state->out's IPv4 header.
  * Only used for external IPv6 headers. (ie. not enclosed in ICMP errors.)
@@ -982,6 +1032,7 @@ static verdict post_icmp4error(struct xlation *state, bool handle_extensions)
 		return result;
 
 	compute_icmp4_csum(&state->out);
+	jstat_inc(state->jool.stats, JSTAT_CSUM_COMPUTED);
 	return VERDICT_CONTINUE;
 }
 
@@ -1015,6 +1066,7 @@ static verdict ttp64_icmp(struct xlation *state)
 				: icmpv6_hdr->icmp6_identifier;
 		icmpv4_hdr->un.echo.sequence = icmpv6_hdr->icmp6_sequence;
 		update_icmp4_csum(state);
+		jstat_inc(state->jool.stats, JSTAT_CSUM_INCREMENTAL);
 		return VERDICT_CONTINUE;
 
 	case ICMPV6_DEST_UNREACH:
@@ -1124,13 +1176,14 @@ static verdict ttp64_tcp(struct xlation *state)
 		tcp_out->check = update_csum_6to4(tcp_in->check,
 				pkt_ip6_hdr(in), &tcp_copy, sizeof(tcp_copy),
 				pkt_ip4_hdr(out), tcp_out, sizeof(*tcp_out));
-		out->skb->ip_summed = CHECKSUM_NONE;
+		jstat_inc(state->jool.stats, JSTAT_CSUM_INCREMENTAL);
 
 	} else {
 		tcp_out->check = ~tcp_v4_check(pkt_datagram_len(out),
 				pkt_ip4_hdr(out)->saddr,
 				pkt_ip4_hdr(out)->daddr, 0);
 		partialize_skb(out->skb, offsetof(struct tcphdr, check));
+		jstat_inc(state->jool.stats, JSTAT_CSUM_OFFLOADED);
 	}
 
 	return VERDICT_CONTINUE;
@@ -1162,13 +1215,14 @@ static verdict ttp64_udp(struct xlation *state)
 				pkt_ip4_hdr(out), udp_out, sizeof(*udp_out));
 		if (udp_out->check == 0)
 			udp_out->check = CSUM_MANGLED_0;
-		out->skb->ip_summed = CHECKSUM_NONE;
+		jstat_inc(state->jool.stats, JSTAT_CSUM_INCREMENTAL);
 
 	} else {
 		udp_out->check = ~udp_v4_check(pkt_datagram_len(out),
 				pkt_ip4_hdr(out)->saddr,
 				pkt_ip4_hdr(out)->daddr, 0);
 		partialize_skb(out->skb, offsetof(struct udphdr, check));
+		jstat_inc(state->jool.stats, JSTAT_CSUM_OFFLOADED);
 	}
 
 	return VERDICT_CONTINUE;
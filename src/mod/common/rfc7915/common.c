@@ -1,12 +1,18 @@
 #include "mod/common/rfc7915/common.h"
 
 #include <linux/icmp.h>
+#include <net/ip.h>
+#include <net/ip6_checksum.h>
+#include <net/ip6_fib.h>
 
 #include "common/config.h"
 #include "mod/common/ipv6_hdr_iterator.h"
+#include "mod/common/linux_version.h"
 #include "mod/common/log.h"
 #include "mod/common/packet.h"
+#include "mod/common/route_cache.h"
 #include "mod/common/stats.h"
+#include "mod/common/db/bib/db.h"
 #include "mod/common/db/denylist4.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
 
@@ -26,6 +32,243 @@ bool will_need_frag_hdr(const struct iphdr *hdr)
 	return is_fragmented_ipv4(hdr);
 }
 
+/*
+ * Direction-independent half of the in-place translation check. The callers
+ * also need to make sure none of their steps can fail after the skb has been
+ * handed over, because @in will no longer exist by then. (There will be no
+ * packet to return to the kernel, nor to quote in an ICMP error.)
+ *
+ * @delta is the number of bytes the headers will grow.
+ */
+bool ttpcomm_can_xlat_in_place(struct xlation *state, int delta)
+{
+	struct packet *in = &state->in;
+	struct sk_buff *skb = in->skb;
+	unsigned int needed_headroom;
+
+	if (!state->jool.globals.xlat_in_place)
+		return false;
+	/* Hairpinning translates the outgoing packet again; keep it simple. */
+	if (state->is_hairpin)
+		return false;
+	/* ICMP errors need inner packet rewrites. */
+	if (pkt_l4_proto(in) != L4PROTO_TCP && pkt_l4_proto(in) != L4PROTO_UDP)
+		return false;
+	/* Someone else (eg. a packet socket) might be reading the headers. */
+	if (skb_shared(skb) || skb_cloned(skb))
+		return false;
+	/* Locally generated; leave the socket accounting alone. */
+	if (skb->sk)
+		return false;
+	if (pkt_payload(in) - (void *)skb_network_header(skb)
+			> sizeof(state->in_hdrs))
+		return false;
+
+	if (delta > 0) {
+		needed_headroom = delta;
+		if (state->dst)
+			needed_headroom += LL_RESERVED_SPACE(state->dst->dev);
+		if (skb_headroom(skb) < needed_headroom)
+			return false;
+	}
+
+	/*
+	 * @state->is_hairpin is only set during the second pass. A NAT64's
+	 * first pass is a hairpin if the outgoing tuple's destination is in
+	 * pool4, and the core will want to translate @in's translation again.
+	 * (Last, because it's the most expensive check.)
+	 */
+	if (state->jool.is_hairpin && state->jool.is_hairpin(state))
+		return false;
+
+	return true;
+}
+
+/*
+ * Hands @state->in's skb over to @state->out, so the translation steps rewrite
+ * the headers in place instead of in a copy. @in's headers are backed up first,
+ * since the steps still need to read them.
+ *
+ * Only call this after ttpcomm_can_xlat_in_place() returned true.
+ */
+struct sk_buff *ttpcomm_xlat_in_place(struct xlation *state)
+{
+	struct packet *in = &state->in;
+	unsigned char *l3_hdr = skb_network_header(in->skb);
+
+	in->hdrs_l4_offset = skb_transport_header(in->skb) - l3_hdr;
+	in->hdrs_len = (unsigned char *)pkt_payload(in) - l3_hdr;
+	memcpy(state->in_hdrs, l3_hdr, in->hdrs_len);
+	in->hdrs = state->in_hdrs;
+	state->in_place = true;
+
+	/* The new route will be attached later. */
+	skb_dst_drop(in->skb);
+	return in->skb;
+}
+
+/*
+ * GRO fraglist super-packets keep the original segments in their frag_list.
+ * The segments lack their headers (skb->data points to the payload), but they
+ * still hold them right behind, and the kernel rebuilds the segments out of
+ * them during resegmentation. (See skb_segment_list().)
+ *
+ * So translating the first segment is not enough; the others need their
+ * headers translated as well.
+ */
+static bool is_gso_fraglist(struct sk_buff *skb)
+{
+#if LINUX_VERSION_AT_LEAST(5, 6, 0, 9999, 0)
+	return skb_is_gso(skb) && (skb_shinfo(skb)->gso_type & SKB_GSO_FRAGLIST);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Makes sure every fraglist segment of @state->in has room for @delta more
+ * bytes of headers, since ttpcomm_xlat_fraglist() is not allowed to fail.
+ *
+ * Has to be called before @state->in is copied, since the segments will be
+ * shared afterwards.
+ */
+verdict ttpcomm_prepare_fraglist(struct xlation *state, int delta)
+{
+	struct sk_buff *iter;
+	unsigned int needed;
+	unsigned int available;
+
+	if (delta <= 0 || !is_gso_fraglist(state->in.skb))
+		return VERDICT_CONTINUE;
+
+	needed = delta;
+	if (state->dst)
+		needed += LL_RESERVED_SPACE(state->dst->dev);
+
+	skb_walk_frags(state->in.skb, iter) {
+		available = skb_network_header(iter) - iter->head;
+		if (available >= needed)
+			continue;
+		if (skb_shared(iter) || pskb_expand_head(iter,
+				needed - available, 0, GFP_ATOMIC)) {
+			log_debug(state, "Cannot make room for a fraglist segment's headers.");
+			return drop(state, JSTAT_ENOMEM);
+		}
+	}
+
+	return VERDICT_CONTINUE;
+}
+
+static __wsum addrs_csum(struct packet const *pkt)
+{
+	struct ipv6hdr const *hdr6;
+	struct iphdr const *hdr4;
+
+	if (pkt_l3_proto(pkt) == L3PROTO_IPV6) {
+		hdr6 = pkt_ip6_hdr(pkt);
+		return csum_partial(&hdr6->saddr, 2 * sizeof(hdr6->saddr), 0);
+	}
+
+	hdr4 = pkt_ip4_hdr(pkt);
+	return csum_partial(&hdr4->saddr, 2 * sizeof(hdr4->saddr), 0);
+}
+
+/* Ports only; they're the first four bytes in both TCP and UDP. */
+static __wsum ports_csum(struct packet const *pkt, __wsum csum)
+{
+	return csum_partial(pkt_l4_hdr(pkt), 2 * sizeof(__be16), csum);
+}
+
+static void xlat_segment_l3(struct packet const *out, struct sk_buff *seg,
+		unsigned int l4hdr_len)
+{
+	unsigned int l3hdr_len;
+	unsigned int datagram_len;
+
+	l3hdr_len = pkt_l3hdr_len(out);
+	datagram_len = l4hdr_len + seg->len;
+
+	skb_set_network_header(seg, -(int)(l3hdr_len + l4hdr_len));
+	memcpy(skb_network_header(seg), pkt_l3_hdr(out), l3hdr_len);
+
+	if (pkt_l3_proto(out) == L3PROTO_IPV6) {
+		ipv6_hdr(seg)->payload_len = cpu_to_be16(l3hdr_len
+				- sizeof(struct ipv6hdr) + datagram_len);
+	} else {
+		ip_hdr(seg)->tot_len = cpu_to_be16(l3hdr_len + datagram_len);
+		ip_send_check(ip_hdr(seg));
+	}
+
+	seg->protocol = out->skb->protocol;
+}
+
+/*
+ * Translates the headers of @state->out's fraglist segments. Each segment's
+ * l3 header becomes a copy of @state->out's, and its l4 header keeps its own
+ * fields, except for the ports and the checksum.
+ *
+ * (GRO only merges packets from the same flow, so all the segments share
+ * @state->in's addresses and ports.)
+ */
+void ttpcomm_xlat_fraglist(struct xlation *state)
+{
+	struct packet const *in = &state->in;
+	struct packet const *out = &state->out;
+	struct sk_buff *iter;
+	unsigned char *l4_hdr;
+	unsigned int l4hdr_len;
+	unsigned int csum_offset;
+	__sum16 *check;
+	__wsum diff;
+	__wsum csum;
+	bool is_udp;
+
+	if (!is_gso_fraglist(out->skb))
+		return;
+
+	switch (pkt_l4_proto(out)) {
+	case L4PROTO_TCP:
+		csum_offset = offsetof(struct tcphdr, check);
+		is_udp = false;
+		break;
+	case L4PROTO_UDP:
+		csum_offset = offsetof(struct udphdr, check);
+		is_udp = true;
+		break;
+	default:
+		return;
+	}
+
+	diff = csum_sub(ports_csum(out, addrs_csum(out)),
+			ports_csum(in, addrs_csum(in)));
+
+	skb_walk_frags(out->skb, iter) {
+		l4_hdr = skb_transport_header(iter);
+		l4hdr_len = iter->data - l4_hdr;
+		check = (__sum16 *)(l4_hdr + csum_offset);
+
+		xlat_segment_l3(out, iter, l4hdr_len);
+		memcpy(l4_hdr, pkt_l4_hdr(out), 2 * sizeof(__be16));
+
+		if (is_udp && *check == 0) {
+			/* IPv4 UDP checksum is optional, IPv6's is not. */
+			if (pkt_l3_proto(out) != L3PROTO_IPV6)
+				continue;
+			csum = skb_checksum(iter, 0, iter->len,
+					csum_partial(l4_hdr, l4hdr_len, 0));
+			*check = csum_ipv6_magic(&ipv6_hdr(iter)->saddr,
+					&ipv6_hdr(iter)->daddr,
+					l4hdr_len + iter->len, IPPROTO_UDP,
+					csum);
+		} else {
+			*check = csum_fold(csum_add(diff, ~csum_unfold(*check)));
+		}
+
+		if (is_udp && *check == 0)
+			*check = CSUM_MANGLED_0;
+	}
+}
+
 static int move_pointers_in(struct packet *pkt, __u8 protocol,
 		unsigned int l3hdr_len)
 {
@@ -245,6 +488,43 @@ void partialize_skb(struct sk_buff *out_skb, __u16 csum_offset)
 	out_skb->csum_offset = csum_offset;
 }
 
+/**
+ * ttpcomm_update_skb_csum - keep @state->out's skb->csum truthful.
+ *
+ * If the NIC summed the whole incoming packet (CHECKSUM_COMPLETE), the outgoing
+ * packet inherits the sum (skb copies and in-place translation both preserve
+ * the field), but the translation has replaced the headers it covers. Left
+ * alone, the sum would make whoever receives the packet next (veth peers,
+ * hairpinning, local sockets) discard it as corrupted.
+ *
+ * Except for ICMP errors, the payload survives translation untouched, and all
+ * the headers have even lengths, so its contribution to the sum does not
+ * change. Swapping the old headers' sum for the new ones' is enough; there is
+ * no need to downgrade the packet to CHECKSUM_NONE, which would force the next
+ * receiver to sum the entire packet again.
+ */
+void ttpcomm_update_skb_csum(struct xlation *state)
+{
+	struct packet *in = &state->in;
+	struct packet *out = &state->out;
+	struct sk_buff *skb = out->skb;
+	__wsum csum;
+
+	if (skb->ip_summed != CHECKSUM_COMPLETE)
+		return;
+
+	if (pkt_is_icmp4_error(in) || pkt_is_icmp6_error(in)) {
+		skb->ip_summed = CHECKSUM_NONE;
+		return;
+	}
+
+	csum = csum_sub(skb->csum,
+			csum_partial(pkt_l3_hdr(in), pkt_hdrs_len(in), 0));
+	skb->csum = csum_add(csum,
+			csum_partial(pkt_l3_hdr(out), pkt_hdrs_len(out), 0));
+	jstat_inc(state->jool.stats, JSTAT_CSUM_COMPLETE_UPDATED);
+}
+
 static verdict fix_ie(struct xlation *state, size_t in_ie_offset,
 		size_t ipl, size_t pad, size_t iel)
 {
@@ -396,3 +676,231 @@ verdict handle_icmp_extension(struct xlation *state,
 	return fix_ie(state, skb_network_offset(in->skb) + in_ieo, out_ipl,
 			out_pad, out_iel);
 }
+
+static struct dst_entry *__route4(struct xlation *state, struct flowi4 *flow)
+{
+	if (xlation_is_siit(state) && state->jool.globals.siit.route_cache)
+		return rtcache_route4(&state->jool, flow);
+	return route4(&state->jool, flow);
+}
+
+static struct dst_entry *__route6(struct xlation *state, struct flowi6 *flow)
+{
+	if (xlation_is_siit(state) && state->jool.globals.siit.route_cache)
+		return rtcache_route6(&state->jool, flow);
+	return route6(&state->jool, flow);
+}
+
+/*
+ * Returns the batch's cached route if it was computed out of the same routing
+ * arguments. Otherwise, NULL.
+ */
+static struct dst_entry *batch_route(struct xlation_batch *batch,
+		l3_protocol proto, void *flow, size_t flow_len)
+{
+	if (!batch->dst || batch->proto != proto)
+		return NULL;
+	if (memcmp(&batch->key, flow, flow_len) != 0)
+		return NULL;
+
+	memcpy(flow, &batch->flow, flow_len);
+	return dst_clone(batch->dst);
+}
+
+static void batch_remember(struct xlation_batch *batch, l3_protocol proto,
+		void const *key, void const *flow, size_t flow_len,
+		struct dst_entry *dst)
+{
+	if (batch->dst)
+		dst_release(batch->dst);
+
+	batch->dst = dst_clone(dst);
+	batch->proto = proto;
+	memcpy(&batch->key, key, flow_len);
+	memcpy(&batch->flow, flow, flow_len);
+}
+
+/*
+ * route4(), except packets translated as part of a batch reuse the previous
+ * packet's route if the routing arguments didn't change.
+ */
+static struct dst_entry *batch_route4(struct xlation *state,
+		struct flowi4 *flow)
+{
+	struct xlation_batch *batch = state->batch;
+	struct flowi4 key;
+	struct dst_entry *dst;
+
+	if (!batch)
+		return __route4(state, flow);
+
+	dst = batch_route(batch, L3PROTO_IPV4, flow, sizeof(*flow));
+	if (dst)
+		return dst;
+
+	memcpy(&key, flow, sizeof(key));
+	dst = __route4(state, flow);
+	if (dst)
+		batch_remember(batch, L3PROTO_IPV4, &key, flow, sizeof(*flow),
+				dst);
+	return dst;
+}
+
+/*
+ * route6(), except packets translated as part of a batch reuse the previous
+ * packet's route if the routing arguments didn't change.
+ */
+static struct dst_entry *batch_route6(struct xlation *state,
+		struct flowi6 *flow)
+{
+	struct xlation_batch *batch = state->batch;
+	struct flowi6 key;
+	struct dst_entry *dst;
+
+	if (!batch)
+		return __route6(state, flow);
+
+	dst = batch_route(batch, L3PROTO_IPV6, flow, sizeof(*flow));
+	if (dst)
+		return dst;
+
+	memcpy(&key, flow, sizeof(key));
+	dst = __route6(state, flow);
+	if (dst)
+		batch_remember(batch, L3PROTO_IPV6, &key, flow, sizeof(*flow),
+				dst);
+	return dst;
+}
+
+static bool is_icmp_error(struct packet const *pkt)
+{
+	return (pkt_l3_proto(pkt) == L3PROTO_IPV6)
+			? pkt_is_icmp6_error(pkt)
+			: pkt_is_icmp4_error(pkt);
+}
+
+/*
+ * ICMP errors belong to the session of the packet they're complaining about,
+ * but they're usually sourced by some router in the middle, and the session
+ * doesn't fix the source. So they're routed the long way.
+ */
+static bool is_route_cacheable(struct xlation *state)
+{
+	return xlation_is_nat64(state)
+			&& state->entries.session_set
+			&& state->jool.globals.nat64.bib.route_cache
+			&& !is_icmp_error(&state->in);
+}
+
+/*
+ * Returns the route @state's session (or flow) remembered for the packet,
+ * provided it was computed out of the same packet fields. Otherwise, NULL.
+ */
+static struct dst_entry *session_route(struct xlation *state, __u32 mark,
+		__u8 tos)
+{
+	struct session_route *cached = &state->entries.route;
+	struct dst_entry *dst;
+
+	dst = cached->dst;
+	if (!dst)
+		return NULL;
+	cached->dst = NULL;
+
+	if (cached->mark != mark || cached->tos != tos
+			|| is_icmp_error(&state->in)) {
+		dst_release(dst);
+		return NULL;
+	}
+
+	if (is_route_cacheable(state))
+		jstat_inc(state->jool.stats, JSTAT_ROUTE_CACHE_HIT);
+	return dst;
+}
+
+static void session_remember(struct xlation *state, struct dst_entry *dst,
+		__u32 cookie, __u32 mark, __u8 tos)
+{
+	struct session_route route;
+
+	route.dst = dst;
+	route.cookie = cookie;
+	route.mark = mark;
+	route.tos = tos;
+	bib_cache_route(state, &route);
+}
+
+/*
+ * Leaves @dst in @state, for flowcache_add(). Flow cache hits already have
+ * their route cached, and won't be added again.
+ */
+static void flow_remember(struct xlation *state, struct dst_entry *dst,
+		__u32 cookie, __u32 mark, __u8 tos)
+{
+	struct session_route *route = &state->flow_route;
+
+	if (!xlation_is_nat64(state) || !state->jool.globals.nat64.flow_cache
+			|| state->flow_hit)
+		return;
+
+	if (route->dst)
+		dst_release(route->dst);
+	route->dst = dst_clone(dst);
+	route->cookie = cookie;
+	route->mark = mark;
+	route->tos = tos;
+}
+
+/**
+ * Routes @flow, which is @state's outgoing packet's routing arguments.
+ *
+ * Packets that belong to a session reuse the route the session remembers
+ * (if the session-route-cache global is enabled), packets that hit the flow
+ * cache reuse the flow's route, and packets translated as part of a batch
+ * reuse the previous packet's route if the routing arguments didn't change.
+ */
+struct dst_entry *ttpcomm_route4(struct xlation *state, struct flowi4 *flow)
+{
+	struct dst_entry *dst;
+
+	dst = session_route(state, flow->flowi4_mark, flow->flowi4_tos);
+	if (!dst) {
+		if (is_route_cacheable(state))
+			jstat_inc(state->jool.stats, JSTAT_ROUTE_CACHE_MISS);
+		dst = batch_route4(state, flow);
+		if (!dst)
+			return NULL;
+		/* IPv4 routes are validated by the FIB generation instead. */
+		if (is_route_cacheable(state))
+			session_remember(state, dst, 0, flow->flowi4_mark,
+					flow->flowi4_tos);
+	}
+
+	flow_remember(state, dst, 0, flow->flowi4_mark, flow->flowi4_tos);
+	return dst;
+}
+
+/**
+ * IPv6 version of ttpcomm_route4().
+ */
+struct dst_entry *ttpcomm_route6(struct xlation *state, struct flowi6 *flow)
+{
+	struct dst_entry *dst;
+
+	dst = session_route(state, flow->flowi6_mark, 0);
+	if (!dst) {
+		if (is_route_cacheable(state))
+			jstat_inc(state->jool.stats, JSTAT_ROUTE_CACHE_MISS);
+		dst = batch_route6(state, flow);
+		if (!dst)
+			return NULL;
+		if (is_route_cacheable(state))
+			session_remember(state, dst,
+					rt6_get_cookie((struct rt6_info *)dst),
+					flow->flowi6_mark, 0);
+	}
+
+	flow_remember(state, dst, rt6_get_cookie((struct rt6_info *)dst),
+			flow->flowi6_mark, 0);
+	return dst;
+}
@@ -32,6 +32,9 @@ struct translation_steps {
 	 *
 	 * There's also the issue that the incoming packet might not have enough
 	 * room for the header length expansion from v4 to v6.
+	 *
+	 * (That said, when none of this applies, translate-in-place lets the
+	 * function skip the copy. See ttpcomm_xlat_in_place().)
 	 */
 	skb_alloc_fn skb_alloc;
 	/** The function that will translate the external IP header. */
@@ -51,7 +54,14 @@ struct translation_steps {
 };
 
 void partialize_skb(struct sk_buff *skb, __u16 csum_offset);
+void ttpcomm_update_skb_csum(struct xlation *state);
 bool will_need_frag_hdr(const struct iphdr *hdr);
+bool ttpcomm_can_xlat_in_place(struct xlation *state, int delta);
+struct sk_buff *ttpcomm_xlat_in_place(struct xlation *state);
+verdict ttpcomm_prepare_fraglist(struct xlation *state, int delta);
+void ttpcomm_xlat_fraglist(struct xlation *state);
+struct dst_entry *ttpcomm_route4(struct xlation *state, struct flowi4 *flow);
+struct dst_entry *ttpcomm_route6(struct xlation *state, struct flowi6 *flow);
 verdict ttpcomm_translate_inner_packet(struct xlation *state,
 		struct translation_steps const *steps);
 
@@ -81,6 +81,10 @@ verdict translating_the_packet(struct xlation *state)
 	result = steps->skb_alloc(state);
 	if (result != VERDICT_CONTINUE)
 		return result;
+	jstat_inc(state->jool.stats, state->in_place
+			? JSTAT_XLAT_IN_PLACE
+			: JSTAT_XLAT_COPIED);
+
 	result = steps->xlat_outer_l3(state);
 	if (result != VERDICT_CONTINUE)
 		goto revert;
@@ -88,13 +92,29 @@ verdict translating_the_packet(struct xlation *state)
 		result = xlat_l4_function(state, steps);
 		if (result != VERDICT_CONTINUE)
 			goto revert;
+		ttpcomm_xlat_fraglist(state);
 	}
+	ttpcomm_update_skb_csum(state);
 
 	if (xlation_is_nat64(state))
 		log_debug(state, "Done step 4.");
 	return VERDICT_CONTINUE;
 
 revert:
+	if (state->in_place) {
+		/*
+		 * Shouldn't happen; the skb_alloc functions only translate in
+		 * place when the steps can't fail. But if they did, the packet
+		 * is half-translated, so there is nothing to return to the
+		 * kernel or quote in an ICMP error. The kernel still owns the
+		 * skb, so it will free it.
+		 */
+		WARN(1, "In-place translation failed. Verdict: %d", result);
+		state->out.skb = NULL;
+		state->result.icmp = ICMPERR_NONE;
+		return VERDICT_DROP;
+	}
+
 	__kfree_skb_list(state);
 	return result;
 }
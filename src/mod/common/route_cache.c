@@ -0,0 +1,339 @@
+#include "mod/common/route_cache.h"
+
+#include <linux/hash.h>
+#include <linux/kref.h>
+#include <linux/percpu.h>
+#include <net/ip6_fib.h>
+#include <net/ipv6.h>
+#include "mod/common/linux_version.h"
+#include "mod/common/log.h"
+#include "mod/common/stats.h"
+#include "mod/common/wkmalloc.h"
+
+/*
+ * Each CPU remembers (1 << RTCACHE_BITS) destinations.
+ * SIIT-DC border relays tend to send everything towards a handful of next hops,
+ * so this doesn't need to be large.
+ */
+#define RTCACHE_BITS 6
+#define RTCACHE_SLOTS (1 << RTCACHE_BITS)
+/* In jiffies. Entries that go unused this long are forgotten. */
+#define RTCACHE_TTL (10 * HZ)
+
+struct rtcache_entry {
+	/** NULL if the slot is empty. Holds a reference. */
+	struct dst_entry *dst;
+	/**
+	 * Validates @dst. IPv6 routes need the cookie of the FIB node they
+	 * came from; IPv4 routes validate themselves against the namespace's
+	 * route generation ID. Either way, a routing table change renders the
+	 * entry stale. (See dst_check().)
+	 */
+	__u32 cookie;
+	/** Jiffy at which @dst was last handed out. */
+	unsigned long last_used;
+
+	/* The key. */
+	l3_protocol proto;
+	union {
+		__be32 v4;
+		struct in6_addr v6;
+	} daddr;
+	__u32 mark;
+	__u8 tos;
+};
+
+struct rtcache_table {
+	/*
+	 * Only ever contended by rtcache_clean(); the packet path only
+	 * touches its own CPU's table.
+	 */
+	spinlock_t lock;
+	struct rtcache_entry entries[RTCACHE_SLOTS];
+};
+
+struct route_cache {
+	struct rtcache_table __percpu *tables;
+	struct kref refcount;
+};
+
+struct route_cache *rtcache_alloc(void)
+{
+	struct route_cache *result;
+	unsigned int cpu;
+
+	result = wkmalloc(struct route_cache, GFP_KERNEL);
+	if (!result)
+		return NULL;
+
+	result->tables = alloc_percpu(struct rtcache_table);
+	if (!result->tables) {
+		wkfree(struct route_cache, result);
+		return NULL;
+	}
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(result->tables, cpu)->lock);
+	kref_init(&result->refcount);
+
+	return result;
+}
+
+void rtcache_get(struct route_cache *cache)
+{
+	kref_get(&cache->refcount);
+}
+
+static void rtcache_release(struct kref *refcount)
+{
+	struct route_cache *cache;
+	struct rtcache_table *table;
+	unsigned int cpu;
+	unsigned int i;
+
+	cache = container_of(refcount, struct route_cache, refcount);
+
+	for_each_possible_cpu(cpu) {
+		table = per_cpu_ptr(cache->tables, cpu);
+		for (i = 0; i < RTCACHE_SLOTS; i++)
+			if (table->entries[i].dst)
+				dst_release(table->entries[i].dst);
+	}
+
+	free_percpu(cache->tables);
+	wkfree(struct route_cache, cache);
+}
+
+void rtcache_put(struct route_cache *cache)
+{
+	kref_put(&cache->refcount, rtcache_release);
+}
+
+/*
+ * The key does not include the source address, so the cache cannot be trusted
+ * if the user added policy routing rules.
+ */
+static bool has_custom_rules4(struct net *ns)
+{
+#ifdef CONFIG_IP_MULTIPLE_TABLES
+	return ns->ipv4.fib_has_custom_rules;
+#else
+	return false;
+#endif
+}
+
+static bool has_custom_rules6(struct net *ns)
+{
+#ifdef CONFIG_IPV6_MULTIPLE_TABLES
+#if LINUX_VERSION_AT_LEAST(4, 15, 0, 9999, 0)
+	if (ns->ipv6.fib6_has_custom_rules)
+		return true;
+#else
+	return true; /* Can't tell */
+#endif
+#endif
+
+	/* Same problem: Source-specific routes. */
+#ifdef CONFIG_IPV6_SUBTREES
+#if LINUX_VERSION_AT_LEAST(5, 10, 0, 9999, 0)
+	return ns->ipv6.fib6_routes_require_src;
+#else
+	return true; /* Can't tell */
+#endif
+#else
+	return false;
+#endif
+}
+
+/*
+ * Returns the current CPU's table, locked. Release it with put_table().
+ */
+static struct rtcache_table *get_table(struct xlator *jool)
+{
+	struct rtcache_table *table;
+
+	local_bh_disable();
+	table = this_cpu_ptr(jool->siit.route_cache->tables);
+	spin_lock(&table->lock);
+	return table;
+}
+
+static void put_table(struct rtcache_table *table)
+{
+	spin_unlock(&table->lock);
+	local_bh_enable();
+}
+
+static struct rtcache_entry *get_entry(struct rtcache_table *table, u32 hash)
+{
+	return &table->entries[hash_32(hash, RTCACHE_BITS)];
+}
+
+static u32 hash4(struct flowi4 const *flow)
+{
+	return (__force u32)flow->daddr ^ flow->flowi4_mark ^ flow->flowi4_tos;
+}
+
+static u32 hash6(struct flowi6 const *flow)
+{
+	return ipv6_addr_hash(&flow->daddr) ^ flow->flowi6_mark;
+}
+
+static bool entry_matches4(struct rtcache_entry const *entry,
+		struct flowi4 const *flow)
+{
+	return entry->dst
+			&& entry->proto == L3PROTO_IPV4
+			&& entry->daddr.v4 == flow->daddr
+			&& entry->mark == flow->flowi4_mark
+			&& entry->tos == flow->flowi4_tos;
+}
+
+static bool entry_matches6(struct rtcache_entry const *entry,
+		struct flowi6 const *flow)
+{
+	return entry->dst
+			&& entry->proto == L3PROTO_IPV6
+			&& ipv6_addr_equal(&entry->daddr.v6, &flow->daddr)
+			&& entry->mark == flow->flowi6_mark;
+}
+
+static bool entry_is_stale(struct rtcache_entry const *entry)
+{
+	return time_after(jiffies, entry->last_used + RTCACHE_TTL)
+			|| !dst_check(entry->dst, entry->cookie);
+}
+
+static void entry_clear(struct rtcache_entry *entry)
+{
+	dst_release(entry->dst);
+	entry->dst = NULL;
+}
+
+/*
+ * Returns a new reference to @entry's route, or NULL if it's gone stale.
+ * (In which case the entry is emptied.)
+ */
+static struct dst_entry *entry_get(struct xlator *jool,
+		struct rtcache_entry *entry)
+{
+	if (entry_is_stale(entry)) {
+		jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_INVALID);
+		entry_clear(entry);
+		return NULL;
+	}
+
+	dst_hold(entry->dst);
+	entry->last_used = jiffies;
+	return entry->dst;
+}
+
+/* Does not steal @dst's reference. */
+static void entry_set(struct rtcache_entry *entry, struct dst_entry *dst,
+		__u32 cookie)
+{
+	if (entry->dst)
+		dst_release(entry->dst);
+	dst_hold(dst);
+	entry->dst = dst;
+	entry->cookie = cookie;
+	entry->last_used = jiffies;
+}
+
+struct dst_entry *rtcache_route4(struct xlator *jool, struct flowi4 *flow)
+{
+	struct rtcache_table *table;
+	struct rtcache_entry *entry;
+	struct dst_entry *dst = NULL;
+
+	/* Empty source address: Routing also has to choose one. */
+	if (!flow->saddr || has_custom_rules4(jool->ns))
+		return route4(jool, flow);
+
+	table = get_table(jool);
+	entry = get_entry(table, hash4(flow));
+	if (entry_matches4(entry, flow))
+		dst = entry_get(jool, entry);
+	put_table(table);
+
+	if (dst) {
+		jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_HIT);
+		return dst;
+	}
+
+	jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_MISS);
+	dst = route4(jool, flow);
+	if (!dst)
+		return NULL;
+
+	table = get_table(jool);
+	entry = get_entry(table, hash4(flow));
+	entry_set(entry, dst, 0);
+	entry->proto = L3PROTO_IPV4;
+	entry->daddr.v4 = flow->daddr;
+	entry->mark = flow->flowi4_mark;
+	entry->tos = flow->flowi4_tos;
+	put_table(table);
+
+	return dst;
+}
+
+struct dst_entry *rtcache_route6(struct xlator *jool, struct flowi6 *flow)
+{
+	struct rtcache_table *table;
+	struct rtcache_entry *entry;
+	struct dst_entry *dst = NULL;
+
+	if (ipv6_addr_any(&flow->saddr) || has_custom_rules6(jool->ns))
+		return route6(jool, flow);
+
+	table = get_table(jool);
+	entry = get_entry(table, hash6(flow));
+	if (entry_matches6(entry, flow))
+		dst = entry_get(jool, entry);
+	put_table(table);
+
+	if (dst) {
+		jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_HIT);
+		return dst;
+	}
+
+	jstat_inc(jool->stats, JSTAT_ROUTE_CACHE_MISS);
+	dst = route6(jool, flow);
+	if (!dst)
+		return NULL;
+
+	table = get_table(jool);
+	entry = get_entry(table, hash6(flow));
+	entry_set(entry, dst, rt6_get_cookie((struct rt6_info *)dst));
+	entry->proto = L3PROTO_IPV6;
+	entry->daddr.v6 = flow->daddr;
+	entry->mark = flow->flowi6_mark;
+	entry->tos = 0;
+	put_table(table);
+
+	return dst;
+}
+
+/**
+ * rtcache_clean - Forgets the idle and stale routes of every CPU, even if no
+ * packets are arriving. (So the routes don't outlive routing table and device
+ * changes for long.)
+ */
+void rtcache_clean(struct route_cache *cache)
+{
+	struct rtcache_table *table;
+	struct rtcache_entry *entry;
+	unsigned int cpu;
+	unsigned int i;
+
+	for_each_possible_cpu(cpu) {
+		table = per_cpu_ptr(cache->tables, cpu);
+		spin_lock_bh(&table->lock);
+		for (i = 0; i < RTCACHE_SLOTS; i++) {
+			entry = &table->entries[i];
+			if (entry->dst && entry_is_stale(entry))
+				entry_clear(entry);
+		}
+		spin_unlock_bh(&table->lock);
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef SRC_MOD_COMMON_ROUTE_CACHE_H_
+#define SRC_MOD_COMMON_ROUTE_CACHE_H_
+
+/**
+ * @file
+ * SIIT's destination route cache. (See the destination-route-cache global.)
+ *
+ * Stateless translators have no sessions to remember routes in, so each CPU
+ * keeps a small table of the routes it recently computed instead, indexed by
+ * destination address, mark and TOS.
+ */
+
+#include "mod/common/route.h"
+
+struct route_cache;
+
+struct route_cache *rtcache_alloc(void);
+void rtcache_get(struct route_cache *cache);
+void rtcache_put(struct route_cache *cache);
+void rtcache_clean(struct route_cache *cache);
+
+/* route4() and route6(), except they consult @jool's route cache first. */
+struct dst_entry *rtcache_route4(struct xlator *jool, struct flowi4 *flow);
+struct dst_entry *rtcache_route6(struct xlator *jool, struct flowi6 *flow);
+
+#endif /* SRC_MOD_COMMON_ROUTE_CACHE_H_ */
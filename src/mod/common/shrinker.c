@@ -0,0 +1,119 @@
+#include "mod/common/shrinker.h"
+
+#include <linux/shrinker.h>
+
+#include "mod/common/linux_version.h"
+#include "mod/common/log.h"
+#include "mod/common/xlator.h"
+#include "mod/common/db/bib/db.h"
+
+/*
+ * Sessions are live connections, not caches; dropping one breaks somebody's
+ * traffic. struct shrink_control doesn't expose the reclaim priority, but the
+ * kernel scales each request by (objects >> priority) / seeks, and defers it
+ * until it amounts to a full batch. A high seeks value and a large batch
+ * therefore mean the kernel leaves the sessions alone unless it's getting
+ * desperate.
+ */
+#define SESSION_SEEKS (8 * DEFAULT_SEEKS)
+#define SESSION_BATCH 1024
+
+static int count_instance(struct xlator *jool, void *arg)
+{
+	unsigned long *count = arg;
+	*count += bib_count_evictable(jool);
+	return 0;
+}
+
+static unsigned long count_objects(struct shrinker *shrinker,
+		struct shrink_control *sc)
+{
+	unsigned long count = 0;
+
+	xlator_foreach(XT_NAT64, count_instance, &count, NULL);
+	return count;
+}
+
+/*
+ * Instances are drained in hash table order, so the first ones pay for
+ * everyone else. It doesn't matter much; the kernel only asks for one batch
+ * at a time, and everyone's oldest sessions are the least valuable anyway.
+ *
+ * The instances are visited outside of the RCU read-side critical section, so
+ * bib_evict() can let softirqs (and everyone else) run between its batches.
+ */
+static unsigned long scan_objects(struct shrinker *shrinker,
+		struct shrink_control *sc)
+{
+	struct xlator jool;
+	struct instance_entry_usr offset;
+	struct instance_entry_usr *cursor;
+	unsigned long freed;
+	unsigned long evicted;
+
+	freed = 0;
+	cursor = NULL;
+	while (freed < sc->nr_to_scan
+			&& !xlator_next(XT_NAT64, cursor, &jool)) {
+		evicted = bib_evict(&jool, sc->nr_to_scan - freed);
+		if (evicted) {
+			__log_debug(&jool, "Memory pressure: evicted %lu sessions.",
+					evicted);
+		}
+		freed += evicted;
+
+		xlator_offset(&jool, &offset);
+		cursor = &offset;
+		xlator_put(&jool);
+	}
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+#if LINUX_VERSION_AT_LEAST(6, 7, 0, 9999, 0)
+
+static struct shrinker *shrinker;
+
+int jshrinker_setup(void)
+{
+	shrinker = shrinker_alloc(0, "jool-sessions");
+	if (!shrinker)
+		return -ENOMEM;
+
+	shrinker->count_objects = count_objects;
+	shrinker->scan_objects = scan_objects;
+	shrinker->seeks = SESSION_SEEKS;
+	shrinker->batch = SESSION_BATCH;
+	shrinker_register(shrinker);
+	return 0;
+}
+
+void jshrinker_teardown(void)
+{
+	shrinker_free(shrinker);
+}
+
+#else
+
+static struct shrinker shrinker = {
+	.count_objects = count_objects,
+	.scan_objects = scan_objects,
+	.seeks = SESSION_SEEKS,
+	.batch = SESSION_BATCH,
+};
+
+int jshrinker_setup(void)
+{
+#if LINUX_VERSION_AT_LEAST(6, 0, 0, 9999, 0)
+	return register_shrinker(&shrinker, "jool-sessions");
+#else
+	return register_shrinker(&shrinker);
+#endif
+}
+
+void jshrinker_teardown(void)
+{
+	unregister_shrinker(&shrinker);
+}
+
+#endif
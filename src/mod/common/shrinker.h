@@ -0,0 +1,14 @@
+#ifndef SRC_MOD_COMMON_SHRINKER_H_
+#define SRC_MOD_COMMON_SHRINKER_H_
+
+/**
+ * @file
+ * Lets the kernel reclaim session memory when it runs low. The shrinker
+ * evicts the NAT64 instances' oldest evictable sessions (TCP transitory, UDP
+ * and ICMP; see bib_evict()) before anything else has to fail to allocate.
+ */
+
+int jshrinker_setup(void);
+void jshrinker_teardown(void);
+
+#endif /* SRC_MOD_COMMON_SHRINKER_H_ */
@@ -4,6 +4,7 @@
 #include "mod/common/ipv6_hdr_iterator.h"
 #include "mod/common/log.h"
 #include "mod/common/stats.h"
+#include "mod/common/db/fragdb.h"
 
 /*
  * There are several points in this module where the RFC says "drop the packet",
@@ -286,6 +287,15 @@ verdict determine_in_tuple(struct xlation *state)
 
 	log_debug(state, "Step 1: Determining the Incoming Tuple");
 
+	/*
+	 * Subsequent fragments only show up if fragment-tracking is enabled;
+	 * otherwise the kernel reassembles them before they reach us.
+	 */
+	if (pkt_is_subsequent_frag(&state->in)) {
+		result = fragdb_find(state);
+		goto end;
+	}
+
 	switch (pkt_l3_proto(&state->in)) {
 	case L3PROTO_IPV4:
 		switch (pkt_l4_proto(&state->in)) {
@@ -320,6 +330,10 @@ verdict determine_in_tuple(struct xlation *state)
 		break;
 	}
 
+	if (result == VERDICT_CONTINUE)
+		result = fragdb_add(state);
+
+end:
 	if (result == VERDICT_CONTINUE)
 		log_tuple(state, &state->in.tuple);
 	log_debug(state, "Done step 1.");
@@ -146,6 +146,10 @@ static verdict ipv6_simple(struct xlation *state)
 	switch (error) {
 	case 0:
 		return succeed(state);
+	case -EDQUOT:
+		return drop(state, JSTAT_SUBSCRIBER_QUOTA);
+	case -ENOSPC:
+		return drop(state, JSTAT_SESSION_MEMORY_LIMIT);
 	default:
 		/*
 		 * Error msg already printed, but since bib_add6() sprawls
@@ -194,6 +198,8 @@ static verdict ipv4_simple(struct xlation *state)
 	case -EPERM:
 		log_debug(state, "Packet was blocked by Address-Dependent Filtering.");
 		return drop_icmp(state, JSTAT_ADF, ICMPERR_FILTER, 0);
+	case -ENOSPC:
+		return drop(state, JSTAT_SESSION_MEMORY_LIMIT);
 	default:
 		log_debug(state, "Errcode %d while finding a BIB entry.", error);
 		return drop(state, JSTAT_UNKNOWN);
@@ -537,6 +543,16 @@ verdict filtering_and_updating(struct xlation *state)
 		break;
 	}
 
+	/*
+	 * Subsequent fragments have no l4 header; the first fragment already
+	 * went through filtering and updated the session on their behalf.
+	 * (See fragment-tracking.)
+	 */
+	if (pkt_is_subsequent_frag(in)) {
+		log_debug(state, "Packet is a subsequent fragment; skipping step...");
+		return VERDICT_CONTINUE;
+	}
+
 	/*
 	 * Note: I'm sorry, but the remainder of the Filtering and Updating step
 	 * is not going to be done in the order in which the RFC explains it.
@@ -48,3 +48,16 @@ verdict sendpkt_send(struct xlation *state)
 
 	return VERDICT_CONTINUE;
 }
+
+void sendpkt_send_batch(struct xlation *state)
+{
+	struct sk_buff *skb;
+	unsigned int sent = 0;
+
+	while ((skb = __skb_dequeue(&state->batch->out)) != NULL) {
+		if (__sendpkt_send(state, skb) == VERDICT_CONTINUE)
+			sent++;
+	}
+
+	log_debug(state, "Sent a batch of %u packets.", sent);
+}
@@ -23,4 +23,13 @@
  */
 verdict sendpkt_send(struct xlation *state);
 
+/**
+ * Puts every packet queued in @state's batch on the network, and empties the
+ * queue.
+ *
+ * Packets that cannot be sent are freed and counted, but otherwise do not
+ * interrupt the rest of the batch.
+ */
+void sendpkt_send_batch(struct xlation *state);
+
 #endif /* SRC_MOD_COMMON_SEND_PACKET_H_ */
@@ -3,6 +3,8 @@
 #include "mod/common/linux_version.h"
 #include "mod/common/xlator.h"
 #include "mod/common/joold.h"
+#include "mod/common/route_cache.h"
+#include "mod/common/db/flowcache.h"
 #include "mod/common/db/bib/db.h"
 
 /*
@@ -26,6 +28,13 @@ static int clean_state(struct xlator *jool, void *args)
 {
 	bib_clean(jool);
 	joold_clean(jool);
+	flowcache_clean(jool->nat64.flows);
+	return 0;
+}
+
+static int clean_siit(struct xlator *jool, void *args)
+{
+	rtcache_clean(jool->siit.route_cache);
 	return 0;
 }
 
@@ -37,6 +46,7 @@ static void timer_function(
 #endif
 		)
 {
+	xlator_foreach(XT_SIIT, clean_siit, NULL, NULL);
 	xlator_foreach(XT_NAT64, clean_state, NULL, NULL);
 	mod_timer(&timer, jiffies + TIMER_PERIOD);
 }
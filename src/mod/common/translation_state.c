@@ -35,10 +35,26 @@ void xlation_init(struct xlation *state, struct xlator *jool)
 		memcpy(&state->jool, jool, sizeof(*jool));
 }
 
-void xlation_destroy(struct xlation *state)
+static void release_routes(struct xlation *state)
 {
 	if (state->dst)
 		dst_release(state->dst);
+	if (state->entries.route.dst)
+		dst_release(state->entries.route.dst);
+	if (state->flow_route.dst)
+		dst_release(state->flow_route.dst);
+}
+
+/* Prepares @state for another packet, handled by the same instance. */
+void xlation_reset(struct xlation *state)
+{
+	release_routes(state);
+	memset(&state->in, 0, sizeof(*state) - offsetof(struct xlation, in));
+}
+
+void xlation_destroy(struct xlation *state)
+{
+	release_routes(state);
 	wkmem_cache_free("xlation", xlation_cache, state);
 }
 
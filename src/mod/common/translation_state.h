@@ -28,9 +28,65 @@ union flowix {
 	} v6;
 };
 
+/*
+ * Largest set of l3 and l4 headers in-place translation is willing to back up.
+ * (Fits an IPv4 header with options or an IPv6 header with a small extension
+ * header, plus a TCP header with options.)
+ */
+#define XLAT_IN_PLACE_MAX_HDRS 128
+
 struct xlation_result {
 	enum icmp_errcode icmp;
 	__u32 info;
+	/*
+	 * The packet is a GSO super-packet that cannot be translated as a
+	 * whole; its segments need to be translated one by one instead.
+	 */
+	bool segment;
+};
+
+/**
+ * State shared by the packets of a single batch. (See core_batch() and
+ * core_4to6_segments().)
+ *
+ * At present, only GSO segments are translated in batches; the Netfilter hooks
+ * translate each packet on its own, so their states have no batch.
+ */
+struct xlation_batch {
+	/** Translated packets, waiting to be sent all at once. */
+	struct sk_buff_head out;
+	/** Packets Jool refused to translate, for the caller to hand back. */
+	struct sk_buff_head *rejected;
+
+	/**
+	 * Last route computed during the batch.
+	 * Consecutive packets that belong to the same flow tend to yield the
+	 * same routing arguments, so they can skip the lookup.
+	 */
+	struct dst_entry *dst;
+	/** Protocol of @key and @flow. */
+	l3_protocol proto;
+	/** Routing arguments that led to @dst, as they were before routing. */
+	union {
+		struct flowi4 v4;
+		struct flowi6 v6;
+	} key;
+	/** Routing arguments that led to @dst, as routing left them. */
+	union {
+		struct flowi4 v4;
+		struct flowi6 v6;
+	} flow;
+};
+
+/**
+ * What the first three steps made of a GSO super-packet, so its segments don't
+ * have to go through them again. (See core_4to6_segments().)
+ */
+struct xlation_segment {
+	struct tuple in;
+	struct tuple out;
+	/* The route is left out; the segments share the batch's. */
+	struct bib_session entries;
 };
 
 /**
@@ -42,11 +98,29 @@ struct xlation {
 	 * translation.
 	 */
 	struct xlator jool;
+	/**
+	 * The batch this translation belongs to, or NULL if the packet is
+	 * being translated on its own.
+	 * (Survives xlation_reset().)
+	 */
+	struct xlation_batch *batch;
+	/**
+	 * If @in is a segment of a GSO super-packet, the outcome of the
+	 * super-packet's filtering. NULL otherwise.
+	 * (Survives xlation_reset().)
+	 */
+	struct xlation_segment const *segment;
 
 	/** The original packet. */
 	struct packet in;
 	/** The translated version of @in. */
 	struct packet out;
+	/**
+	 * Was @out built by rewriting @in's skb? If so, both packets share the
+	 * skb, and @in's headers live in @in_hdrs.
+	 */
+	bool in_place;
+	unsigned char in_hdrs[XLAT_IN_PLACE_MAX_HDRS];
 
 	/**
 	 * Routing arguments and result.
@@ -62,6 +136,17 @@ struct xlation {
 	 * to the packet being translated, so you don't have to find them again.
 	 */
 	struct bib_session entries;
+	/**
+	 * The route @out used, for the flow cache to remember.
+	 * (Only set if the flow-cache global is enabled, and @entries did not
+	 * come from the flow cache.)
+	 */
+	struct session_route flow_route;
+	/**
+	 * Steps 1 through 3 were skipped, because @entries came from the flow
+	 * cache (or from @segment.)
+	 */
+	bool flow_hit;
 
 	/**
 	 * Intrinsic hairpin?
@@ -78,6 +163,7 @@ void xlation_teardown(void);
 
 struct xlation *xlation_create(struct xlator *jool);
 void xlation_init(struct xlation *state, struct xlator *jool);
+void xlation_reset(struct xlation *state);
 /* xlation_cleanup() not needed. */
 void xlation_destroy(struct xlation *state);
 
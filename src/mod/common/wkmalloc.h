@@ -1,8 +1,10 @@
 #ifndef SRC_MOD_COMMON_WKMALLOC_H_
 #define SRC_MOD_COMMON_WKMALLOC_H_
 
+#include <linux/mm.h>
 #include <linux/slab.h>
 #include "common/types.h"
+#include "mod/common/linux_version.h"
 
 void wkmalloc_add(const char *name);
 void wkmalloc_rm(const char *name, void *obj);
@@ -37,6 +39,39 @@ static inline void __wkfree(const char *name, void *obj)
 
 #define wkfree(type, obj) __wkfree(#type, obj)
 
+/**
+ * For arrays whose length comes from userspace. Returns NULL if @n * @size
+ * overflows, and falls back to vmalloc if the array is too big for kmalloc.
+ * Release with __wkvfree().
+ */
+static inline void *__wkvmalloc_array(const char *name, size_t n, size_t size,
+		gfp_t flags)
+{
+	void *result;
+
+#if LINUX_VERSION_AT_LEAST(4, 12, 0, 8, 0)
+	result = kvmalloc_array(n, size, flags);
+#else
+	if (size != 0 && n > SIZE_MAX / size)
+		return NULL;
+	result = kmalloc(n * size, flags);
+#endif
+#ifdef JKMEMLEAK
+	if (result)
+		wkmalloc_add(name);
+#endif
+
+	return result;
+}
+
+static inline void __wkvfree(const char *name, void *obj)
+{
+	kvfree(obj);
+#ifdef JKMEMLEAK
+	wkmalloc_rm(name, obj);
+#endif
+}
+
 static inline void *wkmem_cache_alloc(const char *name,
 		struct kmem_cache *cache, gfp_t flags)
 {
@@ -12,10 +12,13 @@
 #include "mod/common/linux_version.h"
 #include "mod/common/log.h"
 #include "mod/common/rcu.h"
+#include "mod/common/route_cache.h"
 #include "mod/common/wkmalloc.h"
 #include "mod/common/db/denylist4.h"
 #include "mod/common/db/eam.h"
 #include "mod/common/db/pool4/db.h"
+#include "mod/common/db/flowcache.h"
+#include "mod/common/db/fragdb.h"
 #include "mod/common/db/bib/db.h"
 #include "mod/common/steps/handling_hairpinning_nat64.h"
 #include "mod/common/steps/handling_hairpinning_siit.h"
@@ -33,8 +36,36 @@ static struct nf_hook_ops netfilter_hooks[] = {
 		.hooknum = NF_INET_PRE_ROUTING,
 		.priority = NF_IP_PRI_NAT_DST + 25,
 	},
+	/* The fragment hooks need to stay last; see nf_hook_count(). */
+	{
+		.hook = hook_ipv6_frag,
+		.pf = PF_INET6,
+		.hooknum = NF_INET_PRE_ROUTING,
+		.priority = NF_IP6_PRI_CONNTRACK_DEFRAG - 1,
+	}, {
+		.hook = hook_ipv4_frag,
+		.pf = PF_INET,
+		.hooknum = NF_INET_PRE_ROUTING,
+		.priority = NF_IP_PRI_CONNTRACK_DEFRAG - 1,
+	},
 };
 
+#if LINUX_VERSION_AT_LEAST(4, 13, 0, 8, 0)
+/* Number of netfilter_hooks that only NAT64 needs. */
+#define NF_FRAG_HOOKS 2
+
+/*
+ * Only NAT64 tracks fragments, so SIIT instances skip the fragment hooks, and
+ * their fragments don't pay for a hook call before the defragmenter.
+ */
+static unsigned int nf_hook_count(struct xlator const *jool)
+{
+	return xlator_is_nat64(jool)
+			? ARRAY_SIZE(netfilter_hooks)
+			: (ARRAY_SIZE(netfilter_hooks) - NF_FRAG_HOOKS);
+}
+#endif
+
 /**
  * An xlator, except it's the database node version.
  */
@@ -115,12 +146,22 @@ static struct jool_instance *find_instance(struct net *ns, xlator_type xt,
 
 static void destroy_jool_instance(struct jool_instance *instance, bool unhook)
 {
+	/*
+	 * Packets might still hold the databases, so release the parts that
+	 * sleep from here. Only removals unhook; a replacement's databases
+	 * live on in its successor.
+	 */
+	if (unhook && xlator_is_nat64(&instance->jool)) {
+		joold_stop(instance->jool.nat64.joold);
+		bib_stop(&instance->jool);
+	}
+
 #if LINUX_VERSION_AT_LEAST(4, 13, 0, 8, 0)
 	if (xlator_is_netfilter(&instance->jool)) {
 		if (unhook) {
 			nf_unregister_net_hooks(instance->jool.ns,
 					instance->nf_ops,
-					ARRAY_SIZE(netfilter_hooks));
+					nf_hook_count(&instance->jool));
 		}
 		__wkfree("nf_hook_ops", instance->nf_ops);
 	}
@@ -139,11 +180,14 @@ static void xlator_get(struct xlator *jool)
 	case XT_SIIT:
 		eamt_get(jool->siit.eamt);
 		denylist4_get(jool->siit.denylist4);
+		rtcache_get(jool->siit.route_cache);
 		break;
 	case XT_NAT64:
 		pool4db_get(jool->nat64.pool4);
 		bib_get(jool->nat64.bib);
 		joold_get(jool->nat64.joold);
+		fragdb_get(jool->nat64.frags);
+		flowcache_get(jool->nat64.flows);
 		break;
 	}
 }
@@ -293,11 +337,16 @@ static int init_siit(struct xlator *jool, struct ipv6_prefix *pool6)
 	jool->siit.denylist4 = denylist4_alloc();
 	if (!jool->siit.denylist4)
 		goto denylist4_fail;
+	jool->siit.route_cache = rtcache_alloc();
+	if (!jool->siit.route_cache)
+		goto route_cache_fail;
 
 	jool->is_hairpin = is_hairpin_siit;
 	jool->handling_hairpinning = handling_hairpinning_siit;
 	return 0;
 
+route_cache_fail:
+	denylist4_put(jool->siit.denylist4);
 denylist4_fail:
 	eamt_put(jool->siit.eamt);
 eamt_fail:
@@ -326,11 +375,21 @@ static int init_nat64(struct xlator *jool, struct ipv6_prefix *pool6)
 	jool->nat64.joold = joold_alloc(jool->ns);
 	if (!jool->nat64.joold)
 		goto joold_fail;
+	jool->nat64.frags = fragdb_alloc();
+	if (!jool->nat64.frags)
+		goto frags_fail;
+	jool->nat64.flows = flowcache_alloc();
+	if (!jool->nat64.flows)
+		goto flows_fail;
 
 	jool->is_hairpin = is_hairpin_nat64;
 	jool->handling_hairpinning = handling_hairpinning_nat64;
 	return 0;
 
+flows_fail:
+	fragdb_put(jool->nat64.frags);
+frags_fail:
+	joold_put(jool->nat64.joold);
 joold_fail:
 	bib_put(jool->nat64.bib);
 bib_fail:
@@ -463,7 +522,7 @@ static int __xlator_add(struct jool_instance *new, struct xlator *result)
 		memcpy(ops, netfilter_hooks, sizeof(netfilter_hooks));
 
 		error = nf_register_net_hooks(new->jool.ns, ops,
-				ARRAY_SIZE(netfilter_hooks));
+				nf_hook_count(&new->jool));
 		if (error) {
 			__wkfree("nf_hook_ops", ops);
 			return error;
@@ -653,7 +712,12 @@ int xlator_replace(struct xlator *jool)
 	old = find_instance(jool->ns, xlator_flags2xt(jool->flags), jool->iname);
 	if (!old) {
 		/* Not found, hence not replacing. Add it instead. */
-		error = __xlator_add(new, NULL);
+		error = xlator_is_nat64(&new->jool)
+				? bib_index_subscribers(new->jool.nat64.bib,
+						&new->jool)
+				: 0;
+		if (!error)
+			error = __xlator_add(new, NULL);
 		if (error)
 			destroy_jool_instance(new, false);
 
@@ -661,6 +725,7 @@ int xlator_replace(struct xlator *jool)
 		return error;
 	}
 
+	error = -EINVAL;
 	if (xlator_get_framework(&old->jool) != xlator_get_framework(&new->jool)) {
 		log_err("Sorry; you can't change an instance's framework for now.");
 		goto abort;
@@ -671,6 +736,12 @@ int xlator_replace(struct xlator *jool)
 		log_err("Sorry; you can't change a NAT64 instance's pool6 for now.");
 		goto abort;
 	}
+	if (xlator_is_nat64(&new->jool)) {
+		/* subscriber-prefix-len might have changed. */
+		error = bib_index_subscribers(old->jool.nat64.bib, &new->jool);
+		if (error)
+			goto abort;
+	}
 
 	new->hash_set = old->hash_set;
 	new->hash = old->hash;
@@ -678,14 +749,16 @@ int xlator_replace(struct xlator *jool)
 	new->nf_ops = old->nf_ops;
 #endif
 	/*
-	 * The old BIB and joold must survive,
+	 * The old BIB, joold and fragment tracker must survive,
 	 * because they shouldn't be reset by atomic configuration.
 	 */
 	if (xlator_is_nat64(&new->jool)) {
 		bib_put(new->jool.nat64.bib);
 		joold_put(new->jool.nat64.joold);
+		fragdb_put(new->jool.nat64.frags);
 		new->jool.nat64.bib = old->jool.nat64.bib;
 		new->jool.nat64.joold = old->jool.nat64.joold;
+		new->jool.nat64.frags = old->jool.nat64.frags;
 	}
 
 	hash_del(&old->table_hook);
@@ -706,6 +779,7 @@ int xlator_replace(struct xlator *jool)
 	if (xlator_is_nat64(&old->jool)) {
 		old->jool.nat64.bib = NULL;
 		old->jool.nat64.joold = NULL;
+		old->jool.nat64.frags = NULL;
 	}
 
 	destroy_jool_instance(old, false);
@@ -715,7 +789,7 @@ int xlator_replace(struct xlator *jool)
 abort:
 	mutex_unlock(&lock);
 	destroy_jool_instance(new, false);
-	return -EINVAL;
+	return error;
 }
 
 int xlator_flush(xlator_type xt)
@@ -837,6 +911,35 @@ int xlator_find_netfilter(struct net *ns, struct xlator *result)
 	return -ESRCH;
 }
 
+/**
+ * xlator_tracks_frags - Returns whether @ns's Netfilter instance is a NAT64
+ * that tracks fragments.
+ *
+ * Cheaper than xlator_find_netfilter(), since it doesn't copy the instance nor
+ * take references. Meant for the fragment hooks, which see every fragment in
+ * the namespace.
+ */
+bool xlator_tracks_frags(struct net *ns)
+{
+	struct list_head *list;
+	struct jool_instance *instance;
+	bool result = false;
+
+	rcu_read_lock_bh();
+
+	list = rcu_dereference_bh(netfilter_instances);
+	list_for_each_entry_rcu(instance, list, list_hook) {
+		if (ns == instance->jool.ns) {
+			result = xlator_is_nat64(&instance->jool)
+				&& instance->jool.globals.nat64.frag_tracking;
+			break;
+		}
+	}
+
+	rcu_read_unlock_bh();
+	return result;
+}
+
 /*
  * I am kref_put()ting and there's no lock.
  * This can be dangerous: http://lwn.net/Articles/93617/
@@ -854,6 +957,7 @@ void xlator_put(struct xlator *jool)
 	case XT_SIIT:
 		eamt_put(jool->siit.eamt);
 		denylist4_put(jool->siit.denylist4);
+		rtcache_put(jool->siit.route_cache);
 		return;
 
 	case XT_NAT64:
@@ -866,6 +970,9 @@ void xlator_put(struct xlator *jool)
 			bib_put(jool->nat64.bib);
 		if (jool->nat64.joold)
 			joold_put(jool->nat64.joold);
+		if (jool->nat64.frags)
+			fragdb_put(jool->nat64.frags);
+		flowcache_put(jool->nat64.flows);
 		return;
 	}
 
@@ -911,6 +1018,46 @@ int xlator_foreach(xlator_type xt, xlator_foreach_cb cb, void *args,
 	return 0;
 }
 
+static int get_first(struct xlator *jool, void *arg)
+{
+	xlator_get(jool);
+	memcpy(arg, jool, sizeof(*jool));
+	return 1; /* Stop */
+}
+
+/**
+ * xlator_next - Copies the first @xt instance that follows @offset (or the
+ * first @xt instance, if @offset is NULL) into @result.
+ *
+ * This is xlator_foreach() for callers that need to sleep: Instead of running a
+ * callback inside the RCU read-side critical section, it hands over one
+ * instance at a time, outside of it. @result holds a reference; release it with
+ * xlator_put(). Use xlator_offset() to continue the walk.
+ *
+ * Returns -ESRCH when there are no more instances (or @offset is gone).
+ */
+int xlator_next(xlator_type xt, struct instance_entry_usr *offset,
+		struct xlator *result)
+{
+	int error;
+
+	error = xlator_foreach(xt, get_first, result, offset);
+	if (error == 1)
+		return 0;
+	return error ? error : -ESRCH;
+}
+
+/**
+ * xlator_offset - Initializes @offset so xlator_next() can continue after
+ * @jool.
+ */
+void xlator_offset(struct xlator const *jool, struct instance_entry_usr *offset)
+{
+	offset->ns = ((__u64)jool->ns) & 0xFFFFFFFF;
+	offset->xf = xlator_flags2xf(jool->flags);
+	memcpy(offset->iname, jool->iname, INAME_MAX_SIZE);
+}
+
 xlator_type xlator_get_type(struct xlator const *instance)
 {
 	return xlator_is_nat64(instance) ? XT_NAT64 : XT_SIIT;
@@ -37,11 +37,14 @@ struct xlator {
 		struct {
 			struct eam_table *eamt;
 			struct addr4_pool *denylist4;
+			struct route_cache *route_cache;
 		} siit;
 		struct {
 			struct pool4 *pool4;
 			struct bib *bib;
 			struct joold_queue *joold;
+			struct fragdb *frags;
+			struct flowcache *flows;
 		} nat64;
 	};
 
@@ -73,12 +76,17 @@ int xlator_find(struct net *ns, xlator_flags flags, const char *iname,
 int xlator_find_current(const char *iname, xlator_flags flags,
 		struct xlator *result);
 int xlator_find_netfilter(struct net *ns, struct xlator *result);
+bool xlator_tracks_frags(struct net *ns);
 void xlator_put(struct xlator *instance);
 
 typedef int (*xlator_foreach_cb)(struct xlator *, void *);
 int xlator_foreach(xlator_type xt, xlator_foreach_cb cb, void *args,
 		struct instance_entry_usr *offset);
 
+int xlator_next(xlator_type xt, struct instance_entry_usr *offset,
+		struct xlator *result);
+void xlator_offset(struct xlator const *jool, struct instance_entry_usr *offset);
+
 xlator_type xlator_get_type(struct xlator const *instance);
 xlator_framework xlator_get_framework(struct xlator const *instance);
 
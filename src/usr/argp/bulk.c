@@ -0,0 +1,144 @@
+#include "usr/argp/bulk.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "usr/argp/log.h"
+#include "usr/util/file.h"
+
+static void *get_entry(struct bulk_file *file, unsigned int index)
+{
+	return ((char *)file->entries) + index * file->entry_size;
+}
+
+static int grow(struct bulk_file *file)
+{
+	unsigned int capacity;
+	void *entries;
+	unsigned int *lines;
+
+	capacity = file->capacity ? (2 * file->capacity) : 64;
+
+	entries = realloc(file->entries, capacity * file->entry_size);
+	if (!entries)
+		return -ENOMEM;
+	file->entries = entries;
+
+	lines = realloc(file->lines, capacity * sizeof(*lines));
+	if (!lines)
+		return -ENOMEM;
+	file->lines = lines;
+
+	file->capacity = capacity;
+	return 0;
+}
+
+static int tokenize(char *line, char **argv)
+{
+	char *saveptr;
+	char *token;
+	int argc;
+
+	argc = 0;
+	for (token = strtok_r(line, " \t\r", &saveptr);
+			token;
+			token = strtok_r(NULL, " \t\r", &saveptr)) {
+		if (argc >= BULK_MAX_TOKENS)
+			return -E2BIG;
+		argv[argc++] = token;
+	}
+
+	return argc;
+}
+
+/**
+ * Parses every entry in file @name. On success, remember to
+ * bulk_file_cleanup() @file when you're done.
+ */
+int bulk_file_read(struct bulk_file *file, char const *name, size_t entry_size,
+		bulk_parse_line_cb parse, void const *arg)
+{
+	char *buffer;
+	char *line;
+	char *next;
+	char *argv[BULK_MAX_TOKENS];
+	int argc;
+	unsigned int line_number;
+	struct jool_result result;
+	int error;
+
+	memset(file, 0, sizeof(*file));
+	file->name = name;
+	file->entry_size = entry_size;
+
+	result = file_to_string(name, &buffer);
+	if (result.error)
+		return pr_result(&result);
+
+	line_number = 0;
+	for (line = buffer; line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*(next++) = '\0';
+		line_number++;
+
+		argc = tokenize(line, argv);
+		if (argc < 0) {
+			pr_err("%s:%u: Too many tokens.", name, line_number);
+			error = argc;
+			goto fail;
+		}
+		if (argc == 0 || argv[0][0] == '#')
+			continue;
+
+		if (file->count >= file->capacity) {
+			error = grow(file);
+			if (error) {
+				pr_err("Out of memory.");
+				goto fail;
+			}
+		}
+
+		error = parse(argc, argv, get_entry(file, file->count), arg);
+		if (error) {
+			pr_err("(%s:%u)", name, line_number);
+			goto fail;
+		}
+
+		file->lines[file->count] = line_number;
+		file->count++;
+	}
+
+	free(buffer);
+	return 0;
+
+fail:
+	free(buffer);
+	bulk_file_cleanup(file);
+	return error;
+}
+
+void bulk_file_cleanup(struct bulk_file *file)
+{
+	free(file->entries);
+	free(file->lines);
+	file->entries = NULL;
+	file->lines = NULL;
+	file->count = 0;
+	file->capacity = 0;
+}
+
+void bulk_file_print_failure(unsigned int index, int error, void *arg)
+{
+	struct bulk_file *file = arg;
+
+	if (index >= file->count) {
+		pr_err("The kernel module reported a failure on unknown entry #%u.",
+				index);
+		return;
+	}
+
+	pr_err("%s:%u: %s", file->name, file->lines[index], strerror(-error));
+}
@@ -0,0 +1,40 @@
+#ifndef SRC_USR_ARGP_BULK_H_
+#define SRC_USR_ARGP_BULK_H_
+
+#include <stddef.h>
+
+/*
+ * Support for the `--file` flag of the add commands.
+ *
+ * The file lists one entry per line, in the same format as the command's
+ * positional arguments. Empty lines and lines starting with '#' are ignored.
+ */
+
+#define BULK_MAX_TOKENS 8
+
+struct bulk_file {
+	char const *name;
+	/* Array of @count entries, @entry_size bytes each. */
+	void *entries;
+	size_t entry_size;
+	/* Line number of each entry, for error messages. */
+	unsigned int *lines;
+	unsigned int count;
+	unsigned int capacity;
+};
+
+/*
+ * Fills @entry out of the @argc tokens of one of the file's lines.
+ * Returns 0 on success. Otherwise, the error has to have already been printed.
+ */
+typedef int (*bulk_parse_line_cb)(int argc, char **argv, void *entry,
+		void const *arg);
+
+int bulk_file_read(struct bulk_file *file, char const *name, size_t entry_size,
+		bulk_parse_line_cb parse, void const *arg);
+void bulk_file_cleanup(struct bulk_file *file);
+
+/* Meant to be used as a joolnl_bulk_failure_cb; @file is the bulk_file. */
+void bulk_file_print_failure(unsigned int index, int error, void *file);
+
+#endif /* SRC_USR_ARGP_BULK_H_ */
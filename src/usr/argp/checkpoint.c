@@ -0,0 +1,351 @@
+#include "usr/argp/checkpoint.h"
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "usr/nl/session.h"
+#include "usr/argp/log.h"
+
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof(array[0]))
+
+/* Only the first few failed imports are printed; the rest are just counted. */
+#define MAX_PRINTED_FAILURES 10
+
+static __u64 now_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	return ((__u64)now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+static void init_header(struct checkpoint_header *hdr, __u64 timestamp,
+		__u64 count)
+{
+	memcpy(hdr->magic, CHECKPOINT_MAGIC, sizeof(hdr->magic));
+	hdr->version = htonl(CHECKPOINT_VERSION);
+	hdr->record_size = htonl(sizeof(struct checkpoint_record));
+	hdr->timestamp = htobe64(timestamp);
+	hdr->count = htobe64(count);
+}
+
+static void session2record(struct session_entry_usr const *session,
+		struct checkpoint_record *record)
+{
+	memcpy(record->src6, &session->src6.l3, sizeof(record->src6));
+	record->src6_port = htons(session->src6.l4);
+	memcpy(record->dst6, &session->dst6.l3, sizeof(record->dst6));
+	record->dst6_port = htons(session->dst6.l4);
+	memcpy(record->src4, &session->src4.l3, sizeof(record->src4));
+	record->src4_port = htons(session->src4.l4);
+	memcpy(record->dst4, &session->dst4.l3, sizeof(record->dst4));
+	record->dst4_port = htons(session->dst4.l4);
+	record->proto = session->proto;
+	record->state = session->state;
+	record->timer = session->timer;
+	record->reserved = 0;
+	record->expiration = htonl(session->dying_time);
+	record->age = htonl(session->age);
+}
+
+static void record2session(struct checkpoint_record const *record,
+		struct session_entry_usr *session)
+{
+	memcpy(&session->src6.l3, record->src6, sizeof(record->src6));
+	session->src6.l4 = ntohs(record->src6_port);
+	memcpy(&session->dst6.l3, record->dst6, sizeof(record->dst6));
+	session->dst6.l4 = ntohs(record->dst6_port);
+	memcpy(&session->src4.l3, record->src4, sizeof(record->src4));
+	session->src4.l4 = ntohs(record->src4_port);
+	memcpy(&session->dst4.l3, record->dst4, sizeof(record->dst4));
+	session->dst4.l4 = ntohs(record->dst4_port);
+	session->proto = record->proto;
+	session->state = record->state;
+	session->timer = record->timer;
+	session->dying_time = ntohl(record->expiration);
+	session->age = ntohl(record->age);
+}
+
+struct export_args {
+	FILE *file;
+	__u64 count;
+};
+
+static struct jool_result export_session(struct session_entry_usr const *entry,
+		void *arg)
+{
+	struct export_args *args = arg;
+	struct checkpoint_record record;
+
+	session2record(entry, &record);
+	if (fwrite(&record, sizeof(record), 1, args->file) != 1)
+		return result_from_error(-errno, "Cannot write the checkpoint: %s",
+				strerror(errno));
+
+	args->count++;
+	return result_success();
+}
+
+/*
+ * Dumps the three session tables into @file_name.
+ *
+ * The sessions are fetched through the regular session foreach, so the kernel
+ * only holds each table's lock in short windows.
+ */
+int checkpoint_export(struct joolnl_socket *sk, char const *iname,
+		char const *file_name)
+{
+	static const l4_protocol protos[] = {
+		L4PROTO_TCP, L4PROTO_UDP, L4PROTO_ICMP
+	};
+	struct checkpoint_header hdr;
+	struct export_args args;
+	struct jool_result result;
+	__u64 timestamp;
+	unsigned int i;
+	int error;
+
+	args.file = fopen(file_name, "wb");
+	if (!args.file) {
+		error = errno;
+		pr_err("Cannot open '%s': %s", file_name, strerror(error));
+		return -error;
+	}
+	args.count = 0;
+
+	/* Placeholder; the count is only known at the end. */
+	timestamp = now_ms();
+	init_header(&hdr, timestamp, 0);
+	if (fwrite(&hdr, sizeof(hdr), 1, args.file) != 1)
+		goto write_failure;
+
+	for (i = 0; i < ARRAY_SIZE(protos); i++) {
+		result = joolnl_session_foreach(sk, iname, protos[i], NULL,
+				export_session, &args);
+		if (result.error) {
+			error = pr_result(&result);
+			goto end;
+		}
+	}
+
+	init_header(&hdr, timestamp, args.count);
+	if (fseek(args.file, 0, SEEK_SET))
+		goto write_failure;
+	if (fwrite(&hdr, sizeof(hdr), 1, args.file) != 1)
+		goto write_failure;
+
+	error = fclose(args.file);
+	if (error) {
+		error = errno;
+		pr_err("Cannot close '%s': %s", file_name, strerror(error));
+		return -error;
+	}
+
+	printf("Exported %llu sessions.\n", (unsigned long long)args.count);
+	return 0;
+
+write_failure:
+	error = -errno;
+	pr_err("Cannot write '%s': %s", file_name, strerror(-error));
+end:
+	fclose(args.file);
+	return error;
+}
+
+static int read_records(char const *file_name,
+		struct session_entry_usr **result, unsigned int *count,
+		__u64 *timestamp)
+{
+	FILE *file;
+	struct checkpoint_header hdr;
+	struct checkpoint_record record;
+	struct session_entry_usr *sessions;
+	__u64 total;
+	size_t record_size;
+	size_t read_size;
+	unsigned int i;
+	int error;
+
+	file = fopen(file_name, "rb");
+	if (!file) {
+		error = errno;
+		pr_err("Cannot open '%s': %s", file_name, strerror(error));
+		return -error;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1)
+		goto truncated;
+	if (memcmp(hdr.magic, CHECKPOINT_MAGIC, sizeof(hdr.magic)) != 0) {
+		pr_err("'%s' is not a session checkpoint.", file_name);
+		error = -EINVAL;
+		goto end;
+	}
+	if (ntohl(hdr.version) != CHECKPOINT_VERSION) {
+		pr_err("Unsupported checkpoint version: %u", ntohl(hdr.version));
+		error = -EINVAL;
+		goto end;
+	}
+	record_size = ntohl(hdr.record_size);
+	if (record_size < CHECKPOINT_RECORD_MIN_SIZE) {
+		pr_err("The checkpoint's records are too small. (%zu bytes)",
+				record_size);
+		error = -EINVAL;
+		goto end;
+	}
+	total = be64toh(hdr.count);
+	if (total > UINT_MAX) {
+		pr_err("The checkpoint has too many sessions. (%llu)",
+				(unsigned long long)total);
+		error = -E2BIG;
+		goto end;
+	}
+
+	sessions = calloc(total ? total : 1, sizeof(*sessions));
+	if (!sessions) {
+		pr_err("Out of memory.");
+		error = -ENOMEM;
+		goto end;
+	}
+
+	read_size = (record_size < sizeof(record)) ? record_size : sizeof(record);
+	memset(&record, 0, sizeof(record));
+
+	for (i = 0; i < total; i++) {
+		if (fread(&record, read_size, 1, file) != 1)
+			goto truncated_free;
+		if (record_size > read_size) {
+			if (fseek(file, record_size - read_size, SEEK_CUR))
+				goto truncated_free;
+		}
+		record2session(&record, &sessions[i]);
+	}
+
+	fclose(file);
+	*result = sessions;
+	*count = total;
+	*timestamp = be64toh(hdr.timestamp);
+	return 0;
+
+truncated_free:
+	free(sessions);
+truncated:
+	pr_err("'%s' seems to be truncated.", file_name);
+	error = -EINVAL;
+end:
+	fclose(file);
+	return error;
+}
+
+/*
+ * The kernel keeps each timer's sessions sorted by expiration, and looks for
+ * the insertion point starting from the youngest. Feeding it the sessions in
+ * this order makes every insertion O(1).
+ */
+static int compare_sessions(const void *a, const void *b)
+{
+	struct session_entry_usr const *s1 = a;
+	struct session_entry_usr const *s2 = b;
+
+	if (s1->proto != s2->proto)
+		return ((int)s1->proto) - ((int)s2->proto);
+	if (s1->timer != s2->timer)
+		return ((int)s1->timer) - ((int)s2->timer);
+	if (s1->dying_time != s2->dying_time)
+		return (s1->dying_time < s2->dying_time) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Sessions keep whatever time they had left at export time, minus the time
+ * that has passed since then. Those that would have already expired are
+ * dropped. Likewise, they get older by that time.
+ */
+static unsigned int age_sessions(struct session_entry_usr *sessions,
+		unsigned int count, __u64 timestamp)
+{
+	__u64 now;
+	__u64 elapsed;
+	__u64 age;
+	unsigned int i, j;
+
+	now = now_ms();
+	elapsed = (now > timestamp) ? (now - timestamp) : 0;
+
+	for (i = 0, j = 0; i < count; i++) {
+		if (sessions[i].dying_time <= elapsed)
+			continue;
+		sessions[j] = sessions[i];
+		sessions[j].dying_time -= elapsed;
+		age = sessions[j].age + elapsed;
+		sessions[j].age = (age > UINT_MAX) ? UINT_MAX : age;
+		j++;
+	}
+
+	return j;
+}
+
+struct import_failures {
+	struct session_entry_usr const *sessions;
+	unsigned int count;
+};
+
+static void print_failure(unsigned int index, int error, void *arg)
+{
+	struct import_failures *failures = arg;
+	struct session_entry_usr const *session = &failures->sessions[index];
+	char src6[INET6_ADDRSTRLEN];
+	char dst4[INET_ADDRSTRLEN];
+
+	failures->count++;
+	if (failures->count > MAX_PRINTED_FAILURES)
+		return;
+
+	inet_ntop(AF_INET6, &session->src6.l3, src6, sizeof(src6));
+	inet_ntop(AF_INET, &session->dst4.l3, dst4, sizeof(dst4));
+	pr_err("Session [%s]#%u -> %s#%u: %s", src6, session->src6.l4,
+			dst4, session->dst4.l4, strerror(abs(error)));
+}
+
+int checkpoint_import(struct joolnl_socket *sk, char const *iname,
+		char const *file_name)
+{
+	struct session_entry_usr *sessions;
+	struct import_failures failures;
+	struct jool_result result;
+	unsigned int total;
+	unsigned int count;
+	__u64 timestamp;
+	int error;
+
+	error = read_records(file_name, &sessions, &total, &timestamp);
+	if (error)
+		return error;
+
+	count = age_sessions(sessions, total, timestamp);
+	qsort(sessions, count, sizeof(*sessions), compare_sessions);
+
+	failures.sessions = sessions;
+	failures.count = 0;
+	result = joolnl_session_add_bulk(sk, iname, sessions, count,
+			print_failure, &failures);
+	if (failures.count > MAX_PRINTED_FAILURES) {
+		pr_err("(%u more failures omitted.)",
+				failures.count - MAX_PRINTED_FAILURES);
+	}
+
+	if (result.error) {
+		error = pr_result(&result);
+	} else {
+		printf("Imported %u sessions. (%u had already expired.)\n",
+				count, total - count);
+	}
+
+	free(sessions);
+	return error;
+}
@@ -0,0 +1,57 @@
+#ifndef SRC_USR_ARGP_CHECKPOINT_H_
+#define SRC_USR_ARGP_CHECKPOINT_H_
+
+#include <stddef.h>
+#include "usr/nl/core.h"
+
+/*
+ * Session table checkpoints. (`jool session export` and `jool session import`.)
+ *
+ * The file is a checkpoint_header followed by checkpoint_header.count
+ * checkpoint_records. Every field is big endian.
+ */
+
+#define CHECKPOINT_MAGIC "JOOLSESS"
+#define CHECKPOINT_VERSION 1
+
+struct checkpoint_header {
+	char magic[8];
+	__be32 version;
+	/* sizeof(struct checkpoint_record); lets old versions skip new fields. */
+	__be32 record_size;
+	/* Unix time of the export, in milliseconds. */
+	__be64 timestamp;
+	__be64 count;
+} __attribute__((packed));
+
+struct checkpoint_record {
+	__u8 src6[16];
+	__be16 src6_port;
+	__u8 dst6[16];
+	__be16 dst6_port;
+	__u8 src4[4];
+	__be16 src4_port;
+	__u8 dst4[4];
+	__be16 dst4_port;
+	__u8 proto;
+	__u8 state;
+	__u8 timer;
+	__u8 reserved;
+	/* Milliseconds the session had left, as of the export. */
+	__be32 expiration;
+	/*
+	 * Milliseconds since the session was created, as of the export.
+	 * (Older checkpoints lack it; their sessions are imported as new.)
+	 */
+	__be32 age;
+} __attribute__((packed));
+
+/* Size of the records of the checkpoints that predate @age. */
+#define CHECKPOINT_RECORD_MIN_SIZE offsetof(struct checkpoint_record, age)
+
+int checkpoint_export(struct joolnl_socket *sk, char const *iname,
+		char const *file_name);
+int checkpoint_import(struct joolnl_socket *sk, char const *iname,
+		char const *file_name);
+
+#endif /* SRC_USR_ARGP_CHECKPOINT_H_ */
@@ -0,0 +1,307 @@
+#include "usr/argp/evlog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "usr/nl/session.h"
+#include "usr/argp/log.h"
+
+#define MAX_FILE_NAME 4096
+/* How often the collector wakes up to check signals and file age. */
+#define WAKEUP_SECS 1
+
+/*
+ * The current output file. Compression is delegated to a gzip child process,
+ * which reads the records from @pipe.
+ */
+struct evlog_file {
+	FILE *pipe;
+	pid_t gzip;
+	unsigned long long size;
+	time_t birth;
+};
+
+struct evlog_args {
+	char const *prefix;
+	unsigned long long max_size;
+	unsigned int max_age;
+
+	struct evlog_file file;
+	unsigned long long events;
+	unsigned long long dropped;
+	/* Receive buffer overflows; the batches they lost are not counted. */
+	unsigned int overruns;
+};
+
+static volatile sig_atomic_t stop;
+
+static void handle_signal(int signum)
+{
+	stop = 1;
+}
+
+/*
+ * libnl retries interrupted receives, so the flag is only noticed on the next
+ * wakeup. (See WAKEUP_SECS.)
+ */
+static int setup_signals(void)
+{
+	struct sigaction action;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handle_signal;
+	sigemptyset(&action.sa_mask);
+
+	if (sigaction(SIGINT, &action, NULL) || sigaction(SIGTERM, &action, NULL)) {
+		pr_err("Cannot install the signal handlers: %s", strerror(errno));
+		return -errno;
+	}
+
+	/* A dead gzip should surface as a write error, not kill the collector. */
+	signal(SIGPIPE, SIG_IGN);
+	return 0;
+}
+
+static int open_file(struct evlog_args *args)
+{
+	char name[MAX_FILE_NAME];
+	char stamp[32];
+	struct tm tm;
+	time_t now;
+	unsigned int i;
+	int fds[2];
+	int out;
+	pid_t pid;
+	int error;
+
+	now = time(NULL);
+	gmtime_r(&now, &tm);
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+
+	/* Size rotations can happen more than once per second. */
+	for (i = 0; ; i++) {
+		error = i
+			? snprintf(name, sizeof(name), "%s-%s.%u.bin.gz",
+					args->prefix, stamp, i)
+			: snprintf(name, sizeof(name), "%s-%s.bin.gz",
+					args->prefix, stamp);
+		if (error >= sizeof(name)) {
+			pr_err("The file name prefix is too long.");
+			return -ENAMETOOLONG;
+		}
+
+		out = open(name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+		if (out >= 0 || errno != EEXIST)
+			break;
+	}
+	if (out < 0) {
+		error = errno;
+		pr_err("Cannot create '%s': %s", name, strerror(error));
+		return -error;
+	}
+
+	if (pipe(fds)) {
+		error = errno;
+		pr_err("Cannot create a pipe: %s", strerror(error));
+		goto close_out;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		error = errno;
+		pr_err("Cannot fork: %s", strerror(error));
+		goto close_pipe;
+	}
+
+	if (pid == 0) {
+		/*
+		 * Own process group, so a terminal ^C only reaches the collector,
+		 * which then closes the pipe and lets gzip finish the file.
+		 */
+		setpgid(0, 0);
+		if (dup2(fds[0], STDIN_FILENO) < 0 || dup2(out, STDOUT_FILENO) < 0)
+			_exit(EXIT_FAILURE);
+		close(fds[0]);
+		close(fds[1]);
+		execlp("gzip", "gzip", "-c", NULL);
+		_exit(EXIT_FAILURE);
+	}
+
+	close(fds[0]);
+	close(out);
+
+	args->file.pipe = fdopen(fds[1], "w");
+	if (!args->file.pipe) {
+		error = errno;
+		pr_err("Cannot open the gzip pipe: %s", strerror(error));
+		close(fds[1]);
+		waitpid(pid, NULL, 0);
+		return -error;
+	}
+	args->file.gzip = pid;
+	args->file.size = 0;
+	args->file.birth = now;
+
+	fprintf(stderr, "Writing events to '%s'.\n", name);
+	return 0;
+
+close_pipe:
+	close(fds[0]);
+	close(fds[1]);
+close_out:
+	close(out);
+	return -error;
+}
+
+static int close_file(struct evlog_args *args)
+{
+	int status;
+	int error = 0;
+
+	if (!args->file.pipe)
+		return 0;
+
+	if (fclose(args->file.pipe)) {
+		error = -errno;
+		pr_err("Cannot flush the events: %s", strerror(errno));
+	}
+	args->file.pipe = NULL;
+
+	if (waitpid(args->file.gzip, &status, 0) < 0) {
+		pr_err("Cannot wait for gzip: %s", strerror(errno));
+		return error ? error : -ECHILD;
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		pr_err("gzip failed. (Is it installed?)");
+		return error ? error : -EIO;
+	}
+
+	return error;
+}
+
+/* Empty files are never rotated, so quiet periods don't leave a trail. */
+static bool needs_rotation(struct evlog_args *args)
+{
+	if (!args->file.size)
+		return false;
+	if (args->max_size && args->file.size >= args->max_size)
+		return true;
+	if (args->max_age && time(NULL) - args->file.birth >= args->max_age)
+		return true;
+	return false;
+}
+
+static int rotate(struct evlog_args *args)
+{
+	int error;
+
+	error = close_file(args);
+	if (error)
+		return error;
+	return open_file(args);
+}
+
+static struct jool_result write_events(struct jool_event const *events,
+		unsigned int count, unsigned int dropped, void *arg)
+{
+	struct evlog_args *args = arg;
+	int error;
+
+	if (dropped) {
+		fprintf(stderr, "The kernel dropped %u events.\n", dropped);
+		args->dropped += dropped;
+	}
+
+	if (needs_rotation(args)) {
+		error = rotate(args);
+		if (error)
+			return result_from_error(error, "Cannot rotate the log file.");
+	}
+
+	if (fwrite(events, sizeof(*events), count, args->file.pipe) != count) {
+		return result_from_error(-EIO, "Cannot write the events: %s",
+				strerror(errno));
+	}
+
+	args->file.size += count * sizeof(*events);
+	args->events += count;
+	return result_success();
+}
+
+static int set_wakeup(struct joolnl_socket *sk)
+{
+	struct timeval timeout = { .tv_sec = WAKEUP_SECS };
+
+	if (setsockopt(nl_socket_get_fd(sk->sk), SOL_SOCKET, SO_RCVTIMEO,
+			&timeout, sizeof(timeout))) {
+		pr_err("Cannot set the socket's receive timeout: %s",
+				strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+int evlog_collect(struct joolnl_socket *sk, char const *iname,
+		char const *prefix, unsigned long long max_size,
+		unsigned int max_age)
+{
+	struct evlog_args args;
+	struct jool_result result;
+	unsigned int overruns;
+	int error;
+
+	memset(&args, 0, sizeof(args));
+	args.prefix = prefix;
+	args.max_size = max_size;
+	args.max_age = max_age;
+
+	result = joolnl_session_events_subscribe(sk);
+	if (result.error)
+		return pr_result(&result);
+	error = set_wakeup(sk);
+	if (error)
+		return error;
+	error = setup_signals();
+	if (error)
+		return error;
+	error = open_file(&args);
+	if (error)
+		return error;
+
+	while (!stop) {
+		overruns = args.overruns;
+		result = joolnl_session_events_recv(sk, iname, write_events,
+				&args.overruns, &args);
+		if (result.error) {
+			error = pr_result(&result);
+			break;
+		}
+		if (args.overruns != overruns)
+			fprintf(stderr, "The receive buffer overflowed; some events were lost.\n");
+		if (needs_rotation(&args)) {
+			error = rotate(&args);
+			if (error)
+				break;
+		}
+	}
+
+	if (close_file(&args) && !error)
+		error = -EIO;
+
+	fprintf(stderr, "Collected %llu events. (The kernel dropped %llu.)\n",
+			args.events, args.dropped);
+	if (args.overruns) {
+		fprintf(stderr, "The receive buffer overflowed %u times; the events lost there are not included in the counts.\n",
+				args.overruns);
+	}
+	return error;
+}
@@ -0,0 +1,18 @@
+#ifndef SRC_USR_ARGP_EVLOG_H_
+#define SRC_USR_ARGP_EVLOG_H_
+
+#include "usr/nl/core.h"
+
+/*
+ * Binary BIB/session event collector. (`jool session log`.)
+ *
+ * Writes the kernel's struct jool_event records, verbatim, into gzipped files
+ * named <prefix>-<UTC timestamp>.bin.gz. A new file is started whenever the
+ * current one reaches @max_size uncompressed bytes or @max_age seconds.
+ * (Zero means "no limit.")
+ */
+int evlog_collect(struct joolnl_socket *sk, char const *iname,
+		char const *prefix, unsigned long long max_size,
+		unsigned int max_age);
+
+#endif /* SRC_USR_ARGP_EVLOG_H_ */
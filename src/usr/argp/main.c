@@ -73,6 +73,11 @@ static struct cmd_option stats_ops[] = {
 			.xt = XT_ANY,
 			.handler = handle_stats_display,
 			.handle_autocomplete = autocomplete_stats_display,
+		}, {
+			.label = "subscribers",
+			.xt = XT_NAT64,
+			.handler = handle_stats_subscribers,
+			.handle_autocomplete = autocomplete_stats_subscribers,
 		},
 		{ 0 },
 };
@@ -227,6 +232,26 @@ static struct cmd_option session_ops[] = {
 			.xt = XT_NAT64,
 			.handler = handle_session_display,
 			.handle_autocomplete = autocomplete_session_display,
+		}, {
+			.label = "stats",
+			.xt = XT_NAT64,
+			.handler = handle_session_stats,
+			.handle_autocomplete = autocomplete_session_stats,
+		}, {
+			.label = "export",
+			.xt = XT_NAT64,
+			.handler = handle_session_export,
+			.handle_autocomplete = autocomplete_session_checkpoint,
+		}, {
+			.label = "import",
+			.xt = XT_NAT64,
+			.handler = handle_session_import,
+			.handle_autocomplete = autocomplete_session_checkpoint,
+		}, {
+			.label = "log",
+			.xt = XT_NAT64,
+			.handler = handle_session_log,
+			.handle_autocomplete = autocomplete_session_log,
 		},
 		{ 0 },
 };
@@ -247,6 +272,11 @@ static struct cmd_option joold_ops[] = {
 			.xt = XT_NAT64,
 			.handler = handle_joold_advertise,
 			.handle_autocomplete = autocomplete_joold_advertise,
+		}, {
+			.label = "resync",
+			.xt = XT_NAT64,
+			.handler = handle_joold_resync,
+			.handle_autocomplete = autocomplete_joold_resync,
 		},
 		{ 0 },
 };
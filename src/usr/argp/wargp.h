@@ -41,6 +41,7 @@ extern struct wargp_type wt_string;
 extern struct wargp_type wt_addr;
 extern struct wargp_type wt_prefix6;
 extern struct wargp_type wt_prefix4;
+extern struct wargp_type wt_port_range;
 
 struct wargp_option {
 	const char *name;
@@ -81,12 +82,21 @@ struct wargp_prefix4 {
 	struct ipv4_prefix prefix;
 };
 
+struct wargp_port_range {
+	bool set;
+	struct port_range range;
+};
+
 #define ARGP_TCP 't'
 #define ARGP_UDP 'u'
 #define ARGP_ICMP 'i'
 #define ARGP_CSV 2000
 #define ARGP_NO_HEADERS 2001
 #define ARGP_NUMERIC 2002
+#define ARGP_FILE 2003
+#define ARGP_SRC6 2004
+#define ARGP_SRC4 2005
+#define ARGP_PORTS 2006
 #define ARGP_FORCE 'f'
 
 #define WARGP_TCP(container, field, description) \
@@ -143,6 +153,37 @@ struct wargp_prefix4 {
 		.type = &wt_bool, \
 	}
 
+#define WARGP_FILE(container, field) { \
+		.name = "file", \
+		.key = ARGP_FILE, \
+		.doc = "Add the entries listed in this file (one per line)", \
+		.offset = offsetof(container, field), \
+		.type = &wt_string, \
+	}
+
+/* BIB and session display filters. */
+#define WARGP_SRC6(container, field) { \
+		.name = "src6", \
+		.key = ARGP_SRC6, \
+		.doc = "Only print the entries whose IPv6 node address belongs to this prefix", \
+		.offset = offsetof(container, field), \
+		.type = &wt_prefix6, \
+	}
+#define WARGP_SRC4(container, field) { \
+		.name = "src4", \
+		.key = ARGP_SRC4, \
+		.doc = "Only print the entries whose pool4 address belongs to this prefix", \
+		.offset = offsetof(container, field), \
+		.type = &wt_prefix4, \
+	}
+#define WARGP_PORTS(container, field) { \
+		.name = "ports", \
+		.key = ARGP_PORTS, \
+		.doc = "Only print the entries whose pool4 port (or ICMP identifier) belongs to this range", \
+		.offset = offsetof(container, field), \
+		.type = &wt_port_range, \
+	}
+
 int wargp_parse(struct wargp_option *wopts, int argc, char **argv, void *input);
 void print_wargp_opts(struct wargp_option *opts);
 
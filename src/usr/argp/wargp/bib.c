@@ -2,6 +2,7 @@
 
 #include <string.h>
 
+#include "usr/argp/bulk.h"
 #include "usr/argp/dns.h"
 #include "usr/argp/log.h"
 #include "usr/argp/requirements.h"
@@ -17,6 +18,10 @@ struct display_args {
 	struct wargp_bool no_headers;
 	struct wargp_bool csv;
 	struct wargp_bool numeric;
+
+	struct wargp_prefix6 src6;
+	struct wargp_prefix4 src4;
+	struct wargp_port_range ports;
 };
 
 static struct wargp_option display_opts[] = {
@@ -26,9 +31,29 @@ static struct wargp_option display_opts[] = {
 	WARGP_NO_HEADERS(struct display_args, no_headers),
 	WARGP_CSV(struct display_args, csv),
 	WARGP_NUMERIC(struct display_args, numeric),
+	WARGP_SRC6(struct display_args, src6),
+	WARGP_SRC4(struct display_args, src4),
+	WARGP_PORTS(struct display_args, ports),
 	{ 0 },
 };
 
+static struct table_filter *build_filter(struct display_args *dargs,
+		struct table_filter *filter)
+{
+	if (!dargs->src6.set && !dargs->src4.set && !dargs->ports.set)
+		return NULL;
+
+	memset(filter, 0, sizeof(*filter));
+	filter->src6.set = dargs->src6.set;
+	filter->src6.prefix = dargs->src6.prefix;
+	filter->src4.set = dargs->src4.set;
+	filter->src4.prefix = dargs->src4.prefix;
+	filter->ports_set = dargs->ports.set;
+	filter->port_min = dargs->ports.range.min;
+	filter->port_max = dargs->ports.range.max;
+	return filter;
+}
+
 static struct jool_result print_entry(struct bib_entry const *entry, void *args)
 {
 	struct display_args *dargs = args;
@@ -59,6 +84,7 @@ static struct jool_result print_entry(struct bib_entry const *entry, void *args)
 int handle_bib_display(char *iname, int argc, char **argv, void const *arg)
 {
 	struct display_args dargs = { 0 };
+	struct table_filter filter;
 	struct joolnl_socket sk;
 	struct jool_result result;
 
@@ -74,7 +100,7 @@ int handle_bib_display(char *iname, int argc, char **argv, void const *arg)
 		printf("Protocol,IPv6 Address,IPv6 L4-ID,IPv4 Address,IPv4 L4-ID,Static?\n");
 
 	result = joolnl_bib_foreach(&sk, iname, dargs.proto.proto,
-			print_entry, &dargs);
+			build_filter(&dargs, &filter), print_entry, &dargs);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
@@ -114,6 +140,7 @@ static int parse_taddr(void *void_field, int key, char *str)
 struct add_args {
 	struct wargp_l4proto proto;
 	struct taddr_tuple taddrs;
+	struct wargp_string file;
 };
 
 struct wargp_type wt_taddr = {
@@ -125,6 +152,7 @@ static struct wargp_option add_opts[] = {
 	WARGP_TCP(struct add_args, proto, "Add the entry to the TCP table (default)"),
 	WARGP_UDP(struct add_args, proto, "Add the entry to the UDP table"),
 	WARGP_ICMP(struct add_args, proto, "Add the entry to the ICMP table"),
+	WARGP_FILE(struct add_args, file),
 	{
 		.name = "Transport addresses",
 		.key = ARGP_KEY_ARG,
@@ -135,6 +163,69 @@ static struct wargp_option add_opts[] = {
 	{ 0 },
 };
 
+/*
+ * Lines look like the positional arguments:
+ * "<IPv6 transport address> <IPv4 transport address>".
+ */
+static int parse_bib_line(int argc, char **argv, void *entry, void const *arg)
+{
+	struct add_args const *aargs = arg;
+	struct taddr_tuple parsing = { 0 };
+	struct bib_entry *bib = entry;
+	int i;
+	int error;
+
+	for (i = 0; i < argc; i++) {
+		error = parse_taddr(&parsing, ARGP_KEY_ARG, argv[i]);
+		if (error == ARGP_ERR_UNKNOWN) {
+			pr_err("'%s' is not a transport address.", argv[i]);
+			return -EINVAL;
+		}
+		if (error)
+			return error;
+	}
+
+	if (!parsing.addr6_set || !parsing.addr4_set) {
+		struct requirement reqs[] = {
+			{ parsing.addr6_set, "an IPv6 transport address" },
+			{ parsing.addr4_set, "an IPv4 transport address" },
+			{ 0 },
+		};
+		return requirement_print(reqs);
+	}
+
+	bib->addr6 = parsing.addr6;
+	bib->addr4 = parsing.addr4;
+	bib->l4_proto = aargs->proto.proto;
+	bib->is_static = true;
+	return 0;
+}
+
+static int handle_bib_add_file(char *iname, struct add_args *aargs)
+{
+	struct bulk_file file;
+	struct joolnl_socket sk;
+	struct jool_result result;
+
+	result.error = bulk_file_read(&file, aargs->file.value,
+			sizeof(struct bib_entry), parse_bib_line, aargs);
+	if (result.error)
+		return result.error;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error) {
+		bulk_file_cleanup(&file);
+		return pr_result(&result);
+	}
+
+	result = joolnl_bib_add_bulk(&sk, iname, file.entries, file.count,
+			bulk_file_print_failure, &file);
+
+	joolnl_teardown(&sk);
+	bulk_file_cleanup(&file);
+	return pr_result(&result);
+}
+
 int handle_bib_add(char *iname, int argc, char **argv, void const *arg)
 {
 	struct add_args aargs = { 0 };
@@ -145,6 +236,14 @@ int handle_bib_add(char *iname, int argc, char **argv, void const *arg)
 	if (result.error)
 		return result.error;
 
+	if (aargs.file.value) {
+		if (aargs.taddrs.addr6_set || aargs.taddrs.addr4_set) {
+			pr_err("--file cannot be combined with positional transport addresses.");
+			return -EINVAL;
+		}
+		return handle_bib_add_file(iname, &aargs);
+	}
+
 	if (!aargs.taddrs.addr6_set || !aargs.taddrs.addr4_set) {
 		struct requirement reqs[] = {
 			{ aargs.taddrs.addr6_set, "an IPv6 transport address" },
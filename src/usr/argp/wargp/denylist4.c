@@ -1,5 +1,6 @@
 #include "usr/argp/wargp/denylist4.h"
 
+#include "usr/argp/bulk.h"
 #include "usr/argp/log.h"
 #include "usr/argp/requirements.h"
 #include "usr/argp/userspace-types.h"
@@ -89,10 +90,12 @@ void autocomplete_denylist4_display(void const *args)
 struct add_args {
 	bool force;
 	struct wargp_prefix4 prefix;
+	struct wargp_string file;
 };
 
 static struct wargp_option add_opts[] = {
 	WARGP_FORCE(struct add_args, force),
+	WARGP_FILE(struct add_args, file),
 	{
 		.name = "Prefixes",
 		.key = ARGP_KEY_ARG,
@@ -103,6 +106,46 @@ static struct wargp_option add_opts[] = {
 	{ 0 },
 };
 
+/* Lines contain one IPv4 prefix (or address) each. */
+static int parse_denylist4_line(int argc, char **argv, void *entry,
+		void const *arg)
+{
+	struct jool_result result;
+
+	if (argc != 1) {
+		pr_err("Expected exactly one IPv4 prefix per line.");
+		return -EINVAL;
+	}
+
+	result = str_to_prefix4(argv[0], entry);
+	return pr_result(&result);
+}
+
+static int handle_denylist4_add_file(char *iname, struct add_args *aargs)
+{
+	struct bulk_file file;
+	struct joolnl_socket sk;
+	struct jool_result result;
+
+	result.error = bulk_file_read(&file, aargs->file.value,
+			sizeof(struct ipv4_prefix), parse_denylist4_line, NULL);
+	if (result.error)
+		return result.error;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error) {
+		bulk_file_cleanup(&file);
+		return pr_result(&result);
+	}
+
+	result = joolnl_denylist4_add_bulk(&sk, iname, file.entries, file.count,
+			aargs->force, bulk_file_print_failure, &file);
+
+	joolnl_teardown(&sk);
+	bulk_file_cleanup(&file);
+	return pr_result(&result);
+}
+
 int handle_denylist4_add(char *iname, int argc, char **argv, void const *arg)
 {
 	struct add_args aargs = { 0 };
@@ -113,6 +156,14 @@ int handle_denylist4_add(char *iname, int argc, char **argv, void const *arg)
 	if (result.error)
 		return result.error;
 
+	if (aargs.file.value) {
+		if (aargs.prefix.set) {
+			pr_err("--file cannot be combined with a positional prefix.");
+			return -EINVAL;
+		}
+		return handle_denylist4_add_file(iname, &aargs);
+	}
+
 	if (!aargs.prefix.set) {
 		struct requirement reqs[] = {
 				{ false, "an IPv4 prefix" },
@@ -1,5 +1,6 @@
 #include "usr/argp/wargp/eamt.h"
 
+#include "usr/argp/bulk.h"
 #include "usr/argp/log.h"
 #include "usr/argp/requirements.h"
 #include "usr/argp/userspace-types.h"
@@ -99,6 +100,7 @@ struct wargp_eamt_entry {
 struct add_args {
 	struct wargp_eamt_entry entry;
 	bool force;
+	struct wargp_string file;
 };
 
 static int parse_eamt_column(void *void_field, int key, char *str)
@@ -127,6 +129,7 @@ struct wargp_type wt_prefixes = {
 
 static struct wargp_option add_opts[] = {
 	WARGP_FORCE(struct add_args, force),
+	WARGP_FILE(struct add_args, file),
 	{
 		.name = "Prefixes",
 		.key = ARGP_KEY_ARG,
@@ -137,6 +140,62 @@ static struct wargp_option add_opts[] = {
 	{ 0 },
 };
 
+/* Lines look like the positional arguments: "<IPv6 prefix> <IPv4 prefix>". */
+static int parse_eamt_line(int argc, char **argv, void *entry, void const *arg)
+{
+	struct wargp_eamt_entry parsing = { 0 };
+	int i;
+	int error;
+
+	for (i = 0; i < argc; i++) {
+		error = parse_eamt_column(&parsing, ARGP_KEY_ARG, argv[i]);
+		if (error == ARGP_ERR_UNKNOWN) {
+			pr_err("'%s' is neither an IPv6 nor an IPv4 prefix.",
+					argv[i]);
+			return -EINVAL;
+		}
+		if (error)
+			return error;
+	}
+
+	if (!parsing.prefix6_set || !parsing.prefix4_set) {
+		struct requirement reqs[] = {
+				{ parsing.prefix6_set, "an IPv6 prefix" },
+				{ parsing.prefix4_set, "an IPv4 prefix" },
+				{ 0 },
+		};
+		return requirement_print(reqs);
+	}
+
+	memcpy(entry, &parsing.value, sizeof(parsing.value));
+	return 0;
+}
+
+static int handle_eamt_add_file(char *iname, struct add_args *aargs)
+{
+	struct bulk_file file;
+	struct joolnl_socket sk;
+	struct jool_result result;
+
+	result.error = bulk_file_read(&file, aargs->file.value,
+			sizeof(struct eamt_entry), parse_eamt_line, NULL);
+	if (result.error)
+		return result.error;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error) {
+		bulk_file_cleanup(&file);
+		return pr_result(&result);
+	}
+
+	result = joolnl_eamt_add_bulk(&sk, iname, file.entries, file.count,
+			aargs->force, bulk_file_print_failure, &file);
+
+	joolnl_teardown(&sk);
+	bulk_file_cleanup(&file);
+	return pr_result(&result);
+}
+
 int handle_eamt_add(char *iname, int argc, char **argv, void const *arg)
 {
 	struct add_args aargs = { 0 };
@@ -147,6 +206,14 @@ int handle_eamt_add(char *iname, int argc, char **argv, void const *arg)
 	if (result.error)
 		return result.error;
 
+	if (aargs.file.value) {
+		if (aargs.entry.prefix6_set || aargs.entry.prefix4_set) {
+			pr_err("--file cannot be combined with positional prefixes.");
+			return -EINVAL;
+		}
+		return handle_eamt_add_file(iname, &aargs);
+	}
+
 	if (!aargs.entry.prefix6_set || !aargs.entry.prefix4_set) {
 		struct requirement reqs[] = {
 				{ aargs.entry.prefix6_set, "an IPv6 prefix" },
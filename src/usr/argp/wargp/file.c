@@ -9,13 +9,23 @@
 #include "usr/nl/core.h"
 #include "usr/nl/file.h"
 
+#define ARGP_INCREMENTAL 3000
+
 struct update_args {
 	struct wargp_string file_name;
 	struct wargp_bool force;
+	struct wargp_bool incremental;
 };
 
 static struct wargp_option update_opts[] = {
 	WARGP_FORCE(struct update_args, force),
+	{
+		.name = "incremental",
+		.key = ARGP_INCREMENTAL,
+		.doc = "Only apply the differences between the file and the running configuration, on the running tables (faster, but not atomic)",
+		.offset = offsetof(struct update_args, incremental),
+		.type = &wt_bool,
+	},
 	{
 		.name = "File name",
 		.key = ARGP_KEY_ARG,
@@ -49,7 +59,7 @@ int handle_file_update(char *iname, int argc, char **argv, void const *arg)
 		return pr_result(&result);
 
 	result = joolnl_file_parse(&sk, xt_get(), iname, uargs.file_name.value,
-			uargs.force.value);
+			uargs.force.value, uargs.incremental.value);
 
 	joolnl_teardown(&sk);
 	return pr_result(&result);
@@ -23,3 +23,23 @@ void autocomplete_joold_advertise(void const *args)
 {
 	/* joold advertise has no arguments. */
 }
+
+int handle_joold_resync(char *iname, int argc, char **argv, void const *arg)
+{
+	struct joolnl_socket sk;
+	struct jool_result result;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	result = joolnl_joold_resync(&sk, iname);
+
+	joolnl_teardown(&sk);
+	return pr_result(&result);
+}
+
+void autocomplete_joold_resync(void const *args)
+{
+	/* joold resync has no arguments. */
+}
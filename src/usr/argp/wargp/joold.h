@@ -3,5 +3,7 @@
 
 int handle_joold_advertise(char *iname, int argc, char **argv, void const *arg);
 void autocomplete_joold_advertise(void const *args);
+int handle_joold_resync(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_joold_resync(void const *args);
 
 #endif /* SRC_USR_ARGP_WARGP_JOOLD_H_ */
@@ -3,6 +3,7 @@
 #include "usr/util/str_utils.h"
 #include "usr/nl/core.h"
 #include "usr/nl/pool4.h"
+#include "usr/argp/bulk.h"
 #include "usr/argp/log.h"
 #include "usr/argp/requirements.h"
 #include "usr/argp/userspace-types.h"
@@ -167,6 +168,7 @@ struct add_args {
 	struct parsing_entry entry;
 	struct wargp_l4proto proto;
 	bool force;
+	struct wargp_string file;
 };
 
 static int parse_max_iterations(void *void_field, int key, char *str)
@@ -236,6 +238,7 @@ static struct wargp_option add_opts[] = {
 		.type = &wt_max_iterations,
 	},
 	WARGP_FORCE(struct add_args, force),
+	WARGP_FILE(struct add_args, file),
 	{
 		.name = "pool4 entry",
 		.key = ARGP_KEY_ARG,
@@ -246,6 +249,74 @@ static struct wargp_option add_opts[] = {
 	{ 0 },
 };
 
+static int check_prefix_len(struct add_args const *aargs,
+		struct ipv4_prefix const *prefix)
+{
+	if (prefix->len < 24 && !aargs->force) {
+		pr_err("Warning: You're adding lots of addresses, which might defeat the whole point of NAT64 over SIIT.");
+		pr_err("Will cancel the operation. Use --force to override this.");
+		return -E2BIG;
+	}
+
+	return 0;
+}
+
+/* Lines look like the positional arguments: "<IPv4 prefix> <port range>". */
+static int parse_pool4_line(int argc, char **argv, void *entry, void const *arg)
+{
+	struct add_args const *aargs = arg;
+	struct parsing_entry parsing = { .meat = aargs->entry.meat };
+	int i;
+	int error;
+
+	for (i = 0; i < argc; i++) {
+		error = parse_pool4_entry(&parsing, ARGP_KEY_ARG, argv[i]);
+		if (error)
+			return error;
+	}
+
+	if (!parsing.prefix4_set || !parsing.range_set) {
+		struct requirement reqs[] = {
+			{ parsing.prefix4_set, "an IPv4 prefix or address" },
+			{ parsing.range_set, "a port (or ICMP id) range" },
+			{ 0 },
+		};
+		return requirement_print(reqs);
+	}
+
+	error = check_prefix_len(aargs, &parsing.meat.range.prefix);
+	if (error)
+		return error;
+
+	memcpy(entry, &parsing.meat, sizeof(parsing.meat));
+	return 0;
+}
+
+static int handle_pool4_add_file(char *iname, struct add_args *aargs)
+{
+	struct bulk_file file;
+	struct joolnl_socket sk;
+	struct jool_result result;
+
+	result.error = bulk_file_read(&file, aargs->file.value,
+			sizeof(struct pool4_entry), parse_pool4_line, aargs);
+	if (result.error)
+		return result.error;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error) {
+		bulk_file_cleanup(&file);
+		return pr_result(&result);
+	}
+
+	result = joolnl_pool4_add_bulk(&sk, iname, file.entries, file.count,
+			bulk_file_print_failure, &file);
+
+	joolnl_teardown(&sk);
+	bulk_file_cleanup(&file);
+	return pr_result(&result);
+}
+
 int handle_pool4_add(char *iname, int argc, char **argv, void const *arg)
 {
 	struct add_args aargs = { 0 };
@@ -256,6 +327,23 @@ int handle_pool4_add(char *iname, int argc, char **argv, void const *arg)
 	if (result.error)
 		return result.error;
 
+	if (aargs.file.value) {
+		if (!aargs.proto.set) {
+			struct requirement reqs[] = {
+				{ aargs.proto.set, "a protocol (--tcp, --udp or --icmp)" },
+				{ 0 },
+			};
+			return requirement_print(reqs);
+		}
+		if (aargs.entry.prefix4_set || aargs.entry.range_set) {
+			pr_err("--file cannot be combined with a positional pool4 entry.");
+			return -EINVAL;
+		}
+
+		aargs.entry.meat.proto = aargs.proto.proto;
+		return handle_pool4_add_file(iname, &aargs);
+	}
+
 	if (!aargs.entry.prefix4_set
 			|| !aargs.entry.range_set
 			|| !aargs.proto.set) {
@@ -268,11 +356,9 @@ int handle_pool4_add(char *iname, int argc, char **argv, void const *arg)
 		return requirement_print(reqs);
 	}
 
-	if (aargs.entry.meat.range.prefix.len < 24 && !aargs.force) {
-		pr_err("Warning: You're adding lots of addresses, which might defeat the whole point of NAT64 over SIIT.");
-		pr_err("Will cancel the operation. Use --force to override this.");
-		return -E2BIG;
-	}
+	result.error = check_prefix_len(&aargs, &aargs.entry.meat.range.prefix);
+	if (result.error)
+		return result.error;
 
 	aargs.entry.meat.proto = aargs.proto.proto;
 
@@ -6,17 +6,53 @@
 #include "usr/util/str_utils.h"
 #include "usr/nl/core.h"
 #include "usr/nl/session.h"
+#include "usr/argp/checkpoint.h"
 #include "usr/argp/dns.h"
+#include "usr/argp/evlog.h"
 #include "usr/argp/log.h"
+#include "usr/argp/requirements.h"
 #include "usr/argp/userspace-types.h"
 #include "usr/argp/wargp.h"
 #include "usr/argp/xlator_type.h"
 
+#define ARGP_DST4 3000
+#define ARGP_STATE 3001
+#define ARGP_MIN_AGE 3002
+#define ARGP_HISTOGRAM 3003
+#define ARGP_MAX_SIZE 3004
+#define ARGP_MAX_AGE 3005
+
+struct wargp_tcp_state {
+	bool set;
+	tcp_state state;
+};
+
 struct display_args {
 	struct wargp_bool no_headers;
 	struct wargp_bool csv;
 	struct wargp_bool numeric;
 	struct wargp_l4proto proto;
+
+	struct wargp_prefix6 src6;
+	struct wargp_prefix4 src4;
+	struct wargp_port_range ports;
+	struct wargp_prefix4 dst4;
+	struct wargp_tcp_state state;
+	__u32 min_age;
+};
+
+static int parse_tcp_state(void *void_field, int key, char *str);
+static int parse_min_age(void *void_field, int key, char *str);
+
+static struct wargp_type wt_tcp_state = {
+	.argument = "<TCP state>",
+	.parse = parse_tcp_state,
+	.candidates = "ESTABLISHED V4_INIT V6_INIT V4_FIN_RCV V6_FIN_RCV V4_FIN_V6_FIN_RCV TRANS",
+};
+
+static struct wargp_type wt_min_age = {
+	.argument = "<[HH:[MM:]]SS[.mmm]>",
+	.parse = parse_min_age,
 };
 
 static struct wargp_option display_opts[] = {
@@ -26,6 +62,28 @@ static struct wargp_option display_opts[] = {
 	WARGP_NO_HEADERS(struct display_args, no_headers),
 	WARGP_CSV(struct display_args, csv),
 	WARGP_NUMERIC(struct display_args, numeric),
+	WARGP_SRC6(struct display_args, src6),
+	WARGP_SRC4(struct display_args, src4),
+	WARGP_PORTS(struct display_args, ports),
+	{
+		.name = "dst4",
+		.key = ARGP_DST4,
+		.doc = "Only print the sessions whose IPv4 node address belongs to this prefix",
+		.offset = offsetof(struct display_args, dst4),
+		.type = &wt_prefix4,
+	}, {
+		.name = "state",
+		.key = ARGP_STATE,
+		.doc = "Only print the TCP sessions that are in this state",
+		.offset = offsetof(struct display_args, state),
+		.type = &wt_tcp_state,
+	}, {
+		.name = "min-age",
+		.key = ARGP_MIN_AGE,
+		.doc = "Only print the sessions that were created at least this long ago",
+		.offset = offsetof(struct display_args, min_age),
+		.type = &wt_min_age,
+	},
 	{ 0 },
 };
 
@@ -51,6 +109,54 @@ static char *tcp_state_to_string(tcp_state state)
 	return "UNKNOWN";
 }
 
+static int parse_tcp_state(void *void_field, int key, char *str)
+{
+	struct wargp_tcp_state *field = void_field;
+	tcp_state state;
+
+	for (state = ESTABLISHED; state <= TRANS; state++) {
+		if (STR_EQUAL(str, tcp_state_to_string(state))) {
+			field->set = true;
+			field->state = state;
+			return 0;
+		}
+	}
+
+	pr_err("Unknown TCP state: '%s'", str);
+	return -EINVAL;
+}
+
+static int parse_min_age(void *void_field, int key, char *str)
+{
+	struct jool_result result;
+	result = str_to_timeout(str, void_field);
+	return pr_result(&result);
+}
+
+static struct table_filter *build_filter(struct display_args *dargs,
+		struct table_filter *filter)
+{
+	if (!dargs->src6.set && !dargs->src4.set && !dargs->ports.set
+			&& !dargs->dst4.set && !dargs->state.set
+			&& !dargs->min_age)
+		return NULL;
+
+	memset(filter, 0, sizeof(*filter));
+	filter->src6.set = dargs->src6.set;
+	filter->src6.prefix = dargs->src6.prefix;
+	filter->src4.set = dargs->src4.set;
+	filter->src4.prefix = dargs->src4.prefix;
+	filter->ports_set = dargs->ports.set;
+	filter->port_min = dargs->ports.range.min;
+	filter->port_max = dargs->ports.range.max;
+	filter->dst4.set = dargs->dst4.set;
+	filter->dst4.prefix = dargs->dst4.prefix;
+	filter->state_set = dargs->state.set;
+	filter->state = dargs->state.state;
+	filter->min_age = dargs->min_age;
+	return filter;
+}
+
 static struct jool_result handle_display_response(
 		struct session_entry_usr const *entry, void *args)
 {
@@ -101,6 +207,7 @@ static struct jool_result handle_display_response(
 int handle_session_display(char *iname, int argc, char **argv, void const *arg)
 {
 	struct display_args dargs = { 0 };
+	struct table_filter filter;
 	struct joolnl_socket sk;
 	struct jool_result result;
 
@@ -108,6 +215,11 @@ int handle_session_display(char *iname, int argc, char **argv, void const *arg)
 	if (result.error)
 		return result.error;
 
+	if (dargs.state.set && dargs.proto.proto != L4PROTO_TCP) {
+		pr_err("--state only applies to TCP sessions.");
+		return -EINVAL;
+	}
+
 	result = joolnl_setup(&sk, xt_get());
 	if (result.error)
 		return pr_result(&result);
@@ -124,7 +236,8 @@ int handle_session_display(char *iname, int argc, char **argv, void const *arg)
 	}
 
 	result = joolnl_session_foreach(&sk, iname, dargs.proto.proto,
-			handle_display_response, &dargs);
+			build_filter(&dargs, &filter), handle_display_response,
+			&dargs);
 
 	joolnl_teardown(&sk);
 
@@ -135,3 +248,272 @@ void autocomplete_session_display(void const *args)
 {
 	print_wargp_opts(display_opts);
 }
+
+struct stats_args {
+	struct wargp_bool no_headers;
+	struct wargp_bool csv;
+	struct wargp_l4proto proto;
+	struct wargp_bool histogram;
+};
+
+static struct wargp_option stats_opts[] = {
+	WARGP_TCP(struct stats_args, proto, "Count the TCP table (default)"),
+	WARGP_UDP(struct stats_args, proto, "Count the UDP table"),
+	WARGP_ICMP(struct stats_args, proto, "Count the ICMP table"),
+	WARGP_NO_HEADERS(struct stats_args, no_headers),
+	WARGP_CSV(struct stats_args, csv),
+	{
+		.name = "histogram",
+		.key = ARGP_HISTOGRAM,
+		.doc = "Also print the sessions' age distribution (walks the table)",
+		.offset = offsetof(struct stats_args, histogram),
+		.type = &wt_bool,
+	},
+	{ 0 },
+};
+
+static void print_counter(struct stats_args *sargs, char const *name,
+		__u32 value)
+{
+	if (sargs->csv.value)
+		printf("%s,%u\n", name, value);
+	else
+		printf("%s: %u\n", name, value);
+}
+
+static void print_timeout(struct stats_args *sargs, char const *name,
+		__u32 msecs)
+{
+	char value[TIMEOUT_BUFLEN];
+
+	timeout2str(msecs, value);
+	if (sargs->csv.value)
+		printf("%s,%s\n", name, value);
+	else
+		printf("%s: %s\n", name, value);
+}
+
+static void print_ages(struct stats_args *sargs, struct session_stats *stats)
+{
+	static const unsigned int limits[] = SESSION_AGE_LIMITS;
+	char name[64];
+	char limit[TIMEOUT_BUFLEN];
+	unsigned int i;
+
+	if (!sargs->csv.value)
+		printf("Age:\n");
+
+	for (i = 0; i < SESSION_AGE_BUCKETS; i++) {
+		if (i < SESSION_AGE_BUCKETS - 1) {
+			timeout2str(1000 * limits[i], limit);
+			snprintf(name, sizeof(name), "%sYounger than %s",
+					sargs->csv.value ? "" : "  ", limit);
+		} else {
+			timeout2str(1000 * limits[i - 1], limit);
+			snprintf(name, sizeof(name), "%s%s or older",
+					sargs->csv.value ? "" : "  ", limit);
+		}
+		print_counter(sargs, name, stats->ages[i]);
+	}
+}
+
+int handle_session_stats(char *iname, int argc, char **argv, void const *arg)
+{
+	struct stats_args sargs = { 0 };
+	struct session_stats stats;
+	struct joolnl_socket sk;
+	struct jool_result result;
+	char name[64];
+	tcp_state state;
+	bool csv;
+
+	result.error = wargp_parse(stats_opts, argc, argv, &sargs);
+	if (result.error)
+		return result.error;
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	result = joolnl_session_stats(&sk, iname, sargs.proto.proto,
+			sargs.histogram.value, &stats);
+
+	joolnl_teardown(&sk);
+
+	if (result.error)
+		return pr_result(&result);
+
+	csv = sargs.csv.value;
+	if (show_csv_header(sargs.no_headers.value, csv))
+		printf("Counter,Value\n");
+
+	print_counter(&sargs, "BIB entries", stats.bibs);
+	print_counter(&sargs, "Sessions", stats.sessions);
+	print_counter(&sargs, csv ? "Established timer" : "  Established timer",
+			stats.est);
+	if (sargs.proto.proto == L4PROTO_TCP) {
+		print_counter(&sargs,
+				csv ? "Transitory timer" : "  Transitory timer",
+				stats.trans);
+		print_counter(&sargs, csv ? "SO timer" : "  SO timer",
+				stats.syn4);
+		print_counter(&sargs, "Stored packets", stats.stored_pkts);
+
+		if (!csv)
+			printf("State:\n");
+		for (state = ESTABLISHED; state <= TRANS; state++) {
+			snprintf(name, sizeof(name), "%s%s", csv ? "" : "  ",
+					tcp_state_to_string(state));
+			print_counter(&sargs, name, stats.states[state]);
+		}
+	}
+
+	if (!csv)
+		printf("Effective timeouts:\n");
+	print_timeout(&sargs, csv ? "Established timeout" : "  Established",
+			stats.est_timeout);
+	if (sargs.proto.proto == L4PROTO_TCP) {
+		print_timeout(&sargs, csv ? "Transitory timeout" : "  Transitory",
+				stats.trans_timeout);
+	}
+
+	if (stats.has_ages)
+		print_ages(&sargs, &stats);
+
+	return 0;
+}
+
+void autocomplete_session_stats(void const *args)
+{
+	print_wargp_opts(stats_opts);
+}
+
+struct checkpoint_args {
+	struct wargp_string file_name;
+};
+
+static struct wargp_option checkpoint_opts[] = {
+	{
+		.name = "File name",
+		.key = ARGP_KEY_ARG,
+		.doc = "Path to the session checkpoint file.",
+		.offset = offsetof(struct checkpoint_args, file_name),
+		.type = &wt_string,
+	},
+	{ 0 },
+};
+
+typedef int (*checkpoint_cb)(struct joolnl_socket *, char const *,
+		char const *);
+
+static int handle_checkpoint(char *iname, int argc, char **argv,
+		checkpoint_cb cb)
+{
+	struct checkpoint_args cargs = { 0 };
+	struct joolnl_socket sk;
+	struct jool_result result;
+	int error;
+
+	result.error = wargp_parse(checkpoint_opts, argc, argv, &cargs);
+	if (result.error)
+		return result.error;
+
+	if (!cargs.file_name.value) {
+		struct requirement reqs[] = {
+				{ false, "a file name" },
+				{ 0 }
+		};
+		return requirement_print(reqs);
+	}
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	error = cb(&sk, iname, cargs.file_name.value);
+
+	joolnl_teardown(&sk);
+	return error;
+}
+
+int handle_session_export(char *iname, int argc, char **argv, void const *arg)
+{
+	return handle_checkpoint(iname, argc, argv, checkpoint_export);
+}
+
+int handle_session_import(char *iname, int argc, char **argv, void const *arg)
+{
+	return handle_checkpoint(iname, argc, argv, checkpoint_import);
+}
+
+void autocomplete_session_checkpoint(void const *args)
+{
+	/* Do nothing; default to autocomplete directory path */
+}
+
+struct log_args {
+	struct wargp_string prefix;
+	__u32 max_size;
+	__u32 max_age;
+};
+
+static struct wargp_option log_opts[] = {
+	{
+		.name = "Prefix",
+		.key = ARGP_KEY_ARG,
+		.doc = "Path and name prefix of the event files.",
+		.offset = offsetof(struct log_args, prefix),
+		.type = &wt_string,
+	}, {
+		.name = "max-size",
+		.key = ARGP_MAX_SIZE,
+		.doc = "Start a new file after this many MiB of events (0 = never)",
+		.offset = offsetof(struct log_args, max_size),
+		.type = &wt_u32,
+	}, {
+		.name = "max-age",
+		.key = ARGP_MAX_AGE,
+		.doc = "Start a new file after this many seconds (0 = never)",
+		.offset = offsetof(struct log_args, max_age),
+		.type = &wt_u32,
+	},
+	{ 0 },
+};
+
+int handle_session_log(char *iname, int argc, char **argv, void const *arg)
+{
+	struct log_args largs = { 0 };
+	struct joolnl_socket sk;
+	struct jool_result result;
+	int error;
+
+	largs.max_size = 64;
+	largs.max_age = 3600;
+	result.error = wargp_parse(log_opts, argc, argv, &largs);
+	if (result.error)
+		return result.error;
+
+	if (!largs.prefix.value) {
+		struct requirement reqs[] = {
+				{ false, "a file name prefix" },
+				{ 0 }
+		};
+		return requirement_print(reqs);
+	}
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	error = evlog_collect(&sk, iname, largs.prefix.value,
+			((unsigned long long)largs.max_size) << 20,
+			largs.max_age);
+
+	joolnl_teardown(&sk);
+	return error;
+}
+
+void autocomplete_session_log(void const *args)
+{
+	print_wargp_opts(log_opts);
+}
@@ -4,4 +4,14 @@
 int handle_session_display(char *iname, int argc, char **argv, void const *arg);
 void autocomplete_session_display(void const *args);
 
+int handle_session_stats(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_session_stats(void const *args);
+
+int handle_session_export(char *iname, int argc, char **argv, void const *arg);
+int handle_session_import(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_session_checkpoint(void const *args);
+
+int handle_session_log(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_session_log(void const *args);
+
 #endif /* SRC_USR_ARGP_WARGP_SESSION_H_ */
@@ -1,5 +1,10 @@
 #include "usr/argp/wargp/stats.h"
 
+#include <arpa/inet.h>
+#include <errno.h>
+
+#include "common/constants.h"
+#include "usr/nl/bib.h"
 #include "usr/nl/core.h"
 #include "usr/nl/stats.h"
 #include "usr/argp/log.h"
@@ -85,3 +90,108 @@ void autocomplete_stats_display(void const *args)
 {
 	print_wargp_opts(display_opts);
 }
+
+#define ARGP_TOP 4000
+
+struct subscribers_args {
+	struct wargp_l4proto proto;
+	struct wargp_bool no_headers;
+	struct wargp_bool csv;
+	__u32 top;
+};
+
+static struct wargp_option subscribers_opts[] = {
+	WARGP_TCP(struct subscribers_args, proto, "Print the TCP table's subscribers (default)"),
+	WARGP_UDP(struct subscribers_args, proto, "Print the UDP table's subscribers"),
+	WARGP_ICMP(struct subscribers_args, proto, "Print the ICMP table's subscribers"),
+	WARGP_NO_HEADERS(struct subscribers_args, no_headers),
+	WARGP_CSV(struct subscribers_args, csv),
+	{
+		.name = "top",
+		.key = ARGP_TOP,
+		.doc = "Only print the N subscribers with the most sessions, sorted",
+		.offset = offsetof(struct subscribers_args, top),
+		.type = &wt_u32,
+	},
+	{ 0 },
+};
+
+static void print_subscriber_separator(void)
+{
+	print_table_separator(0, 43, 10, 10, 0);
+}
+
+static struct jool_result print_subscriber(struct subscriber_entry const *entry,
+		void *args)
+{
+	struct subscribers_args *sargs = args;
+	char ipv6_str[INET6_ADDRSTRLEN];
+
+	inet_ntop(AF_INET6, &entry->prefix.addr, ipv6_str, sizeof(ipv6_str));
+
+	if (sargs->csv.value) {
+		printf("%s/%u,%u,%u\n", ipv6_str, entry->prefix.len,
+				entry->bibs, entry->sessions);
+	} else {
+		printf("| %39s/%-3u | %10u | %10u |\n", ipv6_str,
+				entry->prefix.len, entry->bibs, entry->sessions);
+	}
+
+	return result_success();
+}
+
+int handle_stats_subscribers(char *iname, int argc, char **argv,
+		void const *arg)
+{
+	struct subscribers_args sargs = { 0 };
+	struct joolnl_socket sk;
+	struct jool_result result;
+
+	result.error = wargp_parse(subscribers_opts, argc, argv, &sargs);
+	if (result.error)
+		return result.error;
+
+	if (sargs.top > SUBSCRIBER_TOP_MAX) {
+		pr_err("--top cannot exceed %u.", SUBSCRIBER_TOP_MAX);
+		return -EINVAL;
+	}
+
+	result = joolnl_setup(&sk, xt_get());
+	if (result.error)
+		return pr_result(&result);
+
+	if (!sargs.no_headers.value) {
+		static char const *const th1 = "Subscriber";
+		static char const *const th2 = "BIB";
+		static char const *const th3 = "Sessions";
+		if (sargs.csv.value)
+			printf("%s,%s,%s\n", th1, th2, th3);
+		else {
+			print_subscriber_separator();
+			printf("| %43s | %10s | %10s |\n", th1, th2, th3);
+			print_subscriber_separator();
+		}
+	}
+
+	if (sargs.top) {
+		result = joolnl_subscriber_top(&sk, iname, sargs.proto.proto,
+				sargs.top, print_subscriber, &sargs);
+	} else {
+		result = joolnl_subscriber_foreach(&sk, iname,
+				sargs.proto.proto, print_subscriber, &sargs);
+	}
+
+	joolnl_teardown(&sk);
+
+	if (result.error)
+		return pr_result(&result);
+
+	if (!sargs.csv.value)
+		print_subscriber_separator();
+	return 0;
+}
+
+void autocomplete_stats_subscribers(void const *args)
+{
+	print_wargp_opts(subscribers_opts);
+}
@@ -4,4 +4,7 @@
 int handle_stats_display(char *iname, int argc, char **argv, void const *arg);
 void autocomplete_stats_display(void const *args);
 
+int handle_stats_subscribers(char *iname, int argc, char **argv, void const *arg);
+void autocomplete_stats_subscribers(void const *args);
+
 #endif /* SRC_USR_ARGP_WARGP_STATS_H_ */
@@ -45,6 +45,14 @@ int main(int argc, char **argv)
 		goto end;
 	}
 
+	error = modsocket_set_transport(netsocket_kernel_transport());
+	if (error)
+		goto clean;
+	if (netsocket_kernel_transport()) {
+		syslog(LOG_INFO, "The kernel module will exchange the sessions by itself. Bye.");
+		goto clean;
+	}
+
 	error = pthread_create(&mod2net_thread, NULL, modsocket_listen, NULL);
 	if (error) {
 		pr_perror("Module-to-network thread initialization", error);
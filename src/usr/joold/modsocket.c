@@ -169,6 +169,26 @@ fail:
 	return result.error;
 }
 
+/**
+ * Tells the kernel module whether it should exchange the sessions through its
+ * own socket (@cfg) or multicast them to us (NULL).
+ */
+int modsocket_set_transport(struct joolnl_joold_socket const *cfg)
+{
+	struct joolnl_socket sk;
+	struct jool_result result;
+
+	/* @jsocket's callbacks are reserved for the multicast group. */
+	result = joolnl_setup(&sk, XT_NAT64);
+	if (result.error)
+		return pr_result(&result);
+
+	result = joolnl_joold_transport(&sk, iname, cfg);
+
+	joolnl_teardown(&sk);
+	return pr_result(&result);
+}
+
 int modsocket_setup(int argc, char **argv)
 {
 	int error;
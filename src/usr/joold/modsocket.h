@@ -6,10 +6,13 @@
  */
 
 #include <stddef.h>
+#include "usr/nl/joold.h"
 
 int modsocket_setup(int argc, char **argv);
 void modsocket_teardown(void);
 
+int modsocket_set_transport(struct joolnl_joold_socket const *cfg);
+
 void *modsocket_listen(void *arg);
 void modsocket_send(void *buffer, size_t size);
 
@@ -15,6 +15,7 @@
 #include "modsocket.h"
 #include "common/config.h"
 #include "common/types.h"
+#include "usr/nl/joold.h"
 #include "usr/util/cJSON.h"
 #include "usr/util/file.h"
 #include "usr/util/str_utils.h"
@@ -40,9 +41,19 @@ struct netsocket_config {
 
 	int ttl;
 	bool ttl_set;
+
+	/**
+	 * Have the kernel module exchange the sessions through its own socket?
+	 * (If so, this daemon only configures it, and then exits.)
+	 * Defaults to false.
+	 */
+	bool kernel_transport;
 };
 
 static int sk;
+/** Configuration of the kernel socket, if the kernel transport was chosen. */
+static struct joolnl_joold_socket kernel_cfg;
+static bool kernel_transport;
 /** Processed version of the configuration's hostname and service. */
 static struct addrinfo *addr_candidates;
 /** Candidate from @addr_candidates that we managed to bind the socket with. */
@@ -124,6 +135,21 @@ static int json_to_config(cJSON *json, struct netsocket_config *cfg)
 		cfg->ttl = child->valueint;
 	}
 
+	child = cJSON_GetObjectItem(json, "kernel transport");
+	if (child) {
+		switch (child->type) {
+		case cJSON_True:
+			cfg->kernel_transport = true;
+			break;
+		case cJSON_False:
+			cfg->kernel_transport = false;
+			break;
+		default:
+			syslog(LOG_ERR, "'kernel transport' is not a boolean.");
+			return -EINVAL;
+		}
+	}
+
 	return 0;
 
 fail:
@@ -430,6 +456,81 @@ static int adjust_mcast_opts(struct netsocket_config *cfg)
 	return 1;
 }
 
+static int str_to_ifindex(char const *name, unsigned int *result)
+{
+	if (!name) {
+		*result = 0;
+		return 0;
+	}
+
+	*result = if_nametoindex(name);
+	if (!(*result)) {
+		syslog(LOG_ERR, "'%s' is not an interface name. (The kernel transport does not accept interface addresses.)",
+				name);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Translates @cfg into the kernel socket's configuration. It's the kernel
+ * module who creates the socket.
+ */
+static int prepare_kernel_transport(struct netsocket_config *cfg)
+{
+	struct addrinfo hints = { 0 };
+	int err;
+
+	syslog(LOG_INFO, "Getting address info of %s#%s...",
+			cfg->mcast_addr,
+			cfg->mcast_port);
+
+	hints.ai_socktype = SOCK_DGRAM;
+	err = getaddrinfo(cfg->mcast_addr, cfg->mcast_port, &hints,
+			&addr_candidates);
+	if (err) {
+		syslog(LOG_ERR, "getaddrinfo() failed: %s", gai_strerror(err));
+		return err;
+	}
+
+	memset(&kernel_cfg, 0, sizeof(kernel_cfg));
+	kernel_cfg.family = addr_candidates->ai_family;
+	switch (addr_candidates->ai_family) {
+	case AF_INET:
+		kernel_cfg.addr.v4 = *get_addr4(addr_candidates);
+		kernel_cfg.port = ntohs(((struct sockaddr_in *)
+				addr_candidates->ai_addr)->sin_port);
+		break;
+	case AF_INET6:
+		kernel_cfg.addr.v6 = *get_addr6(addr_candidates);
+		kernel_cfg.port = ntohs(((struct sockaddr_in6 *)
+				addr_candidates->ai_addr)->sin6_port);
+		break;
+	default:
+		syslog(LOG_ERR, "Unknown address family: %d",
+				addr_candidates->ai_family);
+		err = 1;
+		goto end;
+	}
+
+	err = str_to_ifindex(cfg->in_interface, &kernel_cfg.in_ifindex);
+	if (err)
+		goto end;
+	err = str_to_ifindex(cfg->out_interface, &kernel_cfg.out_ifindex);
+	if (err)
+		goto end;
+	kernel_cfg.ttl = cfg->ttl;
+	kernel_cfg.ttl_set = cfg->ttl_set;
+
+	kernel_transport = true;
+	/* Fall through. */
+
+end:
+	freeaddrinfo(addr_candidates);
+	return err;
+}
+
 int netsocket_setup(int argc, char **argv)
 {
 	cJSON *json;
@@ -444,6 +545,11 @@ int netsocket_setup(int argc, char **argv)
 	if (error)
 		goto end;
 
+	if (cfg.kernel_transport) {
+		error = prepare_kernel_transport(&cfg);
+		goto end;
+	}
+
 	error = create_socket(&cfg);
 	if (error)
 		goto end;
@@ -461,8 +567,20 @@ end:
 	return error;
 }
 
+/**
+ * Returns the configuration of the kernel module's socket, or NULL if the
+ * sessions are supposed to travel through this daemon.
+ */
+struct joolnl_joold_socket *netsocket_kernel_transport(void)
+{
+	return kernel_transport ? &kernel_cfg : NULL;
+}
+
 void netsocket_teardown(void)
 {
+	if (kernel_transport)
+		return;
+
 	close(sk);
 	freeaddrinfo(addr_candidates);
 }
@@ -6,10 +6,13 @@
  */
 
 #include <stddef.h>
+#include "usr/nl/joold.h"
 
 int netsocket_setup(int argc, char **argv);
 void netsocket_teardown(void);
 
+struct joolnl_joold_socket *netsocket_kernel_transport(void);
+
 void *netsocket_listen(void *arg);
 void netsocket_send(void *buffer, size_t size);
 
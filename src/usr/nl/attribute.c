@@ -267,6 +267,25 @@ struct jool_result nla_get_bib(struct nlattr *root, struct bib_entry *out)
 	return result_success();
 }
 
+struct jool_result nla_get_subscriber(struct nlattr *root,
+		struct subscriber_entry *out)
+{
+	struct nlattr *attrs[JNLASU_COUNT];
+	struct jool_result result;
+
+	result = jnla_parse_nested(attrs, JNLASU_MAX, root,
+			joolnl_subscriber_policy);
+	if (result.error)
+		return result;
+
+	result = nla_get_prefix6(attrs[JNLASU_PREFIX], &out->prefix);
+	if (result.error)
+		return result;
+	out->bibs = nla_get_u32(attrs[JNLASU_BIBS]);
+	out->sessions = nla_get_u32(attrs[JNLASU_SESSIONS]);
+	return result_success();
+}
+
 struct jool_result nla_get_session(struct nlattr *root, struct session_entry_usr *out)
 {
 	struct nlattr *attrs[JNLASE_COUNT];
@@ -290,7 +309,9 @@ struct jool_result nla_get_session(struct nlattr *root, struct session_entry_usr
 		return result;
 	out->proto = nla_get_u8(attrs[JNLASE_PROTO]);
 	out->state = nla_get_u8(attrs[JNLASE_STATE]);
+	out->timer = attrs[JNLASE_TIMER] ? nla_get_u8(attrs[JNLASE_TIMER]) : 0;
 	out->dying_time = nla_get_u32(attrs[JNLASE_EXPIRATION]);
+	out->age = attrs[JNLASE_AGE] ? nla_get_u32(attrs[JNLASE_AGE]) : 0;
 	return result_success();
 }
 
@@ -542,7 +563,73 @@ int nla_put_session(struct nl_msg *msg, int attrtype, struct session_entry_usr c
 		goto nla_put_failure;
 	NLA_PUT_U8(msg, JNLASE_PROTO, entry->proto);
 	NLA_PUT_U8(msg, JNLASE_STATE, entry->state);
+	NLA_PUT_U8(msg, JNLASE_TIMER, entry->timer);
 	NLA_PUT_U32(msg, JNLASE_EXPIRATION, entry->dying_time);
+	NLA_PUT_U32(msg, JNLASE_AGE, entry->age);
+
+	nla_nest_end(msg, root);
+	return 0;
+
+nla_put_failure:
+	nla_nest_cancel(msg, root);
+	return -NLE_NOMEM;
+}
+
+int nla_put_session_touch(struct nl_msg *msg, int attrtype, struct session_touch_usr const *touch)
+{
+	struct session_entry_usr const *entry = &touch->session;
+	struct nlattr *root;
+
+	root = jnla_nest_start(msg, attrtype);
+	if (!root)
+		return -NLE_NOMEM;
+
+	if (nla_put_taddr6(msg, JNLASE_SRC6, &entry->src6) < 0)
+		goto nla_put_failure;
+	if (nla_put_taddr6(msg, JNLASE_DST6, &entry->dst6) < 0)
+		goto nla_put_failure;
+	if (nla_put_taddr4(msg, JNLASE_SRC4, &entry->src4) < 0)
+		goto nla_put_failure;
+	if (nla_put_taddr4(msg, JNLASE_DST4, &entry->dst4) < 0)
+		goto nla_put_failure;
+	NLA_PUT_U8(msg, JNLASE_PROTO, entry->proto);
+	NLA_PUT_U8(msg, JNLASE_STATE, entry->state);
+	NLA_PUT_U8(msg, JNLASE_TIMER, entry->timer);
+	NLA_PUT_U32(msg, JNLASE_IDLE, touch->idle);
+
+	nla_nest_end(msg, root);
+	return 0;
+
+nla_put_failure:
+	nla_nest_cancel(msg, root);
+	return -NLE_NOMEM;
+}
+
+int nla_put_filter(struct nl_msg *msg, int attrtype, struct table_filter const *filter)
+{
+	struct nlattr *root;
+
+	root = jnla_nest_start(msg, attrtype);
+	if (!root)
+		return -NLE_NOMEM;
+
+	if (filter->src6.set && nla_put_prefix6(msg, JNLAFI_SRC6,
+			&filter->src6.prefix) < 0)
+		goto nla_put_failure;
+	if (filter->src4.set && nla_put_prefix4(msg, JNLAFI_SRC4,
+			&filter->src4.prefix) < 0)
+		goto nla_put_failure;
+	if (filter->ports_set) {
+		NLA_PUT_U16(msg, JNLAFI_PORT_MIN, filter->port_min);
+		NLA_PUT_U16(msg, JNLAFI_PORT_MAX, filter->port_max);
+	}
+	if (filter->dst4.set && nla_put_prefix4(msg, JNLAFI_DST4,
+			&filter->dst4.prefix) < 0)
+		goto nla_put_failure;
+	if (filter->state_set)
+		NLA_PUT_U8(msg, JNLAFI_STATE, filter->state);
+	if (filter->min_age)
+		NLA_PUT_U32(msg, JNLAFI_MIN_AGE, filter->min_age);
 
 	nla_nest_end(msg, root);
 	return 0;
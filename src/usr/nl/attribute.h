@@ -33,6 +33,7 @@ struct jool_result nla_get_taddr4(struct nlattr *attr, struct ipv4_transport_add
 struct jool_result nla_get_eam(struct nlattr *attr, struct eamt_entry *out);
 struct jool_result nla_get_pool4(struct nlattr *attr, struct pool4_entry *out);
 struct jool_result nla_get_bib(struct nlattr *attr, struct bib_entry *out);
+struct jool_result nla_get_subscriber(struct nlattr *attr, struct subscriber_entry *out);
 struct jool_result nla_get_session(struct nlattr *attr, struct session_entry_usr *out);
 struct jool_result nla_get_plateaus(struct nlattr *attr, struct mtu_plateaus *out);
 
@@ -72,5 +73,7 @@ int nla_put_bib_attrs(struct nl_msg *msg, int attrtype,
 		l4_protocol proto,
 		bool is_static);
 int nla_put_session(struct nl_msg *msg, int attrtype, struct session_entry_usr const *entry);
+int nla_put_session_touch(struct nl_msg *msg, int attrtype, struct session_touch_usr const *touch);
+int nla_put_filter(struct nl_msg *msg, int attrtype, struct table_filter const *filter);
 
 #endif /* SRC_USR_NL_ATTRIBUTE_H_ */
@@ -41,7 +41,8 @@ static struct jool_result handle_foreach_response(struct nl_msg *response,
 }
 
 struct jool_result joolnl_bib_foreach(struct joolnl_socket *sk, char const *iname,
-	l4_protocol proto, joolnl_bib_foreach_cb cb, void *_args)
+	l4_protocol proto, struct table_filter const *filter,
+	joolnl_bib_foreach_cb cb, void *_args)
 {
 	struct nl_msg *msg;
 	struct foreach_args args;
@@ -68,6 +69,9 @@ struct jool_result joolnl_bib_foreach(struct joolnl_socket *sk, char const *inam
 			goto cancel;
 		}
 
+		if (filter && nla_put_filter(msg, JNLAR_FILTER, filter) < 0)
+			goto cancel;
+
 		result = joolnl_request(sk, msg, handle_foreach_response, &args);
 		if (result.error)
 			return result;
@@ -80,6 +84,107 @@ cancel:
 	return joolnl_err_msgsize();
 }
 
+struct subscriber_foreach_args {
+	joolnl_subscriber_foreach_cb cb;
+	void *args;
+	bool done;
+	struct subscriber_entry last;
+};
+
+static struct jool_result handle_subscriber_response(struct nl_msg *response,
+		void *arg)
+{
+	struct subscriber_foreach_args *args = arg;
+	struct nlattr *attr;
+	int rem;
+	struct subscriber_entry entry;
+	struct jool_result result;
+
+	result = joolnl_init_foreach_list(response, "subscriber", &args->done);
+	if (result.error)
+		return result;
+
+	foreach_entry(attr, genlmsg_hdr(nlmsg_hdr(response)), rem) {
+		result = nla_get_subscriber(attr, &entry);
+		if (result.error)
+			return result;
+
+		result = args->cb(&entry, args->args);
+		if (result.error)
+			return result;
+
+		memcpy(&args->last, &entry, sizeof(entry));
+	}
+
+	return result_success();
+}
+
+struct jool_result joolnl_subscriber_foreach(struct joolnl_socket *sk,
+	char const *iname, l4_protocol proto,
+	joolnl_subscriber_foreach_cb cb, void *_args)
+{
+	struct nl_msg *msg;
+	struct subscriber_foreach_args args;
+	struct jool_result result;
+	bool first_request;
+
+	args.cb = cb;
+	args.args = _args;
+	args.done = true;
+	memset(&args.last, 0, sizeof(args.last));
+	first_request = true;
+
+	do {
+		result = joolnl_alloc_msg(sk, iname, JNLOP_SUBSCRIBER_FOREACH,
+				0, &msg);
+		if (result.error)
+			return result;
+
+		if (nla_put_u8(msg, JNLAR_PROTO, proto) < 0)
+			goto cancel;
+		if (!first_request && nla_put_prefix6(msg, JNLAR_OFFSET,
+				&args.last.prefix) < 0)
+			goto cancel;
+		first_request = false;
+
+		result = joolnl_request(sk, msg, handle_subscriber_response,
+				&args);
+		if (result.error)
+			return result;
+	} while (!args.done);
+
+	return result_success();
+
+cancel:
+	nlmsg_free(msg);
+	return joolnl_err_msgsize();
+}
+
+struct jool_result joolnl_subscriber_top(struct joolnl_socket *sk,
+	char const *iname, l4_protocol proto, unsigned int max,
+	joolnl_subscriber_foreach_cb cb, void *_args)
+{
+	struct nl_msg *msg;
+	struct subscriber_foreach_args args;
+	struct jool_result result;
+
+	args.cb = cb;
+	args.args = _args;
+	args.done = true;
+
+	result = joolnl_alloc_msg(sk, iname, JNLOP_SUBSCRIBER_FOREACH, 0, &msg);
+	if (result.error)
+		return result;
+
+	if (nla_put_u8(msg, JNLAR_PROTO, proto) < 0
+			|| nla_put_u16(msg, JNLAR_TOP, max) < 0) {
+		nlmsg_free(msg);
+		return joolnl_err_msgsize();
+	}
+
+	return joolnl_request(sk, msg, handle_subscriber_response, &args);
+}
+
 static struct jool_result __update(struct joolnl_socket *sk, char const *iname,
 		enum joolnl_operation op,
 		struct ipv6_transport_addr const *a6,
@@ -111,6 +216,22 @@ struct jool_result joolnl_bib_add(struct joolnl_socket *sk,
 	return __update(sk, iname, JNLOP_BIB_ADD, a6, a4, proto);
 }
 
+static int put_bib(struct nl_msg *msg, unsigned int index, void const *arg)
+{
+	struct bib_entry const *entries = arg;
+	return nla_put_bib_attrs(msg, JNLAL_ENTRY, &entries[index].addr6,
+			&entries[index].addr4, entries[index].l4_proto, true);
+}
+
+/* Entries should be grouped by protocol. */
+struct jool_result joolnl_bib_add_bulk(struct joolnl_socket *sk,
+		char const *iname, struct bib_entry const *entries,
+		unsigned int count, joolnl_bulk_failure_cb cb, void *arg)
+{
+	return joolnl_bulk_add(sk, iname, JNLOP_BIB_ADD, 0, JNLAR_BIB_ENTRIES,
+			count, put_bib, entries, cb, arg);
+}
+
 struct jool_result joolnl_bib_rm(struct joolnl_socket *sk,
 		char const *iname,
 		struct ipv6_transport_addr const *a6,
@@ -2,20 +2,45 @@
 #define SRC_USR_NL_BIB_H_
 
 #include "common/config.h"
+#include "usr/nl/common.h"
 #include "usr/nl/core.h"
 
 typedef struct jool_result (*joolnl_bib_foreach_cb)(
 	struct bib_entry const *entry, void *args
 );
 
+/* @filter can be NULL. */
 struct jool_result joolnl_bib_foreach(
 	struct joolnl_socket *sk,
 	char const *iname,
 	l4_protocol proto,
+	struct table_filter const *filter,
 	joolnl_bib_foreach_cb cb,
 	void *args
 );
 
+typedef struct jool_result (*joolnl_subscriber_foreach_cb)(
+	struct subscriber_entry const *entry, void *args
+);
+
+struct jool_result joolnl_subscriber_foreach(
+	struct joolnl_socket *sk,
+	char const *iname,
+	l4_protocol proto,
+	joolnl_subscriber_foreach_cb cb,
+	void *args
+);
+
+/* Subscribers with the most sessions first. @max <= SUBSCRIBER_TOP_MAX. */
+struct jool_result joolnl_subscriber_top(
+	struct joolnl_socket *sk,
+	char const *iname,
+	l4_protocol proto,
+	unsigned int max,
+	joolnl_subscriber_foreach_cb cb,
+	void *args
+);
+
 struct jool_result joolnl_bib_add(
 	struct joolnl_socket *sk,
 	char const *iname,
@@ -24,6 +49,15 @@ struct jool_result joolnl_bib_add(
 	l4_protocol proto
 );
 
+struct jool_result joolnl_bib_add_bulk(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct bib_entry const *entries,
+	unsigned int count,
+	joolnl_bulk_failure_cb cb,
+	void *arg
+);
+
 struct jool_result joolnl_bib_rm(
 	struct joolnl_socket *sk,
 	char const *iname,
@@ -1,5 +1,8 @@
 #include "usr/nl/common.h"
 
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <netlink/errno.h>
 #include <netlink/msg.h>
 #include <netlink/genl/genl.h>
@@ -53,3 +56,136 @@ struct jool_result joolnl_init_foreach_list(struct nl_msg *msg,
 		joolnl_struct_list_policy
 	);
 }
+
+struct bulk_args {
+	/* Index of the current request's first entry */
+	unsigned int offset;
+	unsigned int failures;
+	/* Everything the kernel module logged; NULL if nothing. */
+	char *log;
+
+	joolnl_bulk_failure_cb cb;
+	void *arg;
+};
+
+static struct nla_policy bulk_response_policy[JNLAR_COUNT] = {
+	[JNLAR_BULK_FAILURES] = { .type = NLA_NESTED },
+	[JNLAR_BULK_LOG] = { .type = NLA_STRING },
+};
+
+static struct jool_result append_log(struct bulk_args *args, char const *log)
+{
+	size_t old_len;
+	char *tmp;
+
+	old_len = args->log ? strlen(args->log) : 0;
+	tmp = realloc(args->log, old_len + strlen(log) + 1);
+	if (!tmp)
+		return result_from_enomem();
+
+	strcpy(tmp + old_len, log);
+	args->log = tmp;
+	return result_success();
+}
+
+static struct jool_result handle_bulk_response(struct nl_msg *response,
+		void *arg)
+{
+	struct bulk_args *args = arg;
+	struct nlattr *attrs[JNLAR_COUNT];
+	struct nlattr *fattrs[JNLABF_COUNT];
+	struct nlattr *attr;
+	int rem;
+	struct jool_result result;
+
+	result = jnla_parse_msg(response, attrs, JNLAR_MAX,
+			bulk_response_policy, false);
+	if (result.error)
+		return result;
+
+	if (attrs[JNLAR_BULK_FAILURES]) {
+		nla_for_each_nested(attr, attrs[JNLAR_BULK_FAILURES], rem) {
+			result = jnla_parse_nested(fattrs, JNLABF_MAX, attr,
+					joolnl_bulk_failure_policy);
+			if (result.error)
+				return result;
+
+			args->failures++;
+			if (args->cb) {
+				args->cb(args->offset
+					+ nla_get_u32(fattrs[JNLABF_INDEX]),
+					-((int)nla_get_u16(fattrs[JNLABF_CODE])),
+					args->arg);
+			}
+		}
+	}
+
+	return attrs[JNLAR_BULK_LOG]
+			? append_log(args, nla_get_string(attrs[JNLAR_BULK_LOG]))
+			: result_success();
+}
+
+/**
+ * Sends @count entries to the kernel module, packing as many of them as
+ * possible in every request.
+ *
+ * The result is an error if any of the entries could not be added; @cb tells
+ * which ones.
+ */
+struct jool_result joolnl_bulk_add(struct joolnl_socket *sk, char const *iname,
+		enum joolnl_operation op, __u8 flags, int list, unsigned int count,
+		joolnl_bulk_put_cb put, void const *put_arg,
+		joolnl_bulk_failure_cb cb, void *cb_arg)
+{
+	struct nl_msg *msg;
+	struct nlattr *root;
+	struct bulk_args args;
+	unsigned int i;
+	struct jool_result result;
+
+	args.offset = 0;
+	args.failures = 0;
+	args.log = NULL;
+	args.cb = cb;
+	args.arg = cb_arg;
+
+	while (args.offset < count) {
+		result = joolnl_alloc_msg(sk, iname, op, flags, &msg);
+		if (result.error)
+			goto end;
+
+		root = jnla_nest_start(msg, list);
+		if (!root)
+			goto too_small;
+		for (i = args.offset; i < count; i++)
+			if (put(msg, i, put_arg) < 0)
+				break;
+		if (i == args.offset)
+			goto too_small;
+		nla_nest_end(msg, root);
+
+		result = joolnl_request(sk, msg, handle_bulk_response, &args);
+		if (result.error)
+			goto end;
+
+		args.offset = i;
+	}
+
+	if (args.failures == 0) {
+		result = result_success();
+		goto end;
+	}
+
+	result = result_from_error(-EINVAL, "%u/%u entries could not be added.%s%s",
+			args.failures, count,
+			args.log ? "\n" : "",
+			args.log ? args.log : "");
+	goto end;
+
+too_small:
+	nlmsg_free(msg);
+	result = joolnl_err_msgsize();
+end:
+	free(args.log);
+	return result;
+}
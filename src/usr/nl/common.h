@@ -2,6 +2,7 @@
 #define SRC_USR_NL_COMMON_H_
 
 #include <netlink/msg.h>
+#include "usr/nl/core.h"
 #include "usr/util/result.h"
 
 struct jool_result joolnl_err_msgsize(void);
@@ -10,4 +11,16 @@ struct jool_result joolnl_init_foreach(struct nl_msg *response, bool *done);
 struct jool_result joolnl_init_foreach_list(struct nl_msg *msg,
 		char const *what, bool *done);
 
+/* Called once for every entry the kernel module could not add. */
+typedef void (*joolnl_bulk_failure_cb)(unsigned int index, int error,
+		void *arg);
+/* Writes the @index'th entry as a JNLAL_ENTRY. Returns negative if no room. */
+typedef int (*joolnl_bulk_put_cb)(struct nl_msg *msg, unsigned int index,
+		void const *arg);
+
+struct jool_result joolnl_bulk_add(struct joolnl_socket *sk, char const *iname,
+		enum joolnl_operation op, __u8 flags, int list, unsigned int count,
+		joolnl_bulk_put_cb put, void const *put_arg,
+		joolnl_bulk_failure_cb cb, void *cb_arg);
+
 #endif /* SRC_USR_NL_COMMON_H_ */
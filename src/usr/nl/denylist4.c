@@ -101,6 +101,23 @@ struct jool_result joolnl_denylist4_add(struct joolnl_socket *sk,
 			force ? JOOLNLHDR_FLAGS_FORCE : 0);
 }
 
+static int put_prefix4(struct nl_msg *msg, unsigned int index,
+		void const *arg)
+{
+	struct ipv4_prefix const *prefixes = arg;
+	return nla_put_prefix4(msg, JNLAL_ENTRY, &prefixes[index]);
+}
+
+struct jool_result joolnl_denylist4_add_bulk(struct joolnl_socket *sk,
+		char const *iname, struct ipv4_prefix const *prefixes,
+		unsigned int count, bool force,
+		joolnl_bulk_failure_cb cb, void *arg)
+{
+	return joolnl_bulk_add(sk, iname, JNLOP_BL4_ADD,
+			force ? JOOLNLHDR_FLAGS_FORCE : 0, JNLAR_BL4_ENTRIES,
+			count, put_prefix4, prefixes, cb, arg);
+}
+
 struct jool_result joolnl_denylist4_rm(struct joolnl_socket *sk,
 		char const *iname, struct ipv4_prefix const *prefix)
 {
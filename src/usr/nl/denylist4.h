@@ -2,6 +2,7 @@
 #define SRC_USR_NL_DENYLIST_H_
 
 #include "common/types.h"
+#include "usr/nl/common.h"
 #include "usr/nl/core.h"
 
 typedef struct jool_result (*joolnl_denylist4_foreach_cb)(
@@ -22,6 +23,16 @@ struct jool_result joolnl_denylist4_add(
 	bool force
 );
 
+struct jool_result joolnl_denylist4_add_bulk(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct ipv4_prefix const *prefixes,
+	unsigned int count,
+	bool force,
+	joolnl_bulk_failure_cb cb,
+	void *arg
+);
+
 struct jool_result joolnl_denylist4_rm(
 	struct joolnl_socket *sk,
 	char const *iname,
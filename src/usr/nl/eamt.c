@@ -113,6 +113,22 @@ struct jool_result joolnl_eamt_add(struct joolnl_socket *sk, char const *iname,
 			force ? JOOLNLHDR_FLAGS_FORCE : 0);
 }
 
+static int put_eam(struct nl_msg *msg, unsigned int index, void const *arg)
+{
+	struct eamt_entry const *entries = arg;
+	return nla_put_eam(msg, JNLAL_ENTRY, &entries[index]);
+}
+
+struct jool_result joolnl_eamt_add_bulk(struct joolnl_socket *sk,
+		char const *iname, struct eamt_entry const *entries,
+		unsigned int count, bool force,
+		joolnl_bulk_failure_cb cb, void *arg)
+{
+	return joolnl_bulk_add(sk, iname, JNLOP_EAMT_ADD,
+			force ? JOOLNLHDR_FLAGS_FORCE : 0, JNLAR_EAMT_ENTRIES,
+			count, put_eam, entries, cb, arg);
+}
+
 struct jool_result joolnl_eamt_rm(struct joolnl_socket *sk, char const *iname,
 		struct ipv6_prefix const *p6, struct ipv4_prefix const *p4)
 {
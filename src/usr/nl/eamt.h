@@ -2,6 +2,7 @@
 #define SRC_USR_NL_EAMT_H_
 
 #include "common/config.h"
+#include "usr/nl/common.h"
 #include "usr/nl/core.h"
 
 typedef struct jool_result (*joolnl_eamt_foreach_cb)(
@@ -23,6 +24,16 @@ struct jool_result joolnl_eamt_add(
 	bool force
 );
 
+struct jool_result joolnl_eamt_add_bulk(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct eamt_entry const *entries,
+	unsigned int count,
+	bool force,
+	joolnl_bulk_failure_cb cb,
+	void *arg
+);
+
 struct jool_result joolnl_eamt_rm(
 	struct joolnl_socket *sk,
 	char const *iname,
@@ -11,8 +11,12 @@
 #include "usr/util/str_utils.h"
 #include "usr/nl/attribute.h"
 #include "usr/nl/common.h"
+#include "usr/nl/denylist4.h"
+#include "usr/nl/eamt.h"
 #include "usr/nl/global.h"
+#include "usr/nl/instance.h"
 #include "usr/nl/json.h"
+#include "usr/nl/pool4.h"
 
 #define OPTNAME_INAME 			"instance"
 #define OPTNAME_FW			"framework"
@@ -29,6 +33,36 @@ static struct joolnl_socket sk;
 static char const *iname;
 static xlator_flags flags;
 static __u8 force;
+static bool incremental;
+
+/*
+ * Incremental mode: a table's entries. (Either the ones listed in the file, or
+ * the ones the running instance has.)
+ */
+struct entry_array {
+	void *entries;
+	size_t entry_size;
+	unsigned int count;
+	unsigned int capacity;
+};
+
+/*
+ * Incremental mode: pool4 entry, tagged with its position so the order of the
+ * file can be recovered after sorting.
+ */
+struct pool4_item {
+	struct pool4_entry entry;
+	unsigned int index;
+};
+
+/* Incremental mode: The tables, as listed in the file. */
+static struct entry_array file_eamt;
+static struct entry_array file_denylist4;
+static struct entry_array file_pool4;
+/* Incremental mode: The tables, as they currently are in the kernel. */
+static struct entry_array running_eamt;
+static struct entry_array running_denylist4;
+static struct entry_array running_pool4;
 
 struct json_meta {
 	char const *name; /* This being NULL signals the end of the array. */
@@ -369,17 +403,24 @@ static struct jool_result json2proto(cJSON *json, void const *arg1, void *arg2)
  * =================================
  */
 
-static struct jool_result handle_eam_entry(cJSON *json, struct nl_msg *msg)
+static struct jool_result json2eam(cJSON *json, void *arg)
 {
-	struct eamt_entry eam;
+	struct eamt_entry *eam = arg;
 	struct json_meta meta[] = {
-		{ "ipv6 prefix", json2prefix6, NULL, &eam.prefix6, true },
-		{ "ipv4 prefix", json2prefix4, NULL, &eam.prefix4, true },
+		{ "ipv6 prefix", json2prefix6, NULL, &eam->prefix6, true },
+		{ "ipv4 prefix", json2prefix4, NULL, &eam->prefix4, true },
 		{ NULL },
 	};
+
+	return handle_object(json, meta);
+}
+
+static struct jool_result handle_eam_entry(cJSON *json, struct nl_msg *msg)
+{
+	struct eamt_entry eam;
 	struct jool_result result;
 
-	result = handle_object(json, meta);
+	result = json2eam(json, &eam);
 	if (result.error)
 		return result;
 
@@ -388,15 +429,20 @@ static struct jool_result handle_eam_entry(cJSON *json, struct nl_msg *msg)
 			: result_success();
 }
 
+static struct jool_result json2denylist(cJSON *json, void *prefix)
+{
+	if (json->type != cJSON_String)
+		return string_expected("denylist entry", json);
+
+	return str_to_prefix4(json->valuestring, prefix);
+}
+
 static struct jool_result handle_denylist_entry(cJSON *json, struct nl_msg *msg)
 {
 	struct ipv4_prefix prefix;
 	struct jool_result result;
 
-	if (json->type != cJSON_String)
-		return string_expected("denylist entry", json);
-
-	result = str_to_prefix4(json->valuestring, &prefix);
+	result = json2denylist(json, &prefix);
 	if (result.error)
 		return result;
 
@@ -405,26 +451,33 @@ static struct jool_result handle_denylist_entry(cJSON *json, struct nl_msg *msg)
 			: result_success();
 }
 
-static struct jool_result handle_pool4_entry(cJSON *json, struct nl_msg *msg)
+static struct jool_result json2pool4(cJSON *json, void *arg)
 {
-	struct pool4_entry entry;
+	struct pool4_entry *entry = arg;
 	struct json_meta meta[] = {
-		{ "mark", json2mark, NULL, &entry.mark, false },
-		{ "protocol", json2proto, NULL, &entry.proto, true },
-		{ "prefix", json2prefix4, NULL, &entry.range.prefix, true },
-		{ "port range", json2port_range, NULL, &entry.range.ports, false },
-		{ OPTNAME_MAX_ITERATIONS, json2max_iterations, NULL, &entry, false },
+		{ "mark", json2mark, NULL, &entry->mark, false },
+		{ "protocol", json2proto, NULL, &entry->proto, true },
+		{ "prefix", json2prefix4, NULL, &entry->range.prefix, true },
+		{ "port range", json2port_range, NULL, &entry->range.ports, false },
+		{ OPTNAME_MAX_ITERATIONS, json2max_iterations, NULL, entry, false },
 		{ NULL },
 	};
-	struct jool_result result;
 
-	entry.mark = 0;
-	entry.range.ports.min = DEFAULT_POOL4_MIN_PORT;
-	entry.range.ports.max = DEFAULT_POOL4_MAX_PORT;
-	entry.iterations = 0;
-	entry.flags = 0;
+	entry->mark = 0;
+	entry->range.ports.min = DEFAULT_POOL4_MIN_PORT;
+	entry->range.ports.max = DEFAULT_POOL4_MAX_PORT;
+	entry->iterations = 0;
+	entry->flags = 0;
 
-	result = handle_object(json, meta);
+	return handle_object(json, meta);
+}
+
+static struct jool_result handle_pool4_entry(cJSON *json, struct nl_msg *msg)
+{
+	struct pool4_entry entry;
+	struct jool_result result;
+
+	result = json2pool4(json, &entry);
 	if (result.error)
 		return result;
 
@@ -455,6 +508,676 @@ static struct jool_result handle_bib_entry(cJSON *json, struct nl_msg *msg)
 			: result_success();
 }
 
+/*
+ * =================================
+ * ======= Incremental mode ========
+ * =================================
+ */
+
+/*
+ * pool4 sets whose addresses add up to more than this are not compared; they
+ * are always replaced.
+ */
+#define POOL4_MAX_ATOMS (1 << 20)
+
+/* A port range of a single pool4 address. */
+struct pool4_atom {
+	__u32 addr;
+	struct port_range ports;
+};
+
+static void array_init(struct entry_array *array, size_t entry_size)
+{
+	memset(array, 0, sizeof(*array));
+	array->entry_size = entry_size;
+}
+
+static void *array_get(struct entry_array const *array, unsigned int index)
+{
+	return ((char *)array->entries) + index * array->entry_size;
+}
+
+static struct jool_result array_add(struct entry_array *array,
+		void const *entry)
+{
+	void *entries;
+	unsigned int capacity;
+
+	if (array->count >= array->capacity) {
+		capacity = array->capacity ? (2 * array->capacity) : 64;
+		entries = realloc(array->entries, capacity * array->entry_size);
+		if (!entries)
+			return result_from_enomem();
+		array->entries = entries;
+		array->capacity = capacity;
+	}
+
+	memcpy(array_get(array, array->count), entry, array->entry_size);
+	array->count++;
+	return result_success();
+}
+
+static void array_sort(struct entry_array *array,
+		int (*cmp)(void const *, void const *))
+{
+	if (array->count > 1)
+		qsort(array->entries, array->count, array->entry_size, cmp);
+}
+
+static void array_cleanup(struct entry_array *array)
+{
+	free(array->entries);
+	array->entries = NULL;
+	array->count = 0;
+	array->capacity = 0;
+}
+
+static void tables_init(void)
+{
+	array_init(&file_eamt, sizeof(struct eamt_entry));
+	array_init(&file_denylist4, sizeof(struct ipv4_prefix));
+	array_init(&file_pool4, sizeof(struct pool4_item));
+	array_init(&running_eamt, sizeof(struct eamt_entry));
+	array_init(&running_denylist4, sizeof(struct ipv4_prefix));
+	array_init(&running_pool4, sizeof(struct pool4_item));
+}
+
+static void tables_cleanup(void)
+{
+	array_cleanup(&file_eamt);
+	array_cleanup(&file_denylist4);
+	array_cleanup(&file_pool4);
+	array_cleanup(&running_eamt);
+	array_cleanup(&running_denylist4);
+	array_cleanup(&running_pool4);
+}
+
+static struct jool_result collect_array(cJSON *json, char const *name,
+		struct jool_result (*parse)(cJSON *, void *),
+		struct entry_array *array)
+{
+	union {
+		struct eamt_entry eam;
+		struct ipv4_prefix prefix;
+		struct pool4_item pool4;
+	} entry;
+	struct jool_result result;
+
+	if (json->type != cJSON_Array)
+		return type_mismatch(name, json, "Array");
+
+	for (json = json->child; json; json = json->next) {
+		memset(&entry, 0, sizeof(entry));
+		result = parse(json, &entry);
+		if (result.error)
+			return result;
+		result = array_add(array, &entry);
+		if (result.error)
+			return result;
+	}
+
+	return result_success();
+}
+
+static struct jool_result collect_eam(struct eamt_entry const *entry,
+		void *array)
+{
+	return array_add(array, entry);
+}
+
+static struct jool_result collect_prefix4(struct ipv4_prefix const *entry,
+		void *array)
+{
+	return array_add(array, entry);
+}
+
+static struct jool_result collect_pool4(struct pool4_entry const *entry,
+		void *array)
+{
+	struct pool4_item item;
+
+	item.entry = *entry;
+	item.index = ((struct entry_array *)array)->count;
+	return array_add(array, &item);
+}
+
+/* Downloads the running instance's tables. */
+static struct jool_result load_running_tables(void)
+{
+	l4_protocol protos[] = { L4PROTO_TCP, L4PROTO_UDP, L4PROTO_ICMP };
+	unsigned int i;
+	struct jool_result result;
+
+	switch (xlator_flags2xt(flags)) {
+	case XT_SIIT:
+		result = joolnl_eamt_foreach(&sk, iname, collect_eam,
+				&running_eamt);
+		if (result.error)
+			return result;
+		return joolnl_denylist4_foreach(&sk, iname, collect_prefix4,
+				&running_denylist4);
+	case XT_NAT64:
+		for (i = 0; i < sizeof(protos) / sizeof(protos[0]); i++) {
+			result = joolnl_pool4_foreach(&sk, iname, protos[i],
+					collect_pool4, &running_pool4);
+			if (result.error)
+				return result;
+		}
+		return result_success();
+	}
+
+	return result_from_error(
+		-EINVAL,
+		"Invalid translator type: %d", xlator_flags2xt(flags)
+	);
+}
+
+static int cmp_prefix4(struct ipv4_prefix const *p1,
+		struct ipv4_prefix const *p2)
+{
+	__u32 a1 = ntohl(p1->addr.s_addr);
+	__u32 a2 = ntohl(p2->addr.s_addr);
+
+	if (a1 != a2)
+		return (a1 < a2) ? -1 : 1;
+	return ((int)p1->len) - ((int)p2->len);
+}
+
+static int cmp_prefix6(struct ipv6_prefix const *p1,
+		struct ipv6_prefix const *p2)
+{
+	int gap;
+
+	gap = memcmp(&p1->addr, &p2->addr, sizeof(p1->addr));
+	if (gap)
+		return gap;
+	return ((int)p1->len) - ((int)p2->len);
+}
+
+static int cmp_denylist4(void const *p1, void const *p2)
+{
+	return cmp_prefix4(p1, p2);
+}
+
+static int cmp_eam(void const *e1, void const *e2)
+{
+	struct eamt_entry const *eam1 = e1;
+	struct eamt_entry const *eam2 = e2;
+	int gap;
+
+	gap = cmp_prefix6(&eam1->prefix6, &eam2->prefix6);
+	if (gap)
+		return gap;
+	return cmp_prefix4(&eam1->prefix4, &eam2->prefix4);
+}
+
+/* Sorts by pool4 set, then by position in the file. */
+static int cmp_pool4_item(void const *i1, void const *i2)
+{
+	struct pool4_item const *item1 = i1;
+	struct pool4_item const *item2 = i2;
+
+	if (item1->entry.proto != item2->entry.proto)
+		return ((int)item1->entry.proto) - ((int)item2->entry.proto);
+	if (item1->entry.mark != item2->entry.mark)
+		return (item1->entry.mark < item2->entry.mark) ? -1 : 1;
+	if (item1->index != item2->index)
+		return (item1->index < item2->index) ? -1 : 1;
+	return 0;
+}
+
+static bool same_pool4_set(struct pool4_item const *item1,
+		struct pool4_item const *item2)
+{
+	return item1->entry.proto == item2->entry.proto
+			&& item1->entry.mark == item2->entry.mark;
+}
+
+static int cmp_pool4_atom(void const *a1, void const *a2)
+{
+	struct pool4_atom const *atom1 = a1;
+	struct pool4_atom const *atom2 = a2;
+
+	if (atom1->addr != atom2->addr)
+		return (atom1->addr < atom2->addr) ? -1 : 1;
+	return ((int)atom1->ports.min) - ((int)atom2->ports.min);
+}
+
+typedef int (*put_entry_cb)(struct nl_msg *, void const *);
+
+static int put_eam(struct nl_msg *msg, void const *entry)
+{
+	return nla_put_eam(msg, JNLAL_ENTRY, entry);
+}
+
+static int put_prefix4(struct nl_msg *msg, void const *entry)
+{
+	return nla_put_prefix4(msg, JNLAL_ENTRY, entry);
+}
+
+static int put_pool4(struct nl_msg *msg, void const *entry)
+{
+	return nla_put_pool4(msg, JNLAL_ENTRY,
+			&((struct pool4_item const *)entry)->entry);
+}
+
+static struct jool_result send_list(struct nl_msg *msg, struct nlattr *outer,
+		struct nlattr *root)
+{
+	nla_nest_end(msg, root);
+	if (outer)
+		nla_nest_end(msg, outer);
+	return joolnl_request(&sk, msg, NULL, NULL);
+}
+
+/*
+ * Sends @array's entries to the kernel as an @attrtype list. If @rm, the list
+ * is wrapped in a JNLAR_ATOMIC_RM container (so its entries will be removed).
+ */
+static struct jool_result send_array(struct entry_array *array, int attrtype,
+		bool rm, put_entry_cb put)
+{
+	struct nl_msg *msg;
+	struct nlattr *outer;
+	struct nlattr *root;
+	unsigned int i;
+	unsigned int entries_written;
+	struct jool_result result;
+
+	msg = NULL;
+	outer = NULL;
+	root = NULL;
+	entries_written = 0;
+	i = 0;
+	while (i < array->count) {
+		if (msg == NULL) {
+			result = joolnl_alloc_msg(&sk, iname, JNLOP_FILE_HANDLE,
+					force, &msg);
+			if (result.error)
+				return result;
+
+			if (rm) {
+				outer = jnla_nest_start(msg, JNLAR_ATOMIC_RM);
+				if (!outer)
+					goto too_small;
+			}
+			root = jnla_nest_start(msg, attrtype);
+			if (!root)
+				goto too_small;
+		}
+
+		if (put(msg, array_get(array, i)) < 0) {
+			if (entries_written == 0)
+				goto too_small;
+
+			result = send_list(msg, outer, root);
+			if (result.error)
+				return result;
+
+			msg = NULL;
+			entries_written = 0;
+			continue; /* Retry the same entry in a new message. */
+		}
+
+		entries_written++;
+		i++;
+	}
+
+	if (entries_written == 0)
+		return result_success();
+
+	return send_list(msg, outer, root);
+
+too_small:
+	nlmsg_free(msg);
+	return joolnl_err_msgsize();
+}
+
+static struct jool_result send_delta(struct entry_array *rms,
+		struct entry_array *adds, int attrtype, put_entry_cb put)
+{
+	struct jool_result result;
+
+	result = send_array(rms, attrtype, true, put);
+	if (result.error)
+		return result;
+	return send_array(adds, attrtype, false, put);
+}
+
+/*
+ * Sends the entries that are in @file but not in @running as additions, and
+ * the ones that are in @running but not in @file as removals.
+ */
+static struct jool_result diff_table(struct entry_array *file,
+		struct entry_array *running, int attrtype,
+		int (*cmp)(void const *, void const *), put_entry_cb put)
+{
+	struct entry_array adds;
+	struct entry_array rms;
+	unsigned int f, r;
+	int gap;
+	struct jool_result result;
+
+	array_init(&adds, file->entry_size);
+	array_init(&rms, running->entry_size);
+	array_sort(file, cmp);
+	array_sort(running, cmp);
+
+	f = r = 0;
+	while (f < file->count || r < running->count) {
+		if (f >= file->count)
+			gap = 1;
+		else if (r >= running->count)
+			gap = -1;
+		else
+			gap = cmp(array_get(file, f), array_get(running, r));
+
+		if (gap < 0) {
+			result = array_add(&adds, array_get(file, f++));
+		} else if (gap > 0) {
+			result = array_add(&rms, array_get(running, r++));
+		} else {
+			f++;
+			r++;
+			continue;
+		}
+		if (result.error)
+			goto end;
+	}
+
+	result = send_delta(&rms, &adds, attrtype, put);
+	/* Fall through */
+
+end:
+	array_cleanup(&adds);
+	array_cleanup(&rms);
+	return result;
+}
+
+static void normalize_ports(l4_protocol proto, struct port_range *ports)
+{
+	__u16 tmp;
+
+	if (ports->min > ports->max) {
+		tmp = ports->min;
+		ports->min = ports->max;
+		ports->max = tmp;
+	}
+	if ((proto == L4PROTO_TCP || proto == L4PROTO_UDP) && ports->min == 0)
+		ports->min = 1;
+}
+
+/*
+ * Computes the per-address port ranges the pool4 set @items would end up as
+ * (assuming the kernel fuses touching ranges, same as we do.)
+ * Returns -E2BIG if the set is too large to bother.
+ */
+static struct jool_result compute_atoms(struct pool4_item const *items,
+		unsigned int count, struct entry_array *atoms)
+{
+	struct pool4_entry const *entry;
+	struct pool4_atom atom;
+	struct pool4_atom *prev;
+	struct pool4_atom *cursor;
+	__u64 total;
+	__u64 a, addresses;
+	unsigned int i;
+	struct jool_result result;
+
+	total = 0;
+	for (i = 0; i < count; i++)
+		total += ((__u64)1) << (32 - items[i].entry.range.prefix.len);
+	if (total > POOL4_MAX_ATOMS)
+		return result_from_error(-E2BIG, "pool4 set too big to compare.");
+
+	for (i = 0; i < count; i++) {
+		entry = &items[i].entry;
+		atom.ports = entry->range.ports;
+		normalize_ports(entry->proto, &atom.ports);
+
+		addresses = ((__u64)1) << (32 - entry->range.prefix.len);
+		for (a = 0; a < addresses; a++) {
+			atom.addr = ntohl(entry->range.prefix.addr.s_addr) + a;
+			result = array_add(atoms, &atom);
+			if (result.error)
+				return result;
+		}
+	}
+
+	array_sort(atoms, cmp_pool4_atom);
+
+	/* Fuse touching ranges. */
+	prev = NULL;
+	for (i = 0; i < atoms->count; i++) {
+		cursor = array_get(atoms, i);
+		if (prev && prev->addr == cursor->addr
+				&& port_range_touches(&prev->ports, &cursor->ports)) {
+			port_range_fuse(&prev->ports, &cursor->ports);
+			continue;
+		}
+		prev = prev ? (prev + 1) : atoms->entries;
+		*prev = *cursor;
+	}
+	atoms->count = prev ? (prev - (struct pool4_atom *)atoms->entries + 1) : 0;
+
+	return result_success();
+}
+
+/*
+ * Retrieves the set's Max Iterations configuration.
+ * In the file, the last entry that defines it wins. In the kernel, all the
+ * samples carry the same one.
+ */
+static void get_iterations(struct pool4_item const *items, unsigned int count,
+		__u8 *flags, __u32 *iterations)
+{
+	unsigned int i;
+
+	*flags = ITERATIONS_AUTO;
+	*iterations = 0;
+	for (i = 0; i < count; i++) {
+		if (items[i].entry.flags & ITERATIONS_SET) {
+			*flags = items[i].entry.flags
+					& (ITERATIONS_AUTO | ITERATIONS_INFINITE);
+			*iterations = items[i].entry.iterations;
+		}
+	}
+
+	if (*flags)
+		*iterations = 0;
+}
+
+static struct jool_result pool4_set_differs(struct pool4_item const *file,
+		unsigned int file_count, struct pool4_item const *running,
+		unsigned int running_count, bool *differs)
+{
+	struct pool4_item first;
+	struct entry_array file_atoms;
+	struct entry_array running_atoms;
+	__u8 file_flags, running_flags;
+	__u32 file_iterations, running_iterations;
+	struct jool_result result;
+
+	get_iterations(file, file_count, &file_flags, &file_iterations);
+	/* Samples lack ITERATIONS_SET when the value is the default. */
+	first = running[0];
+	first.entry.flags |= ITERATIONS_SET;
+	get_iterations(&first, 1, &running_flags, &running_iterations);
+	if (file_flags != running_flags
+			|| file_iterations != running_iterations) {
+		*differs = true;
+		return result_success();
+	}
+
+	array_init(&file_atoms, sizeof(struct pool4_atom));
+	array_init(&running_atoms, sizeof(struct pool4_atom));
+
+	result = compute_atoms(file, file_count, &file_atoms);
+	if (result.error)
+		goto end;
+	result = compute_atoms(running, running_count, &running_atoms);
+	if (result.error)
+		goto end;
+
+	*differs = (file_atoms.count != running_atoms.count) || memcmp(
+		file_atoms.entries,
+		running_atoms.entries,
+		file_atoms.count * sizeof(struct pool4_atom)
+	);
+	/* Fall through */
+
+end:
+	if (result.error == -E2BIG) {
+		result_cleanup(&result);
+		*differs = true;
+		result = result_success();
+	}
+	array_cleanup(&file_atoms);
+	array_cleanup(&running_atoms);
+	return result;
+}
+
+static unsigned int pool4_set_end(struct entry_array *array, unsigned int start)
+{
+	unsigned int end;
+
+	for (end = start + 1; end < array->count; end++)
+		if (!same_pool4_set(array_get(array, start), array_get(array, end)))
+			break;
+
+	return end;
+}
+
+static struct jool_result add_range(struct entry_array *dst,
+		struct entry_array *src, unsigned int start, unsigned int end)
+{
+	struct jool_result result;
+
+	for (; start < end; start++) {
+		result = array_add(dst, array_get(src, start));
+		if (result.error)
+			return result;
+	}
+
+	return result_success();
+}
+
+/*
+ * pool4 entries fuse and split in the kernel, so they cannot be compared one by
+ * one. Instead, this compares entire sets (all the entries sharing a protocol
+ * and mark), and replaces the ones that changed.
+ */
+static struct jool_result diff_pool4(void)
+{
+	struct entry_array adds;
+	struct entry_array rms;
+	unsigned int f, r;
+	unsigned int f_end, r_end;
+	int gap;
+	bool differs;
+	struct jool_result result;
+
+	array_init(&adds, sizeof(struct pool4_item));
+	array_init(&rms, sizeof(struct pool4_item));
+	array_sort(&file_pool4, cmp_pool4_item);
+	array_sort(&running_pool4, cmp_pool4_item);
+
+	f = r = 0;
+	result = result_success();
+	while (f < file_pool4.count || r < running_pool4.count) {
+		if (f >= file_pool4.count) {
+			gap = 1;
+		} else if (r >= running_pool4.count) {
+			gap = -1;
+		} else {
+			gap = same_pool4_set(array_get(&file_pool4, f),
+					array_get(&running_pool4, r))
+				? 0
+				: cmp_pool4_item(array_get(&file_pool4, f),
+					array_get(&running_pool4, r));
+		}
+
+		f_end = (gap <= 0) ? pool4_set_end(&file_pool4, f) : f;
+		r_end = (gap >= 0) ? pool4_set_end(&running_pool4, r) : r;
+
+		if (gap == 0) {
+			result = pool4_set_differs(
+				array_get(&file_pool4, f), f_end - f,
+				array_get(&running_pool4, r), r_end - r,
+				&differs
+			);
+			if (result.error)
+				goto end;
+			if (!differs)
+				goto next;
+		}
+
+		result = add_range(&adds, &file_pool4, f, f_end);
+		if (result.error)
+			goto end;
+		result = add_range(&rms, &running_pool4, r, r_end);
+		if (result.error)
+			goto end;
+next:
+		f = f_end;
+		r = r_end;
+	}
+
+	result = send_delta(&rms, &adds, JNLAR_POOL4_ENTRIES, put_pool4);
+	/* Fall through */
+
+end:
+	array_cleanup(&adds);
+	array_cleanup(&rms);
+	return result;
+}
+
+static struct jool_result send_table_deltas(void)
+{
+	struct jool_result result;
+
+	switch (xlator_flags2xt(flags)) {
+	case XT_SIIT:
+		result = diff_table(&file_denylist4, &running_denylist4,
+				JNLAR_BL4_ENTRIES, cmp_denylist4, put_prefix4);
+		if (result.error)
+			return result;
+		return diff_table(&file_eamt, &running_eamt,
+				JNLAR_EAMT_ENTRIES, cmp_eam, put_eam);
+	case XT_NAT64:
+		return diff_pool4();
+	}
+
+	return result_from_error(
+		-EINVAL,
+		"Invalid translator type: %d", xlator_flags2xt(flags)
+	);
+}
+
+/*
+ * Decides whether the transaction can be incremental, and if so, downloads the
+ * running tables.
+ */
+static struct jool_result prepare_incremental(void)
+{
+	enum instance_hello_status status;
+	struct jool_result result;
+
+	if (!incremental)
+		return result_success();
+
+	result = joolnl_instance_hello(&sk, iname, &status);
+	if (result.error)
+		return result;
+	if (status != IHS_ALIVE) {
+		/* Nothing to diff against; create the instance normally. */
+		incremental = false;
+		return result_success();
+	}
+
+	return load_running_tables();
+}
+
 /*
  * ==========================================
  * = Second level tag handlers, second pass =
@@ -473,26 +1196,50 @@ static struct jool_result handle_global_tag(cJSON *json, void const *arg1, void
 
 static struct jool_result handle_eamt_tag(cJSON *json, void const *arg1, void *arg2)
 {
-	return handle_array(json, JNLAR_EAMT_ENTRIES, OPTNAME_EAMT, handle_eam_entry);
+	return incremental
+		? collect_array(json, OPTNAME_EAMT, json2eam, &file_eamt)
+		: handle_array(json, JNLAR_EAMT_ENTRIES, OPTNAME_EAMT, handle_eam_entry);
 }
 
 static struct jool_result handle_bl4_tag(cJSON *json, void const *arg1, void *arg2)
 {
-	return handle_array(json, JNLAR_BL4_ENTRIES, OPTNAME_BLACKLIST, handle_denylist_entry);
+	return incremental
+		? collect_array(json, OPTNAME_BLACKLIST, json2denylist, &file_denylist4)
+		: handle_array(json, JNLAR_BL4_ENTRIES, OPTNAME_BLACKLIST, handle_denylist_entry);
 }
 
 static struct jool_result handle_dl4_tag(cJSON *json, void const *arg1, void *arg2)
 {
-	return handle_array(json, JNLAR_BL4_ENTRIES, OPTNAME_DENYLIST, handle_denylist_entry);
+	return incremental
+		? collect_array(json, OPTNAME_DENYLIST, json2denylist, &file_denylist4)
+		: handle_array(json, JNLAR_BL4_ENTRIES, OPTNAME_DENYLIST, handle_denylist_entry);
 }
 
 static struct jool_result handle_pool4_tag(cJSON *json, void const *arg1, void *arg2)
 {
-	return handle_array(json, JNLAR_POOL4_ENTRIES, OPTNAME_POOL4, handle_pool4_entry);
+	struct pool4_item *items;
+	unsigned int i;
+	struct jool_result result;
+
+	if (!incremental)
+		return handle_array(json, JNLAR_POOL4_ENTRIES, OPTNAME_POOL4,
+				handle_pool4_entry);
+
+	result = collect_array(json, OPTNAME_POOL4, json2pool4, &file_pool4);
+	if (result.error)
+		return result;
+
+	items = file_pool4.entries;
+	for (i = 0; i < file_pool4.count; i++)
+		items[i].index = i;
+	return result_success();
 }
 
 static struct jool_result handle_bib_tag(cJSON *json, void const *arg1, void *arg2)
 {
+	/* The kernel ignores the BIB on updates anyway. */
+	if (incremental)
+		return result_success();
 	return handle_array(json, JNLAR_BIB_ENTRIES, OPTNAME_BIB, handle_bib_entry);
 }
 
@@ -645,14 +1392,17 @@ static struct jool_result send_ctrl_msg(bool init)
 	struct nl_msg *msg;
 	struct jool_result result;
 
-	result = joolnl_alloc_msg(&sk, iname, JNLOP_FILE_HANDLE, 0, &msg);
+	result = joolnl_alloc_msg(&sk, iname, JNLOP_FILE_HANDLE, force, &msg);
 	if (result.error)
 		return result;
 
-	if (init)
+	if (init) {
 		NLA_PUT_U8(msg, JNLAR_ATOMIC_INIT, xlator_flags2xf(flags));
-	else
+		if (incremental)
+			NLA_PUT_FLAG(msg, JNLAR_ATOMIC_INCREMENTAL);
+	} else {
 		NLA_PUT(msg, JNLAR_ATOMIC_END, 0, NULL);
+	}
 
 	result = joolnl_request(&sk, msg, NULL, NULL);
 	if (result.error)
@@ -683,6 +1433,11 @@ static struct jool_result do_parsing(char const *iname, char *buffer)
 	if (result.error)
 		goto fail;
 
+	tables_init();
+	result = prepare_incremental();
+	if (result.error)
+		goto fail;
+
 	result = send_ctrl_msg(true);
 	if (result.error)
 		goto fail;
@@ -704,21 +1459,35 @@ static struct jool_result do_parsing(char const *iname, char *buffer)
 	if (result.error)
 		goto fail;
 
+	if (incremental) {
+		result = send_table_deltas();
+		if (result.error)
+			goto fail;
+	}
+
 	/*
 	 * Send the control message before deleting, because @iname might point
 	 * to the json object, and send_ctrl_msg() needs @iname.
 	 */
 	result = send_ctrl_msg(false);
+	tables_cleanup();
 	cJSON_Delete(json);
 	return result;
 
 fail:
+	tables_cleanup();
 	cJSON_Delete(json);
 	return result;
 }
 
+/*
+ * If @_incremental and the instance already exists, only the differences
+ * between the running tables and the file are sent to the kernel.
+ * Otherwise, the instance is rebuilt from scratch.
+ */
 struct jool_result joolnl_file_parse(struct joolnl_socket *_sk, xlator_type xt,
-		char const *iname, char const *file_name, bool _force)
+		char const *iname, char const *file_name, bool _force,
+		bool _incremental)
 {
 	char *buffer;
 	struct jool_result result;
@@ -726,6 +1495,7 @@ struct jool_result joolnl_file_parse(struct joolnl_socket *_sk, xlator_type xt,
 	sk = *_sk;
 	flags = xt;
 	force = _force ? JOOLNLHDR_FLAGS_FORCE : 0;
+	incremental = _incremental;
 
 	result = file_to_string(file_name, &buffer);
 	if (result.error)
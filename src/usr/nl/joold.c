@@ -3,6 +3,8 @@
 #include <stddef.h>
 #include <netlink/msg.h>
 #include "common/config.h"
+#include "usr/nl/attribute.h"
+#include "usr/nl/common.h"
 
 static struct jool_result send_to_kernel(struct joolnl_socket *sk,
 		struct nl_msg *msg)
@@ -62,6 +64,70 @@ struct jool_result joolnl_joold_advertise(struct joolnl_socket *sk,
 	return send_to_kernel(sk, msg);
 }
 
+struct jool_result joolnl_joold_resync(struct joolnl_socket *sk,
+		char const *iname)
+{
+	struct nl_msg *msg;
+	struct jool_result result;
+
+	result = joolnl_alloc_msg(sk, iname, JNLOP_JOOLD_RESYNC, 0, &msg);
+	if (result.error)
+		return result;
+
+	return send_to_kernel(sk, msg);
+}
+
+static int nla_put_joold_socket(struct nl_msg *msg,
+		struct joolnl_joold_socket const *cfg)
+{
+	struct nlattr *root;
+
+	root = jnla_nest_start(msg, JNLAR_OPERAND);
+	if (!root)
+		return -NLE_NOMEM;
+
+	if (cfg->family == AF_INET)
+		NLA_PUT(msg, JNLAJS_ADDR, sizeof(cfg->addr.v4), &cfg->addr.v4);
+	else
+		NLA_PUT(msg, JNLAJS_ADDR, sizeof(cfg->addr.v6), &cfg->addr.v6);
+	NLA_PUT_U16(msg, JNLAJS_PORT, cfg->port);
+	if (cfg->in_ifindex)
+		NLA_PUT_U32(msg, JNLAJS_IN_IFINDEX, cfg->in_ifindex);
+	if (cfg->out_ifindex)
+		NLA_PUT_U32(msg, JNLAJS_OUT_IFINDEX, cfg->out_ifindex);
+	if (cfg->ttl_set)
+		NLA_PUT_U8(msg, JNLAJS_TTL, cfg->ttl);
+
+	nla_nest_end(msg, root);
+	return 0;
+
+nla_put_failure:
+	nla_nest_cancel(msg, root);
+	return -NLE_NOMEM;
+}
+
+/*
+ * Have the kernel module exchange the sessions through its own socket. (NULL
+ * @cfg means "go back to multicasting them to the daemon".)
+ */
+struct jool_result joolnl_joold_transport(struct joolnl_socket *sk,
+		char const *iname, struct joolnl_joold_socket const *cfg)
+{
+	struct nl_msg *msg;
+	struct jool_result result;
+
+	result = joolnl_alloc_msg(sk, iname, JNLOP_JOOLD_TRANSPORT, 0, &msg);
+	if (result.error)
+		return result;
+
+	if (cfg && nla_put_joold_socket(msg, cfg) < 0) {
+		nlmsg_free(msg);
+		return joolnl_err_msgsize();
+	}
+
+	return joolnl_request(sk, msg, NULL, NULL);
+}
+
 struct jool_result joolnl_joold_ack(struct joolnl_socket *sk, char const *iname)
 {
 	struct nl_msg *msg;
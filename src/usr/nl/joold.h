@@ -1,8 +1,26 @@
 #ifndef SRC_USR_NL_JOOLD_H_
 #define SRC_USR_NL_JOOLD_H_
 
+#include <netinet/in.h>
 #include "usr/nl/core.h"
 
+/* Configuration of the kernel module's own joold socket. */
+struct joolnl_joold_socket {
+	/* AF_INET or AF_INET6. */
+	int family;
+	union {
+		struct in_addr v4;
+		struct in6_addr v6;
+	} addr;
+	__u16 port;
+	/* Zero means "any." */
+	unsigned int in_ifindex;
+	/* Zero means "route." */
+	unsigned int out_ifindex;
+	int ttl;
+	bool ttl_set;
+};
+
 struct jool_result joolnl_joold_add(
 	struct joolnl_socket *sk,
 	char const *iname,
@@ -15,6 +33,17 @@ struct jool_result joolnl_joold_advertise(
 	char const *iname
 );
 
+struct jool_result joolnl_joold_resync(
+	struct joolnl_socket *sk,
+	char const *iname
+);
+
+struct jool_result joolnl_joold_transport(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct joolnl_joold_socket const *cfg
+);
+
 struct jool_result joolnl_joold_ack(
 	struct joolnl_socket *sk,
 	char const *iname
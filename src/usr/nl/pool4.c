@@ -106,6 +106,20 @@ struct jool_result joolnl_pool4_add(struct joolnl_socket *sk, char const *iname,
 	return __update(sk, iname, JNLOP_POOL4_ADD, entry, false);
 }
 
+static int put_pool4(struct nl_msg *msg, unsigned int index, void const *arg)
+{
+	struct pool4_entry const *entries = arg;
+	return nla_put_pool4(msg, JNLAL_ENTRY, &entries[index]);
+}
+
+struct jool_result joolnl_pool4_add_bulk(struct joolnl_socket *sk,
+		char const *iname, struct pool4_entry const *entries,
+		unsigned int count, joolnl_bulk_failure_cb cb, void *arg)
+{
+	return joolnl_bulk_add(sk, iname, JNLOP_POOL4_ADD, 0,
+			JNLAR_POOL4_ENTRIES, count, put_pool4, entries, cb, arg);
+}
+
 struct jool_result joolnl_pool4_rm(struct joolnl_socket *sk, char const *iname,
 		struct pool4_entry const *entry, bool quick)
 {
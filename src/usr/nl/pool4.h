@@ -2,6 +2,7 @@
 #define SRC_USR_NL_POOL4_H_
 
 #include "common/config.h"
+#include "usr/nl/common.h"
 #include "usr/nl/core.h"
 
 typedef struct jool_result (*joolnl_pool4_foreach_cb)(
@@ -22,6 +23,15 @@ struct jool_result joolnl_pool4_add(
 	struct pool4_entry const *entry
 );
 
+struct jool_result joolnl_pool4_add_bulk(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct pool4_entry const *entries,
+	unsigned int count,
+	joolnl_bulk_failure_cb cb,
+	void *arg
+);
+
 struct jool_result joolnl_pool4_rm(
 	struct joolnl_socket *sk,
 	char const *iname,
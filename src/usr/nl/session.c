@@ -1,6 +1,8 @@
 #include "usr/nl/session.h"
 
 #include <errno.h>
+#include <string.h>
+#include <netlink/genl/ctrl.h>
 #include <netlink/genl/genl.h>
 #include "usr/nl/attribute.h"
 #include "usr/nl/common.h"
@@ -42,6 +44,7 @@ static struct jool_result handle_foreach_response(struct nl_msg *response,
 
 struct jool_result joolnl_session_foreach(struct joolnl_socket *sk,
 		char const *iname, l4_protocol proto,
+		struct table_filter const *filter,
 		joolnl_session_foreach_cb cb, void *_args)
 {
 	struct nl_msg *msg;
@@ -68,6 +71,9 @@ struct jool_result joolnl_session_foreach(struct joolnl_socket *sk,
 		else if (nla_put_session(msg, JNLAR_OFFSET, &args.last) < 0)
 			goto cancel;
 
+		if (filter && nla_put_filter(msg, JNLAR_FILTER, filter) < 0)
+			goto cancel;
+
 		result = joolnl_request(sk, msg, handle_foreach_response, &args);
 		if (result.error)
 			return result;
@@ -80,3 +86,235 @@ cancel:
 	return joolnl_err_msgsize();
 }
 
+
+static int put_session(struct nl_msg *msg, unsigned int index,
+		void const *arg)
+{
+	struct session_entry_usr const *entries = arg;
+	return nla_put_session(msg, JNLAL_ENTRY, &entries[index]);
+}
+
+/* Timers should be sorted by expiration; see bib_add_session_bulk(). */
+struct jool_result joolnl_session_add_bulk(struct joolnl_socket *sk,
+		char const *iname, struct session_entry_usr const *entries,
+		unsigned int count, joolnl_bulk_failure_cb cb, void *arg)
+{
+	return joolnl_bulk_add(sk, iname, JNLOP_SESSION_ADD, 0,
+			JNLAR_SESSION_ENTRIES, count, put_session, entries,
+			cb, arg);
+}
+
+static int put_touch(struct nl_msg *msg, unsigned int index, void const *arg)
+{
+	struct session_touch_usr const *touches = arg;
+	return nla_put_session_touch(msg, JNLAL_ENTRY, &touches[index]);
+}
+
+struct jool_result joolnl_session_touch_bulk(struct joolnl_socket *sk,
+		char const *iname, struct session_touch_usr const *touches,
+		unsigned int count, joolnl_bulk_failure_cb cb, void *arg)
+{
+	return joolnl_bulk_add(sk, iname, JNLOP_SESSION_TOUCH, 0,
+			JNLAR_SESSION_ENTRIES, count, put_touch, touches,
+			cb, arg);
+}
+
+static struct jool_result nla_get_u32_list(struct nlattr *root,
+		char const *what, __u32 *values, unsigned int count)
+{
+	struct nlattr *attr;
+	int rem;
+
+	memset(values, 0, count * sizeof(*values));
+
+	nla_for_each_nested(attr, root, rem) {
+		if (nla_type(attr) < 1 || nla_type(attr) > count
+				|| nla_len(attr) != sizeof(__u32)) {
+			return result_from_error(
+				-EINVAL,
+				"The kernel's %s list contains an unknown element.",
+				what
+			);
+		}
+		values[nla_type(attr) - 1] = nla_get_u32(attr);
+	}
+
+	return result_success();
+}
+
+static struct jool_result handle_stats_response(struct nl_msg *response,
+		void *arg)
+{
+	struct nlattr *attrs[JNLASS_COUNT];
+	struct session_stats *stats = arg;
+	struct jool_result result;
+
+	result = jnla_parse_msg(response, attrs, JNLASS_MAX,
+			joolnl_session_stats_policy, false);
+	if (result.error)
+		return result;
+
+	if (!attrs[JNLASS_BIBS] || !attrs[JNLASS_SESSIONS]
+			|| !attrs[JNLASS_EST] || !attrs[JNLASS_TRANS]
+			|| !attrs[JNLASS_SYN4] || !attrs[JNLASS_STORED_PKTS]
+			|| !attrs[JNLASS_STATES] || !attrs[JNLASS_EST_TIMEOUT]
+			|| !attrs[JNLASS_TRANS_TIMEOUT]) {
+		return result_from_error(
+			-EINVAL,
+			"The kernel's response lacks some session counters."
+		);
+	}
+
+	stats->bibs = nla_get_u32(attrs[JNLASS_BIBS]);
+	stats->sessions = nla_get_u32(attrs[JNLASS_SESSIONS]);
+	stats->est = nla_get_u32(attrs[JNLASS_EST]);
+	stats->trans = nla_get_u32(attrs[JNLASS_TRANS]);
+	stats->syn4 = nla_get_u32(attrs[JNLASS_SYN4]);
+	stats->stored_pkts = nla_get_u32(attrs[JNLASS_STORED_PKTS]);
+	stats->est_timeout = nla_get_u32(attrs[JNLASS_EST_TIMEOUT]);
+	stats->trans_timeout = nla_get_u32(attrs[JNLASS_TRANS_TIMEOUT]);
+	result = nla_get_u32_list(attrs[JNLASS_STATES], "TCP state",
+			stats->states, TCP_STATE_COUNT);
+	if (result.error)
+		return result;
+
+	stats->has_ages = !!attrs[JNLASS_AGES];
+	if (!stats->has_ages)
+		return result_success();
+	return nla_get_u32_list(attrs[JNLASS_AGES], "session age",
+			stats->ages, SESSION_AGE_BUCKETS);
+}
+
+struct jool_result joolnl_session_stats(struct joolnl_socket *sk,
+		char const *iname, l4_protocol proto, bool histogram,
+		struct session_stats *result)
+{
+	struct nl_msg *msg;
+	struct jool_result error;
+
+	error = joolnl_alloc_msg(sk, iname, JNLOP_SESSION_STATS, 0, &msg);
+	if (error.error)
+		return error;
+
+	if (nla_put_u8(msg, JNLAR_PROTO, proto) < 0)
+		goto cancel;
+	if (histogram && nla_put_flag(msg, JNLAR_HISTOGRAM) < 0)
+		goto cancel;
+
+	memset(result, 0, sizeof(*result));
+	return joolnl_request(sk, msg, handle_stats_response, result);
+
+cancel:
+	nlmsg_free(msg);
+	return joolnl_err_msgsize();
+}
+
+/* The collector can fall behind during bursts; give it some slack. */
+#define EVENTS_RCVBUF (4 * 1024 * 1024)
+
+struct events_args {
+	char const *iname;
+	joolnl_event_cb cb;
+	void *arg;
+	struct jool_result result;
+};
+
+static int handle_events(struct nl_msg *msg, void *arg)
+{
+	struct events_args *args = arg;
+	struct nlmsghdr *nhdr;
+	struct joolnlhdr *jhdr;
+	struct nlattr *attrs[JNLAR_COUNT];
+	unsigned int dropped;
+	int error;
+
+	nhdr = nlmsg_hdr(msg);
+	if (!genlmsg_valid_hdr(nhdr, sizeof(struct joolnlhdr)))
+		return NL_SKIP;
+	jhdr = genlmsg_user_hdr(genlmsg_hdr(nhdr));
+	if (validate_joolnlhdr(jhdr, XT_NAT64).error)
+		return NL_SKIP;
+	if (strncmp(jhdr->iname, args->iname, INAME_MAX_SIZE) != 0)
+		return NL_SKIP; /* Some other instance's */
+
+	error = genlmsg_parse(nhdr, sizeof(struct joolnlhdr), attrs, JNLAR_MAX,
+			NULL);
+	if (error || !attrs[JNLAR_EVENTS])
+		return NL_SKIP;
+
+	dropped = attrs[JNLAR_EVENTS_DROPPED]
+			? nla_get_u32(attrs[JNLAR_EVENTS_DROPPED])
+			: 0;
+	args->result = args->cb(nla_data(attrs[JNLAR_EVENTS]),
+			nla_len(attrs[JNLAR_EVENTS]) / sizeof(struct jool_event),
+			dropped, args->arg);
+	return args->result.error ? NL_STOP : NL_OK;
+}
+
+struct jool_result joolnl_session_events_subscribe(struct joolnl_socket *sk)
+{
+	int group;
+	int error;
+
+	group = genl_ctrl_resolve_grp(sk->sk, JOOLNL_FAMILY,
+			JOOLNL_EVENTS_GRP_NAME);
+	if (group < 0) {
+		return result_from_error(group,
+				"Unable to resolve the events multicast group: %s",
+				nl_geterror(group));
+	}
+
+	error = nl_socket_add_membership(sk->sk, group);
+	if (error) {
+		return result_from_error(error,
+				"Cannot join the events multicast group: %s",
+				nl_geterror(error));
+	}
+
+	nl_socket_disable_seq_check(sk->sk);
+	nl_socket_set_buffer_size(sk->sk, EVENTS_RCVBUF, 0);
+	return result_success();
+}
+
+struct jool_result joolnl_session_events_recv(struct joolnl_socket *sk,
+		char const *iname, joolnl_event_cb cb, unsigned int *overruns,
+		void *arg)
+{
+	struct events_args args;
+	int error;
+
+	args.iname = iname ? iname : INAME_DEFAULT;
+	args.cb = cb;
+	args.arg = arg;
+	args.result = result_success();
+
+	error = nl_socket_modify_cb(sk->sk, NL_CB_VALID, NL_CB_CUSTOM,
+			handle_events, &args);
+	if (error) {
+		return result_from_error(error,
+				"Cannot register the events callback: %s",
+				nl_geterror(error));
+	}
+
+	error = nl_recvmsgs_default(sk->sk);
+	if (args.result.error)
+		return args.result;
+
+	switch (error) {
+	case -NLE_AGAIN:
+		/* Receive timeout. */
+		return result_success();
+	case -NLE_NOMEM:
+		/*
+		 * Receive buffer overrun. The lost batches cannot be counted,
+		 * but the caller can at least tell the user it happened.
+		 */
+		(*overruns)++;
+		return result_success();
+	}
+
+	return (error < 0)
+			? result_from_error(error, "Error receiving events: %s",
+					nl_geterror(error))
+			: result_success();
+}
@@ -2,6 +2,7 @@
 #define SRC_USR_NL_SESSION_H_
 
 #include "common/config.h"
+#include "usr/nl/common.h"
 #include "usr/nl/core.h"
 
 /**
@@ -19,19 +20,94 @@ struct session_entry_usr {
 	struct ipv4_transport_addr dst4;
 	__u8 proto;
 	__u8 state;
+	__u8 timer; /* session_timer_type */
 	__u32 dying_time;
+	/* Milliseconds since the session was created. */
+	__u32 age;
+};
+
+/* A session someone else has been translating. (See JNLOP_SESSION_TOUCH.) */
+struct session_touch_usr {
+	struct session_entry_usr session;
+	/* Milliseconds since the session's last packet. */
+	__u32 idle;
 };
 
 typedef struct jool_result (*joolnl_session_foreach_cb)(
 	struct session_entry_usr const *entry, void *args
 );
 
+/* @filter can be NULL. */
 struct jool_result joolnl_session_foreach(
 	struct joolnl_socket *sk,
 	char const *iname,
 	l4_protocol proto,
+	struct table_filter const *filter,
 	joolnl_session_foreach_cb cb,
 	void *args
 );
 
+/* Imports sessions, as a batch. (ie. `jool session import`.) */
+struct jool_result joolnl_session_add_bulk(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct session_entry_usr const *entries,
+	unsigned int count,
+	joolnl_bulk_failure_cb cb,
+	void *arg
+);
+
+/*
+ * Tells the kernel the @count sessions have seen traffic it did not. Sessions
+ * that are gone (or no longer established) are reported through @cb.
+ */
+struct jool_result joolnl_session_touch_bulk(
+	struct joolnl_socket *sk,
+	char const *iname,
+	struct session_touch_usr const *touches,
+	unsigned int count,
+	joolnl_bulk_failure_cb cb,
+	void *arg
+);
+
+/* The age histogram is only requested (and walked) if @histogram is true. */
+struct jool_result joolnl_session_stats(
+	struct joolnl_socket *sk,
+	char const *iname,
+	l4_protocol proto,
+	bool histogram,
+	struct session_stats *result
+);
+
+/*
+ * @events is an array of @count records. @dropped is the number of events the
+ * kernel could not deliver since the previous batch from the same CPU.
+ */
+typedef struct jool_result (*joolnl_event_cb)(
+	struct jool_event const *events,
+	unsigned int count,
+	unsigned int dropped,
+	void *arg
+);
+
+/*
+ * Subscribes @sk to the binary logging multicast group. (See logging-binary.)
+ * @sk should not be used for requests afterwards.
+ */
+struct jool_result joolnl_session_events_subscribe(struct joolnl_socket *sk);
+/*
+ * Waits for the next round of event batches, and hands @iname's to @cb.
+ * Returns success on receive timeouts, so callers can set SO_RCVTIMEO to wake
+ * up periodically.
+ * If the socket's receive buffer overflowed (which means some batches were
+ * lost), @overruns is incremented, and success is returned as well.
+ */
+struct jool_result joolnl_session_events_recv(
+	struct joolnl_socket *sk,
+	char const *iname,
+	joolnl_event_cb cb,
+	unsigned int *overruns,
+	void *arg
+);
+
 #endif /* SRC_USR_NL_SESSION_H_ */
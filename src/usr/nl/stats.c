@@ -90,6 +90,33 @@ static struct joolnl_stat_metadata const jstat_metadatas[] = {
 	DEFINE_STAT(JSTAT_ICMP4ERR_FAILURE, "ICMPv4 errors (created by Jool, not translated) that could not be sent."),
 	DEFINE_STAT(JSTAT_ICMPEXT_SMALL, "Illegal ICMP header length. (Inner packet has less than 128 bytes.)"),
 	DEFINE_STAT(JSTAT_ICMPEXT_BIG, "Illegal ICMP header length. (Exceeds available payload in packet.)"),
+	DEFINE_STAT(JSTAT_JOOLD_FILTER_PROTO, "Session updates not synchronized because joold was told to ignore their protocol."),
+	DEFINE_STAT(JSTAT_JOOLD_FILTER_STATE, "TCP session updates not synchronized because the session was not ESTABLISHED."),
+	DEFINE_STAT(JSTAT_JOOLD_FILTER_AGE, "Session updates not synchronized because the session was younger than ss-sync-min-age."),
+	DEFINE_STAT(JSTAT_JOOLD_FILTER_SRC6, "Session updates not synchronized because the IPv6 client did not belong to ss-sync-src6-prefix."),
+	DEFINE_STAT(JSTAT_SUBSCRIBERS, "Number of subscribers (src6 prefixes of length subscriber-prefix-len) currently holding BIB entries."),
+	DEFINE_STAT(JSTAT_SUBSCRIBER_QUOTA, TC "The IPv6 client's subscriber already had subscriber-max-bibs BIB entries or subscriber-max-sessions sessions."),
+	DEFINE_STAT(JSTAT_SESSION_MEMORY_LIMIT, TC "The instance had reached session-memory-limit, and there were no evictable sessions left in the table."),
+	DEFINE_STAT(JSTAT_EVICTED_MEMORY_LIMIT, "Sessions evicted early (oldest first) to stay within session-memory-limit."),
+	DEFINE_STAT(JSTAT_EVICTED_MEMORY_PRESSURE, "Sessions evicted early (oldest first) because the kernel was running low on memory."),
+	DEFINE_STAT(JSTAT_EVENTS_DROPPED, "BIB/session events (logging-binary) that could not be delivered to the collector."),
+	DEFINE_STAT(JSTAT_XLAT_IN_PLACE, "Packets translated by rewriting their own headers. (See translate-in-place.)"),
+	DEFINE_STAT(JSTAT_XLAT_COPIED, "Packets translated into a new skb."),
+	DEFINE_STAT(JSTAT46_GSO_SEGMENTED, "GSO/GRO IPv4 super-packets whose segments needed fragmentation, so they had to be segmented and translated one by one."),
+	DEFINE_STAT(JSTAT_ROUTE_CACHE_HIT, "Translated packets that reused a cached route. (See session-route-cache and destination-route-cache.)"),
+	DEFINE_STAT(JSTAT_ROUTE_CACHE_MISS, "Translated packets that found no usable cached route, so they had to be routed."),
+	DEFINE_STAT(JSTAT_ROUTE_CACHE_INVALID, "Cached routes that were dropped because the routing tables changed."),
+	DEFINE_STAT(JSTAT_CSUM_INCREMENTAL, "Transport checksums updated incrementally. (Only the headers were summed.)"),
+	DEFINE_STAT(JSTAT_CSUM_OFFLOADED, "Transport checksums left for the NIC (or the kernel) to compute on the way out."),
+	DEFINE_STAT(JSTAT_CSUM_COMPUTED, "Transport checksums computed from scratch, over the entire payload."),
+	DEFINE_STAT(JSTAT_CSUM_COMPLETE_UPDATED, "Packets whose hardware-computed packet sum (CHECKSUM_COMPLETE) was carried over to the translated packet."),
+	DEFINE_STAT(JSTAT_FRAG_TRACKED, "First fragments whose ports were remembered for the rest of their packet. (See fragment-tracking.)"),
+	DEFINE_STAT(JSTAT_FRAG_MATCHED, "Subsequent fragments matched to the ports of their first fragment."),
+	DEFINE_STAT(JSTAT_FRAG_UNTRACKED, TC "Fragment could not be tracked, so it was left to the kernel's defragmenter. (It arrived before its first fragment, after its packet was forgotten, or while the tracker was full.)"),
+	DEFINE_STAT(JSTAT_FRAG_EVICTED, "Fragmented packets forgotten early because fragment-tracking-capacity was reached."),
+	DEFINE_STAT(JSTAT_FLOW_CACHE_HIT, "Packets that skipped the session lookup because their flow was cached. (See flow-cache.)"),
+	DEFINE_STAT(JSTAT_FLOW_CACHE_MISS, "Cacheable packets whose flow was not cached, and so needed the session lookup."),
+	DEFINE_STAT(JSTAT_FLOW_CACHE_EVICTED, "Flows forgotten early because flow-cache-capacity was reached."),
 	DEFINE_STAT(JSTAT_UNKNOWN, TC "Programming error found. The module recovered, but the packet was dropped."),
 	DEFINE_STAT(JSTAT_PADDING, "Dummy; ignore this one."),
 };
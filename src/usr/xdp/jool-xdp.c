@@ -0,0 +1,407 @@
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <net/if.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <linux/if_link.h>
+
+#include "common/types.h"
+#include "common/xlat.h"
+#include "usr/nl/instance.h"
+#include "usr/xdp/maps.h"
+#include "usr/xdp/sync.h"
+
+#ifndef JOOL_XDP_OBJECT
+#define JOOL_XDP_OBJECT "/usr/local/lib/jool/jool_xdp.o"
+#endif
+
+#define MAX_INTERFACES 16
+
+struct xdp_args {
+	char const *iname;
+	xlator_type xt;
+	char const *object;
+	unsigned int interval;
+	unsigned int capacity;
+	__u32 flags;
+
+	int ifindexes[MAX_INTERFACES];
+	unsigned int ifcount;
+};
+
+static volatile sig_atomic_t stop;
+
+static void handle_signal(int signum)
+{
+	stop = 1;
+}
+
+static int setup_signals(void)
+{
+	struct sigaction action;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handle_signal;
+	sigemptyset(&action.sa_mask);
+
+	if (sigaction(SIGINT, &action, NULL) || sigaction(SIGTERM, &action, NULL)) {
+		fprintf(stderr, "Cannot install the signal handlers: %s\n",
+				strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+static void print_usage(void)
+{
+	printf("Usage: jool-xdp [OPTIONS] INTERFACE...\n");
+	printf("Translates the traffic of a Jool instance's simplest flows from XDP.\n");
+	printf("\n");
+	printf("  -i, --instance=NAME    Instance to offload (default: %s)\n",
+			INAME_DEFAULT);
+	printf("  -s, --siit             The instance is SIIT (default: NAT64)\n");
+	printf("  -o, --object=FILE      BPF object (default: %s)\n",
+			JOOL_XDP_OBJECT);
+	printf("  -t, --interval=SECS    Seconds between sync rounds (default: 1)\n");
+	printf("  -c, --capacity=COUNT   Maximum offloaded NAT64 sessions (default: 65536)\n");
+	printf("  -g, --generic          Use generic (skb) XDP instead of native\n");
+	printf("  -h, --help             Print this and exit\n");
+	printf("  -V, --version          Print the version and exit\n");
+}
+
+static int parse_uint(char const *str, char const *what, unsigned int *result)
+{
+	unsigned long value;
+	char *end;
+
+	errno = 0;
+	value = strtoul(str, &end, 10);
+	if (errno || *end != '\0' || value == 0 || value > UINT_MAX) {
+		fprintf(stderr, "Invalid %s: '%s'\n", what, str);
+		return -EINVAL;
+	}
+
+	*result = value;
+	return 0;
+}
+
+static int parse_args(int argc, char **argv, struct xdp_args *args)
+{
+	static struct option const options[] = {
+		{ "instance", required_argument, NULL, 'i' },
+		{ "siit", no_argument, NULL, 's' },
+		{ "object", required_argument, NULL, 'o' },
+		{ "interval", required_argument, NULL, 't' },
+		{ "capacity", required_argument, NULL, 'c' },
+		{ "generic", no_argument, NULL, 'g' },
+		{ "help", no_argument, NULL, 'h' },
+		{ "version", no_argument, NULL, 'V' },
+		{ 0 },
+	};
+	int opt;
+	int error;
+
+	args->iname = INAME_DEFAULT;
+	args->xt = XT_NAT64;
+	args->object = JOOL_XDP_OBJECT;
+	args->interval = 1;
+	args->capacity = 0;
+	args->flags = XDP_FLAGS_DRV_MODE;
+	args->ifcount = 0;
+
+	while ((opt = getopt_long(argc, argv, "i:so:t:c:ghV", options, NULL)) != -1) {
+		switch (opt) {
+		case 'i':
+			args->iname = optarg;
+			break;
+		case 's':
+			args->xt = XT_SIIT;
+			break;
+		case 'o':
+			args->object = optarg;
+			break;
+		case 't':
+			error = parse_uint(optarg, "interval", &args->interval);
+			if (error)
+				return error;
+			break;
+		case 'c':
+			error = parse_uint(optarg, "capacity", &args->capacity);
+			if (error)
+				return error;
+			break;
+		case 'g':
+			args->flags = XDP_FLAGS_SKB_MODE;
+			break;
+		case 'h':
+			print_usage();
+			exit(EXIT_SUCCESS);
+		case 'V':
+			printf(JOOL_VERSION_STR "\n");
+			exit(EXIT_SUCCESS);
+		default:
+			print_usage();
+			return -EINVAL;
+		}
+	}
+
+	if (optind == argc) {
+		fprintf(stderr, "I need at least one interface.\n");
+		print_usage();
+		return -EINVAL;
+	}
+	if (argc - optind > MAX_INTERFACES) {
+		fprintf(stderr, "Too many interfaces. (Max: %u)\n",
+				MAX_INTERFACES);
+		return -EINVAL;
+	}
+
+	for (; optind < argc; optind++) {
+		args->ifindexes[args->ifcount] = if_nametoindex(argv[optind]);
+		if (!args->ifindexes[args->ifcount]) {
+			fprintf(stderr, "Unknown interface: '%s'\n", argv[optind]);
+			return -EINVAL;
+		}
+		args->ifcount++;
+	}
+
+	return 0;
+}
+
+static int check_instance(struct xdp_sync *sync)
+{
+	enum instance_hello_status status;
+	struct jool_result result;
+
+	result = joolnl_instance_hello(&sync->sk, sync->iname, &status);
+	if (result.error) {
+		fprintf(stderr, "%s\n", result.msg);
+		result_cleanup(&result);
+		return result.error;
+	}
+
+	if (status != IHS_ALIVE) {
+		fprintf(stderr, "Instance '%s' does not exist.\n", sync->iname);
+		return -ESRCH;
+	}
+
+	return 0;
+}
+
+static int map_fd(struct bpf_object *obj, char const *name)
+{
+	int fd;
+
+	fd = bpf_object__find_map_fd_by_name(obj, name);
+	if (fd < 0)
+		fprintf(stderr, "The BPF object lacks map '%s'.\n", name);
+	return fd;
+}
+
+static struct bpf_object *load_object(struct xdp_args *args,
+		struct xdp_sync *sync)
+{
+	struct bpf_object *obj;
+	int error;
+
+	obj = bpf_object__open_file(args->object, NULL);
+	if (!obj) {
+		fprintf(stderr, "Cannot open %s: %s\n", args->object,
+				strerror(errno));
+		return NULL;
+	}
+
+	if (args->capacity) {
+		error = bpf_map__set_max_entries(
+				bpf_object__find_map_by_name(obj, "sessions6"),
+				args->capacity);
+		if (!error)
+			error = bpf_map__set_max_entries(
+					bpf_object__find_map_by_name(obj, "sessions4"),
+					args->capacity);
+		if (error) {
+			fprintf(stderr, "Cannot resize the session maps: %s\n",
+					strerror(-error));
+			goto fail;
+		}
+	}
+
+	error = bpf_object__load(obj);
+	if (error) {
+		fprintf(stderr, "Cannot load %s: %s\n", args->object,
+				strerror(-error));
+		goto fail;
+	}
+
+	sync->config_fd = map_fd(obj, "config");
+	sync->sessions6_fd = map_fd(obj, "sessions6");
+	sync->sessions4_fd = map_fd(obj, "sessions4");
+	sync->eamt6_fd = map_fd(obj, "eamt6");
+	sync->eamt4_fd = map_fd(obj, "eamt4");
+	sync->denylist4_fd = map_fd(obj, "denylist4");
+	sync->local4_fd = map_fd(obj, "local4");
+	if (sync->config_fd < 0 || sync->sessions6_fd < 0
+			|| sync->sessions4_fd < 0 || sync->eamt6_fd < 0
+			|| sync->eamt4_fd < 0 || sync->denylist4_fd < 0
+			|| sync->local4_fd < 0)
+		goto fail;
+
+	return obj;
+
+fail:
+	bpf_object__close(obj);
+	return NULL;
+}
+
+static int attach(struct xdp_args *args, struct bpf_object *obj)
+{
+	struct bpf_program *prog;
+	unsigned int i;
+	int error;
+
+	prog = bpf_object__find_program_by_name(obj, "jool_xdp");
+	if (!prog) {
+		fprintf(stderr, "The BPF object lacks program 'jool_xdp'.\n");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < args->ifcount; i++) {
+		error = bpf_xdp_attach(args->ifindexes[i], bpf_program__fd(prog),
+				args->flags, NULL);
+		if (error) {
+			fprintf(stderr, "Cannot attach to interface %d: %s\n",
+					args->ifindexes[i], strerror(-error));
+			goto revert;
+		}
+	}
+
+	return 0;
+
+revert:
+	while (i-- > 0)
+		bpf_xdp_detach(args->ifindexes[i], args->flags, NULL);
+	return error;
+}
+
+static void detach(struct xdp_args *args)
+{
+	unsigned int i;
+
+	for (i = 0; i < args->ifcount; i++)
+		bpf_xdp_detach(args->ifindexes[i], args->flags, NULL);
+}
+
+static void print_stats(struct bpf_object *obj)
+{
+	static char const *const names[] = {
+		[XDP_STAT_XLAT64] = "Translated 6->4",
+		[XDP_STAT_XLAT46] = "Translated 4->6",
+		[XDP_STAT_PUNT] = "Punted to the kernel",
+		[XDP_STAT_NO_ROUTE] = "Punted for lack of a route",
+	};
+	int ncpus;
+	int fd;
+	__u64 *values;
+	__u64 total;
+	__u32 key;
+	int cpu;
+
+	fd = bpf_object__find_map_fd_by_name(obj, "stats");
+	ncpus = libbpf_num_possible_cpus();
+	if (fd < 0 || ncpus <= 0)
+		return;
+
+	values = calloc(ncpus, sizeof(*values));
+	if (!values)
+		return;
+
+	for (key = 0; key < XDP_STAT_COUNT; key++) {
+		if (bpf_map_lookup_elem(fd, &key, values))
+			continue;
+		total = 0;
+		for (cpu = 0; cpu < ncpus; cpu++)
+			total += values[cpu];
+		printf("%s: %llu\n", names[key], (unsigned long long)total);
+	}
+
+	free(values);
+}
+
+int main(int argc, char **argv)
+{
+	struct xdp_args args;
+	struct xdp_sync sync;
+	struct bpf_object *obj;
+	struct jool_result result;
+	int error;
+
+	error = parse_args(argc, argv, &args);
+	if (error)
+		return error;
+
+	memset(&sync, 0, sizeof(sync));
+	sync.iname = args.iname;
+	sync.xt = args.xt;
+
+	result = joolnl_setup(&sync.sk, sync.xt);
+	if (result.error) {
+		fprintf(stderr, "%s\n", result.msg);
+		result_cleanup(&result);
+		return result.error;
+	}
+
+	error = check_instance(&sync);
+	if (error)
+		goto end;
+
+	obj = load_object(&args, &sync);
+	if (!obj) {
+		error = -EINVAL;
+		goto end;
+	}
+
+	/* Fill the maps before the program sees any traffic. */
+	error = xdp_sync_round(&sync);
+	if (error)
+		goto close;
+	error = setup_signals();
+	if (error)
+		goto close;
+	error = attach(&args, obj);
+	if (error)
+		goto close;
+
+	while (!stop) {
+		sleep(args.interval);
+		if (stop)
+			break;
+		error = xdp_sync_round(&sync);
+		if (error) {
+			/* Don't translate with stale tables. */
+			xdp_sync_disable(&sync);
+			break;
+		}
+	}
+
+	detach(&args);
+	/* Refresh the sessions translated since the last round. */
+	if (!error)
+		error = xdp_sync_round(&sync);
+	print_stats(obj);
+	/* Fall through. */
+
+close:
+	bpf_object__close(obj);
+	/* Fall through. */
+
+end:
+	joolnl_teardown(&sync.sk);
+	return error;
+}
@@ -0,0 +1,601 @@
+/*
+ * Jool's XDP fast path. (See jool-xdp.c, which loads this.)
+ *
+ * Translates the packets of established NAT64 sessions (or of SIIT addresses
+ * that need nothing but the EAMT and pool6), and redirects them straight to
+ * their outgoing interface. Anything that needs more than that (fragments,
+ * IPv4 options, IPv6 extension headers, ICMP, TCP handshakes and teardowns,
+ * TTL expirations, MTU trouble, local destinations, etc.) is passed to the
+ * kernel, which hands it to Jool as usual.
+ *
+ * Build with clang -O2 -target bpf.
+ */
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <bpf/bpf_endian.h>
+#include <bpf/bpf_helpers.h>
+
+#include "maps.h"
+
+#ifndef AF_INET
+#define AF_INET 2
+#endif
+#ifndef AF_INET6
+#define AF_INET6 10
+#endif
+
+#define IP_DF 0x4000
+#define IP_MF 0x2000
+#define IP_OFFSET 0x1FFF
+
+/* Size difference between the IPv6 and IPv4 headers. */
+#define HDR_DIFF ((int)(sizeof(struct ipv6hdr) - sizeof(struct iphdr)))
+
+/* jool-xdp can override the sizes before loading. */
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, __u32);
+	__type(value, struct xdp_config);
+} config SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, 65536);
+	__type(key, struct xdp_key6);
+	__type(value, struct xdp_session6);
+} sessions6 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, 65536);
+	__type(key, struct xdp_key4);
+	__type(value, struct xdp_session4);
+} sessions4 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__uint(max_entries, 4096);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__type(key, struct xdp_lpm6);
+	__type(value, struct xdp_eam6);
+} eamt6 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__uint(max_entries, 4096);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__type(key, struct xdp_lpm4);
+	__type(value, struct xdp_eam4);
+} eamt4 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__uint(max_entries, 1024);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__type(key, struct xdp_lpm4);
+	__type(value, __u32);
+} denylist4 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, 256);
+	__type(key, __be32);
+	__type(value, __u32);
+} local4 SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, XDP_STAT_COUNT);
+	__type(key, __u32);
+	__type(value, __u64);
+} stats SEC(".maps");
+
+/* The L4 fields the translation rewrites. (Both TCP and UDP start with them.) */
+union ports {
+	struct {
+		__be16 src;
+		__be16 dst;
+	};
+	__be32 word;
+};
+
+static __always_inline void count(enum xdp_stat stat)
+{
+	__u32 key = stat;
+	__u64 *counter;
+
+	counter = bpf_map_lookup_elem(&stats, &key);
+	if (counter)
+		(*counter)++;
+}
+
+static __always_inline int punt(void)
+{
+	count(XDP_STAT_PUNT);
+	return XDP_PASS;
+}
+
+static __always_inline __u16 csum_fold(__u32 csum)
+{
+	csum = (csum & 0xFFFF) + (csum >> 16);
+	csum = (csum & 0xFFFF) + (csum >> 16);
+	return (__u16)~csum;
+}
+
+/*
+ * Adjusts the L4 checksum @check (of protocol @proto) after its pseudoheader
+ * addresses and ports changed from @old to @new.
+ *
+ * The pseudoheaders' length and protocol fields sum the same in both IP
+ * versions, so they don't need to be included.
+ */
+static __always_inline __u16 update_l4_csum(__u16 check, __u8 proto,
+		__be32 *old, __u32 old_size, __be32 *new, __u32 new_size)
+{
+	__u32 csum;
+
+	csum = bpf_csum_diff(old, old_size, new, new_size, (__u16)~check);
+	check = csum_fold(csum);
+	if (proto == IPPROTO_UDP && check == 0)
+		check = 0xFFFF;
+	return check;
+}
+
+/*
+ * Returns a pointer to @l4's checksum field, or NULL if the header is not
+ * complete or the packet needs the module. (TCP packets that carry SYN, FIN or
+ * RST drive the session's state machine.)
+ */
+static __always_inline __sum16 *get_l4_csum(void *l4, void *end, __u8 proto)
+{
+	struct tcphdr *tcp;
+	struct udphdr *udp;
+
+	switch (proto) {
+	case IPPROTO_TCP:
+		tcp = l4;
+		if ((void *)(tcp + 1) > end)
+			return NULL;
+		if (tcp->syn || tcp->fin || tcp->rst)
+			return NULL;
+		return &tcp->check;
+	case IPPROTO_UDP:
+		udp = l4;
+		if ((void *)(udp + 1) > end)
+			return NULL;
+		return &udp->check;
+	}
+
+	return NULL;
+}
+
+static __always_inline bool is_scope_subnet(__be32 addr)
+{
+	__u32 a = bpf_ntohl(addr);
+
+	return (a >> 24) == 0 /* 0.0.0.0/8 */
+			|| (a >> 24) == 127 /* 127.0.0.0/8 */
+			|| (a >> 16) == 0xA9FE /* 169.254.0.0/16 */
+			|| (a >> 28) == 0xE /* 224.0.0.0/4 */
+			|| a == 0xFFFFFFFF;
+}
+
+/* Mirrors the module's must_not_translate(). */
+static __always_inline bool must_not_translate(__be32 addr)
+{
+	return is_scope_subnet(addr) || bpf_map_lookup_elem(&local4, &addr);
+}
+
+static __always_inline bool is_denylisted(__be32 addr)
+{
+	struct xdp_lpm4 key = { .prefixlen = 32, .addr = addr };
+	return bpf_map_lookup_elem(&denylist4, &key) != NULL;
+}
+
+static __always_inline bool eamt4_contains(__be32 addr)
+{
+	struct xdp_lpm4 key = { .prefixlen = 32, .addr = addr };
+	return bpf_map_lookup_elem(&eamt4, &key) != NULL;
+}
+
+/* Bits a prefix of length @len (out of @total) leaves for the suffix. */
+static __always_inline __u32 suffix_mask(__u32 total, __u32 len)
+{
+	__u32 suffix_len = total - len;
+
+	if (suffix_len >= 32)
+		return 0xFFFFFFFF;
+	return (1u << suffix_len) - 1;
+}
+
+/*
+ * Mirrors the module's addrxlat_siit64() for outer packets that are not ICMP
+ * errors. Returns nonzero if the address cannot be translated here.
+ */
+static __always_inline int siit64_addr(struct xdp_config *cfg,
+		__be32 const *addr6, __be32 *addr4, bool *rfc6052)
+{
+	struct xdp_lpm6 key;
+	struct xdp_eam6 *eam;
+
+	/* ::1 */
+	if (!addr6[0] && !addr6[1] && !addr6[2] && addr6[3] == bpf_htonl(1))
+		return -1;
+
+	key.prefixlen = 128;
+	__builtin_memcpy(key.addr, addr6, sizeof(key.addr));
+	eam = bpf_map_lookup_elem(&eamt6, &key);
+	if (eam) {
+		*addr4 = eam->prefix4
+				| (addr6[3] & bpf_htonl(suffix_mask(32, eam->len4)));
+		*rfc6052 = false;
+	} else {
+		if (!cfg->pool6_set
+				|| addr6[0] != cfg->pool6[0]
+				|| addr6[1] != cfg->pool6[1]
+				|| addr6[2] != cfg->pool6[2])
+			return -1;
+		*addr4 = addr6[3];
+		if (is_denylisted(*addr4))
+			return -1;
+		*rfc6052 = true;
+	}
+
+	return must_not_translate(*addr4) ? -1 : 0;
+}
+
+/*
+ * Mirrors the module's addrxlat_siit46() for outer packets that are not ICMP
+ * errors. Returns nonzero if the address cannot be translated here.
+ */
+static __always_inline int siit46_addr(struct xdp_config *cfg, __be32 addr4,
+		bool enable_eam, __be32 *addr6)
+{
+	struct xdp_lpm4 key;
+	struct xdp_eam4 *eam;
+
+	if (must_not_translate(addr4))
+		return -1;
+
+	if (enable_eam) {
+		key.prefixlen = 32;
+		key.addr = addr4;
+		eam = bpf_map_lookup_elem(&eamt4, &key);
+		if (eam) {
+			addr6[0] = eam->prefix6[0];
+			addr6[1] = eam->prefix6[1];
+			addr6[2] = eam->prefix6[2];
+			addr6[3] = eam->prefix6[3] | (addr4
+					& bpf_htonl(suffix_mask(128, eam->len6)));
+			return 0;
+		}
+	}
+
+	if (is_denylisted(addr4) || !cfg->pool6_set)
+		return -1;
+
+	addr6[0] = cfg->pool6[0];
+	addr6[1] = cfg->pool6[1];
+	addr6[2] = cfg->pool6[2];
+	addr6[3] = addr4;
+	return 0;
+}
+
+static __always_inline int xlat64(struct xdp_md *ctx, struct xdp_config *cfg)
+{
+	void *data = (void *)(long)ctx->data;
+	void *end = (void *)(long)ctx->data_end;
+	struct ethhdr *eth = data;
+	struct ipv6hdr *hdr6;
+	struct iphdr hdr4;
+	struct iphdr *out4;
+	struct xdp_key6 key;
+	struct xdp_session6 *session;
+	struct bpf_fib_lookup fib;
+	__sum16 *check;
+	union ports ports;
+	union ports ports4;
+	__be32 old[9];
+	__be32 new[3];
+	__u16 payload_len;
+	__u8 tc;
+	bool src_rfc6052;
+	bool dst_rfc6052;
+	int error;
+
+	hdr6 = (void *)(eth + 1);
+	if ((void *)(hdr6 + 1) > end)
+		return punt();
+	if (hdr6->version != 6 || hdr6->hop_limit <= 1)
+		return punt();
+	if (hdr6->nexthdr != IPPROTO_TCP && hdr6->nexthdr != IPPROTO_UDP)
+		return punt(); /* Extension headers, ICMP or unknown */
+
+	payload_len = bpf_ntohs(hdr6->payload_len);
+	if (sizeof(*eth) + sizeof(*hdr6) + payload_len
+			> ctx->data_end - ctx->data)
+		return punt(); /* Truncated, or a jumbogram */
+
+	check = get_l4_csum(hdr6 + 1, end, hdr6->nexthdr);
+	if (!check)
+		return punt();
+	if (hdr6->nexthdr == IPPROTO_UDP && *check == 0)
+		return punt(); /* Illegal; let the module drop it */
+	__builtin_memcpy(&ports, hdr6 + 1, sizeof(ports));
+
+	__builtin_memcpy(&old[0], &hdr6->saddr, 16);
+	__builtin_memcpy(&old[4], &hdr6->daddr, 16);
+	old[8] = ports.word;
+
+	switch (cfg->xt) {
+	case XDP_XT_NAT64:
+		__builtin_memset(&key, 0, sizeof(key));
+		__builtin_memcpy(key.src, &old[0], sizeof(key.src));
+		__builtin_memcpy(key.dst, &old[4], sizeof(key.dst));
+		key.sport = ports.src;
+		key.dport = ports.dst;
+		key.proto = hdr6->nexthdr;
+		session = bpf_map_lookup_elem(&sessions6, &key);
+		if (!session)
+			return punt();
+		new[0] = session->src;
+		new[1] = session->dst;
+		ports4.src = session->sport;
+		ports4.dst = session->dport;
+		break;
+
+	case XDP_XT_SIIT:
+		session = NULL;
+		/* Dst first, as the module does. */
+		error = siit64_addr(cfg, &old[4], &new[1], &dst_rfc6052);
+		if (error)
+			return punt();
+		/* Intrinsic hairpinning */
+		if (dst_rfc6052 && eamt4_contains(new[1]))
+			return punt();
+		error = siit64_addr(cfg, &old[0], &new[0], &src_rfc6052);
+		if (error)
+			return punt();
+		ports4 = ports;
+		break;
+
+	default:
+		return punt();
+	}
+	new[2] = ports4.word;
+
+	tc = (hdr6->priority << 4) | (hdr6->flow_lbl[0] >> 4);
+	__builtin_memset(&hdr4, 0, sizeof(hdr4));
+	hdr4.version = 4;
+	hdr4.ihl = 5;
+	hdr4.tos = cfg->reset_tos ? cfg->new_tos : tc;
+	hdr4.tot_len = bpf_htons(sizeof(hdr4) + payload_len);
+	hdr4.id = (__be16)bpf_get_prandom_u32();
+	hdr4.frag_off = (sizeof(hdr4) + payload_len > 1260)
+			? bpf_htons(IP_DF) : 0;
+	hdr4.ttl = hdr6->hop_limit - 1;
+	hdr4.protocol = hdr6->nexthdr;
+	hdr4.saddr = new[0];
+	hdr4.daddr = new[1];
+	hdr4.check = csum_fold(bpf_csum_diff(NULL, 0, (__be32 *)&hdr4,
+			sizeof(hdr4), 0));
+
+	__builtin_memset(&fib, 0, sizeof(fib));
+	fib.family = AF_INET;
+	fib.tos = hdr4.tos;
+	fib.l4_protocol = hdr4.protocol;
+	fib.sport = ports4.src;
+	fib.dport = ports4.dst;
+	fib.tot_len = sizeof(hdr4) + payload_len;
+	fib.ipv4_src = hdr4.saddr;
+	fib.ipv4_dst = hdr4.daddr;
+	fib.ifindex = ctx->ingress_ifindex;
+	if (bpf_fib_lookup(ctx, &fib, sizeof(fib), 0) != BPF_FIB_LKUP_RET_SUCCESS) {
+		/* Local, unreachable, needs fragmentation, no neighbor, etc. */
+		count(XDP_STAT_NO_ROUTE);
+		return punt();
+	}
+
+	/* Point of no return. */
+
+	*check = update_l4_csum(*check, hdr4.protocol, old, sizeof(old),
+			new, sizeof(new));
+	__builtin_memcpy(hdr6 + 1, &ports4, sizeof(ports4));
+	if (session)
+		session->last_seen = bpf_ktime_get_ns();
+
+	if (bpf_xdp_adjust_head(ctx, HDR_DIFF))
+		return XDP_DROP; /* The L4 header was already translated */
+
+	data = (void *)(long)ctx->data;
+	end = (void *)(long)ctx->data_end;
+	eth = data;
+	out4 = (void *)(eth + 1);
+	if ((void *)(out4 + 1) > end)
+		return XDP_DROP;
+
+	__builtin_memcpy(eth->h_dest, fib.dmac, ETH_ALEN);
+	__builtin_memcpy(eth->h_source, fib.smac, ETH_ALEN);
+	eth->h_proto = bpf_htons(ETH_P_IP);
+	__builtin_memcpy(out4, &hdr4, sizeof(hdr4));
+
+	count(XDP_STAT_XLAT64);
+	return bpf_redirect(fib.ifindex, 0);
+}
+
+static __always_inline int xlat46(struct xdp_md *ctx, struct xdp_config *cfg)
+{
+	void *data = (void *)(long)ctx->data;
+	void *end = (void *)(long)ctx->data_end;
+	struct ethhdr *eth = data;
+	struct iphdr *hdr4;
+	struct ipv6hdr hdr6;
+	struct ipv6hdr *out6;
+	struct xdp_key4 key;
+	struct xdp_session4 *session;
+	struct bpf_fib_lookup fib;
+	__sum16 *check;
+	union ports ports;
+	union ports ports6;
+	__be32 old[3];
+	__be32 new[9];
+	__u16 tot_len;
+	__u16 payload_len;
+	__u8 tc;
+	int error;
+
+	hdr4 = (void *)(eth + 1);
+	if ((void *)(hdr4 + 1) > end)
+		return punt();
+	if (hdr4->version != 4 || hdr4->ihl != 5)
+		return punt(); /* Options */
+	if (csum_fold(bpf_csum_diff(NULL, 0, (__be32 *)hdr4, sizeof(*hdr4), 0)))
+		return punt(); /* Bad header checksum; ip_rcv() will drop it */
+	if (hdr4->frag_off & bpf_htons(IP_MF | IP_OFFSET))
+		return punt();
+	if (hdr4->ttl <= 1)
+		return punt();
+	if (hdr4->protocol != IPPROTO_TCP && hdr4->protocol != IPPROTO_UDP)
+		return punt();
+
+	tot_len = bpf_ntohs(hdr4->tot_len);
+	if (tot_len < sizeof(*hdr4)
+			|| sizeof(*eth) + tot_len > ctx->data_end - ctx->data)
+		return punt();
+	payload_len = tot_len - sizeof(*hdr4);
+	if (!(hdr4->frag_off & bpf_htons(IP_DF))
+			&& sizeof(hdr6) + payload_len > cfg->lowest_ipv6_mtu)
+		return punt(); /* Needs to be fragmented */
+
+	check = get_l4_csum(hdr4 + 1, end, hdr4->protocol);
+	if (!check)
+		return punt();
+	if (hdr4->protocol == IPPROTO_UDP && *check == 0)
+		return punt(); /* The module decides what to do with these */
+	__builtin_memcpy(&ports, hdr4 + 1, sizeof(ports));
+
+	old[0] = hdr4->saddr;
+	old[1] = hdr4->daddr;
+	old[2] = ports.word;
+
+	switch (cfg->xt) {
+	case XDP_XT_NAT64:
+		__builtin_memset(&key, 0, sizeof(key));
+		key.src = hdr4->saddr;
+		key.dst = hdr4->daddr;
+		key.sport = ports.src;
+		key.dport = ports.dst;
+		key.proto = hdr4->protocol;
+		session = bpf_map_lookup_elem(&sessions4, &key);
+		if (!session)
+			return punt();
+		__builtin_memcpy(&new[0], session->src, 16);
+		__builtin_memcpy(&new[4], session->dst, 16);
+		ports6.src = session->sport;
+		ports6.dst = session->dport;
+		break;
+
+	case XDP_XT_SIIT:
+		session = NULL;
+		error = siit46_addr(cfg, hdr4->daddr, true, &new[4]);
+		if (error)
+			return punt();
+		error = siit46_addr(cfg, hdr4->saddr, cfg->eam46_src, &new[0]);
+		if (error)
+			return punt();
+		ports6 = ports;
+		break;
+
+	default:
+		return punt();
+	}
+	new[8] = ports6.word;
+
+	tc = cfg->reset_traffic_class ? 0 : hdr4->tos;
+	__builtin_memset(&hdr6, 0, sizeof(hdr6));
+	hdr6.version = 6;
+	hdr6.priority = tc >> 4;
+	hdr6.flow_lbl[0] = tc << 4;
+	hdr6.payload_len = bpf_htons(payload_len);
+	hdr6.nexthdr = hdr4->protocol;
+	hdr6.hop_limit = hdr4->ttl - 1;
+	__builtin_memcpy(&hdr6.saddr, &new[0], 16);
+	__builtin_memcpy(&hdr6.daddr, &new[4], 16);
+
+	__builtin_memset(&fib, 0, sizeof(fib));
+	fib.family = AF_INET6;
+	fib.flowinfo = bpf_htonl((__u32)tc << 20);
+	fib.l4_protocol = hdr6.nexthdr;
+	fib.sport = ports6.src;
+	fib.dport = ports6.dst;
+	fib.tot_len = sizeof(hdr6) + payload_len;
+	__builtin_memcpy(fib.ipv6_src, &new[0], 16);
+	__builtin_memcpy(fib.ipv6_dst, &new[4], 16);
+	fib.ifindex = ctx->ingress_ifindex;
+	if (bpf_fib_lookup(ctx, &fib, sizeof(fib), 0) != BPF_FIB_LKUP_RET_SUCCESS) {
+		count(XDP_STAT_NO_ROUTE);
+		return punt();
+	}
+
+	/* Point of no return. */
+
+	*check = update_l4_csum(*check, hdr6.nexthdr, old, sizeof(old),
+			new, sizeof(new));
+	__builtin_memcpy(hdr4 + 1, &ports6, sizeof(ports6));
+	if (session)
+		session->last_seen = bpf_ktime_get_ns();
+
+	if (bpf_xdp_adjust_head(ctx, -HDR_DIFF))
+		return XDP_DROP;
+
+	data = (void *)(long)ctx->data;
+	end = (void *)(long)ctx->data_end;
+	eth = data;
+	out6 = (void *)(eth + 1);
+	if ((void *)(out6 + 1) > end)
+		return XDP_DROP;
+
+	__builtin_memcpy(eth->h_dest, fib.dmac, ETH_ALEN);
+	__builtin_memcpy(eth->h_source, fib.smac, ETH_ALEN);
+	eth->h_proto = bpf_htons(ETH_P_IPV6);
+	__builtin_memcpy(out6, &hdr6, sizeof(hdr6));
+
+	count(XDP_STAT_XLAT46);
+	return bpf_redirect(fib.ifindex, 0);
+}
+
+SEC("xdp")
+int jool_xdp(struct xdp_md *ctx)
+{
+	void *data = (void *)(long)ctx->data;
+	void *end = (void *)(long)ctx->data_end;
+	struct ethhdr *eth = data;
+	struct xdp_config *cfg;
+	__u32 zero = 0;
+
+	if ((void *)(eth + 1) > end)
+		return XDP_PASS;
+
+	cfg = bpf_map_lookup_elem(&config, &zero);
+	if (!cfg || cfg->xt == XDP_XT_NONE)
+		return XDP_PASS;
+
+	switch (eth->h_proto) {
+	case bpf_htons(ETH_P_IPV6):
+		return xlat64(ctx, cfg);
+	case bpf_htons(ETH_P_IP):
+		return xlat46(ctx, cfg);
+	}
+
+	return XDP_PASS; /* ARP, VLANs, etc. */
+}
+
+char LICENSE[] SEC("license") = "GPL";
@@ -0,0 +1,131 @@
+#ifndef SRC_USR_XDP_MAPS_H_
+#define SRC_USR_XDP_MAPS_H_
+
+/**
+ * @file
+ * The BPF maps shared by jool_xdp.o and jool-xdp.
+ *
+ * Addresses and ports are stored in network byte order, exactly as they appear
+ * in the packets. (IPv6 addresses are arrays of big endian words so this can
+ * be included from both the BPF program and userspace without dragging in
+ * their incompatible in6_addr definitions.)
+ */
+
+#include <linux/types.h>
+
+/* Values for xdp_config.xt. */
+#define XDP_XT_NONE 0
+#define XDP_XT_SIIT 1
+#define XDP_XT_NAT64 2
+
+/**
+ * The instance's globals that matter to the fast path.
+ * (The "config" map is an array of one of these.)
+ */
+struct xdp_config {
+	/* XDP_XT_NONE means "punt everything." */
+	__u8 xt;
+	__u8 reset_traffic_class;
+	__u8 reset_tos;
+	__u8 new_tos;
+	__u32 lowest_ipv6_mtu;
+
+	/* SIIT only */
+	/* Only /96 prefixes are offloaded. */
+	__u8 pool6_set;
+	/* Translate IPv4 sources with the EAMT? (False in simple hairpin mode.) */
+	__u8 eam46_src;
+	__u8 pad[2];
+	__be32 pool6[3];
+};
+
+/** A NAT64 session, as seen by an IPv6 packet. ("sessions6" key.) */
+struct xdp_key6 {
+	__be32 src[4];
+	__be32 dst[4];
+	__be16 sport;
+	__be16 dport;
+	__u8 proto;
+	__u8 pad[3];
+};
+
+/** A NAT64 session, as seen by an IPv4 packet. ("sessions4" key.) */
+struct xdp_key4 {
+	__be32 src;
+	__be32 dst;
+	__be16 sport;
+	__be16 dport;
+	__u8 proto;
+	__u8 pad[3];
+};
+
+/** What an IPv6 packet becomes. ("sessions6" value.) */
+struct xdp_session6 {
+	__be32 src;
+	__be32 dst;
+	__be16 sport;
+	__be16 dport;
+	/* jool-xdp's sync round. Stale entries are deleted. */
+	__u32 generation;
+	/* bpf_ktime_get_ns() of the last packet. Zero if none. */
+	__u64 last_seen;
+};
+
+/** What an IPv4 packet becomes. ("sessions4" value.) */
+struct xdp_session4 {
+	__be32 src[4];
+	__be32 dst[4];
+	__be16 sport;
+	__be16 dport;
+	__u32 generation;
+	__u64 last_seen;
+};
+
+/* SIIT */
+
+/** "eamt6" key. (The map is an LPM trie.) */
+struct xdp_lpm6 {
+	__u32 prefixlen;
+	__be32 addr[4];
+};
+
+/** "eamt4" and "denylist4" key. (Both maps are LPM tries.) */
+struct xdp_lpm4 {
+	__u32 prefixlen;
+	__be32 addr;
+};
+
+/** "eamt6" value. */
+struct xdp_eam6 {
+	__be32 prefix4;
+	__u8 len4;
+	__u8 pad[3];
+	/* jool-xdp's sync round. Stale entries are deleted. */
+	__u32 generation;
+};
+
+/** "eamt4" value. */
+struct xdp_eam4 {
+	__be32 prefix6[4];
+	__u8 len6;
+	__u8 pad[3];
+	__u32 generation;
+};
+
+/*
+ * The "denylist4" and "local4" values are also generations. ("local4" is a
+ * hash table of the node's own IPv4 addresses.)
+ */
+
+/* "stats" map indexes. */
+enum xdp_stat {
+	XDP_STAT_XLAT64,
+	XDP_STAT_XLAT46,
+	/* Packets handed over to the kernel module. */
+	XDP_STAT_PUNT,
+	/* Translatable packets the kernel could not route from XDP. */
+	XDP_STAT_NO_ROUTE,
+	XDP_STAT_COUNT,
+};
+
+#endif /* SRC_USR_XDP_MAPS_H_ */
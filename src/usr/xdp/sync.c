@@ -0,0 +1,564 @@
+#include "usr/xdp/sync.h"
+
+#include <errno.h>
+#include <ifaddrs.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <bpf/bpf.h>
+
+#include "common/session.h"
+#include "usr/nl/denylist4.h"
+#include "usr/nl/eamt.h"
+#include "usr/nl/global.h"
+#include "usr/nl/session.h"
+#include "usr/xdp/maps.h"
+
+/* The kernel's SESSION_TIMER_EST. (Touched sessions are always established.) */
+#define TIMER_EST 0
+
+static int pr_result(struct jool_result *result)
+{
+	int error = result->error;
+
+	if (error)
+		fprintf(stderr, "%s\n", result->msg);
+
+	result_cleanup(result);
+	return error;
+}
+
+static __u64 now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now); /* Same as bpf_ktime_get_ns() */
+	return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/* A growable array of map keys. */
+struct key_list {
+	void *keys;
+	size_t key_size;
+	unsigned int count;
+	unsigned int capacity;
+};
+
+static int key_list_add(struct key_list *list, void const *key)
+{
+	void *tmp;
+
+	if (list->count == list->capacity) {
+		list->capacity = list->capacity ? (2 * list->capacity) : 64;
+		tmp = realloc(list->keys, list->capacity * list->key_size);
+		if (!tmp)
+			return -ENOMEM;
+		list->keys = tmp;
+	}
+
+	memcpy((char *)list->keys + list->count * list->key_size, key,
+			list->key_size);
+	list->count++;
+	return 0;
+}
+
+static void *key_list_get(struct key_list *list, unsigned int index)
+{
+	return (char *)list->keys + index * list->key_size;
+}
+
+/*
+ * Deletes @fd's entries whose generation (found @gen_offset bytes into the
+ * value) is not @generation.
+ */
+static int sweep(int fd, size_t key_size, size_t value_size, size_t gen_offset,
+		__u32 generation)
+{
+	struct key_list stale = { .key_size = key_size };
+	char key[key_size];
+	char next[key_size];
+	char value[value_size];
+	__u32 entry_gen;
+	void *prev;
+	unsigned int i;
+	int error = 0;
+
+	for (prev = NULL; !bpf_map_get_next_key(fd, prev, next); prev = key) {
+		memcpy(key, next, key_size);
+		if (bpf_map_lookup_elem(fd, key, value))
+			continue; /* Deleted by someone else */
+		memcpy(&entry_gen, value + gen_offset, sizeof(entry_gen));
+		if (entry_gen != generation) {
+			error = key_list_add(&stale, key);
+			if (error)
+				goto end;
+		}
+	}
+
+	for (i = 0; i < stale.count; i++)
+		bpf_map_delete_elem(fd, key_list_get(&stale, i));
+
+end:
+	free(stale.keys);
+	return error;
+}
+
+/* ----- NAT64 ----- */
+
+static __u8 l4proto_to_ipproto(__u8 proto)
+{
+	return (proto == L4PROTO_TCP) ? IPPROTO_TCP : IPPROTO_UDP;
+}
+
+static __u8 ipproto_to_l4proto(__u8 proto)
+{
+	return (proto == IPPROTO_TCP) ? L4PROTO_TCP : L4PROTO_UDP;
+}
+
+static void session_to_keys(struct session_entry_usr const *session,
+		struct xdp_key6 *key6, struct xdp_key4 *key4)
+{
+	memset(key6, 0, sizeof(*key6));
+	memcpy(key6->src, &session->src6.l3, sizeof(key6->src));
+	memcpy(key6->dst, &session->dst6.l3, sizeof(key6->dst));
+	key6->sport = htons(session->src6.l4);
+	key6->dport = htons(session->dst6.l4);
+	key6->proto = l4proto_to_ipproto(session->proto);
+
+	memset(key4, 0, sizeof(*key4));
+	key4->src = session->dst4.l3.s_addr;
+	key4->dst = session->src4.l3.s_addr;
+	key4->sport = htons(session->dst4.l4);
+	key4->dport = htons(session->src4.l4);
+	key4->proto = key6->proto;
+}
+
+struct touch_args {
+	struct xdp_sync *sync;
+	struct session_touch_usr *touches;
+	unsigned int count;
+	unsigned int capacity;
+};
+
+static int add_touch(struct touch_args *args, struct xdp_key6 const *key6,
+		struct xdp_session6 const *value6, __u64 idle_ns)
+{
+	struct session_touch_usr *touch;
+	struct session_touch_usr *tmp;
+	__u64 idle;
+
+	if (args->count == args->capacity) {
+		args->capacity = args->capacity ? (2 * args->capacity) : 64;
+		tmp = realloc(args->touches,
+				args->capacity * sizeof(*args->touches));
+		if (!tmp)
+			return -ENOMEM;
+		args->touches = tmp;
+	}
+
+	touch = &args->touches[args->count];
+	memset(touch, 0, sizeof(*touch));
+	memcpy(&touch->session.src6.l3, key6->src, sizeof(key6->src));
+	touch->session.src6.l4 = ntohs(key6->sport);
+	memcpy(&touch->session.dst6.l3, key6->dst, sizeof(key6->dst));
+	touch->session.dst6.l4 = ntohs(key6->dport);
+	touch->session.src4.l3.s_addr = value6->src;
+	touch->session.src4.l4 = ntohs(value6->sport);
+	touch->session.dst4.l3.s_addr = value6->dst;
+	touch->session.dst4.l4 = ntohs(value6->dport);
+	touch->session.proto = ipproto_to_l4proto(key6->proto);
+	touch->session.state = ESTABLISHED;
+	touch->session.timer = TIMER_EST;
+	idle = idle_ns / 1000000;
+	touch->idle = (idle > UINT32_MAX) ? UINT32_MAX : idle;
+
+	args->count++;
+	return 0;
+}
+
+/* The session is gone (or no longer established); stop translating it. */
+static void touch_failed(unsigned int index, int error, void *arg)
+{
+	struct touch_args *args = arg;
+	struct xdp_key6 key6;
+	struct xdp_key4 key4;
+
+	session_to_keys(&args->touches[index].session, &key6, &key4);
+	bpf_map_delete_elem(args->sync->sessions6_fd, &key6);
+	bpf_map_delete_elem(args->sync->sessions4_fd, &key4);
+}
+
+/*
+ * The module files each touched session in its expiration list by walking the
+ * list from the newest end. If the touches are grouped by protocol (each one
+ * has its own table) and sent oldest first, every walk stops right away.
+ */
+static int compare_touches(void const *arg1, void const *arg2)
+{
+	struct session_touch_usr const *t1 = arg1;
+	struct session_touch_usr const *t2 = arg2;
+
+	if (t1->session.proto != t2->session.proto)
+		return (int)t1->session.proto - (int)t2->session.proto;
+	if (t1->idle != t2->idle)
+		return (t1->idle > t2->idle) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Tells the kernel about the sessions the fast path has been translating since
+ * the previous round, so it doesn't expire them.
+ */
+static int touch_sessions(struct xdp_sync *sync, __u64 now)
+{
+	struct touch_args args = { .sync = sync };
+	struct xdp_key6 key6;
+	struct xdp_key6 next;
+	struct xdp_key4 key4;
+	struct xdp_session6 value6;
+	struct xdp_session4 value4;
+	struct jool_result result;
+	__u64 last_seen;
+	void *prev;
+	int error = 0;
+
+	for (prev = NULL;
+			!bpf_map_get_next_key(sync->sessions6_fd, prev, &next);
+			prev = &key6) {
+		key6 = next;
+		if (bpf_map_lookup_elem(sync->sessions6_fd, &key6, &value6))
+			continue;
+
+		memset(&key4, 0, sizeof(key4));
+		key4.src = value6.dst;
+		key4.dst = value6.src;
+		key4.sport = value6.dport;
+		key4.dport = value6.sport;
+		key4.proto = key6.proto;
+		last_seen = value6.last_seen;
+		if (!bpf_map_lookup_elem(sync->sessions4_fd, &key4, &value4)
+				&& value4.last_seen > last_seen)
+			last_seen = value4.last_seen;
+
+		if (last_seen < sync->last_round || last_seen > now)
+			continue; /* Idle, or in the current round */
+
+		error = add_touch(&args, &key6, &value6, now - last_seen);
+		if (error)
+			goto end;
+	}
+
+	if (args.count) {
+		qsort(args.touches, args.count, sizeof(*args.touches),
+				compare_touches);
+		result = joolnl_session_touch_bulk(&sync->sk, sync->iname,
+				args.touches, args.count, touch_failed, &args);
+		error = pr_result(&result);
+	}
+
+end:
+	free(args.touches);
+	return error;
+}
+
+static struct jool_result add_session(struct session_entry_usr const *entry,
+		void *arg)
+{
+	struct xdp_sync *sync = arg;
+	struct xdp_key6 key6;
+	struct xdp_key4 key4;
+	struct xdp_session6 value6;
+	struct xdp_session4 value4;
+
+	if (entry->state != ESTABLISHED)
+		return result_success();
+
+	session_to_keys(entry, &key6, &key4);
+
+	/* Keep last_seen if the entry already exists. */
+	if (bpf_map_lookup_elem(sync->sessions6_fd, &key6, &value6))
+		memset(&value6, 0, sizeof(value6));
+	value6.src = entry->src4.l3.s_addr;
+	value6.dst = entry->dst4.l3.s_addr;
+	value6.sport = htons(entry->src4.l4);
+	value6.dport = htons(entry->dst4.l4);
+	value6.generation = sync->generation;
+
+	if (bpf_map_lookup_elem(sync->sessions4_fd, &key4, &value4))
+		memset(&value4, 0, sizeof(value4));
+	memcpy(value4.src, &entry->dst6.l3, sizeof(value4.src));
+	memcpy(value4.dst, &entry->src6.l3, sizeof(value4.dst));
+	value4.sport = htons(entry->dst6.l4);
+	value4.dport = htons(entry->src6.l4);
+	value4.generation = sync->generation;
+
+	/* If the maps are full, the session stays in the slow path. */
+	if (bpf_map_update_elem(sync->sessions6_fd, &key6, &value6, BPF_ANY))
+		return result_success();
+	if (bpf_map_update_elem(sync->sessions4_fd, &key4, &value4, BPF_ANY))
+		bpf_map_delete_elem(sync->sessions6_fd, &key6);
+
+	return result_success();
+}
+
+static int sync_sessions(struct xdp_sync *sync)
+{
+	struct table_filter filter;
+	struct jool_result result;
+	int error;
+
+	/* TCP sessions in any other state need the module's state machine. */
+	memset(&filter, 0, sizeof(filter));
+	filter.state_set = true;
+	filter.state = ESTABLISHED;
+	result = joolnl_session_foreach(&sync->sk, sync->iname, L4PROTO_TCP,
+			&filter, add_session, sync);
+	error = pr_result(&result);
+	if (error)
+		return error;
+
+	result = joolnl_session_foreach(&sync->sk, sync->iname, L4PROTO_UDP,
+			NULL, add_session, sync);
+	error = pr_result(&result);
+	if (error)
+		return error;
+
+	error = sweep(sync->sessions6_fd, sizeof(struct xdp_key6),
+			sizeof(struct xdp_session6),
+			offsetof(struct xdp_session6, generation),
+			sync->generation);
+	if (error)
+		return error;
+	return sweep(sync->sessions4_fd, sizeof(struct xdp_key4),
+			sizeof(struct xdp_session4),
+			offsetof(struct xdp_session4, generation),
+			sync->generation);
+}
+
+/* ----- SIIT ----- */
+
+static struct jool_result add_eam(struct eamt_entry const *entry, void *arg)
+{
+	struct xdp_sync *sync = arg;
+	struct xdp_lpm6 key6;
+	struct xdp_lpm4 key4;
+	struct xdp_eam6 value6;
+	struct xdp_eam4 value4;
+
+	memset(&key6, 0, sizeof(key6));
+	key6.prefixlen = entry->prefix6.len;
+	memcpy(key6.addr, &entry->prefix6.addr, sizeof(key6.addr));
+	memset(&value6, 0, sizeof(value6));
+	value6.prefix4 = entry->prefix4.addr.s_addr;
+	value6.len4 = entry->prefix4.len;
+	value6.generation = sync->generation;
+
+	memset(&key4, 0, sizeof(key4));
+	key4.prefixlen = entry->prefix4.len;
+	key4.addr = entry->prefix4.addr.s_addr;
+	memset(&value4, 0, sizeof(value4));
+	memcpy(value4.prefix6, &entry->prefix6.addr, sizeof(value4.prefix6));
+	value4.len6 = entry->prefix6.len;
+	value4.generation = sync->generation;
+
+	if (bpf_map_update_elem(sync->eamt6_fd, &key6, &value6, BPF_ANY)
+			|| bpf_map_update_elem(sync->eamt4_fd, &key4, &value4, BPF_ANY)) {
+		return result_from_error(-errno,
+				"Cannot copy an EAM into the fast path: %s",
+				strerror(errno));
+	}
+
+	return result_success();
+}
+
+static struct jool_result add_denylist4(struct ipv4_prefix const *entry,
+		void *arg)
+{
+	struct xdp_sync *sync = arg;
+	struct xdp_lpm4 key;
+
+	memset(&key, 0, sizeof(key));
+	key.prefixlen = entry->len;
+	key.addr = entry->addr.s_addr;
+
+	if (bpf_map_update_elem(sync->denylist4_fd, &key, &sync->generation,
+			BPF_ANY)) {
+		return result_from_error(-errno,
+				"Cannot copy a denylist4 prefix into the fast path: %s",
+				strerror(errno));
+	}
+
+	return result_success();
+}
+
+/* The module refuses to translate the node's own addresses. */
+static int sync_local4(struct xdp_sync *sync)
+{
+	struct ifaddrs *addrs;
+	struct ifaddrs *cursor;
+	struct sockaddr_in *sin;
+
+	if (getifaddrs(&addrs)) {
+		fprintf(stderr, "Cannot list the local addresses: %s\n",
+				strerror(errno));
+		return -errno;
+	}
+
+	for (cursor = addrs; cursor; cursor = cursor->ifa_next) {
+		if (!cursor->ifa_addr || cursor->ifa_addr->sa_family != AF_INET)
+			continue;
+		sin = (struct sockaddr_in *)cursor->ifa_addr;
+		bpf_map_update_elem(sync->local4_fd, &sin->sin_addr.s_addr,
+				&sync->generation, BPF_ANY);
+	}
+
+	freeifaddrs(addrs);
+	return sweep(sync->local4_fd, sizeof(__be32), sizeof(__u32), 0,
+			sync->generation);
+}
+
+static int sync_siit_tables(struct xdp_sync *sync)
+{
+	struct jool_result result;
+	int error;
+
+	result = joolnl_eamt_foreach(&sync->sk, sync->iname, add_eam, sync);
+	error = pr_result(&result);
+	if (error)
+		return error;
+	result = joolnl_denylist4_foreach(&sync->sk, sync->iname,
+			add_denylist4, sync);
+	error = pr_result(&result);
+	if (error)
+		return error;
+	error = sync_local4(sync);
+	if (error)
+		return error;
+
+	error = sweep(sync->eamt6_fd, sizeof(struct xdp_lpm6),
+			sizeof(struct xdp_eam6),
+			offsetof(struct xdp_eam6, generation),
+			sync->generation);
+	if (error)
+		return error;
+	error = sweep(sync->eamt4_fd, sizeof(struct xdp_lpm4),
+			sizeof(struct xdp_eam4),
+			offsetof(struct xdp_eam4, generation),
+			sync->generation);
+	if (error)
+		return error;
+	return sweep(sync->denylist4_fd, sizeof(struct xdp_lpm4),
+			sizeof(__u32), 0, sync->generation);
+}
+
+/* ----- Globals ----- */
+
+struct globals_args {
+	bool enabled;
+	struct xdp_config config;
+};
+
+static struct jool_result collect_global(struct joolnl_global_meta const *meta,
+		void *value, void *arg)
+{
+	struct globals_args *args = arg;
+	struct config_prefix6 *pool6;
+
+	switch (joolnl_global_meta_id(meta)) {
+	case JNLAG_ENABLED:
+		args->enabled = *(bool *)value;
+		break;
+	case JNLAG_POOL6:
+		pool6 = value;
+		args->config.pool6_set = pool6->set && pool6->prefix.len == 96;
+		memcpy(args->config.pool6, &pool6->prefix.addr,
+				sizeof(args->config.pool6));
+		break;
+	case JNLAG_LOWEST_IPV6_MTU:
+		args->config.lowest_ipv6_mtu = *(__u32 *)value;
+		break;
+	case JNLAG_RESET_TC:
+		args->config.reset_traffic_class = *(bool *)value;
+		break;
+	case JNLAG_RESET_TOS:
+		args->config.reset_tos = *(bool *)value;
+		break;
+	case JNLAG_TOS:
+		args->config.new_tos = *(__u8 *)value;
+		break;
+	case JNLAG_HAIRPIN_MODE:
+		/* See translate_addrs46_siit(). */
+		args->config.eam46_src = *(__u8 *)value != EHM_SIMPLE;
+		break;
+	default:
+		break;
+	}
+
+	return result_success();
+}
+
+static int sync_config(struct xdp_sync *sync)
+{
+	struct globals_args args;
+	struct jool_result result;
+	__u32 zero = 0;
+	int error;
+
+	memset(&args, 0, sizeof(args));
+	args.config.eam46_src = true;
+
+	result = joolnl_global_foreach(&sync->sk, sync->iname, collect_global,
+			&args);
+	error = pr_result(&result);
+	if (error)
+		return error;
+
+	if (args.enabled)
+		args.config.xt = (sync->xt & XT_SIIT) ? XDP_XT_SIIT : XDP_XT_NAT64;
+	else
+		args.config.xt = XDP_XT_NONE;
+
+	if (bpf_map_update_elem(sync->config_fd, &zero, &args.config, BPF_ANY)) {
+		fprintf(stderr, "Cannot update the fast path's configuration: %s\n",
+				strerror(errno));
+		return -errno;
+	}
+
+	return 0;
+}
+
+int xdp_sync_round(struct xdp_sync *sync)
+{
+	__u64 now;
+	int error;
+
+	now = now_ns();
+	sync->generation++;
+
+	if (sync->xt & XT_NAT64) {
+		error = touch_sessions(sync, now);
+		if (error)
+			return error;
+		error = sync_sessions(sync);
+	} else {
+		error = sync_siit_tables(sync);
+	}
+	if (error)
+		return error;
+
+	sync->last_round = now;
+	return sync_config(sync);
+}
+
+void xdp_sync_disable(struct xdp_sync *sync)
+{
+	struct xdp_config config;
+	__u32 zero = 0;
+
+	memset(&config, 0, sizeof(config));
+	config.xt = XDP_XT_NONE;
+	bpf_map_update_elem(sync->config_fd, &zero, &config, BPF_ANY);
+}
@@ -0,0 +1,43 @@
+#ifndef SRC_USR_XDP_SYNC_H_
+#define SRC_USR_XDP_SYNC_H_
+
+/**
+ * @file
+ * Keeps the fast path's maps in sync with a Jool instance.
+ *
+ * Every round, jool-xdp
+ *
+ * 1. refreshes (in the kernel) the NAT64 sessions the fast path translated
+ *    since the previous round,
+ * 2. copies the instance's established TCP and UDP sessions (NAT64) or its
+ *    EAMT, denylist4 and local addresses (SIIT) into the maps,
+ * 3. deletes the map entries the instance no longer has, and
+ * 4. updates the fast path's copy of the relevant globals.
+ */
+
+#include "usr/nl/core.h"
+
+struct xdp_sync {
+	struct joolnl_socket sk;
+	char const *iname;
+	xlator_type xt;
+
+	int config_fd;
+	int sessions6_fd;
+	int sessions4_fd;
+	int eamt6_fd;
+	int eamt4_fd;
+	int denylist4_fd;
+	int local4_fd;
+
+	/* Map entries that were not refreshed during the last round are stale. */
+	__u32 generation;
+	/* CLOCK_MONOTONIC nanoseconds at the start of the previous round. */
+	__u64 last_round;
+};
+
+int xdp_sync_round(struct xdp_sync *sync);
+/* Stops the fast path. (It punts everything afterwards.) */
+void xdp_sync_disable(struct xdp_sync *sync);
+
+#endif /* SRC_USR_XDP_SYNC_H_ */
@@ -0,0 +1,36 @@
+#!/bin/sh
+
+# Measures the throughput of the 4->6 slow path (ie. Jool fragmenting IPv4
+# packets that don't fit in the IPv6 MTU): n4 sends 1500-byte, DF=0 UDP
+# packets through a 1280 lowest-ipv6-mtu.
+#
+# Not a pass/fail test; it just prints iperf3's results. Needs iperf3 and the
+# network created by ./setup.sh. (It borrows the static 192.0.2.2#2000 BIB
+# entries.)
+#
+# Arguments:
+# $1: Seconds to run. (Default: 10)
+
+DURATION=${1:-10}
+
+iperf3 --version > /dev/null 2>&1 || {
+	echo "iperf3 not found."
+	exit 1
+}
+
+PMTU_DISC=`ip netns exec client4ns sysctl -n net.ipv4.ip_no_pmtu_disc`
+MTU=`ip netns exec joolns jool global display | grep "lowest-ipv6-mtu:" | awk '{ print $2 }'`
+
+# Clear DF, so Jool fragments instead of bouncing Fragmentation Neededs.
+ip netns exec client4ns sysctl -qw net.ipv4.ip_no_pmtu_disc=1
+ip netns exec joolns jool global update lowest-ipv6-mtu 1280
+
+ip netns exec client6ns iperf3 --server --daemon --one-off --port 2000
+sleep 1
+
+ip netns exec client4ns iperf3 --client 192.0.2.2 --port 2000 \
+		--udp --bitrate 0 --length 1472 --time $DURATION --format m \
+	| grep -E "sender|receiver"
+
+ip netns exec joolns jool global update lowest-ipv6-mtu $MTU
+ip netns exec client4ns sysctl -qw net.ipv4.ip_no_pmtu_disc=$PMTU_DISC
@@ -0,0 +1,74 @@
+#!/bin/sh
+
+# Pushes UDP traffic through the translator while it aggregates it into GRO
+# super-packets (UDP L4 GRO and fraglist GRO), in both directions, and checks
+# the receivers get (nearly) everything. A broken checksum or length in the
+# translated segments shows up as lost datagrams.
+#
+# Needs iperf3, a kernel that supports the offloads (5.12+) and the network
+# created by ./setup.sh. (The 4->6 runs borrow the static 192.0.2.2#2000 BIB
+# entries.)
+#
+# Arguments:
+# $1: Seconds per run. (Default: 5)
+
+DURATION=${1:-5}
+# Maximum tolerated loss, in percent.
+MAX_LOSS=5
+FAILS=0
+
+iperf3 --version > /dev/null 2>&1 || {
+	echo "iperf3 not found."
+	exit 1
+}
+
+offload() {
+	for DEV in to_client_v6 to_client_v4; do
+		ip netns exec joolns ethtool -K $DEV $@ 2> /dev/null
+	done
+}
+
+# $1: Test name
+# $2: Server namespace
+# $3: Client namespace
+# $4: Server port
+# $5: Server address, as seen by the client
+# $6: Datagram length
+run() {
+	ip netns exec $2 iperf3 --server --daemon --one-off --port $4
+	sleep 1
+
+	LOSS=`ip netns exec $3 iperf3 --client $5 --port $4 --udp \
+			--bitrate 200M --length $6 --time $DURATION \
+		| grep receiver \
+		| sed -e 's/.*(\([0-9.e+-]*\)%).*/\1/'`
+
+	if [ -n "$LOSS" ] && awk "BEGIN { exit !($LOSS <= $MAX_LOSS) }"; then
+		echo "$1: Success (loss: $LOSS%)"
+	else
+		echo "$1: Failure (loss: ${LOSS:-?}%)"
+		FAILS=$((FAILS+1))
+	fi
+}
+
+run_all() {
+	run "$1 6->4" client4ns client6ns 5201 64:ff9b::192.0.2.5 1200
+	run "$1 4->6" client6ns client4ns 2000 192.0.2.2 1200
+
+	# DF=0, and too big for the IPv6 side: Jool has to segment.
+	PMTU_DISC=`ip netns exec client4ns sysctl -n net.ipv4.ip_no_pmtu_disc`
+	ip netns exec client4ns sysctl -qw net.ipv4.ip_no_pmtu_disc=1
+	run "$1 4->6 fragmented" client6ns client4ns 2000 192.0.2.2 1472
+	ip netns exec client4ns sysctl -qw net.ipv4.ip_no_pmtu_disc=$PMTU_DISC
+}
+
+offload gro on rx-udp-gro-forwarding on rx-gro-list off
+run_all "UDP L4 GRO"
+offload rx-gro-list on
+run_all "Fraglist GRO"
+offload gro off rx-udp-gro-forwarding off rx-gro-list off
+
+ip netns exec joolns jool stats display | grep JSTAT46_GSO_SEGMENTED
+
+echo "Failures: $FAILS"
+[ $FAILS -eq 0 ]
@@ -0,0 +1,114 @@
+#!/bin/sh
+
+# Synchronizes two NAT64 instances through joold's kernel transport, then
+# removes the first one while it's still translating traffic.
+#
+#	ss-client6 --- ss-jool1 --- ss-server4
+#	                  |
+#	               ss-jool2
+#
+# ss-client6 pings ss-server4 through ss-jool1, and the resulting session has
+# to show up in ss-jool2. Removing an instance while packets are in flight
+# used to close the socket in atomic context; the kernel log is checked for
+# that too.
+#
+# Needs root, the module, jool and joold. Builds its own namespaces, so it
+# doesn't need ./setup.sh.
+
+FAILS=0
+DIR=`mktemp -d`
+NAMESPACES="ss-client6 ss-jool1 ss-jool2 ss-server4"
+
+# $1: Test name
+# $2: Command
+check() {
+	if eval "$2"; then
+		echo "$1: Success"
+	else
+		echo "$1: Failure"
+		FAILS=$((FAILS+1))
+	fi
+}
+
+# $1: Namespace
+# $2: Interface
+# $3: Peer namespace
+# $4: Peer interface
+link() {
+	ip link add name $2 type veth peer name $4
+	ip link set dev $2 netns $1
+	ip link set dev $4 netns $3
+	ip netns exec $1 ip link set up dev $2
+	ip netns exec $3 ip link set up dev $4
+}
+
+# $1: Namespace
+# $2: Synchronization interface
+setup_jool() {
+	ip netns exec $1 sysctl -qw net.ipv4.conf.all.forwarding=1
+	ip netns exec $1 sysctl -qw net.ipv6.conf.all.forwarding=1
+	ip netns exec $1 jool instance add --netfilter --pool6 64:ff9b::/96
+	ip netns exec $1 jool pool4 add --icmp 192.0.2.1 1-65535
+	ip netns exec $1 jool global update ss-enabled true
+	ip netns exec $1 jool global update ss-flush-asap true
+
+	cat > $DIR/$1.json <<-EOF
+		{
+			"multicast address": "ff08::db8:64:64",
+			"multicast port": "6464",
+			"in interface": "$2",
+			"out interface": "$2",
+			"kernel transport": true
+		}
+	EOF
+	echo '{ "instance": "default" }' > $DIR/modsocket.json
+	# Opens the socket and exits.
+	ip netns exec $1 joold $DIR/$1.json $DIR/modsocket.json
+}
+
+bugs() {
+	dmesg | grep -cE "sleeping function called from invalid context|scheduling while atomic"
+}
+
+for NS in $NAMESPACES; do
+	ip netns add $NS
+done
+
+link ss-client6 c6 ss-jool1 j1c6
+link ss-jool1 j1s4 ss-server4 s4
+link ss-jool1 sync1 ss-jool2 sync2
+
+ip netns exec ss-client6 ip addr add 2001:db8:1::2/64 dev c6 nodad
+ip netns exec ss-client6 ip route add 64:ff9b::/96 via 2001:db8:1::1
+ip netns exec ss-jool1 ip addr add 2001:db8:1::1/64 dev j1c6 nodad
+ip netns exec ss-jool1 ip addr add 192.0.2.1/24 dev j1s4
+ip netns exec ss-server4 ip addr add 192.0.2.2/24 dev s4
+ip netns exec ss-jool1 ip addr add 2001:db8:ff::1/64 dev sync1 nodad
+ip netns exec ss-jool2 ip addr add 2001:db8:ff::2/64 dev sync2 nodad
+
+setup_jool ss-jool1 sync1
+setup_jool ss-jool2 sync2
+BUGS=`bugs`
+
+check "Translation" \
+	"ip netns exec ss-client6 ping -c 3 -W 1 64:ff9b::192.0.2.2 > /dev/null"
+sleep 1
+check "Synchronization" \
+	"ip netns exec ss-jool2 jool session display --icmp --numeric | grep -q 2001:db8:1::2"
+
+# Keep the packets coming while the instance dies.
+ip netns exec ss-client6 ping -q -i 0.01 -w 3 64:ff9b::192.0.2.2 > /dev/null &
+PING=$!
+sleep 1
+check "Removal" "ip netns exec ss-jool1 jool instance remove"
+wait $PING
+check "Atomic context" "[ `bugs` -eq $BUGS ]"
+
+for NS in $NAMESPACES; do
+	ip netns exec $NS jool instance remove 2> /dev/null
+	ip netns del $NS
+done
+rm -r $DIR
+
+echo "Failures: $FAILS"
+[ $FAILS -eq 0 ]
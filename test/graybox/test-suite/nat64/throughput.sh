@@ -0,0 +1,37 @@
+#!/bin/sh
+
+# Compares the throughput of the copying and in-place (translate-in-place)
+# translation modes.
+#
+# Not a pass/fail test; it just prints iperf3's results and the corresponding
+# stat counters. (The counters are cumulative.) Needs iperf3 and the network
+# created by ./setup.sh.
+#
+# Arguments:
+# $1: Seconds per run. (Default: 10)
+
+DURATION=${1:-10}
+
+iperf3 --version > /dev/null 2>&1 || {
+	echo "iperf3 not found."
+	exit 1
+}
+
+run() {
+	ip netns exec joolns jool global update translate-in-place $1
+	ip netns exec client4ns iperf3 --server --daemon --one-off
+	sleep 1
+
+	echo "translate-in-place $1:"
+	ip netns exec client6ns iperf3 --client 64:ff9b::192.0.2.5 \
+			--time $DURATION --format m \
+		| grep -E "sender|receiver"
+	ip netns exec joolns jool stats display --all \
+		| grep -E "JSTAT_XLAT_(IN_PLACE|COPIED)"
+	echo ""
+}
+
+run false
+run true
+
+ip netns exec joolns jool global update translate-in-place false
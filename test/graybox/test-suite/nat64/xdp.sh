@@ -0,0 +1,121 @@
+#!/bin/sh
+
+# Offloads a UDP session to jool-xdp, and checks that the module keeps it alive
+# while the fast path translates its packets.
+#
+#	xdp-client6 --- xdp-jool --- xdp-server4
+#
+# xdp-client6 opens the session through the module, leaves it idle for a while,
+# and then keeps sending packets, which the fast path should translate. If
+# jool-xdp's touches reach the module, the session's expiration is pushed back
+# to (nearly) the full udp-timeout.
+#
+# Uses the veth workarounds from docs/en/xdp.md (GRO on the receivers, no
+# transmit checksum offload on the senders).
+#
+# Needs root, the module, jool, jool-xdp, ethtool and socat. Builds its own
+# namespaces, so it doesn't need ./setup.sh.
+
+FAILS=0
+DIR=`mktemp -d`
+NAMESPACES="xdp-client6 xdp-jool xdp-server4"
+# Seconds; udp-timeout, which can't go any lower.
+TIMEOUT=120
+IDLE=10
+
+# $1: Test name
+# $2: Command
+check() {
+	if eval "$2"; then
+		echo "$1: Success"
+	else
+		echo "$1: Failure"
+		FAILS=$((FAILS+1))
+	fi
+}
+
+# $1: Namespace
+# $2: Interface
+# $3: Peer namespace
+# $4: Peer interface
+link() {
+	ip link add name $2 type veth peer name $4
+	ip link set dev $2 netns $1
+	ip link set dev $4 netns $3
+	ip netns exec $1 ip link set up dev $2
+	ip netns exec $3 ip link set up dev $4
+}
+
+# $1: Namespace
+# $2: Interface
+veth_quirks() {
+	ip netns exec $1 ethtool -K $2 gro on > /dev/null
+	ip netns exec $1 ethtool -K $2 tx off > /dev/null
+}
+
+# Sends $1 UDP packets from 2001:db8:1::2#2000 to 192.0.2.2#4000.
+send() {
+	for i in `seq $1`; do
+		echo $i
+		sleep 0.1
+	done | ip netns exec xdp-client6 socat -u - \
+		"UDP6-SENDTO:[64:ff9b::192.0.2.2]:4000,sourceport=2000"
+}
+
+# Prints the seconds the session has left.
+expiration() {
+	ip netns exec xdp-jool jool session display --udp --numeric --csv \
+		--no-headers | grep "2001:db8:1::2,2000" \
+		| awk -F, '{ split($10, t, ":"); print t[1] * 3600 + t[2] * 60 + int(t[3]) }'
+}
+
+for NS in $NAMESPACES; do
+	ip netns add $NS
+done
+
+link xdp-client6 c6 xdp-jool jc6
+link xdp-jool js4 xdp-server4 s4
+veth_quirks xdp-client6 c6
+veth_quirks xdp-server4 s4
+
+ip netns exec xdp-client6 ip addr add 2001:db8:1::2/64 dev c6 nodad
+ip netns exec xdp-client6 ip route add 64:ff9b::/96 via 2001:db8:1::1
+ip netns exec xdp-jool ip addr add 2001:db8:1::1/64 dev jc6 nodad
+ip netns exec xdp-jool ip addr add 192.0.2.1/24 dev js4
+ip netns exec xdp-server4 ip addr add 192.0.2.2/24 dev s4
+
+ip netns exec xdp-jool sysctl -qw net.ipv4.conf.all.forwarding=1
+ip netns exec xdp-jool sysctl -qw net.ipv6.conf.all.forwarding=1
+ip netns exec xdp-jool jool instance add --netfilter --pool6 64:ff9b::/96
+ip netns exec xdp-jool jool pool4 add --udp 192.0.2.1 1024-65535
+ip netns exec xdp-jool jool global update udp-timeout 2:00
+
+ip netns exec xdp-jool jool-xdp --generic jc6 js4 > $DIR/jool-xdp.log &
+XDP=$!
+sleep 1
+
+# The first packet is translated by the module, which creates the session.
+send 1
+check "Session" "[ -n \"`expiration`\" ]"
+
+# Leave it idle, so a refresh can be told apart.
+sleep $IDLE
+check "Idle" "[ `expiration` -le $((TIMEOUT - IDLE + 1)) ]"
+
+# The session is in the maps by now; these should go through the fast path.
+send 30
+sleep 2
+check "Touch" "[ `expiration` -ge $((TIMEOUT - 5)) ]"
+
+kill $XDP
+wait $XDP
+check "Fast path" "grep -qE 'Translated 6->4: [1-9]' $DIR/jool-xdp.log"
+
+for NS in $NAMESPACES; do
+	ip netns exec $NS jool instance remove 2> /dev/null
+	ip netns del $NS
+done
+rm -r $DIR
+
+echo "Failures: $FAILS"
+[ $FAILS -eq 0 ]
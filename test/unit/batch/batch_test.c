@@ -0,0 +1,187 @@
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+#include "framework/unit_test.h"
+#include "framework/send_packet.h"
+#include "framework/skb_generator.h"
+#include "framework/types.h"
+
+#include "mod/common/core.h"
+#include "mod/common/xlator.h"
+
+MODULE_LICENSE(JOOL_LICENSE);
+MODULE_AUTHOR("Alberto Leiva");
+MODULE_DESCRIPTION("Batch translation test");
+
+#define BATCH_SIZE 64
+#define ROUNDS 256
+#define PAYLOAD_LEN 1000
+
+static struct xlator jool;
+
+static int init(void)
+{
+	struct ipv6_prefix pool6;
+	int error;
+
+	pool6.len = 96;
+	error = str_to_addr6("2001:db8::", &pool6.addr);
+	if (error)
+		return error;
+
+	return xlator_add(XF_NETFILTER | XT_SIIT, INAME_DEFAULT, &pool6, &jool);
+}
+
+static void clean(void)
+{
+	xlator_put(&jool);
+	xlator_rm(XT_SIIT, INAME_DEFAULT);
+}
+
+static struct sk_buff *create_tcp6_skb(void)
+{
+	struct sk_buff *skb;
+
+	if (create_skb6_tcp("2001:db8::192.0.2.1", 5000,
+			"2001:db8::203.0.113.2", 6000, PAYLOAD_LEN, 64, &skb))
+		return NULL;
+
+	return skb;
+}
+
+static int create_batch(struct sk_buff_head *batch)
+{
+	struct sk_buff *skb;
+	unsigned int i;
+
+	__skb_queue_head_init(batch);
+	for (i = 0; i < BATCH_SIZE; i++) {
+		skb = create_tcp6_skb();
+		if (!skb) {
+			__skb_queue_purge(batch);
+			return -ENOMEM;
+		}
+		__skb_queue_tail(batch, skb);
+	}
+
+	return 0;
+}
+
+static bool validate_batch(void)
+{
+	struct sk_buff_head batch;
+	struct sk_buff_head rejected;
+	struct sk_buff *skb;
+	bool success = true;
+
+	if (create_batch(&batch))
+		return false;
+	/* Not translatable; should be handed back. */
+	skb = skb_peek(&batch);
+	skb->protocol = htons(ETH_P_ARP);
+
+	__skb_queue_head_init(&rejected);
+	batch_out = 0;
+
+	success &= ASSERT_INT(0, core_batch(&jool, &batch, &rejected),
+			"core_batch() result");
+	success &= ASSERT_UINT(0, skb_queue_len(&batch), "input queue");
+	success &= ASSERT_UINT(1, skb_queue_len(&rejected), "rejected queue");
+	success &= ASSERT_PTR(skb, skb_peek(&rejected), "rejected packet");
+	success &= ASSERT_UINT(BATCH_SIZE - 1, batch_out, "sent packets");
+
+	__skb_queue_purge(&rejected);
+	return success;
+}
+
+/* Translates the packets the way the netfilter hooks would. */
+static int xlat_one_by_one(struct sk_buff_head *batch)
+{
+	struct xlation *state;
+	struct sk_buff *skb;
+	verdict result;
+
+	while ((skb = __skb_dequeue(batch)) != NULL) {
+		state = xlation_create(&jool);
+		if (!state) {
+			kfree_skb(skb);
+			return -ENOMEM;
+		}
+
+		result = core_6to4(skb, state);
+		if (result != VERDICT_STOLEN)
+			kfree_skb(skb);
+		kfree_skb(skb_out);
+		skb_out = NULL;
+
+		xlation_destroy(state);
+	}
+
+	return 0;
+}
+
+static bool benchmark(void)
+{
+	struct sk_buff_head batch;
+	struct sk_buff_head rejected;
+	ktime_t start;
+	s64 single_ns = 0;
+	s64 batch_ns = 0;
+	unsigned int i;
+	bool success = true;
+
+	__skb_queue_head_init(&rejected);
+	batch_out = 0;
+
+	for (i = 0; i < ROUNDS; i++) {
+		if (create_batch(&batch))
+			return false;
+		start = ktime_get();
+		success &= ASSERT_INT(0, xlat_one_by_one(&batch), "single");
+		single_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (create_batch(&batch))
+			return false;
+		start = ktime_get();
+		success &= ASSERT_INT(0, core_batch(&jool, &batch, &rejected),
+				"batch");
+		batch_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+
+	success &= ASSERT_UINT(0, skb_queue_len(&rejected), "rejected");
+	success &= ASSERT_UINT(ROUNDS * BATCH_SIZE, batch_out, "sent");
+
+	log_info("%u batches of %u packets:", ROUNDS, BATCH_SIZE);
+	log_info("  One by one: %lld ns/packet",
+			div_s64(single_ns, ROUNDS * BATCH_SIZE));
+	log_info("  Batched:    %lld ns/packet",
+			div_s64(batch_ns, ROUNDS * BATCH_SIZE));
+
+	__skb_queue_purge(&rejected);
+	return success;
+}
+
+int init_module(void)
+{
+	struct test_group test = {
+		.name = "Batch",
+		.setup_fn = xlator_setup,
+		.teardown_fn = xlator_teardown,
+		.init_fn = init,
+		.clean_fn = clean,
+	};
+
+	if (test_group_begin(&test))
+		return -EINVAL;
+
+	test_group_test(&test, validate_batch, "Batch validation");
+	test_group_test(&test, benchmark, "Batch benchmark");
+
+	return test_group_end(&test);
+}
+
+void cleanup_module(void)
+{
+	/* No code. */
+}
@@ -0,0 +1,7 @@
+#include "mod/common/dev.h"
+
+int foreach_ifa(struct net *ns, int (*cb)(struct in_ifaddr *, void const *),
+		void const *args)
+{
+	return 0;
+}
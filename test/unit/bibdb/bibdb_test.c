@@ -1,3 +1,4 @@
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/printk.h>
 #include "framework/unit_test.h"
@@ -205,6 +206,85 @@ static bool test_flow(void)
 	return success;
 }
 
+/* Benchmark: 16 ports in each of 65536 addresses. */
+#define BENCH_ADDRS 65536u
+#define BENCH_PORTS 16u
+
+static int bench_insert(void)
+{
+	struct bib_entry entry;
+	unsigned int i;
+	int error;
+
+	for (i = 0; i < BENCH_ADDRS * BENCH_PORTS; i++) {
+		entry.addr6.l3.s6_addr32[0] = cpu_to_be32(0x20010db8);
+		entry.addr6.l3.s6_addr32[1] = 0;
+		entry.addr6.l3.s6_addr32[2] = 0;
+		entry.addr6.l3.s6_addr32[3] = cpu_to_be32(i);
+		entry.addr6.l4 = 1000;
+		entry.addr4.l3.s_addr = cpu_to_be32(0x0a000000 | (i / BENCH_PORTS));
+		entry.addr4.l4 = 1000 + (i % BENCH_PORTS);
+		entry.l4_proto = PROTO;
+		entry.is_static = true;
+
+		error = bib_add_static(&jool, &entry);
+		if (error) {
+			log_err("Benchmark insertion %u failed: %d", i, error);
+			return error;
+		}
+	}
+
+	return 0;
+}
+
+static bool assert_bib_count(unsigned int expected, char *name)
+{
+	struct session_stats stats;
+	bool success = true;
+
+	success &= ASSERT_INT(0, bib_session_stats(&jool, PROTO, &stats),
+			"%s stats", name);
+	success &= ASSERT_UINT(expected, stats.bibs, "%s BIB count", name);
+	return success;
+}
+
+/*
+ * Not a correctness test so much as a benchmark; 1M entries are removed half
+ * by bib_rm_range(), half by bib_flush(). Time is printed.
+ */
+static bool test_rm_bench(void)
+{
+	struct ipv4_range range;
+	ktime_t start;
+	bool success = true;
+
+	if (bench_insert())
+		return false;
+	success &= assert_bib_count(BENCH_ADDRS * BENCH_PORTS, "inserted");
+
+	/* 10.0.0.0/17, which is the first half. */
+	range.prefix.addr.s_addr = cpu_to_be32(0x0a000000);
+	range.prefix.len = 17;
+	range.ports.min = 0;
+	range.ports.max = 65535;
+
+	start = ktime_get();
+	bib_rm_range(&jool, PROTO, &range);
+	log_info("bib_rm_range() removed %u entries in %lld us.",
+			BENCH_ADDRS * BENCH_PORTS / 2,
+			ktime_us_delta(ktime_get(), start));
+	success &= assert_bib_count(BENCH_ADDRS * BENCH_PORTS / 2, "rm_range");
+
+	start = ktime_get();
+	bib_flush(&jool);
+	log_info("bib_flush() removed %u entries in %lld us.",
+			BENCH_ADDRS * BENCH_PORTS / 2,
+			ktime_us_delta(ktime_get(), start));
+	success &= assert_bib_count(0, "flush");
+
+	return success;
+}
+
 enum session_fate tcp_est_expire_cb(struct session_entry *session, void *arg)
 {
 	return FATE_RM;
@@ -234,6 +314,7 @@ int init_module(void)
 		return -EINVAL;
 
 	test_group_test(&test, test_flow, "Flow");
+	test_group_test(&test, test_rm_bench, "Range removal benchmark");
 
 	return test_group_end(&test);
 }
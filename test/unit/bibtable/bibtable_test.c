@@ -7,6 +7,7 @@ MODULE_AUTHOR("Alberto Leiva");
 MODULE_DESCRIPTION("BIB table module test.");
 
 static struct xlator jool;
+#define XGLOBALS_PLEN (jool.globals.nat64.bib.subscriber_prefix_len)
 #define TEST_BIB_COUNT 5
 static struct bib_entry entries[TEST_BIB_COUNT];
 
@@ -142,6 +143,113 @@ static bool test_foreach(void)
 	return success;
 }
 
+struct subscriber_counter {
+	unsigned int subscribers;
+	unsigned int bibs;
+	__u8 prefix_len;
+};
+
+static int count_subscriber(struct subscriber_entry const *entry, void *arg)
+{
+	struct subscriber_counter *counter = arg;
+
+	counter->subscribers++;
+	counter->bibs += entry->bibs;
+	counter->prefix_len = entry->prefix.len;
+	return 0;
+}
+
+static bool assert_subscribers(unsigned int subscribers, unsigned int bibs,
+		char *test_name)
+{
+	struct subscriber_counter counter = { 0 };
+	bool success = true;
+
+	success &= ASSERT_INT(0, bib_foreach_subscriber(&jool, L4PROTO_UDP,
+			count_subscriber, &counter, NULL), "%s result", test_name);
+	success &= ASSERT_UINT(subscribers, counter.subscribers,
+			"%s subscribers", test_name);
+	success &= ASSERT_UINT(bibs, counter.bibs, "%s BIBs", test_name);
+	if (subscribers)
+		success &= ASSERT_UINT(XGLOBALS_PLEN, counter.prefix_len,
+				"%s prefix length", test_name);
+
+	return success;
+}
+
+static bool test_subscribers(void)
+{
+	struct table_filter filter;
+	struct unit_iteration_args args;
+	struct subscriber_entry top[2];
+	struct subscriber_counter counter;
+	unsigned int count;
+	int error;
+	bool success = true;
+
+	if (!insert_test_bibs())
+		return false;
+
+	/* Index disabled. */
+	success &= assert_subscribers(0, 0, "disabled");
+
+	/* One subscriber per address. */
+	XGLOBALS_PLEN = 128;
+	success &= ASSERT_INT(0, bib_index_subscribers(jool.nat64.bib, &jool),
+			"/128 index");
+	success &= assert_subscribers(3, 5, "/128");
+
+	/* 2001:db8::2 has the most entries. */
+	error = bib_top_subscribers(&jool, L4PROTO_UDP, top, 2, &count);
+	success &= ASSERT_INT(0, error, "top result");
+	success &= ASSERT_UINT(2, count, "top count");
+	success &= ASSERT_ADDR6("2001:db8::2", &top[0].prefix.addr,
+			"top[0] prefix");
+	success &= ASSERT_UINT(3, top[0].bibs, "top[0] BIBs");
+	success &= ASSERT_UINT(1, top[1].bibs, "top[1] BIBs");
+
+	/* Resuming after 2001:db8::2 only leaves 2001:db8::3. */
+	memset(&counter, 0, sizeof(counter));
+	error = bib_foreach_subscriber(&jool, L4PROTO_UDP, count_subscriber,
+			&counter, &top[0].prefix);
+	success &= ASSERT_INT(0, error, "offset result");
+	success &= ASSERT_UINT(1, counter.subscribers, "offset subscribers");
+	success &= ASSERT_UINT(1, counter.bibs, "offset BIBs");
+
+	/* All the addresses belong to the same /64. */
+	XGLOBALS_PLEN = 64;
+	success &= ASSERT_INT(0, bib_index_subscribers(jool.nat64.bib, &jool),
+			"/64 index");
+	success &= assert_subscribers(1, 5, "/64");
+
+	/* Removals are accounted. */
+	success &= ASSERT_INT(0, bib_rm(&jool, &entries[0]), "rm");
+	success &= assert_subscribers(1, 4, "/64 after rm");
+
+	/* The entries of one subscriber, straight from tree6. */
+	memset(&filter, 0, sizeof(filter));
+	filter.src6.set = true;
+	success &= ASSERT_INT(0, str_to_addr6("2001:db8::2",
+			&filter.src6.prefix.addr), "prefix");
+	filter.src6.prefix.len = 128;
+
+	args.i = 0;
+	args.offset = 1;
+	error = bib_foreach_filtered(jool.nat64.bib, L4PROTO_UDP, &filter, cb,
+			&args, NULL);
+	success &= ASSERT_INT(0, error, "src6 result");
+	success &= ASSERT_UINT(3, args.i, "src6 counter");
+
+	args.i = 0;
+	args.offset = 2;
+	error = bib_foreach_filtered(jool.nat64.bib, L4PROTO_UDP, &filter, cb,
+			&args, &entries[1]);
+	success &= ASSERT_INT(0, error, "src6 offset result");
+	success &= ASSERT_UINT(2, args.i, "src6 offset counter");
+
+	return success;
+}
+
 enum session_fate tcp_est_expire_cb(struct session_entry *session, void *arg)
 {
 	return FATE_RM;
@@ -171,6 +279,7 @@ int init_module(void)
 		return -EINVAL;
 
 	test_group_test(&test, test_foreach, "Foreach");
+	test_group_test(&test, test_subscribers, "Subscribers");
 
 	return test_group_end(&test);
 }
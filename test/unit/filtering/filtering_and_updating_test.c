@@ -5,7 +5,9 @@
 #include "framework/types.h"
 #include "framework/unit_test.h"
 #include "framework/skb_generator.h"
+#include "mod/common/linux_version.h"
 #include "mod/common/db/pool4/rfc6056.h"
+#include "mod/common/rfc7915/common.h"
 #include "mod/common/steps/determine_incoming_tuple.h"
 #include "mod/common/steps/filtering_and_updating.c"
 
@@ -381,6 +383,328 @@ static bool test_udp(void)
 	return success;
 }
 
+/* Sends an IPv6 UDP packet through ipv6_simple(). */
+static verdict send_udp6(struct xlation *state, char *src, u16 sport,
+		char *dst, u16 dport)
+{
+	struct sk_buff *skb;
+	verdict result;
+
+	if (create_skb6_udp(src, sport, dst, dport, 16, 32, &skb))
+		return VERDICT_DROP;
+	if (pkt_init_ipv6(state, skb)
+			|| determine_in_tuple(state) != VERDICT_CONTINUE) {
+		kfree_skb(skb);
+		return VERDICT_DROP;
+	}
+
+	result = ipv6_simple(state);
+	kfree_skb(skb);
+	return result;
+}
+
+static __u64 get_stat(enum jool_stat_id id)
+{
+	__u64 *stats;
+	__u64 result;
+
+	stats = jstat_query(jool.stats);
+	if (!stats)
+		return 0;
+	result = stats[id];
+	kfree(stats);
+	return result;
+}
+
+static bool test_subscriber_quota(void)
+{
+	struct xlation state;
+	__u64 drops;
+	bool success = true;
+
+	jool.globals.nat64.bib.subscriber_prefix_len = 64;
+	jool.globals.nat64.bib.subscriber_max_sessions = 2;
+	if (!ASSERT_INT(0, bib_index_subscribers(jool.nat64.bib, &jool),
+			"index"))
+		return false;
+
+	xlation_init(&state, &jool);
+	drops = get_stat(JSTAT_SUBSCRIBER_QUOTA);
+
+	log_debug(&state, "== The subscriber fills its quota ==");
+	success &= ASSERT_VERDICT(CONTINUE,
+			send_udp6(&state, "1::2", 1212, "3::4", 3434),
+			"first session");
+	success &= ASSERT_VERDICT(CONTINUE,
+			send_udp6(&state, "1::2", 1212, "3::5", 3434),
+			"second session");
+	success &= assert_session_count(2, L4PROTO_UDP);
+
+	log_debug(&state, "== The next session is over the quota ==");
+	success &= ASSERT_VERDICT(DROP,
+			send_udp6(&state, "1::2", 1212, "3::6", 3434),
+			"third session");
+	success &= assert_session_count(2, L4PROTO_UDP);
+	success &= ASSERT_UINT(1, (unsigned int)(get_stat(JSTAT_SUBSCRIBER_QUOTA)
+			- drops), "quota drops");
+
+	log_debug(&state, "== Existing sessions are not affected ==");
+	success &= ASSERT_VERDICT(CONTINUE,
+			send_udp6(&state, "1::2", 1212, "3::4", 3434),
+			"first session again");
+	success &= ASSERT_UINT(1, (unsigned int)(get_stat(JSTAT_SUBSCRIBER_QUOTA)
+			- drops), "quota drops again");
+
+	return success;
+}
+
+/* Adds an established (and therefore not evictable) TCP session. */
+static int add_tcp_session(unsigned int i)
+{
+	struct session_entry entry;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.src6.l3.s6_addr32[0] = cpu_to_be32(0x00010000u);
+	entry.src6.l3.s6_addr32[3] = cpu_to_be32(2);
+	entry.src6.l4 = 1024 + i;
+	entry.dst6.l3.s6_addr32[0] = cpu_to_be32(0x00030000u);
+	entry.dst6.l3.s6_addr32[3] = cpu_to_be32(4);
+	entry.dst6.l4 = 80;
+	entry.src4.l3.s_addr = cpu_to_be32(0xc0000280u);
+	entry.src4.l4 = 1024 + i;
+	entry.dst4.l3.s_addr = cpu_to_be32(4);
+	entry.dst4.l4 = 80;
+	entry.proto = L4PROTO_TCP;
+	entry.state = ESTABLISHED;
+	entry.timer_type = SESSION_TIMER_EST;
+	entry.update_time = jiffies;
+	entry.creation_time = jiffies;
+	entry.timeout = TCP_EST;
+
+	return bib_add_session(&jool, &entry, NULL);
+}
+
+static bool test_memory_limit(void)
+{
+	struct xlation state;
+	unsigned int i;
+	int error;
+	__u64 drops;
+	bool success = true;
+
+	jool.globals.nat64.bib.session_memory_limit = 1; /* KiB */
+
+	log_debug(NULL, "== Imported sessions are limited too ==");
+	for (i = 0; i < 1024; i++) {
+		error = add_tcp_session(i);
+		if (error)
+			break;
+	}
+	success &= ASSERT_INT(-ENOSPC, error, "import error");
+	success &= ASSERT_BOOL(true, i > 0, "imported sessions");
+	success &= assert_session_count(i, L4PROTO_TCP);
+
+	xlation_init(&state, &jool);
+	drops = get_stat(JSTAT_SESSION_MEMORY_LIMIT);
+
+	log_debug(&state, "== Nothing can be evicted, so the packet is dropped ==");
+	success &= ASSERT_VERDICT(DROP,
+			send_udp6(&state, "1::2", 1212, "3::4", 3434),
+			"UDP session");
+	success &= assert_session_count(0, L4PROTO_UDP);
+	success &= ASSERT_UINT(1, (unsigned int)(get_stat(JSTAT_SESSION_MEMORY_LIMIT)
+			- drops), "memory limit drops");
+
+	return success;
+}
+
+/* See impersonator.c. */
+extern struct jool_event evlog_events[];
+extern unsigned int evlog_count;
+
+static bool assert_event(unsigned int index, enum jool_event_type type,
+		char *dst6, char *dst4)
+{
+	struct jool_event *event = &evlog_events[index];
+	bool success = true;
+
+	success &= ASSERT_UINT(type, event->type, "event %u type", index);
+	success &= ASSERT_UINT(L4PROTO_UDP, event->proto, "proto");
+	success &= ASSERT_BOOL(true, event->time != 0, "time");
+	success &= ASSERT_ADDR6("1::2", &event->src6, "src6");
+	success &= ASSERT_UINT(1212, event->src6_port, "src6 port");
+	success &= ASSERT_ADDR4("192.0.2.128", &event->src4, "src4");
+	/* The IPv4 port is unpredictable, but it's the same BIB entry. */
+	success &= ASSERT_UINT(evlog_events[0].src4_port, event->src4_port,
+			"src4 port");
+	success &= ASSERT_ADDR6(dst6, &event->dst6, "dst6");
+	success &= ASSERT_ADDR4(dst4, &event->dst4, "dst4");
+	success &= ASSERT_UINT((type == JEV_BIB_ADD) ? 0 : 3434,
+			event->dst6_port, "dst6 port");
+	success &= ASSERT_UINT((type == JEV_BIB_ADD) ? 0 : 3434,
+			event->dst4_port, "dst4 port");
+
+	return success;
+}
+
+static bool test_binary_logging(void)
+{
+	struct xlation state;
+	bool success = true;
+
+	jool.globals.nat64.bib.bib_logging = true;
+	jool.globals.nat64.bib.session_logging = true;
+	jool.globals.nat64.bib.binary_logging = true;
+	evlog_count = 0;
+
+	xlation_init(&state, &jool);
+
+	log_debug(&state, "== A new connection emits a session and a BIB event ==");
+	success &= ASSERT_VERDICT(CONTINUE,
+			send_udp6(&state, "1::2", 1212, "3::4", 3434),
+			"first session");
+	if (!ASSERT_UINT(2, evlog_count, "event count"))
+		return false;
+	success &= assert_event(0, JEV_SESSION_ADD, "3::4", "0.0.0.4");
+	success &= assert_event(1, JEV_BIB_ADD, "::", "0.0.0.0");
+
+	log_debug(&state, "== Known connections emit nothing ==");
+	success &= ASSERT_VERDICT(CONTINUE,
+			send_udp6(&state, "1::2", 1212, "3::4", 3434),
+			"same session");
+	success &= ASSERT_UINT(2, evlog_count, "event count");
+
+	log_debug(&state, "== New sessions on known BIB entries only emit the session ==");
+	success &= ASSERT_VERDICT(CONTINUE,
+			send_udp6(&state, "1::2", 1212, "3::5", 3434),
+			"second session");
+	if (!ASSERT_UINT(3, evlog_count, "event count"))
+		return false;
+	success &= assert_event(2, JEV_SESSION_ADD, "3::5", "0.0.0.5");
+
+	log_debug(&state, "== Text logging doesn't emit events ==");
+	jool.globals.nat64.bib.binary_logging = false;
+	success &= ASSERT_VERDICT(CONTINUE,
+			send_udp6(&state, "1::2", 1212, "3::6", 3434),
+			"third session");
+	success &= ASSERT_UINT(3, evlog_count, "event count");
+
+	return success;
+}
+
+/* See impersonator.c. */
+extern struct dst_entry *route4_dst;
+extern unsigned int route4_calls;
+
+static bool fib_changed;
+
+static struct dst_entry *fake_dst_check(struct dst_entry *dst, u32 cookie)
+{
+	return fib_changed ? NULL : dst;
+}
+
+static struct dst_ops fake_dst_ops = {
+	.family = AF_INET,
+	.check = fake_dst_check,
+};
+
+static struct dst_entry fake_dst;
+
+static void init_fake_dst(void)
+{
+	memset(&fake_dst, 0, sizeof(fake_dst));
+	fake_dst.ops = &fake_dst_ops;
+	fake_dst.obsolete = DST_OBSOLETE_FORCE_CHK;
+	/* The test's own reference. It's never dropped, so nobody frees it. */
+#if LINUX_VERSION_AT_LEAST(6, 4, 0, 9999, 0)
+	rcuref_init(&fake_dst.__rcuref, 1);
+#else
+	atomic_set(&fake_dst.__refcnt, 1);
+#endif
+
+	fib_changed = false;
+	route4_dst = &fake_dst;
+	route4_calls = 0;
+}
+
+/*
+ * Sends an IPv6 UDP packet through filtering, then routes its IPv4 version.
+ * The route's reference is left in @state.
+ */
+static struct dst_entry *route_udp6(struct xlation *state, __u32 mark)
+{
+	struct sk_buff *skb;
+	struct flowi4 flow;
+	struct dst_entry *dst = NULL;
+
+	xlation_reset(state);
+	if (create_skb6_udp("1::2", 1212, "3::4", 3434, 16, 32, &skb))
+		return NULL;
+	if (pkt_init_ipv6(state, skb)
+			|| determine_in_tuple(state) != VERDICT_CONTINUE
+			|| ipv6_simple(state) != VERDICT_CONTINUE)
+		goto end;
+
+	memset(&flow, 0, sizeof(flow));
+	flow.flowi4_mark = mark;
+	dst = ttpcomm_route4(state, &flow);
+	state->dst = dst;
+	/* Fall through */
+
+end:
+	kfree_skb(skb);
+	return dst;
+}
+
+static bool test_route_cache(void)
+{
+	struct xlation state;
+	__u64 hits;
+	__u64 misses;
+	__u64 invalid;
+	bool success = true;
+
+	jool.globals.nat64.bib.route_cache = true;
+	init_fake_dst();
+	xlation_init(&state, &jool);
+	hits = get_stat(JSTAT_ROUTE_CACHE_HIT);
+	misses = get_stat(JSTAT_ROUTE_CACHE_MISS);
+	invalid = get_stat(JSTAT_ROUTE_CACHE_INVALID);
+
+	log_debug(&state, "== The first packet has to be routed ==");
+	success &= ASSERT_PTR(&fake_dst, route_udp6(&state, 0), "route 1");
+	success &= ASSERT_UINT(1, route4_calls, "lookups 1");
+	success &= ASSERT_UINT(1, (unsigned int)(get_stat(JSTAT_ROUTE_CACHE_MISS)
+			- misses), "misses 1");
+
+	log_debug(&state, "== The second one reuses the session's route ==");
+	success &= ASSERT_PTR(&fake_dst, route_udp6(&state, 0), "route 2");
+	success &= ASSERT_UINT(1, route4_calls, "lookups 2");
+	success &= ASSERT_UINT(1, (unsigned int)(get_stat(JSTAT_ROUTE_CACHE_HIT)
+			- hits), "hits 2");
+
+	log_debug(&state, "== A different mark needs a different route ==");
+	success &= ASSERT_PTR(&fake_dst, route_udp6(&state, 1), "route 3");
+	success &= ASSERT_UINT(2, route4_calls, "lookups 3");
+	success &= ASSERT_UINT(2, (unsigned int)(get_stat(JSTAT_ROUTE_CACHE_MISS)
+			- misses), "misses 3");
+
+	log_debug(&state, "== The FIB changes; the cached route goes stale ==");
+	fib_changed = true;
+	success &= ASSERT_PTR(&fake_dst, route_udp6(&state, 1), "route 4");
+	success &= ASSERT_UINT(3, route4_calls, "lookups 4");
+	success &= ASSERT_UINT(1, (unsigned int)(get_stat(JSTAT_ROUTE_CACHE_INVALID)
+			- invalid), "invalidations 4");
+	success &= ASSERT_UINT(3, (unsigned int)(get_stat(JSTAT_ROUTE_CACHE_MISS)
+			- misses), "misses 4");
+	success &= ASSERT_UINT(1, (unsigned int)(get_stat(JSTAT_ROUTE_CACHE_HIT)
+			- hits), "hits 4");
+
+	xlation_reset(&state);
+	route4_dst = NULL;
+	return success;
+}
+
 static bool test_icmp(void)
 {
 	struct xlation state;
@@ -627,6 +951,10 @@ static int filtering_test_init(void)
 	test_group_test(&test, test_udp, "UDP");
 	test_group_test(&test, test_icmp, "ICMP");
 	test_group_test(&test, test_tcp, "test_tcp");
+	test_group_test(&test, test_subscriber_quota, "Subscriber quota");
+	test_group_test(&test, test_memory_limit, "Session memory limit");
+	test_group_test(&test, test_binary_logging, "Binary logging");
+	test_group_test(&test, test_route_cache, "Session route cache");
 
 	return test_group_end(&test);
 }
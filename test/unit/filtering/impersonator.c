@@ -1,6 +1,11 @@
 #include "mod/common/joold.h"
+#include "mod/common/log.h"
+#include "mod/common/route.h"
+#include "mod/common/db/bib/event_log.h"
 #include "framework/unit_test.h"
 
+#define EVLOG_MAX_EVENTS 8
+
 static struct fake {
 	int junk;
 } dummy;
@@ -25,8 +30,59 @@ void joold_put(struct joold_queue *queue)
 	/* No code. */
 }
 
+void joold_stop(struct joold_queue *queue)
+{
+	/* No code. */
+}
+
 int foreach_ifa(struct net *ns, int (*cb)(struct in_ifaddr *, void const *),
 		void const *args)
 {
 	return broken_unit_call(__func__);
 }
+
+struct event_log *evlog_alloc(void)
+{
+	return (struct event_log *)&dummy;
+}
+
+void evlog_release(struct event_log *log)
+{
+	/* No code. */
+}
+
+/* The events db.c emitted, for the tests to inspect. */
+struct jool_event evlog_events[EVLOG_MAX_EVENTS];
+unsigned int evlog_count;
+
+void evlog_add(struct xlator *jool, struct event_log *log,
+		struct jool_event const *event)
+{
+	if (evlog_count < EVLOG_MAX_EVENTS)
+		evlog_events[evlog_count] = *event;
+	evlog_count++;
+}
+
+void evlog_flush(struct xlator *jool, struct event_log *log)
+{
+	/* No code. */
+}
+
+/*
+ * The route the tests want route4() to return, and the number of times it was
+ * asked for it.
+ */
+struct dst_entry *route4_dst;
+unsigned int route4_calls;
+
+struct dst_entry *route4(struct xlator *jool, struct flowi4 *flow)
+{
+	route4_calls++;
+	return route4_dst ? dst_clone(route4_dst) : NULL;
+}
+
+struct dst_entry *route6(struct xlator *jool, struct flowi6 *flow)
+{
+	log_debug(jool, "Pretending I'm routing an IPv6 packet.");
+	return NULL;
+}
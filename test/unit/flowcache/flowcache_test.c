@@ -0,0 +1,171 @@
+#include <linux/module.h>
+
+#include "framework/unit_test.h"
+#include "framework/skb_generator.h"
+#include "framework/types.h"
+#include "mod/common/db/flowcache.h"
+
+MODULE_LICENSE(JOOL_LICENSE);
+MODULE_AUTHOR("Alberto Leiva");
+MODULE_DESCRIPTION("Flow cache test");
+
+static struct xlator jool;
+static struct xlation state;
+
+static int init(void)
+{
+	memset(&jool, 0, sizeof(jool));
+	jool.globals.nat64.flow_cache = true;
+	jool.globals.nat64.flow_cache_capacity = 2;
+	jool.nat64.flows = flowcache_alloc();
+	return jool.nat64.flows ? 0 : -ENOMEM;
+}
+
+static void clean(void)
+{
+	flowcache_put(jool.nat64.flows);
+}
+
+/*
+ * Prepares @state->in as an IPv6 packet from port @sport.
+ * TCP packets are mid-connection (no SYN), and carry a FIN if @fin.
+ */
+static int init_packet(l4_protocol proto, __u16 sport, bool fin)
+{
+	struct sk_buff *skb;
+	size_t l4hdr_len;
+	int error;
+
+	if (proto == L4PROTO_TCP) {
+		error = create_skb6_tcp("2001:db8::1", sport,
+				"64:ff9b::c000:201", 80, 100, 32, &skb);
+		l4hdr_len = sizeof(struct tcphdr);
+	} else {
+		error = create_skb6_udp("2001:db8::1", sport,
+				"64:ff9b::c000:201", 80, 100, 32, &skb);
+		l4hdr_len = sizeof(struct udphdr);
+	}
+	if (error)
+		return error;
+
+	if (proto == L4PROTO_TCP) {
+		tcp_hdr(skb)->syn = 0;
+		tcp_hdr(skb)->fin = fin;
+	}
+
+	xlation_init(&state, &jool);
+	pkt_fill(&state.in, skb, L3PROTO_IPV6, proto, NULL,
+			skb_transport_header(skb) + l4hdr_len, NULL);
+	return 0;
+}
+
+static void clean_packet(void)
+{
+	kfree_skb(state.in.skb);
+	xlation_reset(&state);
+}
+
+/* Pretends @state went through the slow path, and caches it. */
+static bool add(l4_protocol proto, __u16 sport, tcp_state tcp_state)
+{
+	if (init_packet(proto, sport, false))
+		return false;
+
+	if (init_tuple6(&state.in.tuple, "2001:db8::1", sport,
+			"64:ff9b::c000:201", 80, proto))
+		goto fail;
+	if (init_tuple4(&state.out.tuple, "203.0.113.1", sport + 1000,
+			"192.0.2.1", 80, proto))
+		goto fail;
+	state.entries.bib_set = true;
+	state.entries.session_set = true;
+	state.entries.session.proto = proto;
+	state.entries.session.state = tcp_state;
+
+	flowcache_add(&state);
+	clean_packet();
+	return true;
+
+fail:
+	clean_packet();
+	return false;
+}
+
+static bool find(l4_protocol proto, __u16 sport, bool fin, bool expected,
+		char *test_name)
+{
+	bool success = true;
+
+	if (init_packet(proto, sport, fin))
+		return false;
+
+	success &= ASSERT_BOOL(expected, flowcache_find(&state), "%s",
+			test_name);
+	if (expected) {
+		success &= ASSERT_UINT(sport, state.in.tuple.src.addr6.l4,
+				"%s's incoming port", test_name);
+		success &= ASSERT_UINT(sport + 1000,
+				state.out.tuple.src.addr4.l4,
+				"%s's outgoing port", test_name);
+		success &= ASSERT_BOOL(true, state.entries.session_set,
+				"%s's session", test_name);
+	}
+
+	clean_packet();
+	return success;
+}
+
+static bool test_flow(void)
+{
+	bool success = true;
+
+	success &= find(L4PROTO_UDP, 1000, false, false, "Empty");
+
+	success &= add(L4PROTO_UDP, 1000, ESTABLISHED);
+	success &= find(L4PROTO_UDP, 1000, false, true, "UDP");
+	success &= find(L4PROTO_UDP, 1001, false, false, "Other port");
+	success &= find(L4PROTO_TCP, 1000, false, false, "Other protocol");
+
+	flowcache_flush(jool.nat64.flows);
+	success &= find(L4PROTO_UDP, 1000, false, false, "Flushed");
+
+	return success;
+}
+
+static bool test_tcp(void)
+{
+	bool success = true;
+
+	/* Only established sessions can skip the state machine. */
+	success &= add(L4PROTO_TCP, 2000, V6_INIT);
+	success &= find(L4PROTO_TCP, 2000, false, false, "Not established");
+
+	success &= add(L4PROTO_TCP, 2001, ESTABLISHED);
+	success &= find(L4PROTO_TCP, 2001, false, true, "Established");
+	success &= find(L4PROTO_TCP, 2001, true, false, "FIN");
+
+	flowcache_flush(jool.nat64.flows);
+	return success;
+}
+
+int init_module(void)
+{
+	struct test_group test = {
+		.name = "Flow cache",
+		.init_fn = init,
+		.clean_fn = clean,
+	};
+
+	if (test_group_begin(&test))
+		return -EINVAL;
+
+	test_group_test(&test, test_flow, "Flow");
+	test_group_test(&test, test_tcp, "TCP");
+
+	return test_group_end(&test);
+}
+
+void cleanup_module(void)
+{
+	/* No code. */
+}
@@ -0,0 +1,158 @@
+#include <linux/module.h>
+
+#include "framework/unit_test.h"
+#include "framework/skb_generator.h"
+#include "mod/common/db/fragdb.h"
+
+MODULE_LICENSE(JOOL_LICENSE);
+MODULE_AUTHOR("Alberto Leiva");
+MODULE_DESCRIPTION("Fragment tracker test");
+
+static struct xlator jool;
+static struct xlation state;
+
+static int init(void)
+{
+	memset(&jool, 0, sizeof(jool));
+	jool.globals.nat64.frag_tracking = true;
+	jool.globals.nat64.frag_tracking_timeout = 10000;
+	jool.globals.nat64.frag_tracking_capacity = 2;
+	jool.nat64.frags = fragdb_alloc();
+	return jool.nat64.frags ? 0 : -ENOMEM;
+}
+
+static void clean(void)
+{
+	fragdb_put(jool.nat64.frags);
+}
+
+/*
+ * Prepares @state->in as a fragment of IPv4 packet @id.
+ * @offset is measured in bytes.
+ */
+static int init_fragment(__u16 id, __u16 offset, bool mf)
+{
+	struct sk_buff *skb;
+	struct iphdr *hdr;
+
+	if (create_skb4_udp("192.0.2.1", 1000, "203.0.113.2", 2000, 100, 32,
+			&skb))
+		return -ENOMEM;
+
+	hdr = ip_hdr(skb);
+	hdr->id = cpu_to_be16(id);
+	hdr->frag_off = build_ipv4_frag_off_field(false, mf, offset);
+
+	xlation_init(&state, &jool);
+	pkt_fill(&state.in, skb, L3PROTO_IPV4, L4PROTO_UDP, NULL,
+			skb_transport_header(skb) + sizeof(struct udphdr),
+			NULL);
+	state.in.tuple.src.addr4.l4 = (offset == 0) ? 1000 : 0;
+	return 0;
+}
+
+static void clean_fragment(void)
+{
+	kfree_skb(state.in.skb);
+}
+
+static bool add(__u16 id, __u16 offset, bool mf, bool csum0,
+		verdict expected, char *test_name)
+{
+	bool success;
+
+	if (init_fragment(id, offset, mf))
+		return false;
+	if (csum0)
+		pkt_udp_hdr(&state.in)->check = 0;
+	success = ASSERT_VERDICT(expected, fragdb_add(&state), "%s",
+			test_name);
+	clean_fragment();
+	return success;
+}
+
+static bool find(__u16 id, __u16 offset, bool mf, verdict expected,
+		char *test_name)
+{
+	bool success = true;
+
+	if (init_fragment(id, offset, mf))
+		return false;
+
+	success &= ASSERT_VERDICT(expected, fragdb_find(&state), "%s",
+			test_name);
+	if (expected == VERDICT_CONTINUE) {
+		success &= ASSERT_UINT(1000, state.in.tuple.src.addr4.l4,
+				"%s's port", test_name);
+	}
+
+	clean_fragment();
+	return success;
+}
+
+static bool test_flow(void)
+{
+	bool success = true;
+
+	/* Unfragmented packets don't need to be remembered. */
+	success &= add(1, 0, false, false, VERDICT_CONTINUE, "Unfragmented");
+	success &= find(1, 8, false, VERDICT_UNTRANSLATABLE, "Unfragmented");
+
+	success &= add(2, 0, true, false, VERDICT_CONTINUE, "First fragment");
+	success &= find(2, 8, true, VERDICT_CONTINUE, "Middle fragment");
+	success &= find(2, 16, true, VERDICT_CONTINUE, "Middle fragment 2");
+	success &= find(3, 16, true, VERDICT_UNTRANSLATABLE, "Other packet");
+	success &= find(2, 24, false, VERDICT_CONTINUE, "Last fragment");
+	success &= find(2, 32, false, VERDICT_UNTRANSLATABLE,
+			"After last fragment");
+
+	return success;
+}
+
+static bool test_kernel(void)
+{
+	bool success = true;
+
+	/* Out of order; the whole packet has to go to the defragmenter. */
+	success &= find(4, 8, true, VERDICT_UNTRANSLATABLE, "Early fragment");
+	success &= add(4, 0, true, false, VERDICT_UNTRANSLATABLE,
+			"Late first fragment");
+	success &= find(4, 16, false, VERDICT_UNTRANSLATABLE, "Last fragment");
+
+	/* The checksum can only be computed out of the full packet. */
+	success &= add(5, 0, true, true, VERDICT_UNTRANSLATABLE,
+			"Zero checksum");
+	success &= find(5, 8, false, VERDICT_UNTRANSLATABLE,
+			"Zero checksum's last fragment");
+
+	/* Zero capacity disables tracking. */
+	jool.globals.nat64.frag_tracking_capacity = 0;
+	success &= add(6, 0, true, false, VERDICT_UNTRANSLATABLE, "Disabled");
+	success &= find(6, 8, false, VERDICT_UNTRANSLATABLE,
+			"Disabled's last fragment");
+	jool.globals.nat64.frag_tracking_capacity = 2;
+
+	return success;
+}
+
+int init_module(void)
+{
+	struct test_group test = {
+		.name = "Fragment tracker",
+		.init_fn = init,
+		.clean_fn = clean,
+	};
+
+	if (test_group_begin(&test))
+		return -EINVAL;
+
+	test_group_test(&test, test_flow, "Flow");
+	test_group_test(&test, test_kernel, "Kernel fallback");
+
+	return test_group_end(&test);
+}
+
+void cleanup_module(void)
+{
+	/* No code. */
+}
@@ -4,5 +4,7 @@
 #include "mod/common/steps/send_packet.h"
 
 extern struct sk_buff *skb_out;
+/* Number of packets sendpkt_send_batch() has pretended to send. */
+extern unsigned int batch_out;
 
 #endif /* TEST_UNIT_FRAMEWORK_SEND_PACKET_H_ */
@@ -1,4 +1,6 @@
+#include "mod/common/db/flowcache.h"
 #include "mod/common/db/pool4/db.h"
+#include "mod/common/db/bib/event_log.h"
 #include "mod/common/db/bib/pkt_queue.h"
 #include "framework/unit_test.h"
 
@@ -18,6 +20,11 @@ void mask_domain_commit(struct mask_domain *masks)
 	broken_unit_call(__func__);
 }
 
+void mask_domain_rewind(struct mask_domain *masks)
+{
+	broken_unit_call(__func__);
+}
+
 bool mask_domain_matches(struct mask_domain *masks,
 		struct ipv4_transport_addr *addr)
 {
@@ -79,3 +86,29 @@ void pktqueue_clean(struct list_head *probes)
 {
 	broken_unit_call(__func__);
 }
+
+void flowcache_flush(struct flowcache *cache)
+{
+	/* No code. */
+}
+
+struct event_log *evlog_alloc(void)
+{
+	return (struct event_log *)&dummy;
+}
+
+void evlog_release(struct event_log *log)
+{
+	/* No code. */
+}
+
+void evlog_add(struct xlator *jool, struct event_log *log,
+		struct jool_event const *event)
+{
+	/* No code. */
+}
+
+void evlog_flush(struct xlator *jool, struct event_log *log)
+{
+	/* No code. */
+}
@@ -1,4 +1,6 @@
 #include "mod/common/joold.h"
+#include "mod/common/db/flowcache.h"
+#include "mod/common/db/fragdb.h"
 #include "mod/common/db/pool4/db.h"
 #include "mod/common/db/bib/db.h"
 #include "mod/common/steps/compute_outgoing_tuple.h"
@@ -53,6 +55,54 @@ void joold_put(struct joold_queue *queue)
 	fail(__func__);
 }
 
+void joold_stop(struct joold_queue *queue)
+{
+	fail(__func__);
+}
+
+struct fragdb *fragdb_alloc(void)
+{
+	fail(__func__);
+	return NULL;
+}
+
+void fragdb_get(struct fragdb *db)
+{
+	fail(__func__);
+}
+
+void fragdb_put(struct fragdb *db)
+{
+	fail(__func__);
+}
+
+struct flowcache *flowcache_alloc(void)
+{
+	fail(__func__);
+	return NULL;
+}
+
+void flowcache_get(struct flowcache *cache)
+{
+	fail(__func__);
+}
+
+void flowcache_put(struct flowcache *cache)
+{
+	fail(__func__);
+}
+
+bool flowcache_find(struct xlation *state)
+{
+	fail(__func__);
+	return false;
+}
+
+void flowcache_add(struct xlation *state)
+{
+	fail(__func__);
+}
+
 struct pool4 *pool4db_alloc(void)
 {
 	fail(__func__);
@@ -85,6 +135,22 @@ void bib_put(struct bib *db)
 	fail(__func__);
 }
 
+int bib_index_subscribers(struct bib *db, struct xlator *jool)
+{
+	fail(__func__);
+	return -EINVAL;
+}
+
+void bib_stop(struct xlator *jool)
+{
+	fail(__func__);
+}
+
+void bib_cache_route(struct xlation *state, struct session_route const *route)
+{
+	fail(__func__);
+}
+
 bool is_hairpin_nat64(struct xlation *state)
 {
 	fail(__func__);
@@ -11,3 +11,15 @@ unsigned int hook_ipv4(void *priv, struct sk_buff *skb,
 {
 	return NF_ACCEPT;
 }
+
+unsigned int hook_ipv6_frag(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs)
+{
+	return NF_ACCEPT;
+}
+
+unsigned int hook_ipv4_frag(void *priv, struct sk_buff *skb,
+		const struct nf_hook_state *nhs)
+{
+	return NF_ACCEPT;
+}
@@ -3,6 +3,7 @@
 #include "mod/common/log.h"
 
 struct sk_buff *skb_out = NULL;
+unsigned int batch_out = 0;
 
 verdict sendpkt_send(struct xlation *state)
 {
@@ -10,3 +11,11 @@ verdict sendpkt_send(struct xlation *state)
 	skb_out = state->out.skb;
 	return VERDICT_CONTINUE;
 }
+
+void sendpkt_send_batch(struct xlation *state)
+{
+	log_debug(state, "Pretending I'm sending %u packets.",
+			skb_queue_len(&state->batch->out));
+	batch_out += skb_queue_len(&state->batch->out);
+	__skb_queue_purge(&state->batch->out);
+}
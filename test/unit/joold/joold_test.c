@@ -0,0 +1,347 @@
+#include <linux/module.h>
+#include <linux/printk.h>
+#include <net/genetlink.h>
+
+#include "framework/unit_test.h"
+#include "common/constants.h"
+#include "mod/common/joold.h"
+#include "mod/common/db/bib/db.h"
+#include "mod/common/nl/nl_handler.h"
+
+MODULE_LICENSE(JOOL_LICENSE);
+MODULE_AUTHOR("Alberto Leiva Popper");
+MODULE_DESCRIPTION("joold module test.");
+
+#define SESSIONS 1000
+/* Just in case the instances never stop talking. */
+#define MAX_ROUNDS 1000
+#define AGE (10 * HZ)
+
+static struct xlator jool;
+static struct xlator peer;
+static const l4_protocol PROTO = L4PROTO_UDP;
+
+/*
+ * The instances are connected through the UDP transport, which is
+ * impersonated below. Instead of reaching the network, the packets wait in the
+ * sockets' queues until the test delivers them to the other instance.
+ */
+
+struct joold_udp {
+	struct sk_buff_head sent;
+};
+
+static struct joold_udp sockets[2];
+
+struct joold_udp *joold_udp_create(struct xlator *instance,
+		struct joold_udp_config *config)
+{
+	struct joold_udp *udp;
+
+	udp = &sockets[(instance == &jool) ? 0 : 1];
+	skb_queue_head_init(&udp->sent);
+	return udp;
+}
+
+void joold_udp_destroy(struct joold_udp *udp)
+{
+	skb_queue_purge(&udp->sent);
+}
+
+void joold_udp_send(struct joold_udp *udp, struct sk_buff *skb,
+		struct nlattr *root)
+{
+	/* Remember where the sessions are, for deliver(). */
+	*((struct nlattr **)skb->cb) = root;
+	skb_queue_tail(&udp->sent, skb);
+}
+
+void joold_udp_kick(struct joold_udp *udp)
+{
+	/* No code; converse() plays the worker. */
+}
+
+static struct genl_family family = {
+	.hdrsize = sizeof(struct joolnlhdr),
+	.name = "JoolTest",
+	.version = 1,
+};
+
+struct genl_family *jnl_family(void)
+{
+	return &family;
+}
+
+static void init_src6(struct ipv6_transport_addr *addr, unsigned int i)
+{
+	addr->l3.s6_addr32[0] = cpu_to_be32(0x20010db8u);
+	addr->l3.s6_addr32[1] = 0;
+	addr->l3.s6_addr32[2] = 0;
+	addr->l3.s6_addr32[3] = cpu_to_be32(i);
+	addr->l4 = i;
+}
+
+static int add_session(struct xlator *instance, unsigned int i)
+{
+	struct session_entry entry;
+
+	memset(&entry, 0, sizeof(entry));
+	init_src6(&entry.src6, i);
+	entry.dst6.l3.s6_addr32[0] = cpu_to_be32(0x0064ff9bu);
+	entry.dst6.l3.s6_addr32[3] = cpu_to_be32(0xc0000201u);
+	entry.dst6.l4 = 80;
+	entry.src4.l3.s_addr = cpu_to_be32(0xcb007100u | (i >> 8));
+	entry.src4.l4 = 1024 + (i & 0xFFu);
+	entry.dst4.l3.s_addr = cpu_to_be32(0xc0000201u);
+	entry.dst4.l4 = 80;
+	entry.proto = PROTO;
+	entry.state = ESTABLISHED;
+	entry.timer_type = SESSION_TIMER_EST;
+	/* Pretend the sessions were created a while ago. */
+	entry.creation_time = jiffies - AGE;
+	entry.update_time = jiffies;
+	entry.timeout = UDP_DEFAULT;
+	entry.has_stored = false;
+
+	return bib_add_session(instance, &entry, NULL);
+}
+
+struct traffic {
+	unsigned int packets;
+	/* Sessions carried by the packets. (As opposed to digests.) */
+	unsigned int sessions;
+};
+
+/* Hands the packets @from sent over to @to. Returns the number of packets. */
+static unsigned int deliver(struct joold_udp *from, struct xlator *to,
+		struct traffic *traffic, bool *success)
+{
+	struct sk_buff *skb;
+	struct nlattr *root;
+	struct nlattr *attr;
+	unsigned int delivered;
+	int rem;
+
+	delivered = 0;
+	while ((skb = skb_dequeue(&from->sent)) != NULL) {
+		root = *((struct nlattr **)skb->cb);
+
+		nla_for_each_nested(attr, root, rem)
+			if (nla_type(attr) == JNLAL_ENTRY)
+				traffic->sessions++;
+
+		*success &= ASSERT_INT(0, joold_sync_payload(to, nla_data(root),
+				nla_len(root)), "sync payload");
+		kfree_skb(skb);
+		delivered++;
+	}
+
+	traffic->packets += delivered;
+	return delivered;
+}
+
+/* Lets the instances talk until they have nothing left to say. */
+static bool converse(struct traffic *traffic)
+{
+	unsigned int delivered;
+	unsigned int rounds;
+	bool success = true;
+
+	memset(traffic, 0, sizeof(*traffic));
+
+	for (rounds = 0; rounds < MAX_ROUNDS; rounds++) {
+		/* Pretend the timer ran; some nodes might still be queued. */
+		joold_clean(&jool);
+		joold_clean(&peer);
+
+		delivered = deliver(&sockets[0], &peer, traffic, &success);
+		delivered += deliver(&sockets[1], &jool, traffic, &success);
+		if (!delivered)
+			return success;
+	}
+
+	pr_err("The instances are still talking after %u rounds.\n", rounds);
+	return false;
+}
+
+static bool assert_full_digest(struct xlator *instance, unsigned int count,
+		struct session_digest *result)
+{
+	memset(result, 0, sizeof(*result));
+	result->proto = PROTO;
+	result->start.include_offset = true;
+	bib_digest_end_max(result);
+
+	if (!ASSERT_INT(0, bib_digest(instance, result, 0), "full digest"))
+		return false;
+	return ASSERT_UINT(count, result->count, "session count");
+}
+
+static bool test_resync(void)
+{
+	struct session_digest digest1;
+	struct session_digest digest2;
+	struct traffic traffic;
+	unsigned int i;
+	bool success = true;
+
+	/*
+	 * 1% divergence: @peer lacks five of @jool's sessions, and has five
+	 * of its own.
+	 */
+	for (i = 0; i < SESSIONS; i++) {
+		success &= ASSERT_INT(0, add_session(&jool, i), "jool add %u", i);
+		if (i % 200 != 7)
+			success &= ASSERT_INT(0, add_session(&peer, i),
+					"peer add %u", i);
+	}
+	for (i = SESSIONS; i < SESSIONS + 5; i++)
+		success &= ASSERT_INT(0, add_session(&peer, i), "peer add %u", i);
+	if (!success)
+		return false;
+
+	success &= ASSERT_INT(0, joold_resync(&jool), "resync");
+	success &= converse(&traffic);
+
+	success &= assert_full_digest(&jool, SESSIONS + 5, &digest1);
+	success &= assert_full_digest(&peer, SESSIONS + 5, &digest2);
+	success &= ASSERT_UINT(digest1.hash, digest2.hash, "hashes");
+
+	/* Only the differing ranges should have been exchanged. */
+	success &= ASSERT_BOOL(true, traffic.sessions > 0, "sessions sent");
+	success &= ASSERT_BOOL(true,
+			traffic.sessions <= 6 * 2 * JOOLD_DIGEST_SESSIONS,
+			"sessions sent (%u)", traffic.sessions);
+
+	/* Now they're in sync; only the digests should travel. */
+	success &= ASSERT_INT(0, joold_resync(&peer), "second resync");
+	success &= converse(&traffic);
+	success &= ASSERT_BOOL(true, traffic.packets > 0, "digests sent");
+	success &= ASSERT_UINT(0, traffic.sessions, "sessions after sync");
+
+	bib_flush(&jool);
+	bib_flush(&peer);
+	return success;
+}
+
+/* The peer's copies should be as old as the originals, not brand new. */
+static int check_age(struct session_entry const *session, void *arg)
+{
+	unsigned long age = jiffies - session->creation_time;
+	unsigned int *young = arg;
+
+	if (age < AGE - HZ || age > AGE + HZ)
+		(*young)++;
+	return 0;
+}
+
+static bool test_advertise(void)
+{
+	struct session_digest digest;
+	struct traffic traffic;
+	unsigned int young;
+	unsigned int i;
+	bool success = true;
+
+	for (i = 0; i < SESSIONS; i++)
+		success &= ASSERT_INT(0, add_session(&jool, i), "add %u", i);
+	if (!success)
+		return false;
+
+	success &= ASSERT_INT(0, joold_advertise(&jool), "advertise");
+	success &= converse(&traffic);
+	success &= ASSERT_UINT(SESSIONS, traffic.sessions, "sessions sent");
+	success &= assert_full_digest(&peer, SESSIONS, &digest);
+
+	young = 0;
+	success &= ASSERT_INT(0, bib_foreach_session(&peer, PROTO, check_age,
+			&young, NULL), "foreach");
+	success &= ASSERT_UINT(0, young, "sessions with the wrong age");
+
+	bib_flush(&jool);
+	bib_flush(&peer);
+	return success;
+}
+
+static int init_instance(struct xlator *instance, char *iname)
+{
+	struct joold_udp_config config;
+	int error;
+
+	error = xlator_init(instance, NULL, iname, XF_NETFILTER | XT_NAT64,
+			NULL);
+	if (error)
+		return error;
+
+	instance->globals.nat64.joold.enabled = true;
+	instance->globals.nat64.joold.flush_asap = true;
+
+	instance->nat64.joold = joold_alloc(NULL);
+	if (!instance->nat64.joold) {
+		error = -ENOMEM;
+		goto fail;
+	}
+
+	memset(&config, 0, sizeof(config));
+	error = joold_set_transport(instance, &config);
+	if (error)
+		goto fail;
+
+	return 0;
+
+fail:
+	if (instance->nat64.joold)
+		joold_put(instance->nat64.joold);
+	xlator_put(instance);
+	return error;
+}
+
+static void clean_instance(struct xlator *instance)
+{
+	joold_stop(instance->nat64.joold);
+	joold_put(instance->nat64.joold);
+	xlator_put(instance);
+}
+
+static int init(void)
+{
+	int error;
+
+	error = init_instance(&jool, INAME_DEFAULT);
+	if (error)
+		return error;
+
+	error = init_instance(&peer, "peer");
+	if (error)
+		clean_instance(&jool);
+	return error;
+}
+
+static void clean(void)
+{
+	clean_instance(&peer);
+	clean_instance(&jool);
+}
+
+int init_module(void)
+{
+	struct test_group test = {
+		.name = "joold",
+		.teardown_fn = bib_teardown,
+		.init_fn = init,
+		.clean_fn = clean,
+	};
+
+	if (test_group_begin(&test))
+		return -EINVAL;
+
+	test_group_test(&test, test_advertise, "Advertise");
+	test_group_test(&test, test_resync, "Digest resync");
+
+	return test_group_end(&test);
+}
+
+void cleanup_module(void)
+{
+	joold_teardown();
+}
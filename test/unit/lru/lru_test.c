@@ -0,0 +1,140 @@
+#include <linux/module.h>
+
+#include "framework/unit_test.h"
+#include "mod/common/db/lru.h"
+
+MODULE_LICENSE(JOOL_LICENSE);
+MODULE_AUTHOR("Alberto Leiva");
+MODULE_DESCRIPTION("Bounded LRU test");
+
+#define NODES 3
+/* In jiffies. */
+#define TIMEOUT (10 * HZ)
+
+static struct lru lru;
+static struct hlist_head bucket;
+static struct lru_node nodes[NODES];
+static bool freed[NODES];
+
+static void free_node(struct lru_node *node)
+{
+	freed[node - nodes] = true;
+}
+
+static int init(void)
+{
+	lru_init(&lru, free_node);
+	INIT_HLIST_HEAD(&bucket);
+	memset(freed, 0, sizeof(freed));
+	return 0;
+}
+
+static void clean(void)
+{
+	lru_flush(&lru);
+}
+
+/* Fills the table, making room the way the users do. */
+static unsigned int add(unsigned int index, unsigned int capacity)
+{
+	unsigned int evicted;
+
+	evicted = lru_make_room(&lru, capacity);
+	lru_add(&lru, &bucket, &nodes[index], TIMEOUT);
+	return evicted;
+}
+
+static bool assert_freed(bool n0, bool n1, bool n2, char *test_name)
+{
+	bool success = true;
+
+	success &= ASSERT_BOOL(n0, freed[0], "%s: node 0", test_name);
+	success &= ASSERT_BOOL(n1, freed[1], "%s: node 1", test_name);
+	success &= ASSERT_BOOL(n2, freed[2], "%s: node 2", test_name);
+
+	return success;
+}
+
+static bool test_capacity(void)
+{
+	bool success = true;
+
+	success &= ASSERT_UINT(0, add(0, 2), "Add 0");
+	success &= ASSERT_UINT(0, add(1, 2), "Add 1");
+	success &= ASSERT_UINT(1, add(2, 2), "Add 2");
+	success &= ASSERT_UINT(2, lru.count, "Count");
+	success &= assert_freed(true, false, false, "Full");
+
+	/* Refreshed nodes are the last ones to go. */
+	lru_refresh(&lru, &nodes[1], TIMEOUT);
+	success &= ASSERT_UINT(1, lru_make_room(&lru, 2), "Make room");
+	success &= assert_freed(true, false, true, "Refreshed");
+
+	/* Shrinking the capacity evicts several at once. */
+	success &= ASSERT_UINT(1, lru_make_room(&lru, 1), "Shrink");
+	success &= ASSERT_UINT(0, lru.count, "Shrunk count");
+	success &= assert_freed(true, true, true, "Shrunk");
+
+	return success;
+}
+
+static bool test_expiration(void)
+{
+	bool success = true;
+
+	/* Zero timeouts expire right away. */
+	lru_add(&lru, &bucket, &nodes[0], 0);
+	lru_add(&lru, &bucket, &nodes[2], 0);
+	lru_add(&lru, &bucket, &nodes[1], TIMEOUT);
+
+	lru_expire(&lru);
+	success &= ASSERT_UINT(1, lru.count, "Count");
+	success &= assert_freed(true, false, true, "Expired");
+	success &= ASSERT_BOOL(false, hlist_unhashed(&nodes[1].hash_hook),
+			"Survivor hashed");
+
+	lru_rm(&lru, &nodes[1]);
+	success &= ASSERT_BOOL(true, hlist_empty(&bucket), "Bucket emptied");
+	success &= assert_freed(true, true, true, "Removed");
+
+	return success;
+}
+
+static bool test_flush(void)
+{
+	bool success = true;
+
+	add(0, NODES);
+	add(1, NODES);
+	add(2, NODES);
+
+	lru_flush(&lru);
+	success &= ASSERT_UINT(0, lru.count, "Count");
+	success &= ASSERT_BOOL(true, hlist_empty(&bucket), "Bucket");
+	success &= assert_freed(true, true, true, "Flushed");
+
+	return success;
+}
+
+int init_module(void)
+{
+	struct test_group test = {
+		.name = "LRU",
+		.init_fn = init,
+		.clean_fn = clean,
+	};
+
+	if (test_group_begin(&test))
+		return -EINVAL;
+
+	test_group_test(&test, test_capacity, "Capacity");
+	test_group_test(&test, test_expiration, "Expiration");
+	test_group_test(&test, test_flush, "Flush");
+
+	return test_group_end(&test);
+}
+
+void cleanup_module(void)
+{
+	/* No code. */
+}
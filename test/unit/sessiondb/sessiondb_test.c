@@ -115,6 +115,7 @@ static bool inject(unsigned int index, __u32 src_addr, __u16 src_id,
 	entry->proto = L4PROTO_UDP;
 	entry->state = ESTABLISHED;
 	entry->timer_type = SESSION_TIMER_EST;
+	entry->creation_time = jiffies;
 	entry->update_time = jiffies;
 	entry->timeout = UDP_DEFAULT;
 	entry->has_stored = false;
@@ -250,6 +251,368 @@ static bool simple_session(void)
 	return success;
 }
 
+/* Big table helpers */
+
+#define RESYNC_SESSIONS 1000
+
+static void init_resync_session(struct session_entry *entry, unsigned int i)
+{
+	memset(entry, 0, sizeof(*entry));
+	init_src6(&entry->src6, i, i);
+	init_dst6(&entry->dst6, 1, 80);
+	init_src4(&entry->src4, i >> 8, 1024 + (i & 0xFFu));
+	init_dst4(&entry->dst4, 1, 80);
+	entry->proto = PROTO;
+	entry->state = ESTABLISHED;
+	entry->timer_type = SESSION_TIMER_EST;
+	entry->creation_time = jiffies;
+	entry->update_time = jiffies;
+	entry->timeout = UDP_DEFAULT;
+	entry->has_stored = false;
+}
+
+static int add_resync_session(struct xlator *instance, unsigned int i)
+{
+	struct session_entry entry;
+
+	init_resync_session(&entry, i);
+	return bib_add_session(instance, &entry, NULL);
+}
+
+/* Windowed dump test */
+
+#define DUMP_SESSIONS 1024
+#define DUMP_INSERTIONS 20
+
+static unsigned int dump_seen[DUMP_SESSIONS];
+static enum {
+	DUMP_LIVE,
+	DUMP_RM_BEHIND,
+	DUMP_RM_AHEAD,
+} dump_fate[DUMP_SESSIONS];
+
+struct dump_args {
+	bool started;
+	unsigned int last;
+	bool ordered;
+};
+
+static unsigned int session2index(struct session_entry const *session)
+{
+	return be32_to_cpu(session->src6.l3.s6_addr32[3]);
+}
+
+static int dump_cb(struct session_entry const *session, void *arg)
+{
+	struct dump_args *args = arg;
+	unsigned int i;
+
+	i = session2index(session);
+	if (i >= DUMP_SESSIONS)
+		return -EINVAL;
+
+	if (args->started && i <= args->last)
+		args->ordered = false;
+	args->started = true;
+	args->last = i;
+	dump_seen[i]++;
+	return 0;
+}
+
+static int rm_resync_session(struct xlator *instance, unsigned int i)
+{
+	struct bib_entry bib;
+
+	init_src6(&bib.addr6, i, i);
+	init_src4(&bib.addr4, i >> 8, 1024 + (i & 0xFFu));
+	bib.l4_proto = PROTO;
+	bib.is_static = false;
+	return bib_rm(instance, &bib);
+}
+
+/*
+ * Simulates traffic between the windows of a dump: Sessions die on both sides
+ * of the cursor, and new ones show up ahead of it.
+ */
+static bool test_dump(void)
+{
+	struct session_dump dump;
+	struct dump_args args;
+	unsigned int inserted;
+	unsigned int i;
+	int error;
+	bool success = true;
+
+	memset(dump_seen, 0, sizeof(dump_seen));
+	memset(dump_fate, 0, sizeof(dump_fate));
+	for (i = 0; i < RESYNC_SESSIONS; i++)
+		success &= ASSERT_INT(0, add_resync_session(&jool, i),
+				"add %u", i);
+	if (!success)
+		return false;
+
+	args.started = false;
+	args.last = 0;
+	args.ordered = true;
+	inserted = 0;
+
+	bib_dump_init(&dump, PROTO, NULL, NULL);
+	do {
+		error = bib_dump_window(&jool, &dump, dump_cb, &args);
+		if (!ASSERT_INT(0, error, "window %u", dump.windows))
+			return false;
+		if (dump.done || !args.started)
+			continue;
+
+		/* Expire one session behind the cursor... */
+		i = args.last;
+		if (dump_fate[i] == DUMP_LIVE) {
+			success &= ASSERT_INT(0, rm_resync_session(&jool, i),
+					"rm behind %u", i);
+			dump_fate[i] = DUMP_RM_BEHIND;
+		}
+		/* ...one ahead of it... */
+		i = args.last + 5;
+		if (i < RESYNC_SESSIONS && dump_fate[i] == DUMP_LIVE) {
+			success &= ASSERT_INT(0, rm_resync_session(&jool, i),
+					"rm ahead %u", i);
+			dump_fate[i] = DUMP_RM_AHEAD;
+		}
+		/* ...and create one, also ahead. */
+		if (inserted < DUMP_INSERTIONS) {
+			i = RESYNC_SESSIONS + inserted;
+			success &= ASSERT_INT(0, add_resync_session(&jool, i),
+					"insert %u", i);
+			inserted++;
+		}
+	} while (!dump.done);
+
+	log_info("Dump: %u windows; longest lock hold: %lld ns.",
+			dump.windows, dump.max_hold_ns);
+
+	success &= ASSERT_BOOL(true, dump.windows > 1, "windows (%u)",
+			dump.windows);
+	success &= ASSERT_BOOL(true, args.ordered, "tree4 order");
+	success &= ASSERT_UINT(DUMP_INSERTIONS, inserted, "insertions");
+
+	for (i = 0; i < RESYNC_SESSIONS + inserted; i++) {
+		/* Sessions that died ahead of the cursor must not be seen. */
+		success &= ASSERT_UINT(
+				(dump_fate[i] == DUMP_RM_AHEAD) ? 0 : 1,
+				dump_seen[i], "seen %u", i);
+	}
+
+	bib_flush(&jool);
+	return success;
+}
+
+static bool test_stats(void)
+{
+	struct session_stats stats;
+	unsigned int i;
+	bool success = true;
+
+	for (i = 0; i < 10; i++)
+		success &= ASSERT_INT(0, add_resync_session(&jool, i),
+				"add %u", i);
+	success &= ASSERT_INT(0, rm_resync_session(&jool, 3), "rm");
+
+	success &= ASSERT_INT(0, bib_session_stats(&jool, PROTO, &stats),
+			"stats");
+	success &= ASSERT_UINT(9, stats.bibs, "BIB entries");
+	success &= ASSERT_UINT(9, stats.sessions, "sessions");
+	success &= ASSERT_UINT(9, stats.est, "EST timer");
+	success &= ASSERT_UINT(0, stats.trans, "TRANS timer");
+	success &= ASSERT_UINT(9, stats.states[ESTABLISHED], "ESTABLISHED");
+
+	bib_flush(&jool);
+
+	success &= ASSERT_INT(0, bib_session_stats(&jool, PROTO, &stats),
+			"stats after flush");
+	success &= ASSERT_UINT(0, stats.bibs, "flushed BIB entries");
+	success &= ASSERT_UINT(0, stats.sessions, "flushed sessions");
+	success &= ASSERT_UINT(0, stats.states[ESTABLISHED],
+			"flushed ESTABLISHED");
+
+	return success;
+}
+
+static bool test_bulk_add(void)
+{
+	struct session_entry entries[5];
+	int errors[ARRAY_SIZE(entries)];
+	struct session_stats stats;
+	unsigned int i;
+	bool success = true;
+
+	success &= ASSERT_INT(0, add_resync_session(&jool, 4), "add 4");
+
+	for (i = 0; i < ARRAY_SIZE(entries); i++) {
+		init_resync_session(&entries[i], i);
+		errors[i] = 0;
+	}
+	/* Already rejected by the parser; must not be touched. */
+	errors[1] = -EINVAL;
+
+	bib_add_session_bulk(&jool, entries, ARRAY_SIZE(entries), errors);
+
+	success &= ASSERT_INT(0, errors[0], "errors[0]");
+	success &= ASSERT_INT(-EINVAL, errors[1], "errors[1]");
+	success &= ASSERT_INT(0, errors[2], "errors[2]");
+	success &= ASSERT_INT(0, errors[3], "errors[3]");
+	success &= ASSERT_INT(-EEXIST, errors[4], "errors[4]");
+
+	success &= ASSERT_INT(0, bib_session_stats(&jool, PROTO, &stats),
+			"stats");
+	success &= ASSERT_UINT(4, stats.bibs, "BIB entries");
+	success &= ASSERT_UINT(4, stats.sessions, "sessions");
+
+	bib_flush(&jool);
+	return success;
+}
+
+static bool test_evict(void)
+{
+	struct session_entry entry;
+	struct session_stats stats;
+	unsigned int i;
+	bool success = true;
+
+	/* Session 0 is the oldest one. */
+	for (i = 0; i < 10; i++) {
+		init_resync_session(&entry, i);
+		entry.update_time = jiffies - 10 + i;
+		success &= ASSERT_INT(0, bib_add_session(&jool, &entry, NULL),
+				"add %u", i);
+	}
+
+	success &= ASSERT_ULONG(10ul, bib_count_evictable(&jool), "evictable");
+	success &= ASSERT_ULONG(4ul, bib_evict(&jool, 4), "evicted");
+
+	success &= ASSERT_INT(0, bib_session_stats(&jool, PROTO, &stats),
+			"stats");
+	success &= ASSERT_UINT(6, stats.bibs, "BIB entries");
+	success &= ASSERT_UINT(6, stats.sessions, "sessions");
+	for (i = 0; i < 4; i++)
+		success &= ASSERT_INT(-ESRCH, rm_resync_session(&jool, i),
+				"evicted %u", i);
+	for (i = 4; i < 10; i++)
+		success &= ASSERT_INT(0, rm_resync_session(&jool, i),
+				"survivor %u", i);
+
+	bib_flush(&jool);
+	return success;
+}
+
+static bool test_touch(void)
+{
+	struct session_entry entry;
+	struct session_entry touches[5];
+	int errors[ARRAY_SIZE(touches)];
+	unsigned int i;
+	bool success = true;
+
+	/* Session 0 is the oldest one. */
+	for (i = 0; i < 5; i++) {
+		init_resync_session(&entry, i);
+		entry.update_time = jiffies - 100 + i;
+		success &= ASSERT_INT(0, bib_add_session(&jool, &entry, NULL),
+				"add %u", i);
+	}
+
+	/* Oldest first, the way jool-xdp sends them. */
+	init_resync_session(&touches[0], 1);
+	touches[0].update_time = jiffies - 200; /* Stale; ignored */
+	init_resync_session(&touches[1], 0);
+	touches[1].update_time = jiffies - 2;
+	init_resync_session(&touches[2], 1);
+	touches[2].update_time = jiffies - 1;
+	init_resync_session(&touches[3], 9); /* Doesn't exist */
+	touches[3].update_time = jiffies;
+	init_resync_session(&touches[4], 2);
+	touches[4].update_time = jiffies;
+
+	for (i = 0; i < ARRAY_SIZE(touches); i++)
+		errors[i] = 0;
+	/* Already rejected by the parser; must not be touched. */
+	errors[4] = -EINVAL;
+
+	bib_touch_session_bulk(&jool, touches, ARRAY_SIZE(touches), errors);
+
+	success &= ASSERT_INT(0, errors[0], "errors[0]");
+	success &= ASSERT_INT(0, errors[1], "errors[1]");
+	success &= ASSERT_INT(0, errors[2], "errors[2]");
+	success &= ASSERT_INT(-ESRCH, errors[3], "errors[3]");
+	success &= ASSERT_INT(-EINVAL, errors[4], "errors[4]");
+
+	/* The untouched sessions are the oldest ones now. */
+	success &= ASSERT_ULONG(3ul, bib_evict(&jool, 3), "evicted");
+	for (i = 2; i < 5; i++)
+		success &= ASSERT_INT(-ESRCH, rm_resync_session(&jool, i),
+				"evicted %u", i);
+	for (i = 0; i < 2; i++)
+		success &= ASSERT_INT(0, rm_resync_session(&jool, i),
+				"touched %u", i);
+
+	bib_flush(&jool);
+	return success;
+}
+
+static bool assert_est_timeout(__u32 expected, char *name)
+{
+	struct session_stats stats;
+	bool success = true;
+
+	success &= ASSERT_INT(0, bib_session_stats(&jool, PROTO, &stats),
+			"%s stats", name);
+	success &= ASSERT_UINT(expected, stats.est_timeout, "%s timeout", name);
+	return success;
+}
+
+static bool test_adaptive_timeouts(void)
+{
+	struct session_stats stats;
+	unsigned int i;
+	bool success = true;
+
+	jool.globals.nat64.bib.high_water.udp = 8;
+
+	/* Half the mark; not adapted yet. */
+	for (i = 0; i < 4; i++)
+		success &= ASSERT_INT(0, add_resync_session(&jool, i),
+				"add %u", i);
+	success &= assert_est_timeout(1000 * UDP_DEFAULT, "half");
+
+	/* Three quarters; somewhere in between. */
+	for (; i < 6; i++)
+		success &= ASSERT_INT(0, add_resync_session(&jool, i),
+				"add %u", i);
+	success &= ASSERT_INT(0, bib_session_stats(&jool, PROTO, &stats),
+			"3/4 stats");
+	success &= ASSERT_BOOL(true, stats.est_timeout < 1000 * UDP_DEFAULT,
+			"3/4 below configured");
+	success &= ASSERT_BOOL(true, stats.est_timeout
+			> 1000 * UDP_DEFAULT / ADAPTIVE_TIMEOUT_DIVISOR,
+			"3/4 above floor");
+
+	/* At the mark, and beyond. */
+	for (; i < 10; i++)
+		success &= ASSERT_INT(0, add_resync_session(&jool, i),
+				"add %u", i);
+	success &= assert_est_timeout(1000 * UDP_DEFAULT
+			/ ADAPTIVE_TIMEOUT_DIVISOR, "full");
+
+	/* Drained. */
+	for (i = 0; i < 6; i++)
+		success &= ASSERT_INT(0, rm_resync_session(&jool, i),
+				"rm %u", i);
+	success &= assert_est_timeout(1000 * UDP_DEFAULT, "drained");
+
+	jool.globals.nat64.bib.high_water.udp = 0;
+	bib_flush(&jool);
+	return success;
+}
+
 enum session_fate tcp_est_expire_cb(struct session_entry *session, void *arg)
 {
 	return FATE_RM;
@@ -279,6 +642,12 @@ int init_module(void)
 		return -EINVAL;
 
 	test_group_test(&test, simple_session, "Single Session");
+	test_group_test(&test, test_dump, "Windowed dump");
+	test_group_test(&test, test_stats, "Counters");
+	test_group_test(&test, test_bulk_add, "Bulk add");
+	test_group_test(&test, test_evict, "Eviction");
+	test_group_test(&test, test_touch, "Touch");
+	test_group_test(&test, test_adaptive_timeouts, "Adaptive timeouts");
 
 	return test_group_end(&test);
 }
@@ -44,6 +44,7 @@ static bool inject(unsigned int index, __u32 src_addr, __u16 src_id,
 	entry->proto = L4PROTO_UDP;
 	entry->state = ESTABLISHED;
 	entry->timer_type = SESSION_TIMER_EST;
+	entry->creation_time = jiffies;
 	entry->update_time = jiffies;
 	entry->timeout = UDP_DEFAULT;
 	entry->has_stored = false;
@@ -270,6 +271,115 @@ static bool test_foreach(void)
 	return success;
 }
 
+struct filter_args {
+	unsigned int const *expected;
+	unsigned int count;
+	unsigned int i;
+};
+
+static int filter_cb(struct session_entry const *session, void *void_args)
+{
+	struct filter_args *args = void_args;
+	bool success = true;
+
+	success &= ASSERT_BOOL(true, args->i < args->count, "overflow");
+	if (success)
+		success &= ASSERT_SESSION(&entries[args->expected[args->i]],
+				session, "Session");
+
+	args->i++;
+	return success ? 0 : -EINVAL;
+}
+
+static bool test_filter(struct table_filter *filter,
+		struct session_foreach_offset *offset,
+		unsigned int const *expected, unsigned int count,
+		char const *name)
+{
+	struct filter_args args;
+	int error;
+	bool success = true;
+
+	args.expected = expected;
+	args.count = count;
+	args.i = 0;
+	error = bib_foreach_session_filtered(&jool, L4PROTO_UDP, filter,
+			filter_cb, &args, offset);
+	success &= ASSERT_INT(0, error, "%s result", name);
+	success &= ASSERT_UINT(count, args.i, "%s counter", name);
+
+	return success;
+}
+
+static bool test_foreach_filtered(void)
+{
+	static unsigned int const range[] = { 2, 3, 4, 5, 6 };
+	static unsigned int const ports[] = { 1, 8 };
+	static unsigned int const dst4[] = { 3, 4, 5 };
+	static unsigned int const src6[] = { 8 };
+	static unsigned int const offset[] = { 5, 6, 7 };
+	struct table_filter filter;
+	struct session_foreach_offset off;
+	bool success = true;
+
+	if (!insert_test_sessions())
+		return false;
+
+	/* src4 range; has to seek in and stop early. */
+	memset(&filter, 0, sizeof(filter));
+	filter.src4.set = true;
+	filter.src4.prefix.addr.s_addr = cpu_to_be32(0xcb007102u);
+	filter.src4.prefix.len = 32;
+	filter.ports_set = true;
+	filter.port_min = 200;
+	filter.port_max = 200;
+	success &= test_filter(&filter, NULL, range, ARRAY_SIZE(range),
+			"src4 range");
+
+	/* Port range only; has to seek once per address. */
+	memset(&filter, 0, sizeof(filter));
+	filter.ports_set = true;
+	filter.port_min = 100;
+	filter.port_max = 100;
+	success &= test_filter(&filter, NULL, ports, ARRAY_SIZE(ports),
+			"ports");
+
+	/* src4 range, plus an offset that lies inside of it. */
+	memset(&filter, 0, sizeof(filter));
+	filter.src4.set = true;
+	filter.src4.prefix.addr.s_addr = cpu_to_be32(0xcb007102u);
+	filter.src4.prefix.len = 32;
+	off.offset.src = entries[4].src4;
+	off.offset.dst = entries[4].dst4;
+	off.include_offset = false;
+	success &= test_filter(&filter, &off, offset, ARRAY_SIZE(offset),
+			"offset");
+
+	memset(&filter, 0, sizeof(filter));
+	filter.dst4.set = true;
+	filter.dst4.prefix.addr.s_addr = cpu_to_be32(0xc0000202u);
+	filter.dst4.prefix.len = 32;
+	success &= test_filter(&filter, NULL, dst4, ARRAY_SIZE(dst4), "dst4");
+
+	memset(&filter, 0, sizeof(filter));
+	filter.src6.set = true;
+	init_src6(&filter.src6.prefix.addr, 3);
+	filter.src6.prefix.len = 128;
+	success &= test_filter(&filter, NULL, src6, ARRAY_SIZE(src6), "src6");
+
+	memset(&filter, 0, sizeof(filter));
+	filter.state_set = true;
+	filter.state = V4_INIT;
+	success &= test_filter(&filter, NULL, NULL, 0, "state");
+
+	/* The sessions were just created. */
+	memset(&filter, 0, sizeof(filter));
+	filter.min_age = 60000;
+	success &= test_filter(&filter, NULL, NULL, 0, "min age");
+
+	return success;
+}
+
 enum session_fate tcp_est_expire_cb(struct session_entry *session, void *arg)
 {
 	return FATE_RM;
@@ -299,6 +409,7 @@ int init_module(void)
 		return -EINVAL;
 
 	test_group_test(&test, test_foreach, "Foreach");
+	test_group_test(&test, test_foreach_filtered, "Filtered foreach");
 
 	return test_group_end(&test);
 }
@@ -18,6 +18,11 @@ xlator_type xlator_get_type(struct xlator const *instance)
 	return XT_SIIT;
 }
 
+void bib_cache_route(struct xlation *state, struct session_route const *route)
+{
+	log_err("bib_cache_route() was called from SIIT code.");
+}
+
 static bool test_function_has_unexpired_src_route(void)
 {
 	struct iphdr *hdr = kmalloc(60, GFP_ATOMIC); /* 60 is the max value allowed by hdr.ihl. */
@@ -347,6 +352,141 @@ static bool test_function_icmp4_minimum_mtu(void)
 	return success;
 }
 
+static bool test_function_xlat_in_place(void)
+{
+	static struct xlator jool;
+	static struct xlation state;
+	struct sk_buff *skb;
+	struct sk_buff *clone;
+	bool success = true;
+
+	memset(&jool, 0, sizeof(jool));
+	xlation_init(&state, &jool);
+	if (create_skb4_tcp("1.1.1.1", 1111, "2.2.2.2", 2222, 100, 32, &skb))
+		return false;
+	if (pkt_init_ipv4(&state, skb)) {
+		kfree_skb(skb);
+		return false;
+	}
+
+	success &= ASSERT_BOOL(false, can_xlat_in_place46(&state), "Disabled");
+
+	state.jool.globals.xlat_in_place = true;
+	success &= ASSERT_BOOL(true, can_xlat_in_place46(&state), "Enabled");
+
+	pkt_ip4_hdr(&state.in)->ttl = 1;
+	success &= ASSERT_BOOL(false, can_xlat_in_place46(&state), "TTL 1");
+	pkt_ip4_hdr(&state.in)->ttl = 32;
+
+	clone = skb_clone(skb, GFP_KERNEL);
+	if (clone) {
+		success &= ASSERT_BOOL(false, can_xlat_in_place46(&state), "Cloned");
+		kfree_skb(clone);
+	}
+
+	/* The backup must survive the rewriting of the skb's headers. */
+	success &= ASSERT_PTR(skb, ttpcomm_xlat_in_place(&state), "Same skb");
+	success &= ASSERT_BOOL(true, state.in_place, "In place flag");
+	memset(skb_network_header(skb), 0, 40);
+	success &= ASSERT_UINT(32, pkt_ip4_hdr(&state.in)->ttl, "Backup TTL");
+	success &= ASSERT_BE16(1111, pkt_tcp_hdr(&state.in)->source, "Backup port");
+	success &= ASSERT_UINT(20, pkt_l3hdr_len(&state.in), "Backup l3 length");
+	success &= ASSERT_UINT(20, pkt_l4hdr_len(&state.in), "Backup l4 length");
+
+	kfree_skb(skb);
+	return success;
+}
+
+/* Pretends 192.0.2.1 is pool4's only address. (See is_hairpin_nat64().) */
+static bool is_hairpin_pool4(struct xlation *state)
+{
+	return state->out.tuple.l3_proto == L3PROTO_IPV4
+			&& state->out.tuple.dst.addr4.l3.s_addr
+				== cpu_to_be32(0xc0000201u);
+}
+
+static bool test_function_xlat_in_place_hairpin(void)
+{
+	static struct xlator jool;
+	static struct xlation state;
+	struct sk_buff *skb;
+	bool success = true;
+
+	memset(&jool, 0, sizeof(jool));
+	jool.globals.xlat_in_place = true;
+	jool.is_hairpin = is_hairpin_pool4;
+	xlation_init(&state, &jool);
+	if (create_skb6_tcp("2001:db8::1", 1111, "64:ff9b::c000:201", 80, 100,
+			32, &skb))
+		return false;
+	if (pkt_init_ipv6(&state, skb)) {
+		kfree_skb(skb);
+		return false;
+	}
+
+	/* First pass; the second one hasn't set state.is_hairpin yet. */
+	state.out.tuple.l3_proto = L3PROTO_IPV4;
+	state.out.tuple.l4_proto = L4PROTO_TCP;
+	state.out.tuple.dst.addr4.l3.s_addr = cpu_to_be32(0xcb007105u);
+	success &= ASSERT_BOOL(true, can_xlat_in_place64(&state), "Not hairpin");
+
+	state.out.tuple.dst.addr4.l3.s_addr = cpu_to_be32(0xc0000201u);
+	success &= ASSERT_BOOL(false, can_xlat_in_place64(&state), "Hairpin");
+
+	kfree_skb(skb);
+	return success;
+}
+
+/*
+ * The translated packet's CHECKSUM_COMPLETE sum has to match what the NIC would
+ * have computed had it received the translated packet instead.
+ */
+static bool test_function_update_skb_csum(void)
+{
+	static struct xlator jool;
+	static struct xlation state;
+	struct sk_buff *in;
+	struct sk_buff *out;
+	bool success = true;
+
+	memset(&jool, 0, sizeof(jool));
+	xlation_init(&state, &jool);
+
+	if (create_skb4_tcp("192.0.2.1", 1111, "198.51.100.2", 2222, 101, 32,
+			&in))
+		return false;
+	if (create_skb6_tcp("2001:db8::1", 1111, "2001:db8::2", 2222, 101, 31,
+			&out)) {
+		kfree_skb(in);
+		return false;
+	}
+	if (pkt_init_ipv4(&state, in))
+		goto end;
+	pkt_fill(&state.out, out, L3PROTO_IPV6, L4PROTO_TCP, NULL,
+			skb_transport_header(out) + sizeof(struct tcphdr),
+			NULL);
+
+	in->ip_summed = CHECKSUM_COMPLETE;
+	in->csum = skb_checksum(in, 0, in->len, 0);
+	out->ip_summed = CHECKSUM_COMPLETE;
+	out->csum = in->csum;
+
+	ttpcomm_update_skb_csum(&state);
+	success &= ASSERT_UINT(CHECKSUM_COMPLETE, out->ip_summed, "ip_summed");
+	success &= ASSERT_UINT(csum_fold(skb_checksum(out, 0, out->len, 0)),
+			csum_fold(out->csum), "Sum");
+
+	out->ip_summed = CHECKSUM_UNNECESSARY;
+	ttpcomm_update_skb_csum(&state);
+	success &= ASSERT_UINT(CHECKSUM_UNNECESSARY, out->ip_summed,
+			"Unnecessary stays");
+
+end:
+	kfree_skb(out);
+	kfree_skb(in);
+	return success;
+}
+
 int init_module(void)
 {
 	struct test_group test = {
@@ -365,6 +505,9 @@ int init_module(void)
 	test_group_test(&test, test_function_build_protocol_field, "Build protocol function");
 	test_group_test(&test, test_function_has_nonzero_segments_left, "Segments left indicator function");
 	test_group_test(&test, test_function_icmp4_minimum_mtu, "ICMP4 Minimum MTU function");
+	test_group_test(&test, test_function_xlat_in_place, "In-place translation");
+	test_group_test(&test, test_function_xlat_in_place_hairpin, "In-place hairpin");
+	test_group_test(&test, test_function_update_skb_csum, "CHECKSUM_COMPLETE update");
 
 	return test_group_end(&test);
 }